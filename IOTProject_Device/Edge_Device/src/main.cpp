@@ -3,9 +3,12 @@
 #include <BH1750.h>
 #include <DHT20.h>
 #include <WiFi.h>
-#include <PubSubClient.h>
+#include <PubSubClientPool.h>
+#include <AdaptiveSampling.h>
 #include <esp_now.h>
 #include <esp_wifi.h>
+#include <sys/time.h>
+#include <time.h>
 
 #include "cnn_outputs_humidity_model_data.h"
 #include "cnn_outputs_temperature_model_data.h"
@@ -20,6 +23,7 @@
 #include "temperature_model_data.h"
 
 #define N_STEPS 10
+#define MODEL_STEP_MS 5000 // sampling period the models were trained on
 #define SDA 8
 #define SCL 9
 
@@ -67,17 +71,31 @@ int readingCountTemperature = 0;
 float hum = 0.0f; // Humidity value
 float temp = 0.0f; // Temperature value
 float light = 0.0f; // Light value
+uint32_t interval = 0; // Node sampling interval in ms
+uint32_t captureTime = 0; // Capture time of the last sample on the gateway millis() timeline
+
+// Per-sender estimate of (gateway millis - node millis)
+int32_t clockOffset[2] = {0, 0};
+bool hasClockOffset[2] = {false, false};
+uint32_t lastCaptureMs[2];
+
+// Per-sender state for resampling adaptive-rate samples onto the MODEL_STEP_MS grid
+grid_resampler resampler[2];
 
 
 //Begin libraries
-WiFiClient espClient;
-PubSubClient client(espClient);
+// One MQTT session per sender token; sessions share one buffer arena
+WiFiClient netClients[MQTT_POOL_SIZE];
+PubSubClientPool mqttPool;
 
 unsigned long lastPublish = 0;
 const unsigned long publishInterval = 2500;
 
 void tryConnectWiFi(const char* ssid, const char* password, const char* label);
-void reconnect(char * mqtt_token);
+void serviceMqtt();
+#ifdef MQTT_METRICS
+void publishMetrics(int index, PubSubClient* session);
+#endif
 void setupModel();
 
 uint8_t senderAddress[2][6] = {
@@ -92,11 +110,26 @@ typedef struct struct_message {
     float temperature;
     float humidity;
     float light;
+    uint32_t interval_ms; // time the node waited since its previous sample
+    uint32_t capture_ms;  // node millis() when the sensors were read
+    uint32_t send_ms;     // node millis() when this copy of the frame was sent
+    uint32_t rtt_ms;      // node send-to-ACK time of its previous delivered frame
 } struct_message;
 
 struct_message myData;
 bool received[2] = {false, false};
 
+// Telemetry waiting for an MQTT session with the sender's token
+char pendingPayload[2][200];
+char pendingToken[2][50];
+bool pending[2] = {false, false};
+
+#ifdef MQTT_METRICS
+// MQTT session health, reported as client attributes of each sender's device
+unsigned long lastMetricsPublish[2] = {0, 0};
+const unsigned long metricsInterval = 60000;
+#endif
+
 void printMAC(const uint8_t * mac_addr){
   char macStr[18];
   snprintf(macStr, sizeof(macStr), "%02x:%02x:%02x:%02x:%02x:%02x",
@@ -104,9 +137,31 @@ void printMAC(const uint8_t * mac_addr){
   Serial.println(macStr);
 }
 
+// Offset samples further than this from the estimate cannot come from the same node clock
+#define CLOCK_JUMP_MS 2000
+// Most the estimate follows a later offset sample per frame, crystal drift stays far below it
+#define CLOCK_DRIFT_STEP_MS 2
+
+// Track the node clock offset from one-way delay samples. Queuing and retries only ever
+// add delay, so the minimum sample is kept and later samples only nudge it up to follow drift.
+void updateClockOffset(int index, int32_t sample) {
+  if (!hasClockOffset[index] || sample < clockOffset[index]) {
+    clockOffset[index] = sample;
+    hasClockOffset[index] = true;
+  } else if (sample > clockOffset[index]) {
+    clockOffset[index] += min(sample - clockOffset[index], (int32_t)CLOCK_DRIFT_STEP_MS);
+  }
+}
+
 void OnDataRecv(const uint8_t * mac_addr, const uint8_t *incomingData, int len) {
+  uint32_t rx_ms = millis();
   Serial.print("Packet received from: ");
   printMAC(mac_addr);
+  if (len != sizeof(struct_message)) {
+    Serial.print("Dropping frame of unexpected length: ");
+    Serial.println(len);
+    return;
+  }
   for(int i = 0; i < 2; i++) {
     if (memcmp(mac_addr, senderAddress[i], 6) == 0) {
       memcpy(&myData, incomingData, sizeof(struct_message));
@@ -121,6 +176,27 @@ void OnDataRecv(const uint8_t * mac_addr, const uint8_t *incomingData, int len)
       hum = myData.humidity;
       temp = myData.temperature;
       light = myData.light;
+      int32_t sample = (int32_t)(rx_ms - myData.send_ms - myData.rtt_ms / 2);
+      bool seen = hasClockOffset[i];
+      if (seen) {
+        int32_t jump = (int32_t)((uint32_t)sample - (uint32_t)clockOffset[i]);
+        if ((int32_t)(myData.capture_ms - lastCaptureMs[i]) < 0 || jump > CLOCK_JUMP_MS || jump < -CLOCK_JUMP_MS) {
+          // The node restarted and its millis() started over, forget what was learned about its clock
+          Serial.println("Sender clock restarted");
+          seen = false;
+          hasClockOffset[i] = false;
+        }
+      }
+      updateClockOffset(i, sample);
+      if (seen && myData.capture_ms == lastCaptureMs[i]) {
+        // Retry of a frame we already have (its ACK was lost); only the offset sample is new
+        continue;
+      }
+      // Prefer the true capture spacing; the node's interval excludes retry time.
+      // An interval of 0 starts a new resampling grid for a new or restarted sender.
+      interval = seen ? myData.capture_ms - lastCaptureMs[i] : 0;
+      lastCaptureMs[i] = myData.capture_ms;
+      captureTime = myData.capture_ms + clockOffset[i];
       received[i] = true;
     }
   }
@@ -170,17 +246,55 @@ void init_ESPNOW() {
 }
 
 
+void updateTemperatureBuffer(float new_val, int index);
+void updateHumidityBuffer(float new_val, int index);
+float runTemperatureInference(int index);
+float runHumidityInference(int index);
+
+// Linearly interpolate the samples of sender `index` onto the fixed model grid.
+// Returns the number of grid points pushed into the model buffers.
+int resampleToGrid(int index, float temperature, float humidity, uint32_t interval_ms) {
+  float temperatures[N_STEPS];
+  float humidities[N_STEPS];
+  int pushed = resample_to_grid(&resampler[index], temperature, humidity, interval_ms, temperatures, humidities, N_STEPS);
+  for (int i = 0; i < pushed; i++) {
+    updateTemperatureBuffer(temperatures[i], index);
+    updateHumidityBuffer(humidities[i], index);
+  }
+  return pushed;
+}
+
+// Convert a gateway millis() timestamp to Unix epoch ms, or 0 if SNTP has not synced yet
+uint64_t toEpochMs(uint32_t gateway_ms) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  if (now.tv_sec < 1600000000) return 0;
+  uint64_t now_ms = (uint64_t)now.tv_sec * 1000ULL + now.tv_usec / 1000;
+  return now_ms - (uint32_t)(millis() - gateway_ms);
+}
+
 void setup() {
   Serial.begin(115200);
 
   // ==== Connect Wi-Fi and MQTT ==== 
   tryConnectWiFi(ssid, password, "Hieu");
+  configTime(0, 0, "pool.ntp.org");
   init_ESPNOW();
 
   // ==== Begin AI models ==== 
   setupModel();
+  for (int i = 0; i < 2; i++) {
+    // After an outage longer than the model window, start over instead of inventing the gap
+    init_grid_resampler(&resampler[i], MODEL_STEP_MS, N_STEPS * MODEL_STEP_MS);
+  }
 
-  client.setServer(MQTT_SERVER, MQTT_PORT);
+  for (int i = 0; i < MQTT_POOL_SIZE; i++) {
+    mqttPool.addClient(netClients[i]);
+  }
+  mqttPool.setServer(MQTT_SERVER, MQTT_PORT);
+  mqttPool.setBufferSize(512);
+  Serial.print("MQTT bytes per session: ");
+  Serial.println(mqttPool.sessionFootprint());
 
 }
 
@@ -195,47 +309,49 @@ void loop() {
       received[1] = false;
       i = 1;
     }
-    reconnect(myData.mqtt_token);
+    // Resample onto the model grid; a fast node may not have reached the next grid point yet
+    int pushed = resampleToGrid(i, temp, hum, interval);
 
     // Read sensors
     float predictedTemperature = 0.0f;
 
+    readingCountTemperature += pushed;
     if (readingCountTemperature < N_STEPS) {
       predictedTemperature = temp;
-      updateTemperatureBuffer(temp, i);
-      readingCountTemperature++;
     } else {
-      updateTemperatureBuffer(temp, i);
       predictedTemperature = runTemperatureInference(i);
     }
 
     //Process the humidity
     float predictedHumidity = 0.0f;
 
-    if (readingCountHumidity < N_STEPS ) {
+    readingCountHumidity += pushed;
+    if (readingCountHumidity < N_STEPS) {
       predictedHumidity = hum;
-      updateHumidityBuffer(hum, i);
-      readingCountHumidity++;
     } else {
-      updateHumidityBuffer(hum, i);
       predictedHumidity = runHumidityInference(i);
     }
 
     // JSON payload
-    char payload[160];
-    snprintf(payload, sizeof(payload),
-             "{\"temperature\":%.2f,\"predicting_temperature\":%.2f,\"humidity\":%.2f,\"predicting_humidity\":%.2f,\"light\":%.2f}",
-             temp, predictedTemperature, hum, predictedHumidity, light);
-
-    Serial.print("Publishing: ");
-    Serial.println(payload);
-
-    if (client.publish("v1/devices/me/telemetry", payload)) {
-      Serial.println("Publish successful");
+    char *payload = pendingPayload[i];
+    uint64_t ts = toEpochMs(captureTime);
+    if (ts != 0) {
+      snprintf(payload, sizeof(pendingPayload[i]),
+               "{\"ts\":%llu,\"values\":{\"temperature\":%.2f,\"predicting_temperature\":%.2f,\"humidity\":%.2f,\"predicting_humidity\":%.2f,\"light\":%.2f}}",
+               (unsigned long long)ts, temp, predictedTemperature, hum, predictedHumidity, light);
     } else {
-      Serial.println("Publish failed");
+      snprintf(payload, sizeof(pendingPayload[i]),
+               "{\"temperature\":%.2f,\"predicting_temperature\":%.2f,\"humidity\":%.2f,\"predicting_humidity\":%.2f,\"light\":%.2f}",
+               temp, predictedTemperature, hum, predictedHumidity, light);
     }
+
+    // Queue the latest reading; it is published once a session for this token is up
+    strncpy(pendingToken[i], myData.mqtt_token, sizeof(pendingToken[i]) - 1);
+    pendingToken[i][sizeof(pendingToken[i]) - 1] = '\0';
+    pending[i] = true;
   }
+
+  serviceMqtt();
 }
 
 
@@ -260,19 +376,47 @@ void tryConnectWiFi(const char* ssid, const char* password, const char* label) {
 
 
 
-void reconnect(char *mqtt_token) {
-  client.disconnect();
-  while (!client.connected()) {
-    Serial.print("Connecting to MQTT...");
-    if (client.connect("ESP32Client", mqtt_token, NULL)) {
-      Serial.println(" connected.");
+// Drive the MQTT sessions without blocking: publish each pending reading once the
+// session for its token is up. Sessions stay open so senders do not reconnect per reading.
+void serviceMqtt() {
+  for (int i = 0; i < 2; i++) {
+    if (!pending[i]) continue;
+    PubSubClient* session = mqttPool.acquire(pendingToken[i]);
+    if (session == NULL || !session->connected()) continue;
+    pending[i] = false;
+    Serial.print("Publishing: ");
+    Serial.println(pendingPayload[i]);
+    if (session->publish("v1/devices/me/telemetry", pendingPayload[i])) {
+      Serial.println("Publish successful");
     } else {
-      Serial.print(" failed, rc=");
-      Serial.print(client.state());
-      delay(100);
+      Serial.println("Publish failed");
     }
+#ifdef MQTT_METRICS
+    publishMetrics(i, session);
+#endif
   }
+  mqttPool.loop();
+}
+
+#ifdef MQTT_METRICS
+void publishMetrics(int index, PubSubClient* session) {
+  if (millis() - lastMetricsPublish[index] < metricsInterval) return;
+  lastMetricsPublish[index] = millis();
+
+  MQTTMetrics m;
+  session->getMetrics(&m);
+  char attributes[320];
+  snprintf(attributes, sizeof(attributes),
+           "{\"mqtt_connects\":%lu,\"mqtt_connect_failures\":%lu,\"mqtt_connections_lost\":%lu,\"mqtt_timeouts\":%lu,"
+           "\"mqtt_bytes_in\":%lu,\"mqtt_bytes_out\":%lu,\"mqtt_dropped_oversize\":%lu,\"mqtt_retransmits\":%lu,"
+           "\"mqtt_ping_rtt_avg\":%lu,\"mqtt_ping_rtt_max\":%lu}",
+           (unsigned long)m.connects, (unsigned long)m.connectFailures, (unsigned long)m.connectionsLost,
+           (unsigned long)m.timeouts, (unsigned long)m.bytesIn, (unsigned long)m.bytesOut,
+           (unsigned long)m.droppedOversize, (unsigned long)m.retransmits,
+           (unsigned long)(m.pingRtt.count ? m.pingRtt.sum / m.pingRtt.count : 0), (unsigned long)m.pingRtt.max);
+  session->publish("v1/devices/me/attributes", attributes);
 }
+#endif
 
 void setupModel() {
   model_humidity = tflite::GetModel(humidity_model_tflite);
@@ -0,0 +1,150 @@
+#ifndef AdaptiveSampling_h
+#define AdaptiveSampling_h
+
+#include <math.h>
+#include <stdint.h>
+
+// Adaptive sampling: the node shrinks its interval while the signal moves and backs off while it
+// is stable, the gateway resamples the irregular samples onto the fixed grid its models expect.
+// Kept free of Arduino calls so the node, the gateway and the host simulation share one copy.
+
+#ifndef SAMPLE_INTERVAL_MIN_MS
+#define SAMPLE_INTERVAL_MIN_MS   1000
+#endif
+#ifndef SAMPLE_INTERVAL_MAX_MS
+#define SAMPLE_INTERVAL_MAX_MS   30000
+#endif
+#ifndef SAMPLE_INTERVAL_STEP_MS
+#define SAMPLE_INTERVAL_STEP_MS  1000
+#endif
+#ifndef SAMPLE_INTERVAL_START_MS
+#define SAMPLE_INTERVAL_START_MS 5000
+#endif
+#define SAMPLE_WINDOW            8
+
+const float TEMP_VARIANCE_THRESHOLD = 0.05f;  // degC^2
+const float HUM_VARIANCE_THRESHOLD  = 0.50f;  // %RH^2
+const float TEMP_RATE_THRESHOLD     = 0.02f;  // degC per second
+const float HUM_RATE_THRESHOLD      = 0.20f;  // %RH per second
+
+typedef struct sample_window {
+    float values[SAMPLE_WINDOW];
+    int count;
+    int head;
+} sample_window;
+
+typedef struct adaptive_sampler {
+    sample_window temperature;
+    sample_window humidity;
+    uint32_t interval_ms;
+} adaptive_sampler;
+
+// Per-sender state for resampling adaptive-rate samples onto a fixed grid
+typedef struct grid_resampler {
+    uint32_t step_ms;        // grid spacing the models were trained on
+    uint32_t max_gap_ms;     // longer gaps restart the grid instead of being interpolated across
+    float last_temperature;
+    float last_humidity;
+    uint32_t phase_ms;       // ms elapsed since the last grid point
+    bool has_last;
+} grid_resampler;
+
+inline void init_adaptive_sampler(adaptive_sampler *s) {
+  s->temperature = {};
+  s->humidity = {};
+  s->interval_ms = SAMPLE_INTERVAL_START_MS;
+}
+
+inline void push_sample(sample_window *w, float value) {
+  w->values[w->head] = value;
+  w->head = (w->head + 1) % SAMPLE_WINDOW;
+  if (w->count < SAMPLE_WINDOW) w->count++;
+}
+
+inline float window_variance(const sample_window *w) {
+  if (w->count < 2) return 0.0f;
+  float mean = 0.0f;
+  for (int i = 0; i < w->count; i++) mean += w->values[i];
+  mean /= w->count;
+  float var = 0.0f;
+  for (int i = 0; i < w->count; i++) {
+    float d = w->values[i] - mean;
+    var += d * d;
+  }
+  return var / (w->count - 1);
+}
+
+// Rate of change between the two newest samples, per second of the last interval
+inline float window_rate(const sample_window *w, uint32_t interval_ms) {
+  if (w->count < 2 || interval_ms == 0) return 0.0f;
+  int newest = (w->head + SAMPLE_WINDOW - 1) % SAMPLE_WINDOW;
+  int previous = (w->head + SAMPLE_WINDOW - 2) % SAMPLE_WINDOW;
+  return fabsf(w->values[newest] - w->values[previous]) * 1000.0f / interval_ms;
+}
+
+// Halve the interval when either channel is active, otherwise back off linearly
+inline uint32_t next_sample_interval(adaptive_sampler *s, float temperature, float humidity) {
+  push_sample(&s->temperature, temperature);
+  push_sample(&s->humidity, humidity);
+
+  bool active = window_variance(&s->temperature) > TEMP_VARIANCE_THRESHOLD
+             || window_variance(&s->humidity) > HUM_VARIANCE_THRESHOLD
+             || window_rate(&s->temperature, s->interval_ms) > TEMP_RATE_THRESHOLD
+             || window_rate(&s->humidity, s->interval_ms) > HUM_RATE_THRESHOLD;
+
+  if (active) {
+    s->interval_ms = s->interval_ms / 2 > SAMPLE_INTERVAL_MIN_MS ? s->interval_ms / 2 : SAMPLE_INTERVAL_MIN_MS;
+  } else {
+    s->interval_ms = s->interval_ms + SAMPLE_INTERVAL_STEP_MS < SAMPLE_INTERVAL_MAX_MS ? s->interval_ms + SAMPLE_INTERVAL_STEP_MS : SAMPLE_INTERVAL_MAX_MS;
+  }
+  return s->interval_ms;
+}
+
+inline void init_grid_resampler(grid_resampler *r, uint32_t step_ms, uint32_t max_gap_ms) {
+  r->step_ms = step_ms;
+  r->max_gap_ms = max_gap_ms;
+  r->last_temperature = 0.0f;
+  r->last_humidity = 0.0f;
+  r->phase_ms = 0;
+  r->has_last = false;
+}
+
+// Forget the previous sample, the next one starts a new grid
+inline void reset_grid(grid_resampler *r) {
+  r->has_last = false;
+  r->phase_ms = 0;
+}
+
+// Linearly interpolate a sample taken interval_ms after the previous one onto the grid.
+// Writes at most max_points grid points and returns how many were written. A first sample,
+// a zero interval or a gap longer than max_gap_ms restarts the grid at this sample.
+inline int resample_to_grid(grid_resampler *r, float temperature, float humidity, uint32_t interval_ms,
+                            float *temperature_out, float *humidity_out, int max_points) {
+  if (max_points <= 0) return 0;
+  if (!r->has_last || interval_ms == 0 || interval_ms > r->max_gap_ms) {
+    r->has_last = true;
+    r->last_temperature = temperature;
+    r->last_humidity = humidity;
+    r->phase_ms = 0;
+    temperature_out[0] = temperature;
+    humidity_out[0] = humidity;
+    return 1;
+  }
+
+  int pushed = 0;
+  r->phase_ms += interval_ms;
+  while (r->phase_ms >= r->step_ms && pushed < max_points) {
+    r->phase_ms -= r->step_ms;
+    float frac = (float)(interval_ms - r->phase_ms) / interval_ms;
+    temperature_out[pushed] = r->last_temperature + (temperature - r->last_temperature) * frac;
+    humidity_out[pushed] = r->last_humidity + (humidity - r->last_humidity) * frac;
+    pushed++;
+  }
+  // Points beyond max_points would only overwrite the ones just written, drop them
+  r->phase_ms %= r->step_ms;
+  r->last_temperature = temperature;
+  r->last_humidity = humidity;
+  return pushed;
+}
+
+#endif // AdaptiveSampling_h
@@ -470,6 +470,13 @@ int HttpClient::responseStatusCode()
                     timeoutStart = millis();
                 }
             }
+            else if (!iClient->connected())
+            {
+                // The server closed the connection without responding, e.g. a
+                // kept alive connection it had already timed out, so nothing
+                // will arrive anymore
+                return HTTP_ERROR_CONNECTION_FAILED;
+            }
             else
             {
                 // We haven't got any data, so let's pause to allow some to
@@ -11,7 +11,7 @@
 #include "SHT31.h"
 
 
-//  SUPPORTED COMMANDS - single shot mode only
+//  SUPPORTED COMMANDS
 #define SHT31_READ_STATUS       0xF32D
 #define SHT31_CLEAR_STATUS      0x3041
 
@@ -25,6 +25,64 @@
 #define SHT31_HEAT_OFF          0x3066
 #define SHT31_HEATER_TIMEOUT    180000UL   //  milliseconds
 
+#define SHT31_FETCH_DATA        0xE000     //  page 11 datasheet
+#define SHT31_BREAK             0x3093     //  stop periodic mode
+
+//  periodic mode commands, table 9 datasheet
+//  [rate][repeatability] HIGH, MEDIUM, LOW
+static const uint16_t SHT31_PERIODIC_CMD[5][3] =
+{
+  { 0x2032, 0x2024, 0x202F },   //  0.5 mps
+  { 0x2130, 0x2126, 0x212D },   //  1 mps
+  { 0x2236, 0x2220, 0x222B },   //  2 mps
+  { 0x2334, 0x2322, 0x2329 },   //  4 mps
+  { 0x2737, 0x2721, 0x272A }    //  10 mps
+};
+static const uint16_t SHT31_PERIODIC_INTERVAL[5] = { 2000, 1000, 500, 250, 100 };
+
+
+//  CRC-8 lookup, polynomial 0x31, generated at compile time.
+//  entry n is n pushed through 8 bitwise CRC steps, so the first
+//  16 entries double as the nibble table.
+static constexpr uint8_t sht31CrcStep(uint8_t crc)
+{
+  return (crc & 0x80) ? (uint8_t) ((crc << 1) ^ 0x31) : (uint8_t) (crc << 1);
+}
+
+static constexpr uint8_t sht31CrcEntry(uint8_t crc, uint8_t bits = 8)
+{
+  return bits ? sht31CrcEntry(sht31CrcStep(crc), bits - 1) : crc;
+}
+
+#define SHT31_CRC_4(n)    sht31CrcEntry(n), sht31CrcEntry(n + 1), sht31CrcEntry(n + 2), sht31CrcEntry(n + 3)
+#define SHT31_CRC_16(n)   SHT31_CRC_4(n), SHT31_CRC_4(n + 4), SHT31_CRC_4(n + 8), SHT31_CRC_4(n + 12)
+#define SHT31_CRC_64(n)   SHT31_CRC_16(n), SHT31_CRC_16(n + 16), SHT31_CRC_16(n + 32), SHT31_CRC_16(n + 48)
+
+//  define SHT31_CRC_NIBBLE_TABLE to trade speed for 240 bytes of flash
+#ifdef SHT31_CRC_NIBBLE_TABLE
+static constexpr uint8_t SHT31_CRC_TABLE[16] = { SHT31_CRC_16(0) };
+#else
+static constexpr uint8_t SHT31_CRC_TABLE[256] =
+{
+  SHT31_CRC_64(0), SHT31_CRC_64(64), SHT31_CRC_64(128), SHT31_CRC_64(192)
+};
+//  datasheet example: CRC(0xBEEF) = 0x92
+static_assert(SHT31_CRC_TABLE[SHT31_CRC_TABLE[0xFF ^ 0xBE] ^ 0xEF] == 0x92, "SHT31 CRC table");
+#endif
+
+//  two nibble lookups must equal eight bitwise steps for every byte,
+//  checked for all 256 values at compile time.
+static constexpr uint8_t sht31CrcNibble(uint8_t crc)
+{
+  return (uint8_t) ((crc << 4) ^ sht31CrcEntry(crc >> 4));
+}
+
+static constexpr bool sht31CrcNibbleMatches(unsigned n = 0)
+{
+  return (n > 0xFF) || ((sht31CrcNibble(sht31CrcNibble(n)) == sht31CrcEntry(n)) && sht31CrcNibbleMatches(n + 1));
+}
+static_assert(sht31CrcNibbleMatches(), "SHT31 CRC nibble table");
+
 
 SHT31::SHT31(uint8_t address, TwoWire *wire)
 {
@@ -38,6 +96,11 @@ SHT31::SHT31(uint8_t address, TwoWire *wire)
   _heaterStop     = 0;
   _heaterOn       = false;
   _error          = SHT31_OK;
+  _periodic       = false;
+  _periodicInterval = 0;
+  _periodicStart  = 0;
+  _status         = 0;
+  _statusValid    = false;
 }
 
 
@@ -68,6 +131,10 @@ uint8_t SHT31::getAddress()
 
 bool SHT31::read(bool fast)
 {
+  if (_periodic)
+  {
+    return fetchData(fast);
+  }
   if (writeCmd(fast ? SHT31_MEASUREMENT_FAST : SHT31_MEASUREMENT_SLOW) == false)
   {
     return false;
@@ -116,12 +183,8 @@ uint16_t SHT31::readStatus()
 {
   uint8_t status[3] = { 0, 0, 0 };
   //  page 13 datasheet
-  if (writeCmd(SHT31_READ_STATUS) == false)
-  {
-    return 0xFFFF;
-  }
   //  16 bit status + CRC
-  if (readBytes(3, (uint8_t*) &status[0]) == false)
+  if (writeCmdRead(SHT31_READ_STATUS, 3, (uint8_t*) &status[0]) == false)
   {
     return 0xFFFF;
   }
@@ -132,7 +195,19 @@ uint16_t SHT31::readStatus()
     return 0xFFFF;
   }
 
-  return (uint16_t) (status[0] << 8) + status[1];
+  _status      = (uint16_t) (status[0] << 8) + status[1];
+  _statusValid = true;
+  return _status;
+}
+
+
+uint16_t SHT31::getStatus()
+{
+  if (_statusValid)
+  {
+    return _status;
+  }
+  return readStatus();
 }
 
 
@@ -143,6 +218,7 @@ uint16_t SHT31::readStatus()
 //  4   System reset detected
 bool SHT31::clearStatus()
 {
+  _statusValid = false;
   if (writeCmd(SHT31_CLEAR_STATUS) == false)
   {
     return false;
@@ -152,11 +228,14 @@ bool SHT31::clearStatus()
 
 bool SHT31::reset(bool hard)
 {
+  _statusValid = false;
   bool b = writeCmd(hard ? SHT31_HARD_RESET : SHT31_SOFT_RESET);
   if (b == false)
   {
     return false;
   }
+  //  a reset also ends periodic mode
+  _periodic = false;
   delay(1);   //  table 4 datasheet
   return true;
 }
@@ -181,6 +260,7 @@ bool SHT31::heatOn()
     _error = SHT31_ERR_HEATER_COOLDOWN;
     return false;
   }
+  _statusValid = false;
   if (writeCmd(SHT31_HEAT_ON) == false)
   {
     _error = SHT31_ERR_HEATER_ON;
@@ -195,6 +275,7 @@ bool SHT31::heatOn()
 bool SHT31::heatOff()
 {
   //  always switch off the heater - ignore _heaterOn flag.
+  _statusValid = false;
   if (writeCmd(SHT31_HEAT_OFF) == false)
   {
     _error = SHT31_ERR_HEATER_OFF;  // can be serious!
@@ -250,17 +331,18 @@ bool SHT31::readData(bool fast)
   {
     return false;
   }
+  return parseData(buffer, fast);
+}
 
+
+bool SHT31::parseData(const uint8_t *buffer, bool fast)
+{
   if (!fast)
   {
-    if (buffer[2] != crc8(buffer, 2))
+    uint8_t rv = checkCRC(buffer);
+    if (rv != SHT31_OK)
     {
-      _error = SHT31_ERR_CRC_TEMP;
-      return false;
-    }
-    if (buffer[5] != crc8(buffer + 3, 2))
-    {
-      _error = SHT31_ERR_CRC_HUM;
+      _error = rv;
       return false;
     }
   }
@@ -274,6 +356,76 @@ bool SHT31::readData(bool fast)
 }
 
 
+/////////////////////////////////////////////////////////////////
+//
+//  PERIODIC
+//
+bool SHT31::startPeriodic(uint8_t rate, uint8_t repeatability)
+{
+  if ((rate > SHT31_MPS_10) || (repeatability > SHT31_REPEAT_LOW))
+  {
+    _error = SHT31_ERR_PERIODIC;
+    return false;
+  }
+  if (_periodic && (stopPeriodic() == false))
+  {
+    return false;
+  }
+  if (writeCmd(SHT31_PERIODIC_CMD[rate][repeatability]) == false)
+  {
+    return false;
+  }
+  _periodic         = true;
+  _periodicInterval = SHT31_PERIODIC_INTERVAL[rate];
+  _periodicStart    = millis();
+  _lastRequest      = _periodicStart;
+  return true;
+}
+
+
+bool SHT31::stopPeriodic()
+{
+  if (writeCmd(SHT31_BREAK) == false)
+  {
+    return false;
+  }
+  _periodic = false;
+  delay(1);   //  table 4 datasheet
+  return true;
+}
+
+
+bool SHT31::periodicReady()
+{
+  if (_periodic == false) return false;
+  //  first result arrives one interval after start
+  return (millis() - _lastRequest) >= _periodicInterval;
+}
+
+
+bool SHT31::fetchData(bool fast)
+{
+  if (_periodic == false)
+  {
+    _error = SHT31_ERR_PERIODIC;
+    return false;
+  }
+  uint8_t buffer[6];
+  //  sensor NACKs the read header when no new data is available
+  if (writeCmdRead(SHT31_FETCH_DATA, 6, (uint8_t*) &buffer[0]) == false)
+  {
+    if (_error == SHT31_ERR_READBYTES) _error = SHT31_ERR_NOT_READY;
+    return false;
+  }
+  if (parseData(buffer, fast) == false)
+  {
+    return false;
+  }
+  _lastRequest = _lastRead;
+  return true;
+}
+
+
 int SHT31::getError()
 {
   int rv = _error;
@@ -289,22 +441,48 @@ int SHT31::getError()
 uint8_t SHT31::crc8(const uint8_t *data, uint8_t len)
 {
   //  CRC-8 formula from page 14 of SHT spec pdf
-  const uint8_t POLY(0x31);
   uint8_t crc(0xFF);
 
   for (uint8_t j = len; j; --j)
   {
     crc ^= *data++;
-
-    for (uint8_t i = 8; i; --i)
-    {
-      crc = (crc & 0x80) ? (crc << 1) ^ POLY : (crc << 1);
-    }
+#ifdef SHT31_CRC_NIBBLE_TABLE
+    crc = (crc << 4) ^ SHT31_CRC_TABLE[crc >> 4];
+    crc = (crc << 4) ^ SHT31_CRC_TABLE[crc >> 4];
+#else
+    crc = SHT31_CRC_TABLE[crc];
+#endif
   }
   return crc;
 }
 
 
+//  validates both words of a measurement { T, T, CRC, H, H, CRC }
+uint8_t SHT31::checkCRC(const uint8_t *buffer)
+{
+  uint8_t crcT(0xFF);
+  uint8_t crcH(0xFF);
+  //  interleaved so both CRC chains run in one pass
+  for (uint8_t i = 0; i < 2; i++)
+  {
+#ifdef SHT31_CRC_NIBBLE_TABLE
+    crcT ^= buffer[i];
+    crcT = (crcT << 4) ^ SHT31_CRC_TABLE[crcT >> 4];
+    crcT = (crcT << 4) ^ SHT31_CRC_TABLE[crcT >> 4];
+    crcH ^= buffer[i + 3];
+    crcH = (crcH << 4) ^ SHT31_CRC_TABLE[crcH >> 4];
+    crcH = (crcH << 4) ^ SHT31_CRC_TABLE[crcH >> 4];
+#else
+    crcT = SHT31_CRC_TABLE[crcT ^ buffer[i]];
+    crcH = SHT31_CRC_TABLE[crcH ^ buffer[i + 3]];
+#endif
+  }
+  if (crcT != buffer[2]) return SHT31_ERR_CRC_TEMP;
+  if (crcH != buffer[5]) return SHT31_ERR_CRC_HUM;
+  return SHT31_OK;
+}
+
+
 bool SHT31::writeCmd(uint16_t cmd)
 {
   _wire->beginTransmission(_address);
@@ -335,5 +513,20 @@ bool SHT31::readBytes(uint8_t n, uint8_t *val)
 }
 
 
+bool SHT31::writeCmdRead(uint16_t cmd, uint8_t n, uint8_t *val)
+{
+  _wire->beginTransmission(_address);
+  _wire->write(cmd >> 8 );
+  _wire->write(cmd & 0xFF);
+  //  no STOP, requestFrom() follows with a repeated START
+  if (_wire->endTransmission(false) != 0)
+  {
+    _error = SHT31_ERR_WRITECMD;
+    return false;
+  }
+  return readBytes(n, val);
+}
+
+
 //  -- END OF FILE --
 
@@ -39,6 +39,20 @@
 #define SHT31_ERR_CRC_STATUS          0x87
 #define SHT31_ERR_HEATER_COOLDOWN     0x88
 #define SHT31_ERR_HEATER_ON           0x89
+#define SHT31_ERR_PERIODIC            0x8A
+#define SHT31_ERR_NOT_READY           0x8B
+
+//  periodic measurement rates (measurements per second)
+#define SHT31_MPS_0_5                 0
+#define SHT31_MPS_1                   1
+#define SHT31_MPS_2                   2
+#define SHT31_MPS_4                   3
+#define SHT31_MPS_10                  4
+
+//  repeatability
+#define SHT31_REPEAT_HIGH             0
+#define SHT31_REPEAT_MEDIUM           1
+#define SHT31_REPEAT_LOW              2
 
 
 class SHT31
@@ -56,8 +70,13 @@ public:
   bool read(bool fast = true);
 
   //  details see datasheet; summary in SHT31.cpp file
+  //  readStatus() always reads the register and caches it,
+  //  getStatus() only reads it again after invalidateStatus()
+  //  or a command that changes it.
   uint16_t readStatus();
+  uint16_t getStatus();
   bool clearStatus();
+  void invalidateStatus() { _statusValid = false; };
 
   //  lastRead is in milliSeconds since start
   uint32_t lastRead() { return _lastRead; };
@@ -90,6 +109,19 @@ public:
   bool dataReady();
   bool readData(bool fast = true);
 
+  //  PERIODIC INTERFACE
+  //  sensor measures on its own, fetchData() reads the latest result
+  //  without a conversion wait. Single shot, status and heater commands
+  //  are not accepted while periodic mode is running.
+  bool startPeriodic(uint8_t rate = SHT31_MPS_1, uint8_t repeatability = SHT31_REPEAT_HIGH);
+  bool stopPeriodic();
+  bool isPeriodic() { return _periodic; };
+  //  milliseconds between two measurements in periodic mode
+  uint16_t getPeriodicInterval() { return _periodicInterval; };
+  //  true if a new measurement should be available
+  bool periodicReady();
+  bool fetchData(bool fast = true);
+
   int getError();  //  clears error flag
 
 protected:
@@ -103,11 +135,22 @@ protected:
   uint16_t _rawHumidity;
   uint16_t _rawTemperature;
   uint8_t  _error;
+  bool     _periodic;
+  uint16_t _periodicInterval;  //  milliseconds
+  uint32_t _periodicStart;
+  uint16_t _status;
+  bool     _statusValid;
 
-private:
   uint8_t crc8(const uint8_t *data, uint8_t len);
+  //  validates { T, T, CRC, H, H, CRC } in one pass
+  uint8_t checkCRC(const uint8_t *buffer);
+
+private:
+  bool parseData(const uint8_t *buffer, bool fast);
   virtual bool writeCmd(uint16_t cmd);
   virtual bool readBytes(uint8_t n, uint8_t *val);
+  //  command write + repeated start + read in one bus transaction
+  virtual bool writeCmdRead(uint16_t cmd, uint8_t n, uint8_t *val);
   TwoWire* _wire;
 };
 
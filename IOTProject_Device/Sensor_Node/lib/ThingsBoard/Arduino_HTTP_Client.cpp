@@ -23,6 +23,10 @@ void Arduino_HTTP_Client::stop() {
     m_http_client.stop();
 }
 
+bool Arduino_HTTP_Client::connected() {
+    return m_http_client.connected() != 0U;
+}
+
 int Arduino_HTTP_Client::post(const char *url_path, const char *content_type, const char *request_body) {
     return m_http_client.post(url_path, content_type, request_body);
 }
@@ -30,6 +30,8 @@ class Arduino_HTTP_Client : public IHTTP_Client {
 
     void stop() override;
 
+    bool connected() override;
+
     int post(const char *url_path, const char *content_type, const char *request_body) override;
 
     int get_response_status_code() override;
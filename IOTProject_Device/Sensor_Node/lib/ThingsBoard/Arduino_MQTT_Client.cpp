@@ -63,8 +63,6 @@ bool Arduino_MQTT_Client::connected() {
     return m_mqtt_client.connected();
 }
 
-#if THINGSBOARD_ENABLE_STREAM_UTILS
-
 bool Arduino_MQTT_Client::begin_publish(const char *topic, const size_t& length) {
     return m_mqtt_client.beginPublish(topic, length, false);
 }
@@ -73,14 +71,16 @@ bool Arduino_MQTT_Client::end_publish() {
     return m_mqtt_client.endPublish();
 }
 
-size_t Arduino_MQTT_Client::write(uint8_t payload_byte) {
-    return m_mqtt_client.write(payload_byte);
-}
-
 size_t Arduino_MQTT_Client::write(const uint8_t *buffer, size_t size) {
     return m_mqtt_client.write(buffer, size);
 }
 
+#if THINGSBOARD_ENABLE_STREAM_UTILS
+
+size_t Arduino_MQTT_Client::write(uint8_t payload_byte) {
+    return m_mqtt_client.write(payload_byte);
+}
+
 #endif // THINGSBOARD_ENABLE_STREAM_UTILS
 
 #endif // ARDUINO
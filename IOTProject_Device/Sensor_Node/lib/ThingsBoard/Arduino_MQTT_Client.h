@@ -49,20 +49,20 @@ class Arduino_MQTT_Client : public IMQTT_Client {
 
     bool connected() override;
 
-#if THINGSBOARD_ENABLE_STREAM_UTILS
-
     bool begin_publish(const char *topic, const size_t& length) override;
 
     bool end_publish() override;
 
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+#if THINGSBOARD_ENABLE_STREAM_UTILS
+
     //----------------------------------------------------------------------------
     // Print interface
     //----------------------------------------------------------------------------
 
     size_t write(uint8_t payload_byte) override;
 
-    size_t write(const uint8_t *buffer, size_t size) override;
-
 #endif // THINGSBOARD_ENABLE_STREAM_UTILS
 
   private:
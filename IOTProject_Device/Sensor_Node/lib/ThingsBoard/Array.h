@@ -0,0 +1,159 @@
+#ifndef Array_h
+#define Array_h
+
+// Library includes.
+#include <assert.h>
+#include <stddef.h>
+
+
+/// @brief Data container with a capacity fixed at compile time, the elements are stored inside the instance itself.
+/// Offers the same interface as the Vector replacement and the parts of std::vector used by the ThingsBoard class,
+/// but never allocates any memory on the heap, meaning it can not fragment the heap of long running devices either.
+/// Inserting into a full container is ignored, callers are expected to check max_size() beforehand
+/// @tparam T Type of the underlying data the list should contain
+/// @tparam Capacity Maximum amount of elements the list can ever hold
+template <typename T, size_t Capacity>
+class Array {
+  public:
+    /// @brief Constructor
+    inline Array(void) :
+        m_elements(),
+        m_size(0U)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Returns whether there are still any element in the underlying data container
+    /// @return Whether the underlying data container is empty or not
+    inline bool empty() const {
+        return m_size == 0U;
+    }
+
+    /// @brief Gets the current amount of elements in the underlying data container
+    /// @return The amount of items currently in the underlying data container
+    inline const size_t& size() const {
+        return m_size;
+    }
+
+    /// @brief Gets the maximum amount of elements that can be stored in the underlying data container, is always the fixed capacity
+    /// @return The maximum amount of items that can be stored in the underlying data container
+    inline size_t capacity() const {
+        return Capacity;
+    }
+
+    /// @brief Gets the maximum amount of elements that can ever be stored in the underlying data container, is always the fixed capacity
+    /// @return The maximum amount of items that can ever be stored in the underlying data container
+    inline size_t max_size() const {
+        return Capacity;
+    }
+
+    /// @brief Returns a pointer to the first element of the array
+    /// @return Pointer to the first element of the array
+    inline T* begin() {
+        return m_elements;
+    }
+
+    /// @brief Returns the last element of the array
+    /// @return Reference to the last element of the array
+    inline T& back() {
+        assert(m_size != 0U);
+        return m_elements[m_size - 1U];
+    }
+
+    /// @brief Returns a pointer to one-past-the-end element of the array
+    /// @return Pointer to one-past-the-end element of the array
+    inline T* end() {
+        return m_elements + m_size;
+    }
+
+    /// @brief Returns a constant pointer to the first element of the array
+    /// @return Constant pointer to the first element of the array
+    inline const T* begin() const {
+        return m_elements;
+    }
+
+    /// @brief Returns a constant pointer to one-past-the-end element of the array
+    /// @return Constant pointer to one-past-the-end element of the array
+    inline const T* end() const {
+        return m_elements + m_size;
+    }
+
+    /// @brief Returns a constant pointer to the first element of the array
+    /// @return Constant pointer to the first element of the array
+    inline const T* cbegin() const {
+        return m_elements;
+    }
+
+    /// @brief Returns a constant pointer to one-past-the-end element of the array
+    /// @return Constant pointer to one-past-the-end element of the array
+    inline const T* cend() const {
+        return m_elements + m_size;
+    }
+
+    /// @brief Does nothing, because the complete capacity is already part of the instance
+    inline void reserve(const size_t&) {
+        // Nothing to do
+    }
+
+    /// @brief Inserts the given element at the end of the underlying data container, if it is not already full
+    /// @param element Element that should be inserted at the end
+    inline void push_back(const T& element) {
+        if (m_size == Capacity) {
+            return;
+        }
+        m_elements[m_size] = element;
+        m_size++;
+    }
+
+    /// @brief Removes the element at the given index, has to move all element one to the left if the index is not at the end of the array
+    /// @param index Index the element should be removed at from the underlying data container
+    inline void erase(const size_t& index) {
+        // Check if the given index is bigger or equal than the actual amount of elements if it is we can not erase that element because it does not exist
+        if (index < m_size) {
+            // Move all elements after the index one position to the left
+            for (size_t i = index; i < m_size - 1; i++) {
+                m_elements[i] = m_elements[i + 1];
+            }
+            // Decrease the size of the array to remove the last element, because either it was moved one index to the left or was the element we wanted to delete
+            m_size--;
+        }
+    }
+
+    /// @brief Removes the element the given iterator points to, allows to use Helper::remove() with the container when the C++ STL is used
+    /// @param position Iterator pointing to the element that should be removed
+    inline void erase(const T* position) {
+        erase(static_cast<size_t>(position - m_elements));
+    }
+
+    /// @brief Method to access an element at a given index,
+    /// ensures the device crashes if we attempted to access in an invalid location
+    /// @param index Index we want to get the corresponding element for
+    inline T& at(const size_t& index) {
+        assert(index < m_size);
+        return m_elements[index];
+    }
+
+    /// @brief Bracket operator to access an element at a given index
+    /// @param index Index we want to get the corresponding element for
+    inline T& operator[](const size_t& index) {
+        return m_elements[index];
+    }
+
+    /// @brief Bracket operator to access an element at a given index
+    /// @param index Index we want to get the corresponding element for
+    inline const T& operator[](const size_t& index) const {
+        return m_elements[index];
+    }
+
+    /// @brief Clears the given underlying data container.
+    /// Simply sets the underlying size to 0, the elements stay part of the instance
+    inline void clear() {
+        m_size = 0;
+    }
+
+  private:
+    T m_elements[Capacity]; // Storage for all elements we could ever hold
+    size_t m_size;          // Used size that shows how many elements we entered
+};
+
+#endif // Array_h
@@ -5,7 +5,9 @@ Attribute_Request_Callback::Attribute_Request_Callback() :
     Callback(nullptr, ATT_REQUEST_CB_IS_NULL),
     m_attributes(),
     m_request_id(0U),
-    m_attribute_key(nullptr)
+    m_attribute_key(nullptr),
+    m_timeout(Default_Request_Timeout),
+    m_timeout_callback(nullptr)
 {
     // Nothing to do
 }
@@ -16,7 +18,9 @@ Attribute_Request_Callback::Attribute_Request_Callback(const char *attributes, f
     Callback(callback, ATT_REQUEST_CB_IS_NULL),
     m_attributes(attributes),
     m_request_id(0U),
-    m_attribute_key(nullptr)
+    m_attribute_key(nullptr),
+    m_timeout(Default_Request_Timeout),
+    m_timeout_callback(nullptr)
 {
     // Nothing to do
 }
@@ -39,6 +43,21 @@ void Attribute_Request_Callback::Set_Attribute_Key(const char *attribute_key) {
     m_attribute_key = attribute_key;
 }
 
+const uint32_t& Attribute_Request_Callback::Get_Timeout() const {
+    return m_timeout;
+}
+
+void Attribute_Request_Callback::Set_Timeout(const uint32_t& timeout_milliseconds, timeout_function timeoutCallback) {
+    m_timeout = timeout_milliseconds;
+    m_timeout_callback = timeoutCallback;
+}
+
+void Attribute_Request_Callback::Call_Timeout_Callback() const {
+    if (m_timeout_callback) {
+        m_timeout_callback();
+    }
+}
+
 #if THINGSBOARD_ENABLE_STL
 
 const std::vector<const char *>& Attribute_Request_Callback::Get_Attributes() const {
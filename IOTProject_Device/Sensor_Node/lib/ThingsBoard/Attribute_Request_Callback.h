@@ -3,6 +3,7 @@
 
 // Local includes.
 #include "Callback.h"
+#include "Constants.h"
 
 // Library includes.
 #include <ArduinoJson.h>
@@ -36,6 +37,9 @@ using Attribute_Data = const JsonObjectConst;
 /// Documentation about the specific use of Requesting client-side or shared scope atrributes in ThingsBoard can be found here https://thingsboard.io/docs/reference/mqtt-api/#request-attribute-values-from-the-server
 class Attribute_Request_Callback : public Callback<void, const Attribute_Data&> {
   public:
+    /// @brief Timeout callback signature
+    using timeout_function = Callback<void>::function;
+
     /// @brief Constructs empty callback, will result in never being called
     Attribute_Request_Callback();
 
@@ -60,6 +64,8 @@ class Attribute_Request_Callback : public Callback<void, const Attribute_Data&>
       , m_attributes(std::forward<Args>(args)...)
       , m_request_id(0U)
       , m_attribute_key(nullptr)
+      , m_timeout(Default_Request_Timeout)
+      , m_timeout_callback(nullptr)
     {
         // Nothing to do
     }
@@ -104,6 +110,20 @@ class Attribute_Request_Callback : public Callback<void, const Attribute_Data&>
     /// "client" for client-side attributes and "shared" for shared scope attributes
     void Set_Attribute_Key(const char *attribute_key);
 
+    /// @brief Gets the amount of milliseconds the response is waited for,
+    /// before the request is discarded and the timeout callback is called instead
+    /// @return Timeout in milliseconds, 0 meaning the request waits for its response until it is unsubscribed
+    const uint32_t& Get_Timeout() const;
+
+    /// @brief Sets the amount of milliseconds the response is waited for, before the request is discarded and the given timeout callback is called instead.
+    /// Responses arriving afterwards are ignored. Is checked whenever loop() is called, meaning the timeout callback is called from loop() as well, default = Default_Request_Timeout
+    /// @param timeout_milliseconds Timeout in milliseconds, 0 meaning the request waits for its response until it is unsubscribed
+    /// @param timeoutCallback Callback method that will be called if the response did not arrive in time, optional, pass nullptr to only discard the request
+    void Set_Timeout(const uint32_t& timeout_milliseconds, timeout_function timeoutCallback = nullptr);
+
+    /// @brief Calls the timeout callback, if one has been set
+    void Call_Timeout_Callback() const;
+
 #if THINGSBOARD_ENABLE_STL
 
     /// @brief Gets all the requested client-side or shared attributes that will result,
@@ -154,6 +174,8 @@ class Attribute_Request_Callback : public Callback<void, const Attribute_Data&>
 #endif // THINGSBOARD_ENABLE_STL
     size_t                         m_request_id;      // Id the request was called with
     const char                     *m_attribute_key;  // Attribute key that we wil receive the response on ("client" or "shared")
+    uint32_t                       m_timeout;         // Milliseconds the response is waited for
+    timeout_function               m_timeout_callback; // Callback to call if the response did not arrive in time
 };
 
 #endif // Attribute_Request_Callback_h
@@ -17,6 +17,8 @@
 #define Default_Buffering_Size 64
 #define Default_Payload 64
 #define Default_Fields_Amt 8
+#define Default_Requests_Amt 8
+#define Default_Request_Timeout 10000 // Milliseconds a client-side RPC or attribute request waits for its response
 class ThingsBoardDefaultLogger;
 
 #if !THINGSBOARD_ENABLE_PROGMEM
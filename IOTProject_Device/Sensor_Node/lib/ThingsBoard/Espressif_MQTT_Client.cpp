@@ -3,6 +3,10 @@
 
 #if THINGSBOARD_USE_ESP_MQTT
 
+// Library includes.
+#include <new>
+#include <string.h>
+
 // The error integer -1 means a general failure while handling the mqtt client,
 // where as -2 means that the outbox is filled and the message can therefore not be sent.
 // Therefore we have to check if the value is smaller or equal to the MQTT_FAILURE_MESSAGE_ID,
@@ -16,13 +20,20 @@ Espressif_MQTT_Client::Espressif_MQTT_Client() :
     m_connected(false),
     m_enqueue_messages(false),
     m_mqtt_configuration(),
-    m_mqtt_client(nullptr)
+    m_mqtt_client(nullptr),
+    m_publish_topic(nullptr),
+    m_publish_payload(nullptr),
+    m_publish_capacity(0U),
+    m_publish_started(false),
+    m_publish_length(0U),
+    m_publish_written(0U)
 {
     m_instance = this;
 }
 
 Espressif_MQTT_Client::~Espressif_MQTT_Client() {
     m_instance = nullptr;
+    delete[] m_publish_payload;
     (void)esp_mqtt_client_destroy(m_mqtt_client);
 }
 
@@ -226,6 +237,44 @@ bool Espressif_MQTT_Client::publish(const char *topic, const uint8_t *payload, c
     return message_id > MQTT_FAILURE_MESSAGE_ID;
 }
 
+bool Espressif_MQTT_Client::begin_publish(const char *topic, const size_t& length) {
+    m_publish_started = false;
+    // Reuse the buffer of previous messages, meaning the heap is only touched if a message is bigger than any before
+    if (length > m_publish_capacity) {
+        delete[] m_publish_payload;
+        m_publish_capacity = 0U;
+        m_publish_payload = new (std::nothrow) uint8_t[length];
+        if (m_publish_payload == nullptr) {
+            return false;
+        }
+        m_publish_capacity = length;
+    }
+    m_publish_topic = topic;
+    m_publish_length = length;
+    m_publish_written = 0U;
+    m_publish_started = true;
+    return true;
+}
+
+bool Espressif_MQTT_Client::end_publish() {
+    const bool result = m_publish_started && m_publish_written == m_publish_length && publish(m_publish_topic, m_publish_payload, m_publish_length);
+    m_publish_started = false;
+    return result;
+}
+
+size_t Espressif_MQTT_Client::write(const uint8_t *buffer, size_t size) {
+    if (!m_publish_started) {
+        return 0U;
+    }
+    const size_t remaining = m_publish_length - m_publish_written;
+    if (size > remaining) {
+        size = remaining;
+    }
+    memcpy(m_publish_payload + m_publish_written, buffer, size);
+    m_publish_written += size;
+    return size;
+}
+
 bool Espressif_MQTT_Client::subscribe(const char *topic) {
     const int message_id = esp_mqtt_client_subscribe(m_mqtt_client, topic, 0U);
     return message_id > MQTT_FAILURE_MESSAGE_ID;
@@ -109,12 +109,27 @@ class Espressif_MQTT_Client : public IMQTT_Client {
 
     bool connected() override;
 
+    /// @brief The esp-mqtt client has no way to send a payload in parts, therefore the written parts are collected
+    /// into a buffer owned by the client, which is then published as a whole once end_publish() is called.
+    /// The buffer is kept between messages and only reallocated if a message is bigger than any sent before
+    bool begin_publish(const char *topic, const size_t& length) override;
+
+    bool end_publish() override;
+
+    size_t write(const uint8_t *buffer, size_t size) override;
+
 private:
     function m_received_data_callback;             // Callback that will be called as soon as the mqtt client receives any data
     bool m_connected;                              // Whether the client has received the connected or disconnected event
     bool m_enqueue_messages;                       // Whether we enqueue messages making nearly all ThingsBoard calls non blocking or wheter we publish instead
     esp_mqtt_client_config_t m_mqtt_configuration; // Configuration of the underlying mqtt client, saved as a private variable to allow changes after inital configuration with the same options for all non changed settings
     esp_mqtt_client_handle_t m_mqtt_client;        // Handle to the underlying mqtt client, used to establish the communication
+    const char *m_publish_topic;                   // Topic of the message started with begin_publish()
+    uint8_t *m_publish_payload;                    // Payload collected by write() until end_publish() is called, kept for the next message
+    size_t m_publish_capacity;                     // Size of the allocated payload buffer
+    bool m_publish_started;                        // Whether begin_publish() was successful and end_publish() has not been called yet
+    size_t m_publish_length;                       // Length of the payload announced in begin_publish()
+    size_t m_publish_written;                      // Amount of payload bytes written so far
 
     static Espressif_MQTT_Client *m_instance;      // Instance to the created class, will be set once the constructor has been called and reset once the destructor has been called, used to call private member method from static callback
 
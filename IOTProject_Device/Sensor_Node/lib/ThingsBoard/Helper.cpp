@@ -9,6 +9,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#if THINGSBOARD_USE_ESP_TIMER
+#include <esp_timer.h>
+#else
+#include <Arduino.h>
+#endif // THINGSBOARD_USE_ESP_TIMER
 
 uint8_t Helper::detectSize(const char *msg, ...) {
       va_list args;
@@ -27,11 +32,19 @@ size_t Helper::getOccurences(const char *str, char symbol) {
     if (str == nullptr) {
       return count;
     }
-    for (size_t i = 0; i < strlen(str); i++) {
-      if (str[i] != symbol) {
+    for (; *str != '\0'; str++) {
+      if (*str != symbol) {
         continue;
       }
       count++;
     }
     return count;
 }
+
+uint32_t Helper::getMillis() {
+#if THINGSBOARD_USE_ESP_TIMER
+    return static_cast<uint32_t>(esp_timer_get_time() / 1000U);
+#else
+    return millis();
+#endif // THINGSBOARD_USE_ESP_TIMER
+}
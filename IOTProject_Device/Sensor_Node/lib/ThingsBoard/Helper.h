@@ -28,6 +28,42 @@ class Helper {
     /// @return Amount of occurences of the given symbol
     static size_t getOccurences(const char *str, char symbol);
 
+    /// @brief Returns the time since the device started, uses the esp timer if it exists and the Arduino millis() method otherwise.
+    /// Overflows after roughly 49 days, therefore points in time should only ever be compared by their difference
+    /// @return Time in milliseconds
+    static uint32_t getMillis();
+
+    /// @brief Calculates the 32-bit FNV-1a hash of the given string literal, allows looking up callbacks by their name without having to compare every subscribed name.
+    /// Is constexpr, meaning names that are already known at compile time like string literals can be hashed by the compiler instead,
+    /// if the result is used in a constant expression, for example to construct a RPC_Callback with an already calculated hash.
+    /// See http://www.isthe.com/chongo/tech/comp/fnv/ for more information on the underlying algorithm
+    /// @tparam N Size of the given character array including the null terminator
+    /// @param str String literal that should be hashed
+    /// @return Hash of the given string, is the same as the one calculated for the string at runtime
+    template <size_t N>
+    static constexpr uint32_t hash(const char (&str)[N]) {
+      return Hash_Recursive(str, N - 1U, FNV_OFFSET_BASIS);
+    }
+
+    /// @brief Calculates the 32-bit FNV-1a hash of the given string, used for strings only known at runtime like the ones received from the server.
+    /// Iterates over the string instead of recursing like the constexpr overload for string literals, because the recursion is not guaranteed to be optimized away,
+    /// which would cost one stack frame per character of the hashed string
+    /// @tparam Char Character type of the given string, template so that string literals decay to the constexpr overload instead
+    /// @param str String that should be hashed, nullptr is handled like an empty string
+    /// @param length Maximum amount of characters that should be hashed, allows hashing parts of a string that are not null terminated, default = SIZE_MAX
+    /// @return Hash of the given string
+    template <typename Char>
+    inline static uint32_t hash(Char * const & str, const size_t& length = SIZE_MAX) {
+      uint32_t result = FNV_OFFSET_BASIS;
+      if (str == nullptr) {
+        return result;
+      }
+      for (size_t i = 0U; i < length && str[i] != '\0'; i++) {
+        result = (result ^ static_cast<uint8_t>(str[i])) * FNV_PRIME;
+      }
+      return result;
+    }
+
     /// @brief Calculates the total size of the string the serializeJson method would produce including the null end terminator.
     /// See https://arduinojson.org/v6/api/json/measurejson/ for more information on the underlying method used
     /// @tparam TSource Source class that should be used to serialize the json that is sent to the server
@@ -55,6 +91,19 @@ class Helper {
         container.erase(index);
 #endif // THINGSBOARD_ENABLE_STL
     }
+
+  private:
+    static constexpr uint32_t FNV_OFFSET_BASIS = 2166136261U; // Hash of the empty string
+    static constexpr uint32_t FNV_PRIME = 16777619U;          // Multiplied with the hash after every character
+
+    /// @brief Hashes the given string one character per recursion, because C++11 constexpr methods can only consist of a single return statement
+    /// @param str String that should be hashed
+    /// @param length Maximum amount of characters that should be hashed
+    /// @param basis Hash of all characters preceding the given string
+    /// @return Hash of the given string
+    static constexpr uint32_t Hash_Recursive(const char *str, const size_t length, const uint32_t basis) {
+      return (length == 0U || *str == '\0') ? basis : Hash_Recursive(str + 1, length - 1U, (basis ^ static_cast<uint8_t>(*str)) * FNV_PRIME);
+    }
 };
 
 #endif // Helper
@@ -1,6 +1,9 @@
 #ifndef IHTTP_Client_h
 #define IHTTP_Client_h
 
+// Local include.
+#include "Configuration.h"
+
 // Library include.
 #if THINGSBOARD_ENABLE_STL
 #include <string>
@@ -35,6 +38,11 @@ class IHTTP_Client {
     /// @brief Disconnects the given device from the current host and clears about any remaining bytes still in the reponse body
     virtual void stop() = 0;
 
+    /// @brief Returns whether the connection to the host is still open, a connection the server closed is reported as closed
+    /// once the underlying client noticed it, which allows to open a new connection before a request is sent over the closed one
+    /// @return Whether the client is currently connected or not
+    virtual bool connected() = 0;
+
     /// @brief Connects to the server and sends a POST request with a body and content type
     /// @param url_path URL the POST request should be sent too
     /// @param content_type Type of the content that is sent will be JSON data most of the time
@@ -111,13 +111,11 @@ class IMQTT_Client {
     /// @return Whether the client is currently connected or not
     virtual bool connected() = 0;
 
-#if THINGSBOARD_ENABLE_STREAM_UTILS
-
     /// @brief Start to publish a message over a given topic, without being restricted to the internal buffer size.
     /// Meaning it allows for arbitrarily large payloads to be sent without them having to be copied into a new buffer and held in memory.
     /// To use this feature first call begin_publish(), followed by multiple calls to write() and then ending with a call to end_publish()
     /// @param topic Topic that the message is sent over, where different MQTT topics expect a different kind of payload
-    /// @param length Length of the payload in bytes
+    /// @param length Length of the payload in bytes, has to be exactly the amount of bytes passed to write() afterwards
     /// @return Whether starting to publish on the given topic was successful or not
     virtual bool begin_publish(const char *topic, const size_t& length) = 0;
 
@@ -125,6 +123,15 @@ class IMQTT_Client {
     /// @return Whether the complete packet was sent successfully or not
     virtual bool end_publish() = 0;
 
+    /// @brief Sends a buffer containing multiple bytes of payload to be published, is meant to be used after having calling begin_publish()
+    /// Once the complete payload has been written ensure to call end_publish() to send any remaining bytes
+    /// @param buffer Buffer containing part of the payload that should be sent
+    /// @param size Amount of bytes contained in the buffer that should be sent
+    /// @return The amount of bytes successfully written
+    virtual size_t write(const uint8_t *buffer, size_t size) = 0;
+
+#if THINGSBOARD_ENABLE_STREAM_UTILS
+
     //----------------------------------------------------------------------------
     // Print interface
     //----------------------------------------------------------------------------
@@ -137,13 +144,6 @@ class IMQTT_Client {
     /// @return The amount of bytes successfully written
     virtual size_t write(uint8_t payload_byte) = 0;
 
-    /// @brief Sends a buffer containing multiple bytes of payload to be published, is meant to be used after having calling begin_publish()
-    /// Once the complete payload has been written ensure to call end_publish() to send any remaining bytes
-    /// @param buffer Buffer containing part of the payload that should be sent
-    /// @param size Amount of bytes contained in the buffer that should be sent
-    /// @return The amount of bytes successfully written
-    virtual size_t write(const uint8_t *buffer, size_t size) = 0;
-
 #endif // THINGSBOARD_ENABLE_STREAM_UTILS
 };
 
@@ -0,0 +1,47 @@
+// Header include.
+#include "Publish_Writer.h"
+
+// Library includes.
+#include <string.h>
+
+Publish_Writer::Publish_Writer(IMQTT_Client& client, uint8_t *chunk, const size_t& chunk_size) :
+    m_client(client),
+    m_chunk(chunk),
+    m_chunk_size(chunk_size),
+    m_length(0U)
+{
+    // Nothing to do
+}
+
+size_t Publish_Writer::write(uint8_t payload_byte) {
+    if (m_length == m_chunk_size && !flush()) {
+        return 0U;
+    }
+    m_chunk[m_length++] = payload_byte;
+    return 1U;
+}
+
+size_t Publish_Writer::write(const uint8_t *buffer, size_t size) {
+    if (m_length + size > m_chunk_size) {
+        if (!flush()) {
+            return 0U;
+        }
+        // Parts that would not fit into the chunk anyway are not copied at all
+        if (size >= m_chunk_size) {
+            return m_client.write(buffer, size);
+        }
+    }
+    memcpy(m_chunk + m_length, buffer, size);
+    m_length += size;
+    return size;
+}
+
+bool Publish_Writer::flush() {
+    if (m_length == 0U) {
+        return true;
+    }
+    const size_t written = m_client.write(m_chunk, m_length);
+    const bool result = written == m_length;
+    m_length = 0U;
+    return result;
+}
@@ -0,0 +1,42 @@
+#ifndef Publish_Writer_h
+#define Publish_Writer_h
+
+// Local includes.
+#include "IMQTT_Client.h"
+
+
+/// @brief Writer that allows ArduinoJson to serialize a json document directly into a message started with IMQTT_Client::begin_publish(),
+/// instead of first serializing it into a temporary string that then has to be copied into the buffer of the MQTT client.
+/// Because the serializer emits the json in many tiny parts, those are gathered into the given chunk buffer and only written to the client once it is full.
+/// Any class with these two write() methods can be passed to serializeJson(), see https://arduinojson.org/v6/api/json/serializejson/ for more information
+class Publish_Writer {
+  public:
+    /// @brief Constructor
+    /// @param client MQTT Client implementation the payload is written into, begin_publish() has to have been called already
+    /// @param chunk Buffer used to gather the serialized bytes until they are written to the client, has to outlive this instance
+    /// @param chunk_size Size of the given chunk buffer in bytes
+    Publish_Writer(IMQTT_Client& client, uint8_t *chunk, const size_t& chunk_size);
+
+    /// @brief Appends a single byte of the payload
+    /// @param payload_byte Byte containing part of the payload that should be sent
+    /// @return The amount of bytes successfully written
+    size_t write(uint8_t payload_byte);
+
+    /// @brief Appends multiple bytes of the payload, bigger parts than the chunk buffer are written to the client directly
+    /// @param buffer Buffer containing part of the payload that should be sent
+    /// @param size Amount of bytes contained in the buffer that should be sent
+    /// @return The amount of bytes successfully written
+    size_t write(const uint8_t *buffer, size_t size);
+
+    /// @brief Writes any bytes still held in the chunk buffer to the client, has to be called before IMQTT_Client::end_publish()
+    /// @return Whether all remaining bytes were written successfully or not
+    bool flush();
+
+  private:
+    IMQTT_Client& m_client; // MQTT Client implementation the payload is written into
+    uint8_t *m_chunk;       // Buffer gathering the payload until it is full
+    size_t m_chunk_size;    // Size of the chunk buffer
+    size_t m_length;        // Amount of bytes currently held in the chunk buffer
+};
+
+#endif // Publish_Writer_h
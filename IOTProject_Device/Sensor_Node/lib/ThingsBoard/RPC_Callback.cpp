@@ -1,6 +1,9 @@
 // Header include.
 #include "RPC_Callback.h"
 
+// Local includes.
+#include "Helper.h"
+
 /// ---------------------------------
 /// Constant strings in flash memory.
 /// ---------------------------------
@@ -17,8 +20,15 @@ RPC_Callback::RPC_Callback() :
 }
 
 RPC_Callback::RPC_Callback(const char *methodName, function cb) :
+    RPC_Callback(methodName, Helper::hash(methodName), cb)
+{
+    // Nothing to do
+}
+
+RPC_Callback::RPC_Callback(const char *methodName, const uint32_t& nameHash, function cb) :
     Callback(cb, RPC_CB_NULL),
-    m_methodName(methodName)
+    m_methodName(methodName),
+    m_nameHash(nameHash)
 {
     // Nothing to do
 }
@@ -28,4 +38,9 @@ const char* RPC_Callback::Get_Name() const {
 
 void RPC_Callback::Set_Name(const char *methodName) {
     m_methodName = methodName;
+    m_nameHash = Helper::hash(methodName);
+}
+
+const uint32_t& RPC_Callback::Get_Name_Hash() const {
+    return m_nameHash;
 }
@@ -24,6 +24,15 @@ class RPC_Callback : public Callback<RPC_Response, RPC_Data&> {
     /// and should return a RPC_Response, the RPC_Response can be empty if the RPC widget does not expect any response
     RPC_Callback(const char *methodName, function cb);
 
+    /// @brief Constructs callback with an already calculated hash of the methodName, allows names known at compile time to be hashed by the compiler,
+    /// by passing the result of the constexpr Helper::hash() overload for string literals, e.g. constexpr uint32_t SET_HASH = Helper::hash("set"); RPC_Callback("set", SET_HASH, cb).
+    /// The constructor without the hash instead always hashes the given name at runtime, because the pointer it receives is not a constant expression
+    /// @param methodName Name we expect to be sent via. server-side RPC so that this method callback will be called
+    /// @param nameHash Hash of the given methodName, has to be the same value Helper::hash() returns for it, otherwise the callback will never be found
+    /// @param cb Callback method that will be called upon data arrival with the given data that was received serialized into a JsonDocument
+    /// and should return a RPC_Response, the RPC_Response can be empty if the RPC widget does not expect any response
+    RPC_Callback(const char *methodName, const uint32_t& nameHash, function cb);
+
     /// @brief Gets the poiner to the underlying name we expect to be sent via. server-side RPC so that this method callback will be called
     /// @return Pointer to the passed methodName
     const char* Get_Name() const;
@@ -32,8 +41,13 @@ class RPC_Callback : public Callback<RPC_Response, RPC_Data&> {
     /// @param methodName Pointer to the passed methodName
     void Set_Name(const char *methodName);
 
+    /// @brief Gets the hash of the underlying name, used to look up the callback for a received server-side RPC request without comparing every subscribed name
+    /// @return Hash of the passed methodName, see Helper::hash() for more information
+    const uint32_t& Get_Name_Hash() const;
+
   private:
     const char  *m_methodName;  // Method name
+    uint32_t    m_nameHash;     // Hash of the method name
 };
 
 #endif // RPC_Callback_h
@@ -26,7 +26,9 @@ RPC_Request_Callback::RPC_Request_Callback(const char *methodName, const JsonArr
     Callback(callback, RPC_REQUEST_CB_NULL),
     m_methodName(methodName),
     m_parameters(parameteres),
-    m_request_id(0U)
+    m_request_id(0U),
+    m_timeout(Default_Request_Timeout),
+    m_timeout_callback(nullptr)
 {
     // Nothing to do
 }
@@ -54,3 +56,18 @@ const JsonArray* RPC_Request_Callback::Get_Parameters() const {
 void RPC_Request_Callback::Set_Parameters(const JsonArray *parameteres) {
     m_parameters = parameteres;
 }
+
+const uint32_t& RPC_Request_Callback::Get_Timeout() const {
+    return m_timeout;
+}
+
+void RPC_Request_Callback::Set_Timeout(const uint32_t& timeout_milliseconds, timeout_function timeoutCallback) {
+    m_timeout = timeout_milliseconds;
+    m_timeout_callback = timeoutCallback;
+}
+
+void RPC_Request_Callback::Call_Timeout_Callback() const {
+    if (m_timeout_callback) {
+        m_timeout_callback();
+    }
+}
@@ -3,6 +3,7 @@
 
 // Local includes.
 #include "Callback.h"
+#include "Constants.h"
 
 // Library includes.
 #include <ArduinoJson.h>
@@ -13,6 +14,9 @@
 /// Documentation about the specific use of client-side RPC in ThingsBoard can be found here https://thingsboard.io/docs/user-guide/rpc/#client-side-rpc
 class RPC_Request_Callback : public Callback<void, const JsonVariantConst&> {
   public:
+    /// @brief Timeout callback signature
+    using timeout_function = Callback<void>::function;
+
     /// @brief Constructs empty callback, will result in never being called
     RPC_Request_Callback();
 
@@ -58,10 +62,26 @@ class RPC_Request_Callback : public Callback<void, const JsonVariantConst&> {
     /// @param parameteres Pointer to the passed parameters
     void Set_Parameters(const JsonArray *parameteres);
 
+    /// @brief Gets the amount of milliseconds the response is waited for,
+    /// before the request is discarded and the timeout callback is called instead
+    /// @return Timeout in milliseconds, 0 meaning the request waits for its response until it is unsubscribed
+    const uint32_t& Get_Timeout() const;
+
+    /// @brief Sets the amount of milliseconds the response is waited for, before the request is discarded and the given timeout callback is called instead.
+    /// Responses arriving afterwards are ignored. Is checked whenever loop() is called, meaning the timeout callback is called from loop() as well, default = Default_Request_Timeout
+    /// @param timeout_milliseconds Timeout in milliseconds, 0 meaning the request waits for its response until it is unsubscribed
+    /// @param timeoutCallback Callback method that will be called if the response did not arrive in time, optional, pass nullptr to only discard the request
+    void Set_Timeout(const uint32_t& timeout_milliseconds, timeout_function timeoutCallback = nullptr);
+
+    /// @brief Calls the timeout callback, if one has been set
+    void Call_Timeout_Callback() const;
+
   private:
     const char        *m_methodName;  // Method name
     const JsonArray   *m_parameters;  // Parameter json
     size_t            m_request_id;   // Id the request was called with
+    uint32_t          m_timeout;      // Milliseconds the response is waited for
+    timeout_function  m_timeout_callback; // Callback to call if the response did not arrive in time
 };
 
 #endif // RPC_Request_Callback_h
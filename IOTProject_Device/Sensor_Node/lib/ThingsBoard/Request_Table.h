@@ -0,0 +1,179 @@
+#ifndef Request_Table_h
+#define Request_Table_h
+
+// Library includes.
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// @brief Data container with a capacity fixed at compile time, holding the requests that are still waiting for their response from the server.
+/// Each request is stored in the slot its request id modulo the capacity points to, meaning finding the request a received response answers is a single comparison,
+/// instead of a search through every request that is still in flight. Requests are therefore sent with ids whose slot is free, see is_free().
+/// Additionally each request can have a deadline, once it has passed the request is removed by erase_expired(), which only looks at the slots
+/// once the earliest deadline of all requests has been reached, meaning calling it in every loop is a single comparison as long as nothing timed out
+/// @tparam T Type of the underlying requests the table should contain
+/// @tparam Capacity Maximum amount of requests that can be waiting for their response at once
+template <typename T, size_t Capacity>
+class Request_Table {
+  static_assert(Capacity > 0U, "Request_Table needs to be able to hold atleast one request");
+
+  public:
+    /// @brief Constructor
+    inline Request_Table(void) :
+        m_slots(),
+        m_size(0U),
+        m_next_deadline(0U),
+        m_timed(false)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Returns whether there are still any requests waiting for their response
+    /// @return Whether the underlying data container is empty or not
+    inline bool empty() const {
+        return m_size == 0U;
+    }
+
+    /// @brief Gets the current amount of requests waiting for their response
+    /// @return The amount of requests currently in the underlying data container
+    inline const size_t& size() const {
+        return m_size;
+    }
+
+    /// @brief Gets the maximum amount of requests that can ever wait for their response at once, is always the fixed capacity
+    /// @return The maximum amount of requests that can ever be stored in the underlying data container
+    inline size_t max_size() const {
+        return Capacity;
+    }
+
+    /// @brief Returns whether a request with the given id could be inserted, because the slot it would be stored in is not used by another request.
+    /// As long as the table is not full, atleast one of any Capacity consecutive request ids is free
+    /// @param request_id Unique identifier of the request
+    /// @return Whether the slot of the given request id is free
+    inline bool is_free(const size_t& request_id) const {
+        return !m_slots[request_id % Capacity].used;
+    }
+
+    /// @brief Copies the given request into the slot of the given request id, which has to be free
+    /// @param request_id Unique identifier of the request, the response will be received with
+    /// @param request Request that should be inserted
+    /// @param now Current time in milliseconds
+    /// @param timeout Amount of milliseconds after which erase_expired() removes the request, 0 meaning the request never expires
+    /// @return Pointer to the inserted copy of the request or nullptr if the slot of the given request id is already used
+    inline T* insert(const size_t& request_id, const T& request, const uint32_t& now, const uint32_t& timeout) {
+        Slot& slot = m_slots[request_id % Capacity];
+        if (slot.used) {
+            return nullptr;
+        }
+        slot.request = request;
+        slot.request_id = request_id;
+        slot.deadline = now + timeout;
+        slot.timed = timeout != 0U;
+        slot.used = true;
+        m_size++;
+        if (slot.timed) {
+            Update_Next_Deadline(slot.deadline);
+        }
+        return &slot.request;
+    }
+
+    /// @brief Returns the request with the given request id
+    /// @param request_id Unique identifier of the request, the response was received with
+    /// @return Pointer to the request or nullptr if no request with the given id is waiting for its response, for example because it has already expired
+    inline T* find(const size_t& request_id) {
+        Slot& slot = m_slots[request_id % Capacity];
+        return (slot.used && slot.request_id == request_id) ? &slot.request : nullptr;
+    }
+
+    /// @brief Removes the request with the given request id, does nothing if there is none
+    /// @param request_id Unique identifier of the request
+    inline void erase(const size_t& request_id) {
+        Slot& slot = m_slots[request_id % Capacity];
+        if (slot.used && slot.request_id == request_id) {
+            Release(slot);
+        }
+    }
+
+    /// @brief Removes all requests
+    inline void clear() {
+        for (Slot& slot : m_slots) {
+            if (slot.used) {
+                Release(slot);
+            }
+        }
+        m_timed = false;
+    }
+
+    /// @brief Removes all requests whose deadline has been reached and passes each of them to the given method beforehand.
+    /// Does not look at any slot as long as the earliest deadline has not been reached yet
+    /// @tparam Function Method or lambda receiving a reference to the expired request, is allowed to insert or clear requests
+    /// @param now Current time in milliseconds
+    /// @param expired Method that is called with every expired request, before it is removed
+    /// @return Amount of removed requests
+    template <typename Function>
+    inline size_t erase_expired(const uint32_t& now, Function expired) {
+        if (!m_timed || Is_Before(now, m_next_deadline)) {
+            return 0U;
+        }
+        // Recalculated while walking the slots, requests inserted by the given method update it themselves
+        m_timed = false;
+        size_t removed = 0U;
+        for (Slot& slot : m_slots) {
+            if (!slot.used || !slot.timed) {
+                continue;
+            }
+            else if (Is_Before(now, slot.deadline)) {
+                Update_Next_Deadline(slot.deadline);
+                continue;
+            }
+            const size_t request_id = slot.request_id;
+            expired(slot.request);
+            // The given method might have already removed all requests
+            erase(request_id);
+            removed++;
+        }
+        return removed;
+    }
+
+  private:
+    /// @brief Request and the bookkeeping needed to find and expire it
+    struct Slot {
+      T request;         // Copy of the request
+      size_t request_id; // Unique identifier of the request, the response will be received with
+      uint32_t deadline; // Time in milliseconds once the request expires
+      bool timed;        // Whether the request expires at all
+      bool used;         // Whether the slot holds a request
+    };
+
+    /// @brief Returns whether the first point in time is before the second one, handles the milliseconds overflowing after roughly 49 days
+    /// @param lhs First point in time in milliseconds
+    /// @param rhs Second point in time in milliseconds
+    /// @return Whether the first point in time is before the second one
+    inline static bool Is_Before(const uint32_t& lhs, const uint32_t& rhs) {
+        return static_cast<int32_t>(lhs - rhs) < 0;
+    }
+
+    /// @brief Lowers the earliest deadline of all requests to the given deadline, if it is earlier
+    /// @param deadline Deadline of a request that expires
+    inline void Update_Next_Deadline(const uint32_t& deadline) {
+        if (!m_timed || Is_Before(deadline, m_next_deadline)) {
+            m_next_deadline = deadline;
+            m_timed = true;
+        }
+    }
+
+    /// @brief Frees the given slot, the request is overwritten to release any memory it holds
+    /// @param slot Slot that should be freed
+    inline void Release(Slot& slot) {
+        slot.request = T();
+        slot.used = false;
+        m_size--;
+    }
+
+    Slot m_slots[Capacity];   // Requests stored in the slot of their request id
+    size_t m_size;            // Amount of requests currently waiting for their response
+    uint32_t m_next_deadline; // Earliest deadline of all requests, might be earlier than the actual one after requests were erased
+    bool m_timed;             // Whether any request expires at all
+};
+
+#endif // Request_Table_h
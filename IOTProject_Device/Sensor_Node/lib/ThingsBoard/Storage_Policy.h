@@ -0,0 +1,63 @@
+#ifndef Storage_Policy_h
+#define Storage_Policy_h
+
+// Local includes.
+#include "Configuration.h"
+#include "Constants.h"
+#include "Array.h"
+#include "Request_Table.h"
+#if !THINGSBOARD_ENABLE_STL
+#include "Vector.h"
+#endif // !THINGSBOARD_ENABLE_STL
+
+// Library includes.
+#if THINGSBOARD_ENABLE_STL
+#include <vector>
+#endif // THINGSBOARD_ENABLE_STL
+
+
+/// @brief Storage policy that keeps subscribed callbacks in containers growing on the heap, either std::vector or the Vector replacement for boards without the C++ STL.
+/// Allows subscribing an arbitrary amount of callbacks, but every growth of a container moves it to a new location on the heap.
+/// Requests waiting for their response are the exception, at most Default_Requests_Amt of them can be in flight at once
+struct Dynamic_Storage {
+#if THINGSBOARD_ENABLE_STL
+    /// @brief Container used for the callbacks
+    template <typename T>
+    using Container = std::vector<T>;
+#else
+    /// @brief Container used for the callbacks
+    template <typename T>
+    using Container = Vector<T>;
+#endif // THINGSBOARD_ENABLE_STL
+
+    /// @brief Container used for the keys of subscribed shared attributes
+    template <typename T>
+    using Key_Container = Container<T>;
+
+    /// @brief Container used for the client-side RPC and attribute requests waiting for their response
+    template <typename T>
+    using Request_Container = Request_Table<T, Default_Requests_Amt>;
+};
+
+/// @brief Storage policy that keeps subscribed callbacks in Array containers, which are part of the ThingsBoardSized instance itself.
+/// Meaning subscribing callbacks never touches the heap, not even during setup, which prevents fragmenting the heap of long running devices.
+/// Subscribing more callbacks than the given capacity fails and informs the user with a message to the Logger
+/// @tparam MaxCallbacksAmt Maximum amount of callbacks of each kind (server-side RPC, client-side RPC, shared attribute updates and requests) that can be subscribed at once
+/// @tparam MaxKeysAmt Maximum amount of shared attribute keys that can be subscribed at once over all shared attribute update callbacks, default = MaxCallbacksAmt
+/// @tparam MaxRequestsAmt Maximum amount of client-side RPC and attribute requests of each kind that can wait for their response at once, default = MaxCallbacksAmt
+template <size_t MaxCallbacksAmt, size_t MaxKeysAmt = MaxCallbacksAmt, size_t MaxRequestsAmt = MaxCallbacksAmt>
+struct Static_Storage {
+    /// @brief Container used for the callbacks
+    template <typename T>
+    using Container = Array<T, MaxCallbacksAmt>;
+
+    /// @brief Container used for the keys of subscribed shared attributes
+    template <typename T>
+    using Key_Container = Array<T, MaxKeysAmt>;
+
+    /// @brief Container used for the client-side RPC and attribute requests waiting for their response
+    template <typename T>
+    using Request_Container = Request_Table<T, MaxRequestsAmt>;
+};
+
+#endif // Storage_Policy_h
@@ -0,0 +1,322 @@
+#ifndef Telemetry_Batch_h
+#define Telemetry_Batch_h
+
+// Local includes.
+#include "Configuration.h"
+
+// Library includes.
+#include <string.h>
+#include <ArduinoJson.h>
+#if THINGSBOARD_ENABLE_STL
+#include <type_traits>
+#endif // THINGSBOARD_ENABLE_STL
+
+
+#if THINGSBOARD_ENABLE_PROGMEM
+constexpr char TS_KEY[] PROGMEM = "ts";
+constexpr char VALUES_KEY[] PROGMEM = "values";
+#else
+constexpr char TS_KEY[] = "ts";
+constexpr char VALUES_KEY[] = "values";
+#endif // THINGSBOARD_ENABLE_PROGMEM
+
+
+/// @brief Telemetry of multiple timestamps, allows a device or gateway to buffer its measurements and upload the whole history in a single message,
+/// serialized as [{"ts":1451649600512,"values":{"key1":"value1","key2":"value2"}},{"ts":1451649600513,"values":{"key1":"value3"}}].
+/// Each key is stored once and owns a column holding its values of every timestamp, which all have the same type.
+/// The columns are part of the instance itself, meaning adding timestamps and values never allocates any memory on the heap.
+/// Keys and string values are only referenced and not copied, they therefore have to stay valid until the batch has been sent.
+/// See https://thingsboard.io/docs/reference/mqtt-api/#telemetry-upload-api for more information
+/// @tparam MaxKeysAmt Maximum amount of different keys over all timestamps
+/// @tparam MaxTimestampsAmt Maximum amount of timestamps
+template <size_t MaxKeysAmt, size_t MaxTimestampsAmt>
+class Telemetry_Batch {
+  public:
+    /// @brief Constructor
+    inline Telemetry_Batch(void) :
+        m_timestamps(),
+        m_timestamp_count(0U),
+        m_columns(),
+        m_key_count(0U)
+    {
+        // Nothing to do
+    }
+
+    /// @brief Gets the amount of timestamps values were added for
+    /// @return Amount of timestamps
+    inline const size_t& Timestamp_Count() const {
+        return m_timestamp_count;
+    }
+
+    /// @brief Gets the amount of different keys values were added for
+    /// @return Amount of keys
+    inline const size_t& Key_Count() const {
+        return m_key_count;
+    }
+
+    /// @brief Starts a new timestamp, all following values are added for it until the next timestamp is started
+    /// @param timestamp Unix timestamp in milliseconds the following values were measured at
+    /// @return Whether there was still space for another timestamp or not
+    inline bool Add_Timestamp(const uint64_t& timestamp) {
+        if (m_timestamp_count >= MaxTimestampsAmt) {
+            return false;
+        }
+        m_timestamps[m_timestamp_count] = timestamp;
+        m_timestamp_count++;
+        return true;
+    }
+
+    /// @brief Adds an integral value for the given key to the latest timestamp
+    /// @tparam T Type of the passed value, is required to be integral,
+    /// to ensure this method isn't used instead of the float one by mistake
+    /// @param key Key of the value, the same pointer or at least the same string has to be used for every timestamp
+    /// @param value Value that should be added
+    /// @return Whether the value was added, fails if no timestamp has been started, the key has already been used with a different type or there is no space for another key
+    template <typename T,
+#if THINGSBOARD_ENABLE_STL
+              typename std::enable_if<std::is_integral<T>::value>::type* = nullptr>
+#else
+              typename ArduinoJson::ARDUINOJSON_VERSION_NAMESPACE::detail::enable_if<ArduinoJson::ARDUINOJSON_VERSION_NAMESPACE::detail::is_integral<T>::value>::type* = nullptr>
+#endif // THINGSBOARD_ENABLE_STL
+    inline bool Add_Value(const char *key, T value) {
+        Data data;
+        data.integer = value;
+        return Add_Value(key, DataType::TYPE_INT, data);
+    }
+
+    /// @brief Adds a floating point value for the given key to the latest timestamp
+    /// @tparam T Type of the passed value, is required to be a floating point,
+    /// to ensure this method isn't used instead of the boolean one by mistake
+    /// @param key Key of the value, the same pointer or at least the same string has to be used for every timestamp
+    /// @param value Value that should be added
+    /// @return Whether the value was added, fails if no timestamp has been started, the key has already been used with a different type or there is no space for another key
+    template <typename T,
+#if THINGSBOARD_ENABLE_STL
+              typename std::enable_if<std::is_floating_point<T>::value>::type* = nullptr>
+#else
+              typename ArduinoJson::ARDUINOJSON_VERSION_NAMESPACE::detail::enable_if<ArduinoJson::ARDUINOJSON_VERSION_NAMESPACE::detail::is_floating_point<T>::value>::type* = nullptr>
+#endif // THINGSBOARD_ENABLE_STL
+    inline bool Add_Value(const char *key, T value) {
+        Data data;
+        data.real = value;
+        return Add_Value(key, DataType::TYPE_REAL, data);
+    }
+
+    /// @brief Adds a boolean value for the given key to the latest timestamp
+    /// @param key Key of the value, the same pointer or at least the same string has to be used for every timestamp
+    /// @param value Value that should be added
+    /// @return Whether the value was added, fails if no timestamp has been started, the key has already been used with a different type or there is no space for another key
+    inline bool Add_Value(const char *key, bool value) {
+        Data data;
+        data.boolean = value;
+        return Add_Value(key, DataType::TYPE_BOOL, data);
+    }
+
+    /// @brief Adds a string value for the given key to the latest timestamp
+    /// @param key Key of the value, the same pointer or at least the same string has to be used for every timestamp
+    /// @param value Value that should be added, is only referenced and therefore has to stay valid until the batch has been sent
+    /// @return Whether the value was added, fails if no timestamp has been started, the key has already been used with a different type or there is no space for another key
+    inline bool Add_Value(const char *key, const char *value) {
+        Data data;
+        data.str = value;
+        return Add_Value(key, DataType::TYPE_STR, data);
+    }
+
+    /// @brief Removes all timestamps and their values, but keeps the keys and their types,
+    /// so that the next batch of the same measurements does not have to look up new columns
+    inline void Clear() {
+        m_timestamp_count = 0U;
+        for (size_t i = 0U; i < m_key_count; i++) {
+            memset(m_columns[i].present, 0, sizeof(m_columns[i].present));
+        }
+    }
+
+    /// @brief Calculates the total size of the string Serialize_Json() would produce including the null end terminator,
+    /// the same as Helper::Measure_Json() does for json documents
+    /// @return Total size of the serialized batch + 1 byte for the string null terminator
+    inline size_t Measure_Json() const {
+        Counting_Writer writer;
+        return Serialize_Json(writer) + 1U;
+    }
+
+    /// @brief Serializes the batch directly into the given writer, only a single timestamp is held in a json document at once
+    /// @tparam TWriter Class that contains the write(uint8_t) and write(const uint8_t*, size_t) methods, like Print or the Publish_Writer
+    /// @param writer Writer the batch is serialized into
+    /// @return Amount of bytes written into the writer
+    template <typename TWriter>
+    inline size_t Serialize_Json(TWriter& writer) const {
+        size_t written = writer.write(static_cast<uint8_t>('['));
+        for (size_t i = 0U; i < m_timestamp_count; i++) {
+            if (i > 0U) {
+                written += writer.write(static_cast<uint8_t>(','));
+            }
+            // Keys and string values are only linked, therefore the document never needs more than the key value pairs themselves
+            StaticJsonDocument<JSON_OBJECT_SIZE(2U) + JSON_OBJECT_SIZE(MaxKeysAmt)> jsonBuffer;
+            jsonBuffer[TS_KEY] = m_timestamps[i];
+            const JsonObject values = jsonBuffer.createNestedObject(VALUES_KEY);
+            for (size_t j = 0U; j < m_key_count; j++) {
+                const Column& column = m_columns[j];
+                if (!Is_Present(column, i)) {
+                    continue;
+                }
+                switch (column.type) {
+                    case DataType::TYPE_BOOL:
+                        values[column.key] = column.values[i].boolean;
+                        break;
+                    case DataType::TYPE_INT:
+                        values[column.key] = column.values[i].integer;
+                        break;
+                    case DataType::TYPE_REAL:
+                        values[column.key] = column.values[i].real;
+                        break;
+                    case DataType::TYPE_STR:
+                        values[column.key] = column.values[i].str;
+                        break;
+                    default:
+                        // Nothing to do
+                        break;
+                }
+            }
+            written += serializeJson(jsonBuffer, writer);
+        }
+        written += writer.write(static_cast<uint8_t>(']'));
+        return written;
+    }
+
+    /// @brief Serializes the batch into the given buffer and null terminates it, the same as serializeJson() does for json documents
+    /// @param buffer Buffer the batch is serialized into
+    /// @param size Size of the given buffer in bytes, should be atleast Measure_Json() to hold the complete batch
+    /// @return Amount of bytes written into the buffer, without the null terminator
+    inline size_t Serialize_Json(char *buffer, const size_t& size) const {
+        if (size == 0U) {
+            return 0U;
+        }
+        Buffer_Writer writer(buffer, size - 1U);
+        const size_t written = Serialize_Json(writer);
+        buffer[written] = '\0';
+        return written;
+    }
+
+  private:
+    // Data container
+    union Data {
+        const char  *str;
+        bool        boolean;
+        int64_t     integer;
+        double      real;
+    };
+
+    // Data type that is set inside the container
+    enum class DataType : uint8_t {
+        TYPE_NONE, // Column has not been assigned a type
+        TYPE_BOOL, // Column contains boolean values
+        TYPE_INT, // Column contains integral values
+        TYPE_REAL, // Column contains real (float, double) values
+        TYPE_STR // Column contains string values
+    };
+
+    /// @brief Values of a single key for every timestamp
+    struct Column {
+        const char *key;                                       // Key the values belong to
+        DataType type;                                         // Type of all values in this column
+        Data values[MaxTimestampsAmt];                         // Value of each timestamp, only valid if the timestamp is present
+        uint8_t present[(MaxTimestampsAmt + 7U) / 8U];         // Bit for each timestamp, whether a value was added for it or not
+    };
+
+    /// @brief Writer that only counts the bytes written into it, used to measure the batch without serializing it anywhere
+    struct Counting_Writer {
+        inline size_t write(uint8_t) {
+            return 1U;
+        }
+
+        inline size_t write(const uint8_t *, size_t size) {
+            return size;
+        }
+    };
+
+    /// @brief Writer into a buffer of fixed size, bytes that do not fit anymore are discarded
+    class Buffer_Writer {
+      public:
+        inline Buffer_Writer(char *buffer, const size_t& size) :
+            m_buffer(buffer),
+            m_size(size),
+            m_length(0U)
+        {
+            // Nothing to do
+        }
+
+        inline size_t write(uint8_t payload_byte) {
+            return write(&payload_byte, 1U);
+        }
+
+        inline size_t write(const uint8_t *buffer, size_t size) {
+            if (size > m_size - m_length) {
+                size = m_size - m_length;
+            }
+            memcpy(m_buffer + m_length, buffer, size);
+            m_length += size;
+            return size;
+        }
+
+      private:
+        char *m_buffer;  // Buffer the bytes are written into
+        size_t m_size;   // Maximum amount of bytes that can be written into the buffer
+        size_t m_length; // Amount of bytes already written into the buffer
+    };
+
+    /// @brief Adds the given value for the given key to the latest timestamp, creates the column of the key if it does not exist yet
+    /// @param key Key of the value
+    /// @param type Type of the value
+    /// @param data Value that should be added
+    /// @return Whether the value was added
+    inline bool Add_Value(const char *key, const DataType& type, const Data& data) {
+        if (key == nullptr || m_timestamp_count == 0U) {
+            return false;
+        }
+        Column *column = Find_Column(key);
+        if (column == nullptr) {
+            if (m_key_count >= MaxKeysAmt) {
+                return false;
+            }
+            column = &m_columns[m_key_count];
+            column->key = key;
+            column->type = type;
+            memset(column->present, 0, sizeof(column->present));
+            m_key_count++;
+        }
+        else if (column->type != type) {
+            return false;
+        }
+        const size_t index = m_timestamp_count - 1U;
+        column->values[index] = data;
+        column->present[index / 8U] |= static_cast<uint8_t>(1U << (index % 8U));
+        return true;
+    }
+
+    /// @brief Returns the column of the given key, the pointer is compared first because the same string is most likely used for every timestamp
+    /// @param key Key of the column
+    /// @return Column of the given key or nullptr if there is none yet
+    inline Column* Find_Column(const char *key) {
+        for (size_t i = 0U; i < m_key_count; i++) {
+            if (m_columns[i].key == key || strcmp(m_columns[i].key, key) == 0) {
+                return &m_columns[i];
+            }
+        }
+        return nullptr;
+    }
+
+    /// @brief Returns whether the given column contains a value for the timestamp with the given index
+    /// @param column Column that should be checked
+    /// @param index Index of the timestamp
+    /// @return Whether a value was added for the given timestamp
+    inline static bool Is_Present(const Column& column, const size_t& index) {
+        return (column.present[index / 8U] & (1U << (index % 8U))) != 0U;
+    }
+
+    uint64_t m_timestamps[MaxTimestampsAmt]; // Timestamp of each row
+    size_t m_timestamp_count;                // Amount of timestamps started
+    Column m_columns[MaxKeysAmt];            // Column of each key
+    size_t m_key_count;                      // Amount of keys used
+};
+
+#endif // Telemetry_Batch_h
@@ -3,7 +3,7 @@
 
 // Local includes.
 #include "Constants.h"
-#include "Vector.h"
+#include "Storage_Policy.h"
 #include "Helper.h"
 #include "ThingsBoardDefaultLogger.h"
 #include "Shared_Attribute_Callback.h"
@@ -13,6 +13,9 @@
 #include "Provision_Callback.h"
 #include "OTA_Handler.h"
 #include "IMQTT_Client.h"
+#include "Publish_Writer.h"
+#include "Topic_Router.h"
+#include "Telemetry_Batch.h"
 
 // Library includes.
 #if THINGSBOARD_ENABLE_STREAM_UTILS
@@ -74,6 +77,29 @@ constexpr char PROV_RESPONSE_TOPIC[] PROGMEM = "/provision/response";
 constexpr char PROV_RESPONSE_TOPIC[] = "/provision/response";
 #endif // THINGSBOARD_ENABLE_PROGMEM
 
+/// @brief Process methods the topics of received messages are routed to
+enum class ThingsBoard_Route : uint8_t {
+  PROVISION_RESPONSE,
+  ATTRIBUTE_UPDATE,
+  ATTRIBUTE_RESPONSE,
+  RPC_REQUEST,
+  RPC_RESPONSE,
+  FIRMWARE_RESPONSE
+};
+
+// Received topics, have to stay sorted by their topic so they can be walked like a trie, see Topic_Router for more information.
+constexpr Topic_Route<ThingsBoard_Route> RECEIVE_ROUTES[] = {
+  { PROV_RESPONSE_TOPIC, Topic_Suffix::NONE, ThingsBoard_Route::PROVISION_RESPONSE },
+  { ATTRIBUTE_TOPIC, Topic_Suffix::NONE, ThingsBoard_Route::ATTRIBUTE_UPDATE },
+  { ATTRIBUTE_RESPONSE_TOPIC, Topic_Suffix::NUMBER, ThingsBoard_Route::ATTRIBUTE_RESPONSE },
+  { RPC_REQUEST_TOPIC, Topic_Suffix::NUMBER, ThingsBoard_Route::RPC_REQUEST },
+  { RPC_RESPONSE_TOPIC, Topic_Suffix::NUMBER, ThingsBoard_Route::RPC_RESPONSE },
+#if THINGSBOARD_ENABLE_OTA
+  { FIRMWARE_RESPONSE_TOPIC, Topic_Suffix::NUMBER, ThingsBoard_Route::FIRMWARE_RESPONSE },
+#endif // THINGSBOARD_ENABLE_OTA
+};
+static_assert(Topic_Router::Is_Sorted(RECEIVE_ROUTES, sizeof(RECEIVE_ROUTES) / sizeof(RECEIVE_ROUTES[0U])), "RECEIVE_ROUTES have to be sorted by their topic");
+
 // Default login data.
 #if THINGSBOARD_ENABLE_PROGMEM
 constexpr char PROV_ACCESS_TOKEN[] PROGMEM = "provision";
@@ -119,14 +145,14 @@ constexpr char INVALID_BUFFER_SIZE[] PROGMEM = "Buffer size (%u) to small for th
 #if THINGSBOARD_ENABLE_OTA
 constexpr char NUMBER_PRINTF[] PROGMEM = "%u";
 #endif // THINGSBOARD_ENABLE_OTA
-#if !THINGSBOARD_ENABLE_DYNAMIC
 constexpr char MAX_RPC_EXCEEDED[] PROGMEM = "Too many server-side RPC subscriptions, increase MaxFieldsAmt or unsubscribe";
-constexpr char MAX_RPC_REQUEST_EXCEEDED[] PROGMEM = "Too many client-side RPC subscriptions, increase MaxFieldsAmt or unsubscribe";
+constexpr char MAX_RPC_REQUEST_EXCEEDED[] PROGMEM = "Too many client-side RPC requests waiting for their response, increase MaxRequestsAmt of Static_Storage or Default_Requests_Amt";
 constexpr char MAX_SHARED_ATT_UPDATE_EXCEEDED[] PROGMEM = "Too many shared attribute update callback subscriptions, increase MaxFieldsAmt or unsubscribe";
-constexpr char MAX_SHARED_ATT_REQUEST_EXCEEDED[] PROGMEM = "Too many shared attribute request callback subscriptions, increase MaxFieldsAmt";
-#else
-constexpr char COLON PROGMEM = ':';
-#endif // !THINGSBOARD_ENABLE_DYNAMIC
+constexpr char MAX_SHARED_ATT_REQUEST_EXCEEDED[] PROGMEM = "Too many attribute requests waiting for their response, increase MaxRequestsAmt of Static_Storage or Default_Requests_Amt";
+constexpr char REQUEST_TIMED_OUT[] PROGMEM = "Request with id (%u) timed out, its response is ignored if it still arrives";
+#if THINGSBOARD_ENABLE_DYNAMIC
+constexpr char RECEIVE_FIELDS_EXCEEDED[] PROGMEM = "Received message needs more memory than reserved for maxReceiveFieldsAmt fields, message is discarded, increase it in the constructor";
+#endif // THINGSBOARD_ENABLE_DYNAMIC
 constexpr char COMMA PROGMEM = ',';
 constexpr char NO_KEYS_TO_REQUEST[] PROGMEM = "No keys to request were given";
 constexpr char RPC_METHOD_NULL[] PROGMEM = "RPC methodName is NULL";
@@ -151,14 +177,14 @@ constexpr char INVALID_BUFFER_SIZE[] = "Buffer size (%u) to small for the given
 #if THINGSBOARD_ENABLE_OTA
 constexpr char NUMBER_PRINTF[] = "%u";
 #endif // THINGSBOARD_ENABLE_OTA
-#if !THINGSBOARD_ENABLE_DYNAMIC
 constexpr char MAX_RPC_EXCEEDED[] = "Too many server-side RPC subscriptions, increase MaxFieldsAmt or unsubscribe";
-constexpr char MAX_RPC_REQUEST_EXCEEDED[] = "Too many client-side RPC subscriptions, increase MaxFieldsAmt or unsubscribe";
+constexpr char MAX_RPC_REQUEST_EXCEEDED[] = "Too many client-side RPC requests waiting for their response, increase MaxRequestsAmt of Static_Storage or Default_Requests_Amt";
 constexpr char MAX_SHARED_ATT_UPDATE_EXCEEDED[] = "Too many shared attribute update callback subscriptions, increase MaxFieldsAmt or unsubscribe";
-constexpr char MAX_SHARED_ATT_REQUEST_EXCEEDED[] = "Too many shared attribute request callback subscriptions, increase MaxFieldsAmt";
-#else
-constexpr char COLON = ':';
-#endif // !THINGSBOARD_ENABLE_DYNAMIC
+constexpr char MAX_SHARED_ATT_REQUEST_EXCEEDED[] = "Too many attribute requests waiting for their response, increase MaxRequestsAmt of Static_Storage or Default_Requests_Amt";
+constexpr char REQUEST_TIMED_OUT[] = "Request with id (%u) timed out, its response is ignored if it still arrives";
+#if THINGSBOARD_ENABLE_DYNAMIC
+constexpr char RECEIVE_FIELDS_EXCEEDED[] = "Received message needs more memory than reserved for maxReceiveFieldsAmt fields, message is discarded, increase it in the constructor";
+#endif // THINGSBOARD_ENABLE_DYNAMIC
 constexpr char COMMA = ',';
 constexpr char NO_KEYS_TO_REQUEST[] = "No keys to request were given";
 constexpr char RPC_METHOD_NULL[] = "RPC methodName is NULL";
@@ -302,7 +328,9 @@ constexpr char DOWNLOADING_FW[] = "Attempting to download over MQTT...";
 /// If this feature of automatic deduction, is not needed, or not wanted because it allocates memory on the heap, then the values can be set once as template arguements.
 /// Simply set THINGSBOARD_ENABLE_DYNAMIC to 0, before including ThingsBoard.h
 /// @tparam Logger Logging class that should be used to print messages generated by internal processes, default = ThingsBoardDefaultLogger
-template<typename Logger = ThingsBoardDefaultLogger>
+/// @tparam Storage Storage policy deciding which containers hold the subscribed callbacks, Static_Storage keeps them inside the instance so subscribing never touches the heap, default = Dynamic_Storage
+template<typename Logger = ThingsBoardDefaultLogger,
+         typename Storage = Dynamic_Storage>
 #else
 /// @brief Wrapper around any arbitrary MQTT Client implementing the IMQTT_Client interface, to allow connecting and sending / retrieving data from ThingsBoard over the MQTT or MQTT with TLS/SSL protocol.
 /// BufferSize of the underlying data buffer can be changed during the runtime and the maximum amount of data points that can ever be can be set once as template arguements.
@@ -310,8 +338,11 @@ template<typename Logger = ThingsBoardDefaultLogger>
 /// simply set THINGSBOARD_ENABLE_DYNAMIC to 1, before including ThingsBoard.h
 /// @tparam MaxFieldsAmt Maximum amount of key value pair that we will be able to sent or received by ThingsBoard in one call, default = 8
 /// @tparam Logger Logging class that should be used to print messages generated by internal processes, default = ThingsBoardDefaultLogger
+/// @tparam Storage Storage policy deciding which containers hold the subscribed callbacks, Static_Storage keeps them inside the instance so subscribing never touches the heap.
+/// The capacity of Static_Storage should be atleast MaxFieldsAmt, because that is the amount of callbacks that is permitted to be subscribed, default = Dynamic_Storage
 template<size_t MaxFieldsAmt = Default_Fields_Amt,
-         typename Logger = ThingsBoardDefaultLogger>
+         typename Logger = ThingsBoardDefaultLogger,
+         typename Storage = Dynamic_Storage>
 #endif // THINGSBOARD_ENABLE_DYNAMIC
 class ThingsBoardSized {
   public:
@@ -331,16 +362,32 @@ class ThingsBoardSized {
     /// The aforementioned options can only be enabled if Arduino is used to build this library, because the StreamUtils library requires it, default = Default_Payload
     /// @param maxStackSize Maximum amount of bytes we want to allocate on the stack, default = Default_Max_Stack_Size
     /// @param bufferingSize Amount of bytes allocated to speed up serialization, default = Default_Buffering_Size
+#if THINGSBOARD_ENABLE_DYNAMIC
+    /// @param maxReceiveFieldsAmt Maximum amount of key value pairs a received message can contain after filtering out keys no callback is interested in.
+    /// The document received messages are deserialized into is allocated once with that size and never grows, bigger messages are discarded
+    /// and the user is informed with a message to the Logger, default = Default_Fields_Amt
+    inline ThingsBoardSized(IMQTT_Client& client, const uint16_t& bufferSize = Default_Payload, const size_t& maxStackSize = Default_Max_Stack_Size, const size_t& bufferingSize = Default_Buffering_Size, const size_t& maxReceiveFieldsAmt = Default_Fields_Amt)
+#else
     inline ThingsBoardSized(IMQTT_Client& client, const uint16_t& bufferSize = Default_Payload, const size_t& maxStackSize = Default_Max_Stack_Size, const size_t& bufferingSize = Default_Buffering_Size)
+#endif // THINGSBOARD_ENABLE_DYNAMIC
       : m_client(client)
       , m_max_stack(maxStackSize)
       , m_buffering_size(bufferingSize)
       , m_rpc_callbacks()
       , m_rpc_request_callbacks()
       , m_shared_attribute_update_callbacks()
+      , m_shared_attribute_keys()
+      , m_shared_attribute_matches()
       , m_attribute_request_callbacks()
       , m_provision_callback()
       , m_request_id(0U)
+#if THINGSBOARD_ENABLE_DYNAMIC
+      , m_receive_buffer(JSON_OBJECT_SIZE(maxReceiveFieldsAmt))
+      , m_shared_attribute_filter(0U)
+#else
+      , m_shared_attribute_filter()
+#endif // THINGSBOARD_ENABLE_DYNAMIC
+      , m_rpc_filter()
 #if THINGSBOARD_ENABLE_OTA
       , m_fw_callback(nullptr)
       , m_previous_buffer_size(0U)
@@ -361,6 +408,10 @@ class ThingsBoardSized {
 #if !THINGSBOARD_ENABLE_DYNAMIC
       reserve_callback_size(MaxFieldsAmt);
 #endif // !THINGSBOARD_ENABLE_DYNAMIC
+
+      // Server-side RPC callbacks only ever receive the method name and the parameters
+      m_rpc_filter[RPC_METHOD_KEY] = true;
+      m_rpc_filter[RPC_PARAMS_KEY] = true;
     }
 
     /// @brief Destructor
@@ -383,17 +434,14 @@ class ThingsBoardSized {
       m_max_stack = maxStackSize;
     }
 
-#if THINGSBOARD_ENABLE_STREAM_UTILS
-
-    /// @brief Sets the amount of bytes that can be allocated to speed up fall back serialization with the StreamUtils class
-    /// See https://github.com/bblanchon/ArduinoStreamUtils for more information on the underlying class used
+    /// @brief Sets the amount of bytes that can be allocated to speed up serialization directly into the client,
+    /// when THINGSBOARD_ENABLE_STREAM_UTILS is set this is the buffer of the StreamUtils class (see https://github.com/bblanchon/ArduinoStreamUtils for more information),
+    /// otherwise the chunk of the Publish_Writer class, which is placed on the stack for every sent json message
     /// @param bufferingSize Amount of bytes allocated to speed up serialization
     inline void setBufferingSize(const size_t& bufferingSize) {
       m_buffering_size = bufferingSize;
     }
 
-#endif // THINGSBOARD_ENABLE_STREAM_UTILS
-
     /// @brief Sets the size of the buffer for the underlying network client that will be used to establish the connection to ThingsBoard
     /// @param bufferSize Maximum amount of data that can be either received or sent to ThingsBoard at once, if bigger packets are received they are discarded
     /// and if we attempt to send data that is bigger, it will not be sent, the internal value can be changed later at any time with the setBufferSize() method
@@ -464,9 +512,11 @@ class ThingsBoardSized {
       return m_client.connected();
     }
 
-    /// @brief Receives / sends any outstanding messages from and to the MQTT broker
+    /// @brief Receives / sends any outstanding messages from and to the MQTT broker,
+    /// additionally discards client-side RPC and attribute requests whose response did not arrive in time, see Set_Timeout() of the request callbacks
     /// @return Whether sending or receiving the oustanding the messages was successful or not
     inline bool loop() {
+      Process_Request_Timeouts();
       return m_client.loop();
     }
 
@@ -493,46 +543,7 @@ class ThingsBoardSized {
         return false;
       }
 #endif // !THINGSBOARD_ENABLE_DYNAMIC
-      bool result = false;
-
-#if THINGSBOARD_ENABLE_STREAM_UTILS
-      // Check if the size of the given message would be too big for the actual client,
-      // if it is utilize the serialize json work around, so that the internal client buffer can be circumvented
-      if (m_client.get_buffer_size() < jsonSize)  {
-#if THINGSBOARD_ENABLE_DEBUG
-        char message[JSON_STRING_SIZE(strlen(SEND_MESSAGE)) + JSON_STRING_SIZE(strlen(topic)) + JSON_STRING_SIZE(strlen(SEND_SERIALIZED))];
-        snprintf_P(message, sizeof(message), SEND_MESSAGE, topic, SEND_SERIALIZED);
-        Logger::log(message);
-#endif // THINGSBOARD_ENABLE_DEBUG
-        result = Serialize_Json(topic, source, jsonSize);
-      }
-      // Check if the remaining stack size of the current task would overflow the stack,
-      // if it would allocate the memory on the heap instead to ensure no stack overflow occurs
-      else
-#endif // THINGSBOARD_ENABLE_STREAM_UTILS
-      if (getMaximumStackSize() < jsonSize) {
-        char* json = new char[jsonSize];
-        if (serializeJson(source, json, jsonSize) < jsonSize - 1) {
-          Logger::log(UNABLE_TO_SERIALIZE_JSON);
-        }
-        else {
-          result = Send_Json_String(topic, json);
-        }
-        // Ensure to actually delete the memory placed onto the heap, to make sure we do not create a memory leak
-        // and set the pointer to null so we do not have a dangling reference.
-        delete[] json;
-        json = nullptr;
-      }
-      else {
-        char json[jsonSize];
-        if (serializeJson(source, json, jsonSize) < jsonSize - 1) {
-          Logger::log(UNABLE_TO_SERIALIZE_JSON);
-          return result;
-        }
-        result = Send_Json_String(topic, json);
-      }
-
-      return result;
+      return Publish_Json(topic, source, jsonSize);
     }
 
     /// @brief Attempts to send custom json string over the given topic to the server
@@ -698,6 +709,18 @@ class ThingsBoardSized {
       return Send_Json(TELEMETRY_TOPIC, source, jsonSize);
     }
 
+    /// @brief Attempts to send the telemetry of multiple timestamps in a single message, which allows uploading buffered history at once.
+    /// The batch is serialized one timestamp at a time directly into the client, without creating a json document for the complete message.
+    /// See https://thingsboard.io/docs/reference/mqtt-api/#telemetry-upload-api for more information
+    /// @tparam MaxKeysAmt Maximum amount of different keys of the batch
+    /// @tparam MaxTimestampsAmt Maximum amount of timestamps of the batch
+    /// @param batch Telemetry of multiple timestamps we want to send
+    /// @return Whether sending the data was successful or not
+    template <size_t MaxKeysAmt, size_t MaxTimestampsAmt>
+    inline bool sendTelemetryBatch(const Telemetry_Batch<MaxKeysAmt, MaxTimestampsAmt>& batch) {
+      return Publish_Json(TELEMETRY_TOPIC, batch, batch.Measure_Json());
+    }
+
     //----------------------------------------------------------------------------
     // Attribute API
 
@@ -764,20 +787,21 @@ class ThingsBoardSized {
     /// @return Whether subscribing the given callbacks was successful or not
     template<class InputIterator>
     inline bool RPC_Subscribe(const InputIterator& first_itr, const InputIterator& last_itr) {
-#if !THINGSBOARD_ENABLE_DYNAMIC
-      const size_t size = std::distance(first_itr, last_itr);
-      if (m_rpc_callbacks.size() + size > m_rpc_callbacks.capacity()) {
+      // Checked before anything is inserted, so that either all callbacks are subscribed or none
+      if (Is_Callbacks_Full(m_rpc_callbacks, std::distance(first_itr, last_itr))) {
         Logger::log(MAX_RPC_EXCEEDED);
         return false;
       }
-#endif // !THINGSBOARD_ENABLE_DYNAMIC
       if (!m_client.subscribe(RPC_SUBSCRIBE_TOPIC)) {
         Logger::log(SUBSCRIBE_TOPIC_FAILED);
         return false;
       }
 
-      // Push back complete vector into our local m_rpc_callbacks vector.
-      m_rpc_callbacks.insert(m_rpc_callbacks.end(), first_itr, last_itr);
+      for (InputIterator itr = first_itr; itr != last_itr; ++itr) {
+        if (!RPC_Insert_Sorted(*itr)) {
+          return false;
+        }
+      }
       return true;
     }
 
@@ -791,19 +815,20 @@ class ThingsBoardSized {
     /// if not the system might crash unexpectedly at a later point
     /// @return Whether subscribing the given callbacks was successful or not
     inline bool RPC_Subscribe(const RPC_Callback *callbacks, const size_t& callbacksSize) {
-#if !THINGSBOARD_ENABLE_DYNAMIC
-      if (m_rpc_callbacks.size() + callbacksSize > m_rpc_callbacks.capacity()) {
+      // Checked before anything is inserted, so that either all callbacks are subscribed or none
+      if (Is_Callbacks_Full(m_rpc_callbacks, callbacksSize)) {
         Logger::log(MAX_RPC_EXCEEDED);
         return false;
       }
-#endif // !THINGSBOARD_ENABLE_DYNAMIC
       if (!m_client.subscribe(RPC_SUBSCRIBE_TOPIC)) {
         Logger::log(SUBSCRIBE_TOPIC_FAILED);
         return false;
       }
 
       for (size_t i = 0; i < callbacksSize; i++) {
-        m_rpc_callbacks.push_back(callbacks[i]);
+        if (!RPC_Insert_Sorted(callbacks[i])) {
+          return false;
+        }
       }
       return true;
     }
@@ -816,20 +841,16 @@ class ThingsBoardSized {
     /// @param callback Callback method that will be called
     /// @return Whether subscribing the given callback was successful or not
     inline bool RPC_Subscribe(const RPC_Callback& callback) {
-#if !THINGSBOARD_ENABLE_DYNAMIC
-      if (m_rpc_callbacks.size() + 1 > m_rpc_callbacks.capacity()) {
+      if (Is_Callbacks_Full(m_rpc_callbacks)) {
         Logger::log(MAX_RPC_EXCEEDED);
         return false;
       }
-#endif // !THINGSBOARD_ENABLE_DYNAMIC
       if (!m_client.subscribe(RPC_SUBSCRIBE_TOPIC)) {
         Logger::log(SUBSCRIBE_TOPIC_FAILED);
         return false;
       }
 
-      // Push back given callback into our local vector
-      m_rpc_callbacks.push_back(callback);
-      return true;
+      return RPC_Insert_Sorted(callback);
     }
 
     /// @brief Unsubcribes all server-side RPC callbacks.
@@ -895,14 +916,17 @@ class ThingsBoardSized {
         requestVariant[RPC_PARAMS_KEY] = RPC_EMPTY_PARAMS_VALUE;
       }
 
-      m_request_id++;
-      registeredCallback->Set_Request_ID(m_request_id);
-
-      char topic[Helper::detectSize(RPC_SEND_REQUEST_TOPIC, m_request_id)];
-      snprintf_P(topic, sizeof(topic), RPC_SEND_REQUEST_TOPIC, m_request_id);
+      const size_t request_id = registeredCallback->Get_Request_ID();
+      char topic[Helper::detectSize(RPC_SEND_REQUEST_TOPIC, request_id)];
+      snprintf_P(topic, sizeof(topic), RPC_SEND_REQUEST_TOPIC, request_id);
 
       const size_t objectSize = Helper::Measure_Json(requestBuffer);
-      return Send_Json(topic, requestBuffer, objectSize);
+      if (!Send_Json(topic, requestBuffer, objectSize)) {
+        // A request that was never sent will never be answered either, therefore free its slot for the following requests
+        m_rpc_request_callbacks.erase(request_id);
+        return false;
+      }
+      return true;
     }
 
     //----------------------------------------------------------------------------
@@ -1009,20 +1033,25 @@ class ThingsBoardSized {
     /// @return Whether subscribing the given callbacks was successful or not
     template<class InputIterator>
     inline bool Shared_Attributes_Subscribe(const InputIterator& first_itr, const InputIterator& last_itr) {
-#if !THINGSBOARD_ENABLE_DYNAMIC
-      const size_t size = std::distance(first_itr, last_itr);
-      if (m_shared_attribute_update_callbacks.size() + size > m_shared_attribute_update_callbacks.capacity()) {
+      // Checked before anything is inserted, so that either all callbacks and their keys are subscribed or none
+      size_t key_count = 0U;
+      for (InputIterator itr = first_itr; itr != last_itr; ++itr) {
+        key_count += Get_Key_Count(*itr);
+      }
+      if (Is_Callbacks_Full(m_shared_attribute_update_callbacks, std::distance(first_itr, last_itr)) || Is_Full(m_shared_attribute_keys, key_count)) {
         Logger::log(MAX_SHARED_ATT_UPDATE_EXCEEDED);
         return false;
       }
-#endif // !THINGSBOARD_ENABLE_DYNAMIC
       if (!m_client.subscribe(ATTRIBUTE_TOPIC)) {
         Logger::log(SUBSCRIBE_TOPIC_FAILED);
         return false;
       }
 
-      // Push back complete vector into our local m_shared_attribute_update_callbacks vector.
-      m_shared_attribute_update_callbacks.insert(m_shared_attribute_update_callbacks.end(), first_itr, last_itr);
+      for (InputIterator itr = first_itr; itr != last_itr; ++itr) {
+        if (!Shared_Attributes_Insert(*itr)) {
+          return false;
+        }
+      }
       return true;
     }
 
@@ -1036,19 +1065,24 @@ class ThingsBoardSized {
     /// if not the system might crash unexpectedly at a later point
     /// @return Whether subscribing the given callbacks was successful or not
     inline bool Shared_Attributes_Subscribe(const Shared_Attribute_Callback *callbacks, const size_t& callbacksSize) {
-#if !THINGSBOARD_ENABLE_DYNAMIC
-      if (m_shared_attribute_update_callbacks.size() + callbacksSize > m_shared_attribute_update_callbacks.capacity()) {
+      // Checked before anything is inserted, so that either all callbacks and their keys are subscribed or none
+      size_t key_count = 0U;
+      for (size_t i = 0; i < callbacksSize; i++) {
+        key_count += Get_Key_Count(callbacks[i]);
+      }
+      if (Is_Callbacks_Full(m_shared_attribute_update_callbacks, callbacksSize) || Is_Full(m_shared_attribute_keys, key_count)) {
         Logger::log(MAX_SHARED_ATT_UPDATE_EXCEEDED);
         return false;
       }
-#endif // !THINGSBOARD_ENABLE_DYNAMIC
       if (!m_client.subscribe(ATTRIBUTE_TOPIC)) {
         Logger::log(SUBSCRIBE_TOPIC_FAILED);
         return false;
       }
 
       for (size_t i = 0; i < callbacksSize; i++) {
-        m_shared_attribute_update_callbacks.push_back(callbacks[i]);
+        if (!Shared_Attributes_Insert(callbacks[i])) {
+          return false;
+        }
       }
       return true;
     }
@@ -1061,20 +1095,16 @@ class ThingsBoardSized {
     /// @param callback Callback method that will be called
     /// @return Whether subscribing the given callback was successful or not
     inline bool Shared_Attributes_Subscribe(const Shared_Attribute_Callback& callback) {
-#if !THINGSBOARD_ENABLE_DYNAMIC
-      if (m_shared_attribute_update_callbacks.size() + 1U > m_shared_attribute_update_callbacks.capacity()) {
+      if (Is_Callbacks_Full(m_shared_attribute_update_callbacks) || Is_Full(m_shared_attribute_keys, Get_Key_Count(callback))) {
         Logger::log(MAX_SHARED_ATT_UPDATE_EXCEEDED);
         return false;
       }
-#endif // !THINGSBOARD_ENABLE_DYNAMIC
       if (!m_client.subscribe(ATTRIBUTE_TOPIC)) {
         Logger::log(SUBSCRIBE_TOPIC_FAILED);
         return false;
       }
 
-      // Push back given callback into our local vector
-      m_shared_attribute_update_callbacks.push_back(callback);
-      return true;
+      return Shared_Attributes_Insert(callback);
     }
 
     /// @brief Unsubcribes all shared attribute callbacks.
@@ -1084,38 +1114,144 @@ class ThingsBoardSized {
     inline bool Shared_Attributes_Unsubscribe() {
       // Empty all callbacks
       m_shared_attribute_update_callbacks.clear();
+      m_shared_attribute_keys.clear();
+      m_shared_attribute_matches.clear();
+      m_shared_attribute_filter.clear();
       return m_client.unsubscribe(ATTRIBUTE_TOPIC);
     }
   
   private:
 
+    /// @brief Publishes the given source over the given topic, after it has been checked that the payload fits into the buffer of the underlying client
+    /// @tparam TSource Source class that should be used to serialize the json that is sent to the server
+    /// @param topic Topic we want to send the data over
+    /// @param source Data source containing our json key value pairs or the Telemetry_Batch we want to send
+    /// @param jsonSize Size of the data inside the source, including the null terminator
+    /// @return Whether sending the data was successful or not
+    template <typename TSource>
+    inline bool Publish_Json(const char* topic, const TSource& source, const size_t& jsonSize) {
 #if THINGSBOARD_ENABLE_STREAM_UTILS
+      // Check if the size of the given message would be too big for the actual client,
+      // if it is utilize the serialize json work around, so that the internal client buffer can be circumvented
+      if (m_client.get_buffer_size() < jsonSize)  {
+#if THINGSBOARD_ENABLE_DEBUG
+        char message[JSON_STRING_SIZE(strlen(SEND_MESSAGE)) + JSON_STRING_SIZE(strlen(topic)) + JSON_STRING_SIZE(strlen(SEND_SERIALIZED))];
+        snprintf_P(message, sizeof(message), SEND_MESSAGE, topic, SEND_SERIALIZED);
+        Logger::log(message);
+#endif // THINGSBOARD_ENABLE_DEBUG
+        return Serialize_Json(topic, source, jsonSize);
+      }
+#endif // THINGSBOARD_ENABLE_STREAM_UTILS
+
+      const uint16_t& currentBufferSize = m_client.get_buffer_size();
+      // The measured size includes the null terminator, which is never sent
+      const size_t payloadSize = jsonSize - 1;
+
+      if (currentBufferSize < payloadSize) {
+        char message[Helper::detectSize(INVALID_BUFFER_SIZE, currentBufferSize, payloadSize)];
+        snprintf_P(message, sizeof(message), INVALID_BUFFER_SIZE, currentBufferSize, payloadSize);
+        Logger::log(message);
+        return false;
+      }
+
+#if THINGSBOARD_ENABLE_DEBUG
+      // Only the debug output needs the json as a string, the message itself is serialized directly into the client
+      char json[jsonSize];
+      Serialize_Source(source, json, jsonSize);
+      char message[JSON_STRING_SIZE(strlen(SEND_MESSAGE)) + JSON_STRING_SIZE(strlen(topic)) + jsonSize];
+      snprintf_P(message, sizeof(message), SEND_MESSAGE, topic, json);
+      Logger::log(message);
+#endif // THINGSBOARD_ENABLE_DEBUG
+
+      return Serialize_Json(topic, source, jsonSize);
+    }
+
+    /// @brief Serializes the given json source into the given writer, see https://arduinojson.org/v6/api/json/serializejson/ for more information
+    /// @tparam TSource Source class that should be used to serialize the json that is sent to the server
+    /// @tparam TWriter Class that contains the write(uint8_t) and write(const uint8_t*, size_t) methods
+    /// @param source Data source containing our json key value pairs
+    /// @param writer Writer the source is serialized into
+    /// @return Amount of bytes written
+    template <typename TSource, typename TWriter>
+    inline static size_t Serialize_Source(const TSource& source, TWriter& writer) {
+      return serializeJson(source, writer);
+    }
+
+    /// @brief Serializes the given json source into the given buffer and null terminates it
+    /// @tparam TSource Source class that should be used to serialize the json that is sent to the server
+    /// @param source Data source containing our json key value pairs
+    /// @param buffer Buffer the source is serialized into
+    /// @param size Size of the given buffer in bytes
+    /// @return Amount of bytes written, without the null terminator
+    template <typename TSource>
+    inline static size_t Serialize_Source(const TSource& source, char *buffer, const size_t& size) {
+      return serializeJson(source, buffer, size);
+    }
+
+    /// @brief Serializes the given telemetry batch into the given writer, the batch is not a json document and therefore serializes itself
+    /// @tparam MaxKeysAmt Maximum amount of different keys of the batch
+    /// @tparam MaxTimestampsAmt Maximum amount of timestamps of the batch
+    /// @tparam TWriter Class that contains the write(uint8_t) and write(const uint8_t*, size_t) methods
+    /// @param batch Telemetry of multiple timestamps
+    /// @param writer Writer the batch is serialized into
+    /// @return Amount of bytes written
+    template <size_t MaxKeysAmt, size_t MaxTimestampsAmt, typename TWriter>
+    inline static size_t Serialize_Source(const Telemetry_Batch<MaxKeysAmt, MaxTimestampsAmt>& batch, TWriter& writer) {
+      return batch.Serialize_Json(writer);
+    }
+
+    /// @brief Serializes the given telemetry batch into the given buffer and null terminates it
+    /// @tparam MaxKeysAmt Maximum amount of different keys of the batch
+    /// @tparam MaxTimestampsAmt Maximum amount of timestamps of the batch
+    /// @param batch Telemetry of multiple timestamps
+    /// @param buffer Buffer the batch is serialized into
+    /// @param size Size of the given buffer in bytes
+    /// @return Amount of bytes written, without the null terminator
+    template <size_t MaxKeysAmt, size_t MaxTimestampsAmt>
+    inline static size_t Serialize_Source(const Telemetry_Batch<MaxKeysAmt, MaxTimestampsAmt>& batch, char *buffer, const size_t& size) {
+      return batch.Serialize_Json(buffer, size);
+    }
 
     /// @brief Serialize the custom attribute source into the underlying client.
-    /// Sends the given bytes to the client without requiring any temporary buffer at the cost of hugely increased send times
+    /// Sends the given bytes to the client without requiring any temporary buffer for the complete json,
+    /// only the measured size is needed beforehand to write the MQTT header, afterwards the json is serialized a single time straight into the client.
+    /// If THINGSBOARD_ENABLE_STREAM_UTILS is set the StreamUtils BufferingPrint class is used to gather the serialized bytes, otherwise the Publish_Writer class
     /// @tparam TSource Source class that should be used to serialize the json that is sent to the server
     /// @param topic Topic we want to send the data over
     /// @param source Data source containing our json key value pairs we want to send
-    /// @param jsonSize Size of the data inside the source
+    /// @param jsonSize Size of the data inside the source, including the null terminator
     /// @return Whether sending the data was successful or not
     template <typename TSource>
     inline bool Serialize_Json(const char* topic, const TSource& source, const size_t& jsonSize) {
-      if (!m_client.begin_publish(topic, jsonSize)) {
+      const size_t payloadSize = jsonSize - 1;
+      if (!m_client.begin_publish(topic, payloadSize)) {
         Logger::log(UNABLE_TO_SERIALIZE_JSON);
         return false;
       }
-      BufferingPrint buffered_print(m_client, getBufferingSize());
-      const size_t bytes_serialized = serializeJson(source, buffered_print);
-      if (bytes_serialized < jsonSize) {
+#if THINGSBOARD_ENABLE_STREAM_UTILS
+      BufferingPrint writer(m_client, getBufferingSize());
+#else
+      // Chunk is never bigger than the payload itself and atleast one byte
+      uint8_t chunk[payloadSize < getBufferingSize() ? payloadSize + 1 : getBufferingSize() + 1];
+      Publish_Writer writer(m_client, chunk, sizeof(chunk));
+#endif // THINGSBOARD_ENABLE_STREAM_UTILS
+      const size_t bytes_serialized = Serialize_Source(source, writer);
+#if THINGSBOARD_ENABLE_STREAM_UTILS
+      writer.flush();
+      const bool flushed = true;
+#else
+      const bool flushed = writer.flush();
+#endif // THINGSBOARD_ENABLE_STREAM_UTILS
+      if (!flushed || bytes_serialized < payloadSize) {
         Logger::log(UNABLE_TO_SERIALIZE_JSON);
+        // The header already announced the complete payload, the broker would read the following packets as the rest of it,
+        // therefore the connection can not be used anymore and has to be established again
+        m_client.disconnect();
         return false;
       }
-      buffered_print.flush();
       return m_client.end_publish();
     }
 
-#endif // THINGSBOARD_ENABLE_STREAM_UTILS
-
 #if THINGSBOARD_ENABLE_OTA
 
     /// @brief Publishes a request via MQTT to request the given firmware chunk
@@ -1146,17 +1282,12 @@ class ThingsBoardSized {
       return m_max_stack;
     }
 
-#if THINGSBOARD_ENABLE_STREAM_UTILS
-
-    /// @brief Returns the amount of bytes that can be allocated to speed up fall back serialization with the StreamUtils class
-    /// See https://github.com/bblanchon/ArduinoStreamUtils for more information on the underlying class used
+    /// @brief Returns the amount of bytes that can be allocated to speed up serialization directly into the client
     /// @return Amount of bytes allocated to speed up serialization
     inline const size_t& getBufferingSize() const {
       return m_buffering_size;
     }
 
-#endif // THINGSBOARD_ENABLE_STREAM_UTILS
-
     /// @brief Requests one client-side or shared attribute calllback,
     /// that will be called if the key-value pair from the server for the given client-side or shared attributes is received
     /// @param callback Callback method that will be called
@@ -1230,15 +1361,19 @@ class ThingsBoardSized {
       requestVariant[attributeRequestKey] = request;
 #endif // THINGSBOARD_ENABLE_STL
 
-      m_request_id++;
-      registeredCallback->Set_Request_ID(m_request_id);
       registeredCallback->Set_Attribute_Key(attributeResponseKey);
 
-      char topic[Helper::detectSize(ATTRIBUTE_REQUEST_TOPIC, m_request_id)];
-      snprintf_P(topic, sizeof(topic), ATTRIBUTE_REQUEST_TOPIC, m_request_id);
+      const size_t request_id = registeredCallback->Get_Request_ID();
+      char topic[Helper::detectSize(ATTRIBUTE_REQUEST_TOPIC, request_id)];
+      snprintf_P(topic, sizeof(topic), ATTRIBUTE_REQUEST_TOPIC, request_id);
 
       const size_t objectSize = Helper::Measure_Json(requestBuffer);
-      return Send_Json(topic, requestBuffer, objectSize);
+      if (!Send_Json(topic, requestBuffer, objectSize)) {
+        // A request that was never sent will never be answered either, therefore free its slot for the following requests
+        m_attribute_request_callbacks.erase(request_id);
+        return false;
+      }
+      return true;
     }
 
     /// @brief Subscribes one provision callback,
@@ -1451,9 +1586,8 @@ class ThingsBoardSized {
     /// the internal memory blocks might need to be moved to a new location
     inline void reserve_callback_size(const size_t& reservedSize) {
       m_rpc_callbacks.reserve(reservedSize);
-      m_rpc_request_callbacks.reserve(reservedSize);
       m_shared_attribute_update_callbacks.reserve(reservedSize);
-      m_attribute_request_callbacks.reserve(reservedSize);
+      m_shared_attribute_matches.reserve(reservedSize);
     }
 #endif // !THINGSBOARD_ENABLE_DYNAMIC
 
@@ -1462,20 +1596,16 @@ class ThingsBoardSized {
     /// @param registeredCallback Editable pointer to a reference of the local version that was copied from the passed callback
     /// @return Whether requesting the given callback was successful or not
     inline bool RPC_Request_Subscribe(const RPC_Request_Callback& callback, RPC_Request_Callback*& registeredCallback = nullptr) {
-#if !THINGSBOARD_ENABLE_DYNAMIC
-      if (m_rpc_request_callbacks.size() + 1 > m_rpc_request_callbacks.capacity()) {
+      if (Is_Full(m_rpc_request_callbacks)) {
         Logger::log(MAX_RPC_REQUEST_EXCEEDED);
         return false;
       }
-#endif // !THINGSBOARD_ENABLE_DYNAMIC
       if (!m_client.subscribe(RPC_RESPONSE_SUBSCRIBE_TOPIC)) {
         Logger::log(SUBSCRIBE_TOPIC_FAILED);
         return false;
       }
 
-      // Push back given callback into our local vector
-      m_rpc_request_callbacks.push_back(callback);
-      registeredCallback = &m_rpc_request_callbacks.back();
+      registeredCallback = Insert_Request(m_rpc_request_callbacks, callback);
       return true;
     }
 
@@ -1493,23 +1623,63 @@ class ThingsBoardSized {
     /// @param registeredCallback Editable pointer to a reference of the local version that was copied from the passed callback
     /// @return Whether requesting the given callback was successful or not
     inline bool Attributes_Request_Subscribe(const Attribute_Request_Callback& callback, Attribute_Request_Callback*& registeredCallback = nullptr) {
-#if !THINGSBOARD_ENABLE_DYNAMIC
-      if (m_attribute_request_callbacks.size() + 1 > m_attribute_request_callbacks.capacity()) {
+      if (Is_Full(m_attribute_request_callbacks)) {
         Logger::log(MAX_SHARED_ATT_REQUEST_EXCEEDED);
         return false;
       }
-#endif // !THINGSBOARD_ENABLE_DYNAMIC
       if (!m_client.subscribe(ATTRIBUTE_RESPONSE_SUBSCRIBE_TOPIC)) {
         Logger::log(SUBSCRIBE_TOPIC_FAILED);
         return false;
       }
 
-      // Push back given callback into our local vector
-      m_attribute_request_callbacks.push_back(callback);
-      registeredCallback = &m_attribute_request_callbacks.back();
+      registeredCallback = Insert_Request(m_attribute_request_callbacks, callback);
       return true;
     }
 
+    /// @brief Copies the given request into the given table with the next request id, whose slot in the table is not used by another request still waiting for its response
+    /// @tparam Table Request_Table the request should be inserted into, has to have atleast one free slot
+    /// @tparam Request Client-side RPC or attribute request callback
+    /// @param table Table the request should be inserted into
+    /// @param request Request that should be inserted
+    /// @return Pointer to the inserted copy of the request, which already has its request id set
+    template<typename Table, typename Request>
+    inline Request* Insert_Request(Table& table, const Request& request) {
+      // Because the table is not full, atleast one of the following request ids is free,
+      // skipping the ones still in use keeps the request ids unique for both kinds of requests
+      do {
+        m_request_id++;
+      } while (!table.is_free(m_request_id));
+
+      Request* registeredRequest = table.insert(m_request_id, request, Helper::getMillis(), request.Get_Timeout());
+      registeredRequest->Set_Request_ID(m_request_id);
+      return registeredRequest;
+    }
+
+    /// @brief Discards the client-side RPC and attribute requests whose response did not arrive in time and calls their timeout callback.
+    /// As long as no request timed out, only compares the current time with the earliest deadline of each kind of request
+    inline void Process_Request_Timeouts() {
+      const uint32_t now = Helper::getMillis();
+      // Attempt to unsubscribe from the response topics, if we are not waiting for any further responses from the server.
+      // Will be resubscribed if another request is sent anyway
+      if (m_rpc_request_callbacks.erase_expired(now, Request_Timed_Out<RPC_Request_Callback>) != 0U && m_rpc_request_callbacks.empty()) {
+        RPC_Request_Unsubscribe();
+      }
+      if (m_attribute_request_callbacks.erase_expired(now, Request_Timed_Out<Attribute_Request_Callback>) != 0U && m_attribute_request_callbacks.empty()) {
+        Attributes_Request_Unsubscribe();
+      }
+    }
+
+    /// @brief Informs the user that the given request timed out and calls its timeout callback
+    /// @tparam Request Client-side RPC or attribute request callback
+    /// @param request Request whose response did not arrive in time
+    template<typename Request>
+    inline static void Request_Timed_Out(const Request& request) {
+      char message[Helper::detectSize(REQUEST_TIMED_OUT, request.Get_Request_ID())];
+      snprintf_P(message, sizeof(message), REQUEST_TIMED_OUT, request.Get_Request_ID());
+      Logger::log(message);
+      request.Call_Timeout_Callback();
+    }
+
     /// @brief Unsubscribes all client-side or shared attributes request callbacks
     /// @return Whether unsubcribing the previously subscribed callbacks
     /// and from the  attribute response topic, was successful or not
@@ -1546,31 +1716,12 @@ class ThingsBoardSized {
 
     /// @brief Process callback that will be called upon client-side RPC response arrival
     /// and is responsible for handling the payload and calling the appropriate previously subscribed callbacks
-    /// @param topic Previously subscribed topic, we got the response over
+    /// @param response_id Id at the end of the topic we got the response over, which is the id of the request it answers
     /// @param data Payload sent by the server over our given topic, that contains our key value pairs
-    inline void process_rpc_request_message(char *topic, const JsonObjectConst& data) {
-      // Remove the not needed part of the received topic string, which is everything before the response id,
-      // therefore we remove the section before that which is the topic + an additional "/" character, that seperates the topic from the response id.
-      // Meaning the index we want to get the substring from is the length of the topic + 1 for the additonal "/" character
-      const size_t index = strlen(RPC_RESPONSE_TOPIC) + 1U;
-#if THINGSBOARD_ENABLE_STL
-      std::string response = topic;
-      response = response.substr(index, response.length() - index);
-#else
-      String response = topic;
-      response = response.substring(index);
-#endif // THINGSBOARD_ENABLE_STL
-
-      // Convert the remaining text after the topic to an integer, because it should now contain only the response id
-      const size_t response_id = atoi(response.c_str());
-
-      for (size_t i = 0; i < m_rpc_request_callbacks.size(); i++) {
-        const RPC_Request_Callback& rpc_request = m_rpc_request_callbacks.at(i);
-
-        if (rpc_request.Get_Request_ID() != response_id) {
-          continue;
-        }
-
+    inline void process_rpc_request_message(const size_t& response_id, const JsonObjectConst& data) {
+      // Responses to requests that already timed out are ignored
+      const RPC_Request_Callback *rpc_request = m_rpc_request_callbacks.find(response_id);
+      if (rpc_request != nullptr) {
 #if THINGSBOARD_ENABLE_DEBUG
         char message[Helper::detectSize(CALLING_REQUEST_CB, response_id)];
         snprintf_P(message, sizeof(message), CALLING_REQUEST_CB, response_id);
@@ -1579,11 +1730,10 @@ class ThingsBoardSized {
 
         // Getting non-existing field from JSON should automatically
         // set JSONVariant to null
-        rpc_request.Call_Callback<Logger>(data);
+        rpc_request->Call_Callback<Logger>(data);
 
         // Delete callback because the changes have been requested and the callback is no longer needed
-        Helper::remove(m_rpc_request_callbacks, i);
-        break;
+        m_rpc_request_callbacks.erase(response_id);
       }
 
       // Attempt to unsubscribe from the shared attribute request topic,
@@ -1594,11 +1744,62 @@ class ThingsBoardSized {
       }
     }
 
+    /// @brief Inserts the given server-side RPC callback into our local vector, which is kept sorted by the hash of the method names.
+    /// Keeps the cost of finding the callback for a received request logarithmic, instead of comparing the name of every subscribed callback
+    /// @param callback Callback that should be inserted
+    /// @return Whether inserting the given callback was successful or not
+    inline bool RPC_Insert_Sorted(const RPC_Callback& callback) {
+      if (Is_Callbacks_Full(m_rpc_callbacks)) {
+        Logger::log(MAX_RPC_EXCEEDED);
+        return false;
+      }
+      m_rpc_callbacks.push_back(callback);
+      size_t index = m_rpc_callbacks.size() - 1U;
+      // Move all callbacks with a bigger hash one position to the right, to make space at the position the given callback belongs to
+      for (; index > 0U && callback.Get_Name_Hash() < m_rpc_callbacks[index - 1U].Get_Name_Hash(); index--) {
+        m_rpc_callbacks[index] = m_rpc_callbacks[index - 1U];
+      }
+      m_rpc_callbacks[index] = callback;
+      return true;
+    }
+
+    /// @brief Looks up the server-side RPC callback subscribed with exactly the given method name,
+    /// by binary searching the hash of the name and then comparing the names of the callbacks with the same hash
+    /// @param methodName Name of the method the server requested to call
+    /// @return Pointer to the callback subscribed with the given method name or nullptr if there is none
+    inline const RPC_Callback* Find_RPC_Callback(const char *methodName) const {
+      const uint32_t hash = Helper::hash(methodName);
+      size_t low = 0U;
+      size_t high = m_rpc_callbacks.size();
+      while (low < high) {
+        const size_t middle = low + (high - low) / 2U;
+        if (m_rpc_callbacks[middle].Get_Name_Hash() < hash) {
+          low = middle + 1U;
+        }
+        else {
+          high = middle;
+        }
+      }
+      // Different names might still result in the same hash, therefore the actual name has to be compared as well
+      for (; low < m_rpc_callbacks.size() && m_rpc_callbacks[low].Get_Name_Hash() == hash; low++) {
+        const RPC_Callback& rpc = m_rpc_callbacks[low];
+        const char *subscribedMethodName = rpc.Get_Name();
+        if (subscribedMethodName == nullptr) {
+          Logger::log(RPC_METHOD_NULL);
+          continue;
+        }
+        else if (strcmp(subscribedMethodName, methodName) == 0) {
+          return &rpc;
+        }
+      }
+      return nullptr;
+    }
+
     /// @brief Process callback that will be called upon server-side RPC request arrival
     /// and is responsible for handling the payload and calling the appropriate previously subscribed callbacks
-    /// @param topic Previously subscribed topic, we got the response over
+    /// @param request_id Id at the end of the topic we got the request over, which the response has to be sent back with
     /// @param data Payload sent by the server over our given topic, that contains our key value pairs
-    inline void process_rpc_message(char *topic, const JsonObjectConst& data) {
+    inline void process_rpc_message(const size_t& request_id, const JsonObjectConst& data) {
       const char *methodName = data[RPC_METHOD_KEY].as<const char *>();
 
       if (methodName == nullptr) {
@@ -1606,58 +1807,32 @@ class ThingsBoardSized {
         return;
       }
  
-      RPC_Response response;
-
-      for (const RPC_Callback& rpc : m_rpc_callbacks) {
-        const char *subscribedMethodName = rpc.Get_Name();
-        if (subscribedMethodName == nullptr) {
-          Logger::log(RPC_METHOD_NULL);
-          continue;
-        }
-        // Strncmp returns the ascii value difference of the ascii characters that are different,
-        // meaning 0 is the same string and less and more than 0 is the difference in ascci values between the 2 chararacters.
-        else if (strncmp(subscribedMethodName, methodName, strlen(subscribedMethodName)) != 0) {
-          continue;
-        }
+      const RPC_Callback *rpc = Find_RPC_Callback(methodName);
+      if (rpc == nullptr) {
+        return;
+      }
 
-        // Do not inform client, if parameter field is missing for some reason
-        if (!data.containsKey(RPC_PARAMS_KEY)) {
+      // Do not inform client, if parameter field is missing for some reason
+      if (!data.containsKey(RPC_PARAMS_KEY)) {
 #if THINGSBOARD_ENABLE_DEBUG
-          Logger::log(NO_RPC_PARAMS_PASSED);
+        Logger::log(NO_RPC_PARAMS_PASSED);
 #endif // THINGSBOARD_ENABLE_DEBUG
-        }
+      }
 
 #if THINGSBOARD_ENABLE_DEBUG
-        char message[JSON_STRING_SIZE(strlen(CALLING_RPC_CB)) + JSON_STRING_SIZE(strlen(methodName))];
-        snprintf_P(message, sizeof(message), CALLING_RPC_CB, methodName);
-        Logger::log(message);
+      char message[JSON_STRING_SIZE(strlen(CALLING_RPC_CB)) + JSON_STRING_SIZE(strlen(methodName))];
+      snprintf_P(message, sizeof(message), CALLING_RPC_CB, methodName);
+      Logger::log(message);
 #endif // THINGSBOARD_ENABLE_DEBUG
 
-        const JsonVariantConst param = data[RPC_PARAMS_KEY].as<JsonVariantConst>();
-        response = rpc.Call_Callback<Logger>(param);
-        break;
-      }
+      const JsonVariantConst param = data[RPC_PARAMS_KEY].as<JsonVariantConst>();
+      const RPC_Response response = rpc->Call_Callback<Logger>(param);
 
       if (response.isNull()) {
         // Message is ignored and not sent at all.
         return;
       }
 
-      // Remove the not needed part of the received topic string, which is everything before the request id,
-      // therefore we remove the section before that which is the topic + an additional "/" character, that seperates the topic from the request id.
-      // Meaning the index we want to get the substring from is the length of the topic + 1 for the additonal "/" character
-      const size_t index = strlen(RPC_REQUEST_TOPIC) + 1U;
-#if THINGSBOARD_ENABLE_STL
-      std::string request = topic;
-      request = request.substr(index, request.length() - index);
-#else
-      String request = topic;
-      request = request.substring(index);
-#endif // THINGSBOARD_ENABLE_STL
-
-      // Convert the remaining text after the topic to an integer, because it should now contain only the request id
-      const size_t request_id = atoi(request.c_str());
-
       char responseTopic[Helper::detectSize(RPC_SEND_RESPONSE_TOPIC, request_id)];
       snprintf_P(responseTopic, sizeof(responseTopic), RPC_SEND_RESPONSE_TOPIC, request_id);
 
@@ -1669,25 +1844,10 @@ class ThingsBoardSized {
 
     /// @brief Process callback that will be called upon firmware response arrival
     /// and is responsible for handling the payload and calling the appropriate previously subscribed callback
-    /// @param topic Previously subscribed topic, we got the response over
+    /// @param request_id Id at the end of the topic we got the response over, which is the index of the received firmware chunk
     /// @param payload Payload that was sent over the cloud and received over the given topic
     /// @param length Total length of the received payload
-    inline void process_firmware_response(char *topic, uint8_t *payload, const size_t& length) {
-      // Remove the not needed part of the received topic string, which is everything before the request id,
-      // therefore we remove the section before that which is the topic + an additional "/" character, that seperates the topic from the request id.
-      // Meaning the index we want to get the substring from is the length of the topic + 1 for the additonal "/" character
-      const size_t index = strlen(FIRMWARE_RESPONSE_TOPIC) + 1U;
-#if THINGSBOARD_ENABLE_STL
-      std::string request = topic;
-      request = request.substr(index, request.length() - index);
-#else
-      String request = topic;
-      request = request.substring(index);
-#endif // THINGSBOARD_ENABLE_STL
-
-      // Convert the remaining text after the topic to an integer, because it should now contain only the request id
-      const size_t request_id = atoi(request.c_str());
-
+    inline void process_firmware_response(const size_t& request_id, uint8_t *payload, const size_t& length) {
       // Check if the remaining stack size of the current task would overflow the stack,
       // if it would allocate the memory on the heap instead to ensure no stack overflow occurs.
       if (getMaximumStackSize() < length) {
@@ -1708,6 +1868,179 @@ class ThingsBoardSized {
 
 #endif // THINGSBOARD_ENABLE_OTA
 
+    /// @brief Inserts the given shared attribute update callback into our local vector and adds all of its subscribed keys to m_shared_attribute_keys,
+    /// so that received updates only have to look up their keys instead of comparing them with every subscribed key of every callback
+    /// @param callback Callback that should be inserted
+    /// @return Whether inserting the given callback and all of its keys was successful or not
+    inline bool Shared_Attributes_Insert(const Shared_Attribute_Callback& callback) {
+      // Either the callback is inserted with all of its keys or not at all
+      if (Is_Callbacks_Full(m_shared_attribute_update_callbacks) || Is_Full(m_shared_attribute_keys, Get_Key_Count(callback))) {
+        Logger::log(MAX_SHARED_ATT_UPDATE_EXCEEDED);
+        return false;
+      }
+      const size_t callback_index = m_shared_attribute_update_callbacks.size();
+      m_shared_attribute_update_callbacks.push_back(callback);
+      m_shared_attribute_matches.push_back(nullptr);
+
+#if THINGSBOARD_ENABLE_STL
+      for (const char *att : callback.Get_Attributes()) {
+        if (att == nullptr) {
+#if THINGSBOARD_ENABLE_DEBUG
+          Logger::log(ATT_IS_NULL);
+#endif // THINGSBOARD_ENABLE_DEBUG
+          continue;
+        }
+        Shared_Attributes_Insert_Key(att, strlen(att), callback_index);
+      }
+#else
+      const char *att = callback.Get_Attributes();
+      if (att == nullptr) {
+        Shared_Attributes_Update_Filter();
+        return true;
+      }
+      // Split the comma seperated string in place, the keys simply point into the original string
+      for (const char *current = att; ; current++) {
+        if (*current != COMMA && *current != '\0') {
+          continue;
+        }
+        Shared_Attributes_Insert_Key(att, current - att, callback_index);
+        if (*current == '\0') {
+          break;
+        }
+        att = current + 1;
+      }
+#endif // THINGSBOARD_ENABLE_STL
+      Shared_Attributes_Update_Filter();
+      return true;
+    }
+
+    /// @brief Rebuilds m_shared_attribute_filter from m_shared_attribute_keys, so that received shared attribute updates only keep the keys any callback subscribed to,
+    /// which decreases the memory needed to deserialize and the time spent parsing big updates that mostly contain keys nobody is interested in.
+    /// Stays null and therefore keeps every key, if any callback did not subscribe to specific keys or if the filter does not fit into its JsonDocument.
+    /// See https://arduinojson.org/v6/how-to/deserialize-a-very-large-document/ for more information on filtering while deserializing
+    inline void Shared_Attributes_Update_Filter() {
+      m_shared_attribute_filter.clear();
+      for (size_t i = 0U; i < m_shared_attribute_update_callbacks.size(); i++) {
+#if THINGSBOARD_ENABLE_STL
+        if (m_shared_attribute_update_callbacks[i].Get_Attributes().empty()) {
+#else
+        if (m_shared_attribute_update_callbacks[i].Get_Attributes() == nullptr) {
+#endif // THINGSBOARD_ENABLE_STL
+          return;
+        }
+      }
+
+#if THINGSBOARD_ENABLE_DYNAMIC
+      // Keys of a comma seperated string are not null terminated and therefore have to be copied into the filter,
+      // every other key is simply referenced and only needs the space of the key value pair.
+      // Copies are deduplicated, therefore each copied key is only counted once even though it is used in both objects
+      size_t dataStructureMemoryUsage = JSON_OBJECT_SIZE(m_shared_attribute_keys.size() + 1U) + JSON_OBJECT_SIZE(m_shared_attribute_keys.size());
+      for (size_t i = 0U; i < m_shared_attribute_keys.size(); i++) {
+        const Shared_Attribute_Key& subscribed = m_shared_attribute_keys[i];
+        if (subscribed.key[subscribed.length] != '\0') {
+          dataStructureMemoryUsage += JSON_STRING_SIZE(subscribed.length);
+        }
+      }
+      if (m_shared_attribute_filter.capacity() < dataStructureMemoryUsage) {
+        m_shared_attribute_filter = TBJsonDocument(dataStructureMemoryUsage);
+      }
+#endif // THINGSBOARD_ENABLE_DYNAMIC
+
+      // Updates either contain the keys directly or nested inside of the shared key, therefore both have to be allowed.
+      // The nested object is filled first, because a subscribed key with the same name as the shared key replaces it with true at the top level,
+      // which allows everything nested inside of it and must not be written to afterwards
+      const JsonObject shared = m_shared_attribute_filter.createNestedObject(SHARED_RESPONSE_KEY);
+      for (size_t i = 0U; i < m_shared_attribute_keys.size(); i++) {
+        shared[Get_Filter_Key(m_shared_attribute_keys[i].key, m_shared_attribute_keys[i].length)] = true;
+      }
+      for (size_t i = 0U; i < m_shared_attribute_keys.size(); i++) {
+        m_shared_attribute_filter[Get_Filter_Key(m_shared_attribute_keys[i].key, m_shared_attribute_keys[i].length)] = true;
+      }
+
+      // Filtering is only an optimization, if not all keys fit into the filter every key is kept instead of silently dropping subscribed keys
+      if (m_shared_attribute_filter.overflowed()) {
+        m_shared_attribute_filter.clear();
+      }
+    }
+
+    /// @brief Returns the given subscribed key as a string that can be inserted into the filter JsonDocument
+    /// @param key Start of the subscribed key
+    /// @param length Length of the subscribed key
+    /// @return Key that is referenced if it is null terminated or copied if it points into a comma seperated string
+    inline static JsonString Get_Filter_Key(const char *key, const size_t& length) {
+      return JsonString(key, length, (key[length] == '\0') ? JsonString::Linked : JsonString::Copied);
+    }
+
+    /// @brief Inserts the given subscribed key into m_shared_attribute_keys, which is kept sorted by the hash of the keys
+    /// @param key Start of the subscribed key
+    /// @param length Length of the subscribed key
+    /// @param callback_index Index of the callback that subscribed the key in m_shared_attribute_update_callbacks
+    inline void Shared_Attributes_Insert_Key(const char *key, const size_t& length, const size_t& callback_index) {
+      const Shared_Attribute_Key subscribed = { Helper::hash(key, length), key, length, callback_index };
+      m_shared_attribute_keys.push_back(subscribed);
+      size_t index = m_shared_attribute_keys.size() - 1U;
+      // Move all keys with a bigger hash one position to the right, to make space at the position the given key belongs to
+      for (; index > 0U && subscribed.hash < m_shared_attribute_keys[index - 1U].hash; index--) {
+        m_shared_attribute_keys[index] = m_shared_attribute_keys[index - 1U];
+      }
+      m_shared_attribute_keys[index] = subscribed;
+    }
+
+    /// @brief Returns whether the given container can not hold the given amount of additional elements, which is only ever the case for the fixed capacity containers of Static_Storage
+    /// @tparam DataContainer Class which allows to pass any arbitrary data container that contains the size() and max_size() method
+    /// @param container Data container that should be checked
+    /// @param amount Amount of elements that should be inserted, default = 1
+    /// @return Whether the given container is too full to insert the given amount of elements or not
+    template<class DataContainer>
+    inline static bool Is_Full(const DataContainer& container, const size_t& amount = 1U) {
+      return amount > container.max_size() - container.size();
+    }
+
+    /// @brief Returns whether the given callback container can not hold the given amount of additional callbacks.
+    /// With THINGSBOARD_ENABLE_DYNAMIC disabled the amount of subscribed callbacks is additionally limited to MaxFieldsAmt
+    /// @tparam DataContainer Class which allows to pass any arbitrary data container that contains the size() and max_size() method
+    /// @param container Data container holding either the server-side RPC or the shared attribute update callbacks
+    /// @param amount Amount of callbacks that should be inserted, default = 1
+    /// @return Whether the given container is too full to insert the given amount of callbacks or not
+    template<class DataContainer>
+    inline static bool Is_Callbacks_Full(const DataContainer& container, const size_t& amount = 1U) {
+#if !THINGSBOARD_ENABLE_DYNAMIC
+      if (container.size() + amount > MaxFieldsAmt) {
+        return true;
+      }
+#endif // !THINGSBOARD_ENABLE_DYNAMIC
+      return Is_Full(container, amount);
+    }
+
+    /// @brief Returns the amount of shared attribute keys the given callback subscribed
+    /// @param callback Callback whose keys should be counted
+    /// @return Amount of keys that are inserted into m_shared_attribute_keys together with the callback
+    inline static size_t Get_Key_Count(const Shared_Attribute_Callback& callback) {
+#if THINGSBOARD_ENABLE_STL
+      return callback.Get_Attributes().size();
+#else
+      return (callback.Get_Attributes() == nullptr) ? 0U : Helper::getOccurences(callback.Get_Attributes(), COMMA) + 1U;
+#endif // THINGSBOARD_ENABLE_STL
+    }
+
+    /// @brief Binary searches m_shared_attribute_keys for the first subscribed key with the given hash
+    /// @param hash Hash of the updated key
+    /// @return Index of the first subscribed key with the given hash or with the next bigger hash if there is none
+    inline size_t Find_Shared_Attribute_Key(const uint32_t& hash) const {
+      size_t low = 0U;
+      size_t high = m_shared_attribute_keys.size();
+      while (low < high) {
+        const size_t middle = low + (high - low) / 2U;
+        if (m_shared_attribute_keys[middle].hash < hash) {
+          low = middle + 1U;
+        }
+        else {
+          high = middle;
+        }
+      }
+      return low;
+    }
+
     /// @brief Process callback that will be called upon shared attribute update arrival
     /// and is responsible for handling the payload and calling the appropriate previously subscribed callbacks
     /// @param topic Previously subscribed topic, we got the response over
@@ -1724,7 +2057,25 @@ class ThingsBoardSized {
         data = data[SHARED_RESPONSE_KEY];
       }
 
-      for (const Shared_Attribute_Callback& shared_attribute : m_shared_attribute_update_callbacks) {
+      for (size_t i = 0U; i < m_shared_attribute_matches.size(); i++) {
+        m_shared_attribute_matches[i] = nullptr;
+      }
+
+      // Walk the updated keys once and mark every callback that subscribed to them,
+      // instead of checking every subscribed key of every callback against the update
+      for (const JsonPairConst kv : data) {
+        const char *updated_att = kv.key().c_str();
+        const uint32_t hash = Helper::hash(updated_att);
+        for (size_t i = Find_Shared_Attribute_Key(hash); i < m_shared_attribute_keys.size() && m_shared_attribute_keys[i].hash == hash; i++) {
+          const Shared_Attribute_Key& subscribed = m_shared_attribute_keys[i];
+          if (m_shared_attribute_matches[subscribed.callback] == nullptr && strncmp(subscribed.key, updated_att, subscribed.length) == 0 && updated_att[subscribed.length] == '\0') {
+            m_shared_attribute_matches[subscribed.callback] = updated_att;
+          }
+        }
+      }
+
+      for (size_t i = 0U; i < m_shared_attribute_update_callbacks.size(); i++) {
+        const Shared_Attribute_Callback& shared_attribute = m_shared_attribute_update_callbacks[i];
 #if THINGSBOARD_ENABLE_STL
         if (shared_attribute.Get_Attributes().empty()) {
 #else
@@ -1738,51 +2089,11 @@ class ThingsBoardSized {
           continue;
         }
 
-        bool containsKey = false;
-        const char *requested_att = nullptr;
-
-#if THINGSBOARD_ENABLE_STL
-        for (const char *att : shared_attribute.Get_Attributes()) {
-#else
-        String stringToSplit = shared_attribute.Get_Attributes();
-        int32_t previousIndex = 0;
-        int32_t currentIndex = 0;
-
-        do {
-          // Find the index of the next comma in the string
-          currentIndex = stringToSplit.indexOf(COMMA, previousIndex);
-        
-          // If no more commas are found, set the currentIndex to the end of the string
-          if (currentIndex == -1) {
-            currentIndex = stringToSplit.length();
-          }
-
-          // Extract the attribute from the original string
-          const char *att = stringToSplit.substring(previousIndex, currentIndex).c_str();
-#endif // THINGSBOARD_ENABLE_STL
-          if (att == nullptr) {
-#if THINGSBOARD_ENABLE_DEBUG
-            Logger::log(ATT_IS_NULL);
-#endif // THINGSBOARD_ENABLE_DEBUG
-            continue;
-          }
-          // Check if the request contained any of our requested keys.
-          containsKey = containsKey || data.containsKey(att);
-          // Break early if the key was requested from this callback.
-          if (containsKey) {
-            requested_att = att;
-            break;
-          }
-#if THINGSBOARD_ENABLE_STL
-        }
-#else
-          previousIndex = currentIndex + 1;
-        } while (currentIndex != stringToSplit.length());
-#endif // THINGSBOARD_ENABLE_STL
+        const char *requested_att = m_shared_attribute_matches[i];
 
         // This callback did not request any keys that were in this response,
         // therefore we continue with the next element in the loop.
-        if (!containsKey || requested_att == nullptr) {
+        if (requested_att == nullptr) {
 #if THINGSBOARD_ENABLE_DEBUG
           Logger::log(ATT_NO_CHANGE);
 #endif // THINGSBOARD_ENABLE_DEBUG
@@ -1803,34 +2114,16 @@ class ThingsBoardSized {
 
     /// @brief Process callback that will be called upon client-side or shared attribute request arrival
     /// and is responsible for handling the payload and calling the appropriate previously subscribed callbacks
-    /// @param topic Previously subscribed topic, we got the response over
+    /// @param response_id Id at the end of the topic we got the response over, which is the id of the request it answers
     /// @param data Payload sent by the server over our given topic, that contains our key value pairs
-    inline void process_attribute_request_message(char *topic, JsonObjectConst& data) {
-      // Remove the not needed part of the received topic string, which is everything before the response id,
-      // therefore we remove the section before that which is the topic + an additional "/" character, that seperates the topic from the response id.
-      // Meaning the index we want to get the substring from is the length of the topic + 1 for the additonal "/" character
-      const size_t index = strlen(ATTRIBUTE_RESPONSE_TOPIC) + 1U;
-#if THINGSBOARD_ENABLE_STL
-      std::string response = topic;
-      response = response.substr(index, response.length() - index);
-#else
-      String response = topic;
-      response = response.substring(index);
-#endif // THINGSBOARD_ENABLE_STL
-
-      // Convert the remaining text after the topic to an integer, because it should now contain only the response id
-      const size_t response_id = atoi(response.c_str());
-
+    inline void process_attribute_request_message(const size_t& response_id, JsonObjectConst& data) {
 #if THINGSBOARD_ENABLE_DEBUG
       char message[Helper::detectSize(CALLING_REQUEST_CB, response_id)];
 #endif // THINGSBOARD_ENABLE_DEBUG
-      for (size_t i = 0; i < m_attribute_request_callbacks.size(); i++) {
-        const Attribute_Request_Callback& attribute_request = m_attribute_request_callbacks.at(i);
-
-        if (attribute_request.Get_Request_ID() != response_id) {
-          continue;
-        }
-        const char *attributeResponseKey = attribute_request.Get_Attribute_Key();
+      // Responses to requests that already timed out are ignored
+      const Attribute_Request_Callback *attribute_request = m_attribute_request_callbacks.find(response_id);
+      if (attribute_request != nullptr) {
+        const char *attributeResponseKey = attribute_request->Get_Attribute_Key();
         if (attributeResponseKey == nullptr) {
 #if THINGSBOARD_ENABLE_DEBUG
           Logger::log(ATT_KEY_NOT_FOUND);
@@ -1855,12 +2148,11 @@ class ThingsBoardSized {
 
         // Getting non-existing field from JSON should automatically
         // set JSONVariant to null
-        attribute_request.Call_Callback<Logger>(data);
+        attribute_request->Call_Callback<Logger>(data);
 
         delete_callback:
         // Delete callback because the changes have been requested and the callback is no longer needed
-        Helper::remove(m_attribute_request_callbacks, i);
-        break;
+        m_attribute_request_callbacks.erase(response_id);
       }
 
       // Unsubscribe from the shared attribute request topic,
@@ -1910,11 +2202,21 @@ class ThingsBoardSized {
       return telemetry ? sendTelemetryJson(object, Helper::Measure_Json(object)) : sendAttributeJSON(object, Helper::Measure_Json(object));
     }
 
-    /// @brief Vector signature
-#if THINGSBOARD_ENABLE_STL
+    /// @brief Subscribed shared attribute key, references the callback it was subscribed with
+    struct Shared_Attribute_Key {
+      uint32_t hash;   // Hash of the key, see Helper::hash() for more information
+      const char *key; // Start of the key, is not null terminated if the keys were passed as a comma seperated string
+      size_t length;   // Length of the key
+      size_t callback; // Index of the callback in m_shared_attribute_update_callbacks
+    };
+
+    /// @brief Container signatures, decided by the Storage policy
     template<typename T>
-    using Vector = std::vector<T>;
-#endif // THINGSBOARD_ENABLE_STL
+    using Container = typename Storage::template Container<T>;
+    template<typename T>
+    using Key_Container = typename Storage::template Key_Container<T>;
+    template<typename T>
+    using Request_Container = typename Storage::template Request_Container<T>;
 
     IMQTT_Client& m_client; // MQTT client instance.
     size_t m_max_stack; // Maximum stack size we allocate at once.
@@ -1928,13 +2230,22 @@ class ThingsBoardSized {
     // of its usage, which will lead to dangling references and undefined behaviour.
     // Therefore copy-by-value has been choosen as for this specific use case it is more advantageous,
     // especially because at most we copy a vector, that will only ever contain a few pointers
-    Vector<RPC_Callback> m_rpc_callbacks; // Server side RPC callbacks vector, replacement for non C++ STL boards
-    Vector<RPC_Request_Callback> m_rpc_request_callbacks; // Client side RPC callbacks vector, replacement for non C++ STL boards
-    Vector<Shared_Attribute_Callback> m_shared_attribute_update_callbacks; // Shared attribute update callbacks vector, replacement for non C++ STL boards
-    Vector<Attribute_Request_Callback> m_attribute_request_callbacks; // Client-side or shared attribute request callback vector, replacement for non C++ STL boards
+    Container<RPC_Callback> m_rpc_callbacks; // Server side RPC callbacks vector, replacement for non C++ STL boards
+    Request_Container<RPC_Request_Callback> m_rpc_request_callbacks; // Client side RPC requests waiting for their response, stored in the slot of their request id
+    Container<Shared_Attribute_Callback> m_shared_attribute_update_callbacks; // Shared attribute update callbacks vector, replacement for non C++ STL boards
+    Key_Container<Shared_Attribute_Key> m_shared_attribute_keys; // Keys of all shared attribute update callbacks sorted by their hash, allows finding the interested callbacks of an updated key directly
+    Container<const char *> m_shared_attribute_matches; // First updated key each shared attribute update callback was interested in while processing an update, nullptr if there was none
+    Request_Container<Attribute_Request_Callback> m_attribute_request_callbacks; // Client-side or shared attribute requests waiting for their response, stored in the slot of their request id
 
     Provision_Callback m_provision_callback; // Provision response callback
     size_t m_request_id; // Allows nearly 4.3 million requests before wrapping back to 0
+#if THINGSBOARD_ENABLE_DYNAMIC
+    TBJsonDocument m_receive_buffer; // Document received messages are deserialized into, allocated once with the size for maxReceiveFieldsAmt fields
+    TBJsonDocument m_shared_attribute_filter; // Keys received shared attribute updates are filtered with, null if every key is kept
+#else
+    StaticJsonDocument<JSON_OBJECT_SIZE(MaxFieldsAmt + 1U) + JSON_OBJECT_SIZE(MaxFieldsAmt)> m_shared_attribute_filter; // Keys received shared attribute updates are filtered with, null if every key is kept
+#endif // THINGSBOARD_ENABLE_DYNAMIC
+    StaticJsonDocument<JSON_OBJECT_SIZE(2U)> m_rpc_filter; // Keys received server-side RPC requests are filtered with
 
 #if THINGSBOARD_ENABLE_OTA
     const OTA_Update_Callback *m_fw_callback; // Ota update response callback
@@ -1954,29 +2265,44 @@ class ThingsBoardSized {
       Logger::log(message);
 #endif // THINGSBOARD_ENABLE_DEBUG
 
+      // Decides which process method the message is forwarded to and reads the request or response id at the end of the topic in the same pass,
+      // messages over topics we do not process are skipped before they are deserialized
+      size_t id = 0U;
+      const Topic_Route<ThingsBoard_Route> *route = Topic_Router::Route_Topic(RECEIVE_ROUTES, topic, id);
+      if (route == nullptr) {
+        return;
+      }
+
 #if THINGSBOARD_ENABLE_OTA
       // When receiving the ota binary payload we do not want to deserialize it into json, because it only contains
       // firmware bytes that should be directly writtin into flash, therefore we can skip that step and directly process those bytes
-      if (strncmp_P(FIRMWARE_RESPONSE_TOPIC, topic, strlen(FIRMWARE_RESPONSE_TOPIC)) == 0) {
-        process_firmware_response(topic, payload, length);
+      if (route->route == ThingsBoard_Route::FIRMWARE_RESPONSE) {
+        process_firmware_response(id, payload, length);
         return;
       }
 #endif // THINGSBOARD_ENABLE_OTA
 
 #if THINGSBOARD_ENABLE_DYNAMIC
-      // Buffer that we deserialize is writeable and not read only --> zero copy, meaning the size for the data is 0 bytes,
-      // Data structure size depends on the amount of key value pairs received.
-      // See https://arduinojson.org/v6/assistant/ for more information on the needed size for the JsonDocument
-      const size_t dataStructureMemoryUsage = JSON_OBJECT_SIZE(Helper::getOccurences(reinterpret_cast<char*>(payload), COLON));
-      TBJsonDocument jsonBuffer(dataStructureMemoryUsage);
+      // Every message is deserialized into the same document, which was allocated with the configured maximum size in the constructor.
+      // Growing it to fit bigger messages would keep the biggest message ever received allocated and fragment the heap on every growth,
+      // therefore messages that do not fit are discarded instead, deserializeJson() clears the document anyway
+      TBJsonDocument& jsonBuffer = m_receive_buffer;
 #else
       StaticJsonDocument<JSON_OBJECT_SIZE(MaxFieldsAmt)> jsonBuffer;
 #endif // !THINGSBOARD_ENABLE_DYNAMIC
 
       // The deserializeJson method we use, can use the zero copy mode because a writeable input was passed,
       // if that were not the case the needed allocated memory would drastically increase, because the keys would need to be copied as well.
+      // Messages we have a filter for, skip every key no callback is interested in while parsing, instead of storing them in the JsonDocument first.
       // See https://arduinojson.org/v6/doc/deserialization/ for more info on ArduinoJson deserialization
-      const DeserializationError error = deserializeJson(jsonBuffer, payload, length);
+      const JsonVariantConst filter = Get_Receive_Filter(route->route);
+      const DeserializationError error = filter.isNull() ? deserializeJson(jsonBuffer, payload, length) : deserializeJson(jsonBuffer, payload, length, DeserializationOption::Filter(filter));
+#if THINGSBOARD_ENABLE_DYNAMIC
+      if (error == DeserializationError::NoMemory) {
+        Logger::log(RECEIVE_FIELDS_EXCEEDED);
+        return;
+      }
+#endif // THINGSBOARD_ENABLE_DYNAMIC
       if (error) {
         char message[Helper::detectSize(UNABLE_TO_DE_SERIALIZE_JSON, error.c_str())];
         snprintf_P(message, sizeof(message), UNABLE_TO_DE_SERIALIZE_JSON, error.c_str());
@@ -1988,26 +2314,40 @@ class ThingsBoardSized {
       // and would result in the data simply being "null", instead .as() allows accessing the data over a JsonObjectConst instead.
       JsonObjectConst data = jsonBuffer.template as<JsonObjectConst>();
 
-      // Checks to ensure we forward the already json serialized data to the correct process function,
-      // especially important is the order of ATTRIBUTE_RESPONSE_TOPIC and ATTRIBUTE_TOPIC,
-      // that is the case because the more specific one that is longer but contains the same text has to be checked first,
-      // because if we do not do that then even if we receive a message from the ATTRIBUTE_RESPONSE_TOPIC
-      // we would call the process method for the ATTRIBUTE_TOPIC because we only compare until the end of the ATTRIBUTE_TOPIC string,
-      // therefore the received topic is exactly the same. Therefore the ordering needs to stay the same for thoose two specific checks
-      if (strncmp_P(RPC_RESPONSE_TOPIC, topic, strlen(RPC_RESPONSE_TOPIC)) == 0) {
-        process_rpc_request_message(topic, data);
-      }
-      else if (strncmp_P(RPC_REQUEST_TOPIC, topic, strlen(RPC_REQUEST_TOPIC)) == 0) {
-        process_rpc_message(topic, data);
-      }
-      else if (strncmp_P(ATTRIBUTE_RESPONSE_TOPIC, topic, strlen(ATTRIBUTE_RESPONSE_TOPIC)) == 0) {
-        process_attribute_request_message(topic, data);
-      }
-      else if (strncmp_P(ATTRIBUTE_TOPIC, topic, strlen(ATTRIBUTE_TOPIC)) == 0) {
-        process_shared_attribute_update_message(topic, data);
-      }
-      else if (strncmp_P(PROV_RESPONSE_TOPIC, topic, strlen(PROV_RESPONSE_TOPIC)) == 0) {
-        process_provisioning_response(topic, data);
+      // Forward the already json serialized data to the process method the topic was routed to
+      switch (route->route) {
+        case ThingsBoard_Route::RPC_RESPONSE:
+          process_rpc_request_message(id, data);
+          break;
+        case ThingsBoard_Route::RPC_REQUEST:
+          process_rpc_message(id, data);
+          break;
+        case ThingsBoard_Route::ATTRIBUTE_RESPONSE:
+          process_attribute_request_message(id, data);
+          break;
+        case ThingsBoard_Route::ATTRIBUTE_UPDATE:
+          process_shared_attribute_update_message(topic, data);
+          break;
+        case ThingsBoard_Route::PROVISION_RESPONSE:
+          process_provisioning_response(topic, data);
+          break;
+        default:
+          // Nothing to do
+          break;
+      }
+    }
+
+    /// @brief Returns the filter that should be used to deserialize the message received over the given route
+    /// @param route Process method the topic of the received message was routed to
+    /// @return Filter for shared attribute updates and server-side RPC requests, null if every key of the message should be kept
+    inline JsonVariantConst Get_Receive_Filter(const ThingsBoard_Route& route) const {
+      switch (route) {
+        case ThingsBoard_Route::ATTRIBUTE_UPDATE:
+          return m_shared_attribute_filter.template as<JsonVariantConst>();
+        case ThingsBoard_Route::RPC_REQUEST:
+          return m_rpc_filter.template as<JsonVariantConst>();
+        default:
+          return JsonVariantConst();
       }
     }
 
@@ -2031,13 +2371,13 @@ class ThingsBoardSized {
 
 #if !THINGSBOARD_ENABLE_STL && !THINGSBOARD_ENABLE_DYNAMIC
 
-template<size_t MaxFieldsAmt, typename Logger>
-ThingsBoardSized<MaxFieldsAmt, Logger> *ThingsBoardSized<MaxFieldsAmt, Logger>::m_subscribedInstance = nullptr;
+template<size_t MaxFieldsAmt, typename Logger, typename Storage>
+ThingsBoardSized<MaxFieldsAmt, Logger, Storage> *ThingsBoardSized<MaxFieldsAmt, Logger, Storage>::m_subscribedInstance = nullptr;
 
 #elif !THINGSBOARD_ENABLE_STL && THINGSBOARD_ENABLE_DYNAMIC
 
-template<typename Logger>
-ThingsBoardSized<Logger> *ThingsBoardSized<Logger>::m_subscribedInstance = nullptr;
+template<typename Logger, typename Storage>
+ThingsBoardSized<Logger, Storage> *ThingsBoardSized<Logger, Storage>::m_subscribedInstance = nullptr;
 
 #endif
 
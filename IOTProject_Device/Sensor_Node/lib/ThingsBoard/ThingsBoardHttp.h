@@ -72,15 +72,20 @@ class ThingsBoardHttpSized {
     /// @param access_token Token used to verify the devices identity with the ThingsBoard server
     /// @param host Host server we want to establish a connection to (example: "demo.thingsboard.io")
     /// @param port Port we want to establish a connection over (80 for HTTP, 443 for HTTPS)
-    /// @param keepAlive Attempts to keep the establishes TCP connection alive to make sending data faster
+    /// @param keepAlive Attempts to keep the establishes TCP connection alive to make sending data faster, because following requests are sent over the same connection
+    /// without having to establish a new TCP (and TLS) connection for every request. If the server closed the connection in the meantime, the request is sent over a new connection instead.
+    /// A GET request that failed over the kept alive connection is sent once more, a POST request never is, because the server might have already processed it
     /// @param maxStackSize Maximum amount of bytes we want to allocate on the stack, default = Default_Max_Stack_Size
     inline ThingsBoardHttpSized(IHTTP_Client& client, const char *access_token,
                                 const char *host, const uint16_t& port = 80U, const bool& keepAlive = true, const size_t& maxStackSize = Default_Max_Stack_Size)
       : m_client(client)
       , m_max_stack(maxStackSize)
       , m_token(access_token)
+      , m_keep_alive(keepAlive)
+      , m_connected(false)
     {
       m_client.set_keep_alive(keepAlive);
+      // Only a connection that already completed a request is known to be accepted by the server, therefore the first request is never sent twice
       m_client.connect(host, port);
     }
 
@@ -271,6 +276,45 @@ class ThingsBoardHttpSized {
     /// and resets the TCP as well, if data is resend the TCP connection has to be re-established
     inline void clearConnection() {
       m_client.stop();
+      m_connected = false;
+    }
+
+    /// @brief Keeps the connection open for the following request if keep alive is enabled and clears it otherwise,
+    /// should only be called once the response of the previous request has been read completely
+    inline void finishConnection() {
+      if (!m_keep_alive) {
+        clearConnection();
+        return;
+      }
+      m_connected = true;
+    }
+
+    /// @brief Returns the HTTP status code of the response to the request that was just sent
+    /// @param error Result of sending the request, 0 if successful or if not the internal error code
+    /// @return HTTP status code of the response or the negative internal error code, if sending the request or receiving the response failed
+    inline int getStatusCode(const int& error) {
+      return error != 0 ? error : m_client.get_response_status_code();
+    }
+
+    /// @brief Clears the connection kept alive from a previous request, if the server closed it in the meantime.
+    /// Servers close idle connections after a while, checking before the request is sent means it is sent over a new connection instead of the closed one
+    inline void prepareConnection() {
+      if (m_connected && !m_client.connected()) {
+        clearConnection();
+      }
+    }
+
+    /// @brief Clears the connection if the request failed before any response was received over a connection that was kept alive from a previous request.
+    /// The server might have closed the connection without the client noticing it before the request was sent, therefore that request should be sent once more over a new connection.
+    /// Should only be used for requests that can safely be processed twice by the server, because the request might have arrived before the connection was closed
+    /// @param status HTTP status code of the response or the negative internal error code
+    /// @return Whether the request should be sent once more over a new connection
+    inline bool reconnectAfterError(const int& status) {
+      if (status >= 0 || !m_connected) {
+        return false;
+      }
+      clearConnection();
+      return true;
     }
 
     /// @brief Attempts to send a POST request over HTTP or HTTPS
@@ -278,20 +322,25 @@ class ThingsBoardHttpSized {
     /// @param json String containing our json key value pairs we want to attempt to send
     /// @return Whetherr sending the POST request was successful or not
     inline bool postMessage(const char* path, const char* json) {
-      bool result = true;
-
-      const int success = m_client.post(path, HTTP_POST_PATH, json);
-      const int status = m_client.get_response_status_code();
+      prepareConnection();
+      // Never sent once more, because data that arrived before the connection failed would be processed twice
+      const int status = getStatusCode(m_client.post(path, HTTP_POST_PATH, json));
 
-      if (!success || status < HTTP_RESPONSE_SUCCESS_RANGE_START || status > HTTP_RESPONSE_SUCCESS_RANGE_END) {
+      if (status < HTTP_RESPONSE_SUCCESS_RANGE_START || status > HTTP_RESPONSE_SUCCESS_RANGE_END) {
         char message[Helper::detectSize(HTTP_FAILED, POST, status)];
         snprintf_P(message, sizeof(message), HTTP_FAILED, POST, status);
         Logger::log(message);
-        result = false;
+        clearConnection();
+        return false;
       }
 
-      clearConnection();
-      return result;
+      // The response has to be read completely before the connection can be reused,
+      // otherwise the remaining bytes would be mistaken as the response to the following request
+      if (m_keep_alive) {
+        m_client.get_response_body();
+      }
+      finishConnection();
+      return true;
     }
 
     /// @brief Attempts to send a GET request over HTTP or HTTPS
@@ -304,24 +353,23 @@ class ThingsBoardHttpSized {
 #else
     inline bool getMessage(const char* path, String& response) {
 #endif // THINGSBOARD_ENABLE_STL
-      bool result = true;
-
-      const bool success = m_client.get(path);
-      const int status = m_client.get_response_status_code();
+      prepareConnection();
+      int status = getStatusCode(m_client.get(path));
+      if (reconnectAfterError(status)) {
+        status = getStatusCode(m_client.get(path));
+      }
 
-      if (!success || status < HTTP_RESPONSE_SUCCESS_RANGE_START || status > HTTP_RESPONSE_SUCCESS_RANGE_END) {
+      if (status < HTTP_RESPONSE_SUCCESS_RANGE_START || status > HTTP_RESPONSE_SUCCESS_RANGE_END) {
         char message[Helper::detectSize(HTTP_FAILED, GET, status)];
         snprintf_P(message, sizeof(message), HTTP_FAILED, GET, status);
         Logger::log(message);
-        result = false;
-        goto cleanup;
+        clearConnection();
+        return false;
       }
 
       response = m_client.get_response_body();
-
-      cleanup:
-      clearConnection();
-      return result;
+      finishConnection();
+      return true;
     }
 
     /// @brief Attempts to send aggregated attribute or telemetry data
@@ -383,6 +431,8 @@ class ThingsBoardHttpSized {
     IHTTP_Client& m_client; // HttpClient instance
     size_t m_max_stack;     // Maximum stack size we allocate at once on the stack.
     const char *m_token;    // Access token used to connect with
+    bool m_keep_alive;      // Whether the connection is kept open for the following requests
+    bool m_connected;       // Whether the connection opened by a previous request is still open and will be reused by the next request
 };
 
 using ThingsBoardHttp = ThingsBoardHttpSized<>;
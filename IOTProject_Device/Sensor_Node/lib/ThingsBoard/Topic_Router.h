@@ -0,0 +1,144 @@
+#ifndef Topic_Router_h
+#define Topic_Router_h
+
+// Local includes.
+#include "Configuration.h"
+
+// Library includes.
+#include <stddef.h>
+#include <stdint.h>
+#if THINGSBOARD_ENABLE_PROGMEM
+#include <pgmspace.h>
+#endif // THINGSBOARD_ENABLE_PROGMEM
+
+
+/// @brief What has to follow the prefix of a route, for a received topic to match that route
+enum class Topic_Suffix : uint8_t {
+  NONE,  // Topic has to be exactly the prefix
+  NUMBER // Prefix followed by a "/" and the decimal request or response id, for example "v1/devices/me/rpc/request/42"
+};
+
+/// @brief Route of a received topic to the method that should process it
+/// @tparam Route Enum or integral type identifying the process method
+template <typename Route>
+struct Topic_Route {
+  const char *prefix;  // Topic or start of the topic, can be a string in flash memory
+  Topic_Suffix suffix; // What has to follow the prefix
+  Route route;         // Process method the topic is forwarded to
+};
+
+/// @brief Static helper class that decides which route a received topic matches and extracts its numeric suffix in a single pass over the topic, without allocating any memory.
+/// The routes are a table sorted by their prefix, which is walked like a trie. Each character of the topic narrows the range of routes sharing the already read prefix,
+/// which makes the result independent of the order specific and longer topics are checked in, because the longest matching prefix wins.
+/// Further topics, like the ones of the gateway API, are routed by simply passing another table with their own Route type
+class Topic_Router {
+  public:
+    /// @brief Returns whether the given routes are strictly sorted by their prefix, which is required by Route_Topic().
+    /// Is constexpr, meaning it is meant to be checked with a static_assert once the table of routes is defined
+    /// @tparam Route Enum or integral type identifying the process method
+    /// @param routes Pointer to the first route of the table
+    /// @param amount Amount of routes in the table
+    /// @return Whether every prefix is smaller than the prefix of the following route
+    template <typename Route>
+    static constexpr bool Is_Sorted(const Topic_Route<Route> *routes, const size_t amount) {
+      return amount < 2U || (Is_Less(routes[0U].prefix, routes[1U].prefix) && Is_Sorted(routes + 1U, amount - 1U));
+    }
+
+    /// @brief Returns the route the given topic matches and the numeric suffix of the topic, if the route expects one
+    /// @tparam Route Enum or integral type identifying the process method
+    /// @tparam RouteAmt Amount of routes in the table
+    /// @param routes Table of routes strictly sorted by their prefix, see Is_Sorted()
+    /// @param topic Topic the message was received over
+    /// @param id Numeric suffix of the topic, is only written if the matched route expects a numeric suffix
+    /// @return Matching route or nullptr if the topic does not match any route
+    template <typename Route, size_t RouteAmt>
+    inline static const Topic_Route<Route>* Route_Topic(const Topic_Route<Route> (&routes)[RouteAmt], const char *topic, size_t& id) {
+      // Range of routes whose prefix starts with the already read characters of the topic
+      size_t low = 0U;
+      size_t high = RouteAmt;
+      size_t depth = 0U;
+      while (low < high) {
+        // Because the routes are sorted, the characters the first and the last route of the range have in common are shared by every route in between,
+        // therefore they can be compared with the topic directly. Once a single route is left this compares the rest of its prefix
+        const char *first = routes[low].prefix;
+        const char *last = routes[high - 1U].prefix;
+        for (char expected = Read_Char(first + depth); expected != '\0' && expected == Read_Char(last + depth); expected = Read_Char(first + depth)) {
+          if (topic[depth] != expected) {
+            return nullptr;
+          }
+          depth++;
+        }
+        // A prefix that ends here is sorted before every other prefix starting with the same characters,
+        // it can only match now, because the following characters are not part of it anymore
+        if (Read_Char(first + depth) == '\0') {
+          if (Matches_Suffix(routes[low].suffix, topic + depth, id)) {
+            return &routes[low];
+          }
+          low++;
+          continue;
+        }
+        const char current = topic[depth];
+        if (current == '\0') {
+          break;
+        }
+        while (low < high && Read_Char(routes[low].prefix + depth) < current) {
+          low++;
+        }
+        while (low < high && Read_Char(routes[high - 1U].prefix + depth) > current) {
+          high--;
+        }
+        depth++;
+      }
+      return nullptr;
+    }
+
+  private:
+    /// @brief Returns whether the first string is smaller than the second one, with the same ordering Route_Topic() narrows the routes with
+    /// @param lhs First string
+    /// @param rhs Second string
+    /// @return Whether the first string is sorted before the second string
+    static constexpr bool Is_Less(const char *lhs, const char *rhs) {
+      return (*lhs != *rhs) ? (*lhs < *rhs) : (*lhs != '\0' && Is_Less(lhs + 1U, rhs + 1U));
+    }
+
+    /// @brief Reads a single character of a prefix, which might be stored in flash memory
+    /// @param str Pointer to the character
+    /// @return Character at the given position
+    inline static char Read_Char(const char *str) {
+#if THINGSBOARD_ENABLE_PROGMEM
+      return static_cast<char>(pgm_read_byte(str));
+#else
+      return *str;
+#endif // THINGSBOARD_ENABLE_PROGMEM
+    }
+
+    /// @brief Returns whether the remaining part of the topic after the prefix is what the route expects
+    /// @param suffix What has to follow the prefix
+    /// @param remaining Remaining part of the topic after the prefix
+    /// @param id Numeric suffix of the topic, is only written if the given suffix is a number and matches
+    /// @return Whether the remaining part of the topic matches, a number that does not fit into size_t never matches
+    inline static bool Matches_Suffix(const Topic_Suffix& suffix, const char *remaining, size_t& id) {
+      if (suffix == Topic_Suffix::NONE) {
+        return *remaining == '\0';
+      }
+      else if (*remaining != '/' || *(++remaining) == '\0') {
+        return false;
+      }
+      size_t number = 0U;
+      for (; *remaining != '\0'; remaining++) {
+        if (*remaining < '0' || *remaining > '9') {
+          return false;
+        }
+        // An id that does not fit would silently wrap around and could match an unrelated request
+        const size_t digit = static_cast<size_t>(*remaining - '0');
+        if (number > (SIZE_MAX - digit) / 10U) {
+          return false;
+        }
+        number = number * 10U + digit;
+      }
+      id = number;
+      return true;
+    }
+};
+
+#endif // Topic_Router_h
@@ -8,6 +8,7 @@
 
 // Library includes.
 #include <assert.h>
+#include <stdint.h>
 
 
 /// @brief Replacement data container for boards that do not support the C++ STL.
@@ -79,16 +80,17 @@ class Vector {
         return m_elements + m_size;
     }
 
+    /// @brief Gets the maximum amount of elements that could ever be stored in the underlying data container
+    /// @return The maximum amount of items that could ever be stored in the underlying data container
+    inline size_t max_size() const {
+        return SIZE_MAX / sizeof(T);
+    }
+
     /// @brief Reserves the given capacity for the underlying data container
     /// @param capacity Capacity that should be reserved in the underlying data container
     inline void reserve(const size_t& capacity) {
         if (capacity > m_capacity) {
-            T* newElements = new T[m_capacity];
-            if (m_elements != nullptr) {
-                memcpy(newElements, m_elements, m_size * sizeof(T));
-                delete[] m_elements;
-            }
-            m_elements = newElements;
+            reallocate(capacity);
         }
     }
 
@@ -96,13 +98,7 @@ class Vector {
     /// @param element Element that should be inserted at the end
     inline void push_back(const T& element) {
         if (m_size == m_capacity) {
-            m_capacity = (m_capacity == 0) ? 1 : 2 * m_capacity;
-            T* newElements = new T[m_capacity];
-            if (m_elements != nullptr) {
-                memcpy(newElements, m_elements, m_size * sizeof(T));
-                delete[] m_elements;
-            }
-            m_elements = newElements;
+            reallocate((m_capacity == 0) ? 1 : 2 * m_capacity);
         }
         m_elements[m_size] = element;
         m_size++;
@@ -149,6 +145,19 @@ class Vector {
     }
 
   private:
+    /// @brief Moves the elements into a newly allocated memory block with the given capacity.
+    /// Elements are copied with their assignment operator, because copying the raw bytes is only valid for trivially copyable types
+    /// @param capacity Capacity the new memory block should have, has to be atleast the current size
+    inline void reallocate(const size_t& capacity) {
+        T* newElements = new T[capacity];
+        for (size_t i = 0; i < m_size; i++) {
+            newElements[i] = m_elements[i];
+        }
+        delete[] m_elements;
+        m_elements = newElements;
+        m_capacity = capacity;
+    }
+
     T* m_elements;      // Pointer to the start of our elements
     size_t m_capacity;  // Allocated capacity that shows how many elements we could hold
     size_t m_size;      // Used size that shows how many elements we entered
@@ -0,0 +1,193 @@
+/*
+ MQTTTimerWheel.h - Hashed timing wheel for MQTT keepalive and timeout scheduling.
+*/
+
+#ifndef MQTTTimerWheel_h
+#define MQTTTimerWheel_h
+
+#include <Arduino.h>
+
+// MQTT_TIMER_WHEEL_SLOTS : number of wheel slots, must be a power of two
+#ifndef MQTT_TIMER_WHEEL_SLOTS
+#define MQTT_TIMER_WHEEL_SLOTS 64
+#endif
+
+// MQTT_TIMER_WHEEL_TICK : milliseconds covered by one slot
+#ifndef MQTT_TIMER_WHEEL_TICK
+#define MQTT_TIMER_WHEEL_TICK 100
+#endif
+
+struct MQTTTimer;
+
+// Called by MQTTTimerWheel::run() with a timer that is due, already disarmed
+typedef void (*MQTTTimerCallback)(MQTTTimer* timer);
+
+// Called with the earliest expiry of the wheel whenever it moves earlier, and after run()
+// reached it. Lets one hardware timer replace polling, see setWakeCallback()
+typedef void (*MQTTWakeCallback)(void* arg, unsigned long expires);
+
+// A timer is embedded in its owner and linked into the wheel while armed.
+// Timers further away than one revolution simply stay in their slot until due.
+struct MQTTTimer {
+   MQTTTimer* next;
+   MQTTTimer* prev;
+   unsigned long expires;
+   void* owner;
+   MQTTTimerCallback fire;
+   uint16_t slot;
+   boolean armed;
+};
+
+class MQTTTimerWheel {
+private:
+   MQTTTimer* slots[MQTT_TIMER_WHEEL_SLOTS];
+   unsigned long cursor;    // next tick to examine
+   boolean started;
+   MQTTWakeCallback wake;
+   void* wakeArg;
+   unsigned long wakeAt;    // expiry wake was last told about
+   boolean wakeArmed;
+
+   static unsigned long tickOf(unsigned long ms) {
+      return ms / MQTT_TIMER_WHEEL_TICK;
+   }
+public:
+   MQTTTimerWheel() {
+      memset(this->slots, 0, sizeof(this->slots));
+      this->cursor = 0;
+      this->started = false;
+      this->wake = NULL;
+      this->wakeArg = NULL;
+      this->wakeAt = 0;
+      this->wakeArmed = false;
+   }
+
+   static void init(MQTTTimer* timer, void* owner, MQTTTimerCallback fire) {
+      memset(timer, 0, sizeof(MQTTTimer));
+      timer->owner = owner;
+      timer->fire = fire;
+   }
+
+   // Drive the wheel from a single one-shot esp_timer or FreeRTOS software timer instead of
+   // polling: wake re-arms that timer for expires, its callback notifies the task owning the
+   // wheel (e.g. xTaskNotifyGive), and the task calls run(). The timer callback itself must
+   // not call run(), timers fire into code that is only safe on the owning task.
+   // A cancelled timer may cause one spurious wake; run() then simply finds nothing due
+   void setWakeCallback(MQTTWakeCallback wake, void* arg) {
+      this->wake = wake;
+      this->wakeArg = arg;
+      this->wakeArmed = false;
+      if (wake && nextExpiry(&this->wakeAt)) {
+         this->wakeArmed = true;
+         wake(arg, this->wakeAt);
+      }
+   }
+
+   // Arm (or re-arm) timer to expire at the millis() value expires
+   void schedule(MQTTTimer* timer, unsigned long expires) {
+      cancel(timer);
+      if (!this->started) {
+         this->cursor = tickOf(millis());
+         this->started = true;
+      }
+      unsigned long tick = tickOf(expires);
+      if ((long) (tick - this->cursor) < 0) {
+         // Already due - file it where the next advance looks first
+         tick = this->cursor;
+      }
+      timer->slot = tick & (MQTT_TIMER_WHEEL_SLOTS - 1);
+      MQTTTimer** slot = &this->slots[timer->slot];
+      timer->expires = expires;
+      timer->prev = NULL;
+      timer->next = *slot;
+      if (*slot) {
+         (*slot)->prev = timer;
+      }
+      *slot = timer;
+      timer->armed = true;
+      if (this->wake && (!this->wakeArmed || (long) (expires - this->wakeAt) < 0)) {
+         this->wakeAt = expires;
+         this->wakeArmed = true;
+         this->wake(this->wakeArg, expires);
+      }
+   }
+
+   void cancel(MQTTTimer* timer) {
+      if (!timer->armed) {
+         return;
+      }
+      if (timer->prev) {
+         timer->prev->next = timer->next;
+      } else {
+         this->slots[timer->slot] = timer->next;
+      }
+      if (timer->next) {
+         timer->next->prev = timer->prev;
+      }
+      timer->next = timer->prev = NULL;
+      timer->armed = false;
+   }
+
+   // Earliest expiry of any armed timer. Walks every slot, so meant for deciding how long
+   // to sleep, not for every loop. Returns false if no timer is armed
+   boolean nextExpiry(unsigned long* expires) {
+      boolean found = false;
+      for (uint16_t i = 0; i < MQTT_TIMER_WHEEL_SLOTS; i++) {
+         for (MQTTTimer* t = this->slots[i]; t; t = t->next) {
+            if (!found || (long) (t->expires - *expires) < 0) {
+               *expires = t->expires;
+               found = true;
+            }
+         }
+      }
+      return found;
+   }
+
+   // Returns one timer that is due at now, disarmed, or NULL once none is left.
+   // Call repeatedly; only the slots passed since the last call are examined.
+   MQTTTimer* expired(unsigned long now) {
+      if (!this->started) {
+         return NULL;
+      }
+      unsigned long nowTick = tickOf(now);
+      long behind = (long) (nowTick - this->cursor);
+      if (behind >= MQTT_TIMER_WHEEL_SLOTS || behind < 0) {
+         // Fell behind by a whole revolution (or millis() wrapped and the tick
+         // count jumped); one pass over every slot catches up
+         this->cursor = nowTick - (MQTT_TIMER_WHEEL_SLOTS - 1);
+      }
+      while ((long) (nowTick - this->cursor) >= 0) {
+         for (MQTTTimer* t = this->slots[this->cursor & (MQTT_TIMER_WHEEL_SLOTS - 1)]; t; t = t->next) {
+            if ((long) (t->expires - now) <= 0) {
+               cancel(t);
+               return t;
+            }
+         }
+         if (this->cursor == nowTick) {
+            // Timers may still be filed into the current tick
+            break;
+         }
+         this->cursor++;
+      }
+      return NULL;
+   }
+
+   // Fires every timer due at now. Returns the number fired
+   uint16_t run(unsigned long now) {
+      uint16_t fired = 0;
+      MQTTTimer* timer;
+      while ((timer = expired(now)) != NULL) {
+         timer->fire(timer);
+         fired++;
+      }
+      if (this->wake && this->wakeArmed && (long) (now - this->wakeAt) >= 0) {
+         this->wakeArmed = nextExpiry(&this->wakeAt);
+         if (this->wakeArmed) {
+            this->wake(this->wakeArg, this->wakeAt);
+         }
+      }
+      return fired;
+   }
+};
+
+#endif
@@ -8,158 +8,408 @@
 #include "PubSubClient.h"
 #include "Arduino.h"
 
+// Receive parser states
+#define MQTT_RX_HEADER  0
+#define MQTT_RX_LENGTH  1
+#define MQTT_RX_BODY    2
+
+// Streamed PUBLISH phases
+#define MQTT_STREAM_NONE     0
+#define MQTT_STREAM_HEADER   1
+#define MQTT_STREAM_PAYLOAD  2
+#define MQTT_STREAM_DROP     3
+
+// Non-blocking connect phases
+#define MQTT_CONNECT_IDLE     0
+#define MQTT_CONNECT_TCP      1
+#define MQTT_CONNECT_SEND     2
+#define MQTT_CONNECT_CONNACK  3
+
+#ifdef MQTT_METRICS
+static void recordLatency(MQTTHistogram* h, uint32_t ms) {
+    uint8_t bucket = 0;
+    while (bucket < MQTT_METRICS_BUCKETS - 1 && ms >= (1UL << bucket)) {
+        bucket++;
+    }
+    h->buckets[bucket]++;
+    h->count++;
+    h->sum += ms;
+    if (ms > h->max) {
+        h->max = ms;
+    }
+}
+#endif
+
 PubSubClient::PubSubClient() {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     this->_client = NULL;
     this->stream = NULL;
     setCallback(NULL);
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 
 PubSubClient::PubSubClient(Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     setClient(client);
     this->stream = NULL;
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     setServer(addr, port);
     setClient(client);
     this->stream = NULL;
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     setServer(addr,port);
     setClient(client);
     setStream(stream);
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     setServer(addr, port);
     setCallback(callback);
     setClient(client);
     this->stream = NULL;
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     setServer(addr,port);
     setCallback(callback);
     setClient(client);
     setStream(stream);
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     setServer(ip, port);
     setClient(client);
     this->stream = NULL;
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     setServer(ip,port);
     setClient(client);
     setStream(stream);
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     setServer(ip, port);
     setCallback(callback);
     setClient(client);
     this->stream = NULL;
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     setServer(ip,port);
     setCallback(callback);
     setClient(client);
     setStream(stream);
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 
 PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     setServer(domain,port);
     setClient(client);
     this->stream = NULL;
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     setServer(domain,port);
     setClient(client);
     setStream(stream);
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     setServer(domain,port);
     setCallback(callback);
     setClient(client);
     this->stream = NULL;
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    this->inflightCount = 0;
+    this->reasonCode = 0;
+    this->txBuffer = NULL;
+    this->txSize = 0;
+    this->txLength = 0;
+    this->publishRemaining = 0;
+    initTimers();
+    MQTT_METRIC(resetMetrics();)
+    memset(this->inflight, 0, sizeof(this->inflight));
+    setPublishCallback(NULL);
+    setStreamCallback(NULL);
     setServer(domain,port);
     setCallback(callback);
     setClient(client);
     setStream(stream);
     this->bufferSize = 0;
+    this->bufferExternal = false;
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    setInflightWindow(MQTT_MAX_INFLIGHT);
+    setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
 }
 
 PubSubClient::~PubSubClient() {
-  free(this->buffer);
+  cancelTimers();
+  for (uint8_t i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+    free(this->inflight[i].packet);
+  }
+  if (!this->bufferExternal) {
+    free(this->buffer);
+  }
+  free(this->txBuffer);
+  delete this->ownTimers;
 }
 
 boolean PubSubClient::connect(const char *id) {
@@ -180,248 +430,466 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
 
 boolean PubSubClient::connect(const char *id, const char *user, const char *pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage, boolean cleanSession) {
     if (!connected()) {
-        int result = 0;
+        if (!beginConnect(id,user,pass,willTopic,willQos,willRetain,willMessage,cleanSession)) {
+            return false;
+        }
+        int rc;
+        while ((rc = pollConnect()) == 0) {
+            yield();
+        }
+        return rc > 0;
+    }
+    return true;
+}
+
+boolean PubSubClient::beginConnect(const char *id, const char *user, const char *pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage, boolean cleanSession) {
+    if (connected() || this->connectPhase != MQTT_CONNECT_IDLE) {
+        return false;
+    }
+    if (!ensureTimers()) {
+        _state = MQTT_CONNECT_FAILED;
+        return false;
+    }
+    this->connectId = id;
+    this->connectUser = user;
+    this->connectPass = pass;
+    this->connectWillTopic = willTopic;
+    this->connectWillQos = willQos;
+    this->connectWillRetain = willRetain;
+    this->connectWillMessage = willMessage;
+    this->connectCleanSession = cleanSession;
+    this->connectPhase = MQTT_CONNECT_TCP;
+    _state = MQTT_CONNECTING;
+    return true;
+}
 
+int PubSubClient::pollConnect() {
+    switch (this->connectPhase) {
+    case MQTT_CONNECT_IDLE:
+        return connected() ? 1 : -1;
 
+    case MQTT_CONNECT_TCP: {
+        int result = 0;
         if(_client->connected()) {
             result = 1;
         } else {
+            // Only as non-blocking as the underlying Client::connect()
             if (domain != NULL) {
                 result = _client->connect(this->domain, this->port);
             } else {
                 result = _client->connect(this->ip, this->port);
             }
         }
+        if (result != 1) {
+            this->connectPhase = MQTT_CONNECT_IDLE;
+            _state = MQTT_CONNECT_FAILED;
+            MQTT_METRIC(this->metrics.connectFailures++;)
+            return -1;
+        }
+        this->connectPhase = MQTT_CONNECT_SEND;
+    }
+    // fall through
+
+    case MQTT_CONNECT_SEND:
+        nextMsgId = 1;
+        this->rxState = MQTT_RX_HEADER;
+        // Publishes queued for a previous connection must not precede CONNECT
+        this->txLength = 0;
+        this->timers->cancel(&this->flushTimer);
+#if MQTT_VERSION == MQTT_VERSION_5
+        // Topic aliases only live as long as the network connection
+        this->topicAliasCount = 0;
+        this->aliasPending = false;
+        this->serverTopicAliasMax = 0;
+#endif
+        if (!sendConnect()) {
+            this->connectPhase = MQTT_CONNECT_IDLE;
+            _state = MQTT_CONNECT_FAILED;
+            MQTT_METRIC(this->metrics.connectFailures++;)
+            return -1;
+        }
+        lastInActivity = lastOutActivity = millis();
+        this->connectPhase = MQTT_CONNECT_CONNACK;
+        this->timers->schedule(&this->socketTimer, lastInActivity + this->socketTimeout*1000UL);
+        return 0;
+
+    case MQTT_CONNECT_CONNACK: {
+        uint8_t llen;
+        uint32_t len;
+        int8_t rc = pollPacket(&llen, &len);
+        if (rc == 0) {
+            // The socket timer ends the wait if no CONNACK arrives
+            runTimers();
+            return (this->connectPhase == MQTT_CONNECT_IDLE) ? -1 : 0;
+        }
+        this->connectPhase = MQTT_CONNECT_IDLE;
+        this->timers->cancel(&this->socketTimer);
+        int reason = -1;
+#if MQTT_VERSION == MQTT_VERSION_5
+        // flags, reason code, properties
+        if (rc > 0 && len >= (uint32_t) (llen + 4)) {
+            reason = buffer[llen+2];
+            if (reason == 0) {
+                readConnackProperties(buffer+llen+3, buffer+len);
+            }
+        }
+#else
+        if (rc > 0 && len == 4) {
+            reason = buffer[3];
+        }
+#endif
+        if (reason >= 0) {
+            this->reasonCode = reason;
+            if (reason == 0) {
+                lastInActivity = millis();
+                pingOutstanding = false;
+                _state = MQTT_CONNECTED;
+                MQTT_METRIC(this->metrics.connects++;)
+                this->timers->schedule(&this->keepAliveTimer, keepAliveDeadline());
+                if (this->connectCleanSession) {
+                    // The broker dropped the session - nothing in flight will be acknowledged
+                    for (uint8_t i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+                        if (this->inflight[i].packet) completeInflight(&this->inflight[i], false);
+                    }
+                } else {
+                    retransmitInflight(lastInActivity, true);
+                    armRetransmit();
+                }
+                return 1;
+            } else {
+                _state = reason;
+            }
+        }
+        if (_state == MQTT_CONNECTING) {
+            _state = MQTT_CONNECT_FAILED;
+        }
+        MQTT_METRIC(this->metrics.connectFailures++;)
+        _client->stop();
+        return -1;
+    }
+    }
+    return -1;
+}
 
-        if (result == 1) {
-            nextMsgId = 1;
-            // Leave room in the buffer for header and variable length field
-            uint16_t length = MQTT_MAX_HEADER_SIZE;
-            unsigned int j;
+boolean PubSubClient::sendConnect() {
+    const char* id = this->connectId;
+    const char* user = this->connectUser;
+    const char* pass = this->connectPass;
+    const char* willTopic = this->connectWillTopic;
+    const char* willMessage = this->connectWillMessage;
+
+    // Leave room in the buffer for header and variable length field
+    uint16_t length = MQTT_MAX_HEADER_SIZE;
+    unsigned int j;
 
 #if MQTT_VERSION == MQTT_VERSION_3_1
-            uint8_t d[9] = {0x00,0x06,'M','Q','I','s','d','p', MQTT_VERSION};
+    uint8_t d[9] = {0x00,0x06,'M','Q','I','s','d','p', MQTT_VERSION};
 #define MQTT_HEADER_VERSION_LENGTH 9
-#elif MQTT_VERSION == MQTT_VERSION_3_1_1
-            uint8_t d[7] = {0x00,0x04,'M','Q','T','T',MQTT_VERSION};
+#elif MQTT_VERSION == MQTT_VERSION_3_1_1 || MQTT_VERSION == MQTT_VERSION_5
+    uint8_t d[7] = {0x00,0x04,'M','Q','T','T',MQTT_VERSION};
 #define MQTT_HEADER_VERSION_LENGTH 7
 #endif
-            for (j = 0;j<MQTT_HEADER_VERSION_LENGTH;j++) {
-                this->buffer[length++] = d[j];
-            }
-
-            uint8_t v;
-            if (willTopic) {
-                v = 0x04|(willQos<<3)|(willRetain<<5);
-            } else {
-                v = 0x00;
-            }
-            if (cleanSession) {
-                v = v|0x02;
-            }
+    for (j = 0;j<MQTT_HEADER_VERSION_LENGTH;j++) {
+        this->buffer[length++] = d[j];
+    }
 
-            if(user != NULL) {
-                v = v|0x80;
+    uint8_t v;
+    if (willTopic) {
+        v = 0x04|(this->connectWillQos<<3)|(this->connectWillRetain<<5);
+    } else {
+        v = 0x00;
+    }
+    if (this->connectCleanSession) {
+        v = v|0x02;
+    }
 
-                if(pass != NULL) {
-                    v = v|(0x80>>1);
-                }
-            }
-            this->buffer[length++] = v;
-
-            this->buffer[length++] = ((this->keepAlive) >> 8);
-            this->buffer[length++] = ((this->keepAlive) & 0xFF);
-
-            CHECK_STRING_LENGTH(length,id)
-            length = writeString(id,this->buffer,length);
-            if (willTopic) {
-                CHECK_STRING_LENGTH(length,willTopic)
-                length = writeString(willTopic,this->buffer,length);
-                CHECK_STRING_LENGTH(length,willMessage)
-                length = writeString(willMessage,this->buffer,length);
-            }
+    if(user != NULL) {
+        v = v|0x80;
 
-            if(user != NULL) {
-                CHECK_STRING_LENGTH(length,user)
-                length = writeString(user,this->buffer,length);
-                if(pass != NULL) {
-                    CHECK_STRING_LENGTH(length,pass)
-                    length = writeString(pass,this->buffer,length);
-                }
-            }
+        if(pass != NULL) {
+            v = v|(0x80>>1);
+        }
+    }
+    this->buffer[length++] = v;
 
-            write(MQTTCONNECT,this->buffer,length-MQTT_MAX_HEADER_SIZE);
+    this->buffer[length++] = ((this->keepAlive) >> 8);
+    this->buffer[length++] = ((this->keepAlive) & 0xFF);
 
-            lastInActivity = lastOutActivity = millis();
+#if MQTT_VERSION == MQTT_VERSION_5
+    // CONNECT properties: keep a non-clean session for MQTT5_SESSION_EXPIRY seconds
+    if (this->connectCleanSession) {
+        this->buffer[length++] = 0;
+    } else {
+        this->buffer[length++] = 5;
+        this->buffer[length++] = MQTT5_PROP_SESSION_EXPIRY;
+        this->buffer[length++] = ((uint32_t) MQTT5_SESSION_EXPIRY >> 24);
+        this->buffer[length++] = ((uint32_t) MQTT5_SESSION_EXPIRY >> 16) & 0xFF;
+        this->buffer[length++] = ((uint32_t) MQTT5_SESSION_EXPIRY >> 8) & 0xFF;
+        this->buffer[length++] = ((uint32_t) MQTT5_SESSION_EXPIRY) & 0xFF;
+    }
+#endif
 
-            while (!_client->available()) {
-                unsigned long t = millis();
-                if (t-lastInActivity >= ((int32_t) this->socketTimeout*1000UL)) {
-                    _state = MQTT_CONNECTION_TIMEOUT;
-                    _client->stop();
-                    return false;
-                }
-            }
-            uint8_t llen;
-            uint32_t len = readPacket(&llen);
+    CHECK_STRING_LENGTH(length,id)
+    length = writeString(id,this->buffer,length);
+    if (willTopic) {
+#if MQTT_VERSION == MQTT_VERSION_5
+        this->buffer[length++] = 0; // no will properties
+#endif
+        CHECK_STRING_LENGTH(length,willTopic)
+        length = writeString(willTopic,this->buffer,length);
+        CHECK_STRING_LENGTH(length,willMessage)
+        length = writeString(willMessage,this->buffer,length);
+    }
 
-            if (len == 4) {
-                if (buffer[3] == 0) {
-                    lastInActivity = millis();
-                    pingOutstanding = false;
-                    _state = MQTT_CONNECTED;
-                    return true;
-                } else {
-                    _state = buffer[3];
-                }
-            }
-            _client->stop();
-        } else {
-            _state = MQTT_CONNECT_FAILED;
+    if(user != NULL) {
+        CHECK_STRING_LENGTH(length,user)
+        length = writeString(user,this->buffer,length);
+        if(pass != NULL) {
+            CHECK_STRING_LENGTH(length,pass)
+            length = writeString(pass,this->buffer,length);
         }
-        return false;
     }
-    return true;
-}
 
-// reads a byte into result
-boolean PubSubClient::readByte(uint8_t * result) {
-   uint32_t previousMillis = millis();
-   while(!_client->available()) {
-     yield();
-     uint32_t currentMillis = millis();
-     if(currentMillis - previousMillis >= ((int32_t) this->socketTimeout * 1000)){
-       return false;
-     }
-   }
-   *result = _client->read();
-   return true;
-}
-
-// reads a byte into result[*index] and increments index
-boolean PubSubClient::readByte(uint8_t * result, uint16_t * index){
-  uint16_t current_index = *index;
-  uint8_t * write_address = &(result[current_index]);
-  if(readByte(write_address)){
-    *index = current_index + 1;
-    return true;
-  }
-  return false;
+    return write(MQTTCONNECT,this->buffer,length-MQTT_MAX_HEADER_SIZE);
 }
 
-uint32_t PubSubClient::readPacket(uint8_t* lengthLength) {
-    uint16_t len = 0;
-    if(!readByte(this->buffer, &len)) return 0;
-    bool isPublish = (this->buffer[0]&0xF0) == MQTTPUBLISH;
-    uint32_t multiplier = 1;
-    uint32_t length = 0;
-    uint8_t digit = 0;
-    uint16_t skip = 0;
-    uint32_t start = 0;
-
-    do {
-        if (len == 5) {
-            // Invalid remaining length encoding - kill the connection
-            _state = MQTT_DISCONNECTED;
-            _client->stop();
-            return 0;
-        }
-        if(!readByte(&digit)) return 0;
-        this->buffer[len++] = digit;
-        length += (digit & 127) * multiplier;
-        multiplier <<=7; //multiplier *= 128
-    } while ((digit & 128) != 0);
-    *lengthLength = len-1;
-
-    if (isPublish) {
-        // Read in topic length to calculate bytes to skip over for Stream writing
-        if(!readByte(this->buffer, &len)) return 0;
-        if(!readByte(this->buffer, &len)) return 0;
-        skip = (this->buffer[*lengthLength+1]<<8)+this->buffer[*lengthLength+2];
-        start = 2;
-        if (this->buffer[0]&MQTTQOS1) {
-            // skip message id
-            skip += 2;
-        }
-    }
-    uint32_t idx = len;
-
-    for (uint32_t i = start;i<length;i++) {
-        if(!readByte(&digit)) return 0;
-        if (this->stream) {
-            if (isPublish && idx-*lengthLength-2>skip) {
-                this->stream->write(digit);
+int8_t PubSubClient::pollPacket(uint8_t* lengthLength, uint32_t* length) {
+    uint8_t scratch[MQTT_RX_CHUNK_SIZE];
+    while (true) {
+        if (this->rxState == MQTT_RX_BODY && this->rxBody >= this->rxRemaining) {
+            this->rxState = MQTT_RX_HEADER;
+            *lengthLength = this->rxLengthLength;
+            if (this->rxStreaming == MQTT_STREAM_PAYLOAD) {
+                *length = this->rxLen;
+            } else if (this->rxStreaming == MQTT_STREAM_DROP) {
+                *length = 0;
+                MQTT_METRIC(this->metrics.droppedOversize++;)
+            } else if (!this->stream && 1 + this->rxLengthLength + this->rxRemaining > this->bufferSize) {
+                *length = 0; // This will cause the packet to be ignored.
+                MQTT_METRIC(this->metrics.droppedOversize++;)
+            } else {
+                *length = this->rxLen;
             }
+            MQTT_METRIC(this->metrics.packetsIn++;)
+            return 1;
         }
 
-        if (len < this->bufferSize) {
-            this->buffer[len] = digit;
-            len++;
+        int avail = _client->available();
+        if (avail <= 0) {
+            return 0;
         }
-        idx++;
-    }
 
-    if (!this->stream && idx > this->bufferSize) {
-        len = 0; // This will cause the packet to be ignored.
+        if (this->rxState == MQTT_RX_HEADER) {
+            if (_client->read(this->buffer, 1) != 1) return 0;
+            MQTT_METRIC(this->metrics.bytesIn++;)
+            this->rxLen = 1;
+            this->rxRemaining = 0;
+            this->rxMultiplier = 1;
+            this->rxBody = 0;
+            this->rxSkip = 0;
+            this->rxStreaming = MQTT_STREAM_NONE;
+            this->rxProperties = 0;
+            this->rxState = MQTT_RX_LENGTH;
+        } else if (this->rxState == MQTT_RX_LENGTH) {
+            if (this->rxLen == 5) {
+                // Invalid remaining length encoding - kill the connection
+                this->rxState = MQTT_RX_HEADER;
+                _state = MQTT_DISCONNECTED;
+                _client->stop();
+                return -1;
+            }
+            uint8_t digit;
+            if (_client->read(&digit, 1) != 1) return 0;
+            MQTT_METRIC(this->metrics.bytesIn++;)
+            this->buffer[this->rxLen++] = digit;
+            this->rxRemaining += (digit & 127) * this->rxMultiplier;
+            this->rxMultiplier <<= 7; //multiplier *= 128
+            if ((digit & 128) == 0) {
+                this->rxLengthLength = this->rxLen - 1;
+                this->rxState = MQTT_RX_BODY;
+            }
+        } else {
+            bool isPublish = (this->buffer[0]&0xF0) == MQTTPUBLISH;
+            uint32_t want = this->rxRemaining - this->rxBody;
+            if (isPublish && this->rxBody < 2) {
+                // Stop after the topic length so the payload offset is known
+                want = 2 - this->rxBody;
+            } else if (this->rxProperties && want > 2 + this->rxSkip + 1 - this->rxBody) {
+                // Read the property length one byte at a time
+                want = 2 + this->rxSkip + 1 - this->rxBody;
+            } else if (this->rxStreaming == MQTT_STREAM_HEADER && want > 2 + this->rxSkip - this->rxBody) {
+                // Stop after the topic (+ msg id) so the payload starts a fresh read
+                want = 2 + this->rxSkip - this->rxBody;
+            }
+            if (want > (uint32_t) avail) {
+                want = avail;
+            }
+            uint8_t* dst;
+            if (this->rxStreaming == MQTT_STREAM_PAYLOAD) {
+                // Reuse the buffer behind the topic as a window for each fragment
+                dst = this->buffer + this->rxPayloadBase;
+                if (want > (uint32_t) (this->bufferSize - this->rxPayloadBase)) {
+                    want = this->bufferSize - this->rxPayloadBase;
+                }
+            } else if (this->rxLen < this->bufferSize) {
+                dst = this->buffer + this->rxLen;
+                if (want > (uint32_t) (this->bufferSize - this->rxLen)) {
+                    want = this->bufferSize - this->rxLen;
+                }
+            } else {
+                dst = scratch;
+                if (want > sizeof(scratch)) {
+                    want = sizeof(scratch);
+                }
+            }
+            int n = _client->read(dst, want);
+            if (n <= 0) return 0;
+            MQTT_METRIC(this->metrics.bytesIn += n;)
+
+            if (this->stream && isPublish && this->rxBody >= 2 && !this->rxProperties) {
+                uint32_t payloadStart = 2 + this->rxSkip;
+                if (this->rxBody + n > payloadStart) {
+                    uint32_t from = (this->rxBody < payloadStart) ? payloadStart - this->rxBody : 0;
+                    this->stream->write(dst + from, n - from);
+                }
+            }
+            if (this->rxStreaming == MQTT_STREAM_PAYLOAD) {
+                streamCallback((char*) this->buffer+this->rxLengthLength+3, this->rxBody-2-this->rxSkip, dst, n, this->rxRemaining-2-this->rxSkip);
+            } else if (dst != scratch) {
+                this->rxLen += n;
+            }
+            this->rxBody += n;
+            if (isPublish && this->rxBody == 2) {
+                // Read in topic length to calculate bytes to skip over for Stream writing
+                this->rxSkip = (this->buffer[this->rxLengthLength+1]<<8)+this->buffer[this->rxLengthLength+2];
+                if (this->buffer[0]&MQTTQOS1) {
+                    // skip message id
+                    this->rxSkip += 2;
+                }
+                if (streamCallback) {
+                    this->rxStreaming = MQTT_STREAM_HEADER;
+                }
+#if MQTT_VERSION == MQTT_VERSION_5
+                this->rxProperties = 1;
+                this->rxPropertyLength = 0;
+                this->rxPropertyMultiplier = 1;
+#endif
+            } else if (this->rxProperties && this->rxBody == 2 + this->rxSkip + 1) {
+                // One more byte of the property length; the properties are skipped with the topic
+                uint8_t digit = dst[n-1];
+                this->rxSkip++;
+                this->rxPropertyLength += (digit & 127) * this->rxPropertyMultiplier;
+                this->rxPropertyMultiplier <<= 7;
+                if ((digit & 128) == 0 || this->rxPropertyMultiplier > (1UL << 21)) {
+                    this->rxSkip += this->rxPropertyLength;
+                    this->rxProperties = 0;
+                }
+            }
+            if (this->rxStreaming == MQTT_STREAM_HEADER && !this->rxProperties && this->rxBody == 2 + this->rxSkip) {
+                // Topic (+ msg id) is in the buffer; terminate the topic in place and start streaming
+                uint16_t tl = (this->buffer[this->rxLengthLength+1]<<8)+this->buffer[this->rxLengthLength+2];
+                uint16_t topicEnd = this->rxLengthLength+3+tl;
+                if (this->rxLen == 1 + this->rxLengthLength + 2 + this->rxSkip && topicEnd + 1 < this->bufferSize) {
+                    if (this->buffer[0]&MQTTQOS1) {
+                        this->rxMsgId = (this->buffer[topicEnd]<<8)+this->buffer[topicEnd+1];
+                    }
+                    this->buffer[topicEnd] = 0;
+                    this->rxPayloadBase = topicEnd + 1;
+                    this->rxStreaming = MQTT_STREAM_PAYLOAD;
+                    streamCallback((char*) this->buffer+this->rxLengthLength+3, 0, NULL, 0, this->rxRemaining-2-this->rxSkip);
+                } else {
+                    // Topic does not fit the buffer - drain the packet
+                    this->rxStreaming = MQTT_STREAM_DROP;
+                }
+            }
+        }
+        this->rxLastActivity = millis();
     }
-    return len;
 }
 
 boolean PubSubClient::loop() {
+    if (this->connectPhase != MQTT_CONNECT_IDLE) {
+        return pollConnect() > 0;
+    }
+    runTimers();
     if (connected()) {
         unsigned long t = millis();
-        if ((t - lastInActivity > this->keepAlive*1000UL) || (t - lastOutActivity > this->keepAlive*1000UL)) {
-            if (pingOutstanding) {
-                this->_state = MQTT_CONNECTION_TIMEOUT;
-                _client->stop();
-                return false;
-            } else {
-                this->buffer[0] = MQTTPINGREQ;
-                this->buffer[1] = 0;
-                _client->write(this->buffer,2);
-                lastOutActivity = t;
-                lastInActivity = t;
-                pingOutstanding = true;
-            }
-        }
-        if (_client->available()) {
+        if (this->rxState != MQTT_RX_HEADER || _client->available()) {
             uint8_t llen;
-            uint16_t len = readPacket(&llen);
+            uint32_t plen;
+            int8_t rc = pollPacket(&llen, &plen);
+            if (rc == 0) {
+                // Partial packet - continue on the next call unless the socket timer finds the server stalled
+                if (this->rxState != MQTT_RX_HEADER && !this->socketTimer.armed) {
+                    this->timers->schedule(&this->socketTimer, this->rxLastActivity + this->socketTimeout*1000UL);
+                }
+                return true;
+            }
+            uint16_t len = (rc > 0) ? plen : 0;
             uint16_t msgId = 0;
             uint8_t *payload;
             if (len > 0) {
                 lastInActivity = t;
                 uint8_t type = this->buffer[0]&0xF0;
                 if (type == MQTTPUBLISH) {
-                    if (callback) {
+                    if (this->rxStreaming == MQTT_STREAM_PAYLOAD) {
+                        // Payload already delivered through streamCallback
+                        if ((this->buffer[0]&0x06) == MQTTQOS1) {
+                            msgId = this->rxMsgId;
+                            this->buffer[0] = MQTTPUBACK;
+                            this->buffer[1] = 2;
+                            this->buffer[2] = (msgId >> 8);
+                            this->buffer[3] = (msgId & 0xFF);
+                            flushTx();
+                            writeClient(this->buffer,4);
+                            lastOutActivity = t;
+                        }
+                    } else if (callback) {
                         uint16_t tl = (this->buffer[llen+1]<<8)+this->buffer[llen+2]; /* topic length in bytes */
                         memmove(this->buffer+llen+2,this->buffer+llen+3,tl); /* move topic inside buffer 1 byte to front */
                         this->buffer[llen+2+tl] = 0; /* end the topic as a 'C' string with \x00 */
                         char *topic = (char*) this->buffer+llen+2;
                         // msgId only present for QOS>0
+                        // payload follows the topic, msg id and (MQTT 5) properties
+                        payload = this->buffer+llen+3+this->rxSkip;
                         if ((this->buffer[0]&0x06) == MQTTQOS1) {
                             msgId = (this->buffer[llen+3+tl]<<8)+this->buffer[llen+3+tl+1];
-                            payload = this->buffer+llen+3+tl+2;
-                            callback(topic,payload,len-llen-3-tl-2);
+                            callback(topic,payload,len-llen-3-this->rxSkip);
 
                             this->buffer[0] = MQTTPUBACK;
                             this->buffer[1] = 2;
                             this->buffer[2] = (msgId >> 8);
                             this->buffer[3] = (msgId & 0xFF);
-                            _client->write(this->buffer,4);
+                            flushTx();
+                            writeClient(this->buffer,4);
                             lastOutActivity = t;
 
                         } else {
-                            payload = this->buffer+llen+3+tl;
-                            callback(topic,payload,len-llen-3-tl);
+                            callback(topic,payload,len-llen-3-this->rxSkip);
                         }
                     }
                 } else if (type == MQTTPINGREQ) {
                     this->buffer[0] = MQTTPINGRESP;
                     this->buffer[1] = 0;
-                    _client->write(this->buffer,2);
+                    flushTx();
+                    writeClient(this->buffer,2);
                 } else if (type == MQTTPINGRESP) {
+#ifdef MQTT_METRICS
+                    if (pingOutstanding) {
+                        recordLatency(&this->metrics.pingRtt, t - this->pingSentAt);
+                    }
+#endif
                     pingOutstanding = false;
+                } else if (type == MQTTPUBACK && len >= (uint16_t) (llen + 3)) {
+                    msgId = (this->buffer[llen+1]<<8)+this->buffer[llen+2];
+                    // MQTT 5 may append a reason code; a bare PUBACK means success
+                    this->reasonCode = (len > (uint16_t) (llen + 3)) ? this->buffer[llen+3] : 0;
+                    for (uint8_t i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+                        if (this->inflight[i].packet && this->inflight[i].msgId == msgId) {
+                            completeInflight(&this->inflight[i], this->reasonCode < 0x80);
+                            break;
+                        }
+                    }
                 }
             } else if (!connected()) {
                 // readPacket has closed the connection
@@ -446,6 +914,16 @@ boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigne
 }
 
 boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained) {
+    return publishWithProperties(topic, payload, plength, retained, NULL);
+}
+
+#if MQTT_VERSION == MQTT_VERSION_5
+boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained, const MQTTPublishProperties& props) {
+    return publishWithProperties(topic, payload, plength, retained, &props);
+}
+#endif
+
+boolean PubSubClient::publishWithProperties(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained, const MQTTPublishProperties* props) {
     if (connected()) {
         if (this->bufferSize < MQTT_MAX_HEADER_SIZE + 2+strnlen(topic, this->bufferSize) + plength) {
             // Too long
@@ -453,7 +931,11 @@ boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigne
         }
         // Leave room in the buffer for header and variable length field
         uint16_t length = MQTT_MAX_HEADER_SIZE;
-        length = writeString(topic,this->buffer,length);
+        length = writePublishHeader(topic, 0, props, length);
+        if (length == 0 || this->bufferSize < length + plength) {
+            // Too long
+            return false;
+        }
 
         // Add payload
         uint16_t i;
@@ -466,100 +948,396 @@ boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigne
         if (retained) {
             header |= 1;
         }
-        return write(header,this->buffer,length-MQTT_MAX_HEADER_SIZE);
+        if (this->txBuffer) {
+            return publishSent(coalesce(header,length-MQTT_MAX_HEADER_SIZE));
+        }
+        return publishSent(write(header,this->buffer,length-MQTT_MAX_HEADER_SIZE));
     }
     return false;
 }
 
+uint16_t PubSubClient::publishQos1(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained) {
+    if (!connected() || this->inflightCount >= this->inflightWindow) {
+        return 0;
+    }
+    if (this->bufferSize < MQTT_MAX_HEADER_SIZE + 2+strnlen(topic, this->bufferSize) + 2 + plength) {
+        // Too long
+        return 0;
+    }
+    MQTTInflight* slot = NULL;
+    for (uint8_t i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+        if (this->inflight[i].packet == NULL) {
+            slot = &this->inflight[i];
+            break;
+        }
+    }
+    if (slot == NULL) {
+        return 0;
+    }
+
+    uint16_t msgId = nextPacketId();
+    // Leave room in the buffer for header and variable length field
+    uint16_t length = MQTT_MAX_HEADER_SIZE;
+    length = writePublishHeader(topic, msgId, NULL, length);
+    if (length == 0 || this->bufferSize < length + plength) {
+        // Too long
+        return 0;
+    }
+    memcpy(this->buffer+length, payload, plength);
+    length += plength;
+
+    uint8_t header = MQTTPUBLISH | MQTTQOS1;
+    if (retained) {
+        header |= 1;
+    }
+    size_t hlen = buildHeader(header, this->buffer, length-MQTT_MAX_HEADER_SIZE);
+    uint16_t packetLength = hlen + length - MQTT_MAX_HEADER_SIZE;
+    slot->packet = (uint8_t*)malloc(packetLength);
+    if (slot->packet == NULL) {
+        return 0;
+    }
+    memcpy(slot->packet, this->buffer+(MQTT_MAX_HEADER_SIZE-hlen), packetLength);
+    slot->msgId = msgId;
+    slot->length = packetLength;
+    slot->retries = 0;
+    slot->sentAt = millis();
+    MQTT_METRIC(slot->queuedAt = slot->sentAt;)
+    this->inflightCount++;
+
+    if (!this->retransmitTimer.armed) {
+        this->timers->schedule(&this->retransmitTimer, slot->sentAt + this->retransmitTimeout*1000UL);
+    }
+
+    // A failed write is recovered by the retransmit timer or on reconnect
+    write(header,this->buffer,length-MQTT_MAX_HEADER_SIZE);
+    return msgId;
+}
+
+void PubSubClient::completeInflight(MQTTInflight* slot, boolean delivered) {
+    uint16_t msgId = slot->msgId;
+    free(slot->packet);
+    slot->packet = NULL;
+    slot->msgId = 0;
+    this->inflightCount--;
+#ifdef MQTT_METRICS
+    if (delivered) {
+        recordLatency(&this->metrics.publishLatency, millis() - slot->queuedAt);
+    } else {
+        this->metrics.publishFailures++;
+    }
+#endif
+    if (publishCallback) {
+        publishCallback(msgId, delivered);
+    }
+}
+
+// Resend publishes whose PUBACK is overdue, or all of them when force is set (session resumed)
+void PubSubClient::retransmitInflight(unsigned long t, boolean force) {
+    for (uint8_t i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+        MQTTInflight* slot = &this->inflight[i];
+        if (slot->packet == NULL) {
+            continue;
+        }
+        if (!force && t - slot->sentAt < this->retransmitTimeout*1000UL) {
+            continue;
+        }
+        if (slot->retries >= MQTT_MAX_RETRANSMITS) {
+            completeInflight(slot, false);
+            continue;
+        }
+        slot->packet[0] |= MQTTDUP;
+        flushTx();
+        writeClient(slot->packet, slot->length);
+        slot->sentAt = t;
+        slot->retries++;
+        MQTT_METRIC(this->metrics.retransmits++;)
+        lastOutActivity = t;
+    }
+}
+
+// Re-arm the retransmit timer for the oldest publish still waiting for its PUBACK
+void PubSubClient::armRetransmit() {
+    MQTTInflight* oldest = NULL;
+    for (uint8_t i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+        MQTTInflight* slot = &this->inflight[i];
+        if (slot->packet && (oldest == NULL || (long) (slot->sentAt - oldest->sentAt) < 0)) {
+            oldest = slot;
+        }
+    }
+    if (oldest) {
+        this->timers->schedule(&this->retransmitTimer, oldest->sentAt + this->retransmitTimeout*1000UL);
+    } else {
+        this->timers->cancel(&this->retransmitTimer);
+    }
+}
+
+void PubSubClient::initTimers() {
+    this->ownTimers = NULL;
+    this->timers = NULL;
+    MQTTTimerWheel::init(&this->keepAliveTimer, this, fireTimer);
+    MQTTTimerWheel::init(&this->socketTimer, this, fireTimer);
+    MQTTTimerWheel::init(&this->retransmitTimer, this, fireTimer);
+    MQTTTimerWheel::init(&this->flushTimer, this, fireTimer);
+}
+
+// Timers are only armed once the client connects, so a client that was given a wheel before never allocates its own
+boolean PubSubClient::ensureTimers() {
+    if (this->timers == NULL) {
+        this->ownTimers = new MQTTTimerWheel();
+        this->timers = this->ownTimers;
+    }
+    return this->timers != NULL;
+}
+
+PubSubClient& PubSubClient::setTimerWheel(MQTTTimerWheel* wheel) {
+    if (wheel == NULL) {
+        if (this->timers == NULL) {
+            // Nothing can be armed yet, the own wheel is allocated on connect
+            return *this;
+        }
+        if (this->ownTimers == NULL) {
+            this->ownTimers = new MQTTTimerWheel();
+            if (this->ownTimers == NULL) {
+                // Without a wheel of its own the client keeps using the shared one
+                return *this;
+            }
+        }
+        wheel = this->ownTimers;
+    }
+    if (this->timers == NULL) {
+        this->timers = wheel;
+        return *this;
+    }
+    MQTTTimer* own[4] = { &this->keepAliveTimer, &this->socketTimer, &this->retransmitTimer, &this->flushTimer };
+    for (uint8_t i = 0; i < 4; i++) {
+        if (own[i]->armed) {
+            unsigned long expires = own[i]->expires;
+            this->timers->cancel(own[i]);
+            wheel->schedule(own[i], expires);
+        }
+    }
+    this->timers = wheel;
+    return *this;
+}
+
+void PubSubClient::fireTimer(MQTTTimer* timer) {
+    ((PubSubClient*) timer->owner)->onTimer(timer);
+}
+
+void PubSubClient::cancelTimers() {
+    if (this->timers == NULL) {
+        return;
+    }
+    this->timers->cancel(&this->keepAliveTimer);
+    this->timers->cancel(&this->socketTimer);
+    this->timers->cancel(&this->retransmitTimer);
+    this->timers->cancel(&this->flushTimer);
+}
+
+void PubSubClient::onTimer(MQTTTimer* timer) {
+    unsigned long t = millis();
+    if (timer == &this->socketTimer) {
+        if (this->connectPhase == MQTT_CONNECT_CONNACK) {
+            this->connectPhase = MQTT_CONNECT_IDLE;
+            _state = MQTT_CONNECTION_TIMEOUT;
+            MQTT_METRIC(this->metrics.connectFailures++;)
+            _client->stop();
+        } else if (this->rxState != MQTT_RX_HEADER && _state == MQTT_CONNECTED) {
+            if (t - this->rxLastActivity >= this->socketTimeout*1000UL) {
+                // The server stalled in the middle of a packet
+                this->rxState = MQTT_RX_HEADER;
+                _state = MQTT_CONNECTION_TIMEOUT;
+                MQTT_METRIC(this->metrics.timeouts++;)
+                cancelTimers();
+                _client->stop();
+            } else {
+                this->timers->schedule(&this->socketTimer, this->rxLastActivity + this->socketTimeout*1000UL);
+            }
+        }
+        return;
+    }
+    if (!connected()) {
+        return;
+    }
+    if (timer == &this->keepAliveTimer) {
+        if ((long) (t - keepAliveDeadline()) < 0) {
+            // Traffic since the timer was armed pushed the deadline back
+            this->timers->schedule(&this->keepAliveTimer, keepAliveDeadline());
+        } else if (pingOutstanding) {
+            _state = MQTT_CONNECTION_TIMEOUT;
+            MQTT_METRIC(this->metrics.timeouts++;)
+            cancelTimers();
+            _client->stop();
+        } else {
+            // Not built in buffer - it may hold a partially received packet
+            uint8_t ping[2] = { MQTTPINGREQ, 0 };
+            flushTx();
+            writeClient(ping,2);
+            lastOutActivity = t;
+            lastInActivity = t;
+            pingOutstanding = true;
+            MQTT_METRIC(this->pingSentAt = t;)
+            this->timers->schedule(&this->keepAliveTimer, keepAliveDeadline());
+        }
+    } else if (timer == &this->retransmitTimer) {
+        retransmitInflight(t, false);
+        armRetransmit();
+    } else if (timer == &this->flushTimer) {
+        flushTx();
+    }
+}
+
+void PubSubClient::runTimers() {
+    if (this->timers != NULL) {
+        this->timers->run(millis());
+    }
+}
+
+unsigned long PubSubClient::msUntilNextTimer() {
+    unsigned long expires;
+    if (this->timers == NULL || !this->timers->nextExpiry(&expires)) {
+        return MQTT_NO_TIMER;
+    }
+    long wait = (long) (expires - millis());
+    return (wait > 0) ? wait : 0;
+}
+
+uint16_t PubSubClient::nextPacketId() {
+    // Skip 0 and ids still waiting for a PUBACK
+    while (true) {
+        nextMsgId++;
+        if (nextMsgId == 0) {
+            nextMsgId = 1;
+        }
+        boolean used = false;
+        for (uint8_t i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+            if (this->inflight[i].packet && this->inflight[i].msgId == nextMsgId) {
+                used = true;
+                break;
+            }
+        }
+        if (!used) {
+            return nextMsgId;
+        }
+    }
+}
+
 boolean PubSubClient::publish_P(const char* topic, const char* payload, boolean retained) {
     return publish_P(topic, (const uint8_t*)payload, payload ? strnlen(payload, this->bufferSize) : 0, retained);
 }
 
 boolean PubSubClient::publish_P(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained) {
-    uint8_t llen = 0;
-    uint8_t digit;
     unsigned int rc = 0;
-    uint16_t tlen;
-    unsigned int pos = 0;
     unsigned int i;
     uint8_t header;
-    unsigned int len;
-    int expectedLength;
 
     if (!connected()) {
         return false;
     }
 
-    tlen = strnlen(topic, this->bufferSize);
-
     header = MQTTPUBLISH;
     if (retained) {
         header |= 1;
     }
-    this->buffer[pos++] = header;
-    len = plength + 2 + tlen;
-    do {
-        digit = len  & 127; //digit = len %128
-        len >>= 7; //len = len / 128
-        if (len > 0) {
-            digit |= 0x80;
-        }
-        this->buffer[pos++] = digit;
-        llen++;
-    } while(len>0);
-
-    pos = writeString(topic,this->buffer,pos);
+    uint16_t length = writePublishHeader(topic, 0, NULL, MQTT_MAX_HEADER_SIZE);
+    if (length == 0) {
+        return false;
+    }
+    size_t hlen = buildHeader(header, this->buffer, plength+length-MQTT_MAX_HEADER_SIZE);
+    unsigned int pos = length-(MQTT_MAX_HEADER_SIZE-hlen);
 
-    rc += _client->write(this->buffer,pos);
+    flushTx();
+    rc += writeClient(this->buffer+(MQTT_MAX_HEADER_SIZE-hlen),pos);
 
     for (i=0;i<plength;i++) {
-        rc += _client->write((char)pgm_read_byte_near(payload + i));
+        uint8_t b = pgm_read_byte_near(payload + i);
+        rc += writeClient(&b,1);
     }
 
     lastOutActivity = millis();
 
-    expectedLength = 1 + llen + 2 + tlen + plength;
+    return publishSent(rc == pos + plength);
+}
 
-    return (rc == expectedLength);
+boolean PubSubClient::publishv(const char* topic, const MQTTIOVec* iov, uint8_t count, boolean retained) {
+    if (!connected()) {
+        return false;
+    }
+    uint32_t plength = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        plength += iov[i].len;
+    }
+    // Leave room in the buffer for header and variable length field
+    uint16_t length = MQTT_MAX_HEADER_SIZE;
+    length = writePublishHeader(topic, 0, NULL, length);
+    if (length == 0) {
+        // Too long
+        return false;
+    }
+    uint8_t header = MQTTPUBLISH;
+    if (retained) {
+        header |= 1;
+    }
+    size_t hlen = buildHeader(header, this->buffer, plength+length-MQTT_MAX_HEADER_SIZE);
+    size_t expected = length-(MQTT_MAX_HEADER_SIZE-hlen);
+    flushTx();
+    boolean result = (writeClient(this->buffer+(MQTT_MAX_HEADER_SIZE-hlen),expected) == expected);
+    for (uint8_t i = 0; i < count && result; i++) {
+        if (iov[i].len > 0) {
+            result = (writeClient((const uint8_t*)iov[i].base, iov[i].len) == iov[i].len);
+        }
+    }
+    lastOutActivity = millis();
+    return publishSent(result);
 }
 
 boolean PubSubClient::beginPublish(const char* topic, unsigned int plength, boolean retained) {
     if (connected()) {
         // Send the header and variable length field
         uint16_t length = MQTT_MAX_HEADER_SIZE;
-        length = writeString(topic,this->buffer,length);
+        length = writePublishHeader(topic, 0, NULL, length);
+        if (length == 0) {
+            return false;
+        }
         uint8_t header = MQTTPUBLISH;
         if (retained) {
             header |= 1;
         }
         size_t hlen = buildHeader(header, this->buffer, plength+length-MQTT_MAX_HEADER_SIZE);
-        uint16_t rc = _client->write(this->buffer+(MQTT_MAX_HEADER_SIZE-hlen),length-(MQTT_MAX_HEADER_SIZE-hlen));
+        flushTx();
+        uint16_t rc = writeClient(this->buffer+(MQTT_MAX_HEADER_SIZE-hlen),length-(MQTT_MAX_HEADER_SIZE-hlen));
         lastOutActivity = millis();
-        return (rc == (length-(MQTT_MAX_HEADER_SIZE-hlen)));
+        this->publishRemaining = plength;
+        if (rc != (length-(MQTT_MAX_HEADER_SIZE-hlen))) {
+            return publishSent(false);
+        }
+        // A new topic alias is registered by endPublish(), once the payload is out as well
+        return true;
     }
     return false;
 }
 
 int PubSubClient::endPublish() {
- return 1;
+    return publishSent(this->publishRemaining == 0);
 }
 
 size_t PubSubClient::write(uint8_t data) {
-    lastOutActivity = millis();
-    return _client->write(data);
+    return write(&data,1);
 }
 
 size_t PubSubClient::write(const uint8_t *buffer, size_t size) {
     lastOutActivity = millis();
-    return _client->write(buffer,size);
+    size_t rc = writeClient(buffer,size);
+    this->publishRemaining -= (rc < this->publishRemaining) ? rc : this->publishRemaining;
+    return rc;
 }
 
-size_t PubSubClient::buildHeader(uint8_t header, uint8_t* buf, uint16_t length) {
+size_t PubSubClient::buildHeader(uint8_t header, uint8_t* buf, uint32_t length) {
     uint8_t lenBuf[4];
     uint8_t llen = 0;
     uint8_t digit;
     uint8_t pos = 0;
-    uint16_t len = length;
+    uint32_t len = length;
     do {
 
         digit = len  & 127; //digit = len %128
@@ -580,6 +1358,7 @@ size_t PubSubClient::buildHeader(uint8_t header, uint8_t* buf, uint16_t length)
 
 boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
     uint16_t rc;
+    flushTx();
     uint8_t hlen = buildHeader(header, buf, length);
 
 #ifdef MQTT_MAX_TRANSFER_SIZE
@@ -589,19 +1368,100 @@ boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
     boolean result = true;
     while((bytesRemaining > 0) && result) {
         bytesToWrite = (bytesRemaining > MQTT_MAX_TRANSFER_SIZE)?MQTT_MAX_TRANSFER_SIZE:bytesRemaining;
-        rc = _client->write(writeBuf,bytesToWrite);
+        rc = writeClient(writeBuf,bytesToWrite);
         result = (rc == bytesToWrite);
         bytesRemaining -= rc;
         writeBuf += rc;
     }
     return result;
 #else
-    rc = _client->write(buf+(MQTT_MAX_HEADER_SIZE-hlen),length+hlen);
+    rc = writeClient(buf+(MQTT_MAX_HEADER_SIZE-hlen),length+hlen);
     lastOutActivity = millis();
     return (rc == hlen+length);
 #endif
 }
 
+// Append the packet built in buffer to the send buffer, writing the send buffer out first
+// if the packet does not fit. A packet larger than the whole send buffer is written directly
+boolean PubSubClient::coalesce(uint8_t header, uint16_t length) {
+    uint8_t hlen = buildHeader(header, this->buffer, length);
+    uint16_t packetLength = hlen + length;
+    if (this->txLength + packetLength > this->txSize) {
+        if (!flushTx()) {
+            return false;
+        }
+        if (packetLength > this->txSize) {
+            return write(header,this->buffer,length);
+        }
+    }
+    if (this->txLength == 0) {
+        this->timers->schedule(&this->flushTimer, millis() + this->txDelay);
+#if MQTT_VERSION == MQTT_VERSION_5
+        this->txAliasCount = this->topicAliasCount;
+#endif
+    }
+    memcpy(this->txBuffer+this->txLength, this->buffer+(MQTT_MAX_HEADER_SIZE-hlen), packetLength);
+    this->txLength += packetLength;
+    if (this->txLength == this->txSize) {
+        return flushTx();
+    }
+    return true;
+}
+
+// Returns false if queued publishes could not be written; they are dropped either way
+boolean PubSubClient::flushTx() {
+    if (this->txLength == 0) {
+        return true;
+    }
+    uint16_t length = this->txLength;
+    this->txLength = 0;
+    this->timers->cancel(&this->flushTimer);
+    lastOutActivity = millis();
+    boolean result = true;
+#ifdef MQTT_MAX_TRANSFER_SIZE
+    uint8_t* writeBuf = this->txBuffer;
+    while (length > 0 && result) {
+        uint16_t bytesToWrite = (length > MQTT_MAX_TRANSFER_SIZE)?MQTT_MAX_TRANSFER_SIZE:length;
+        uint16_t rc = writeClient(writeBuf,bytesToWrite);
+        result = (rc == bytesToWrite);
+        length -= rc;
+        writeBuf += rc;
+    }
+#else
+    uint16_t rc = writeClient(this->txBuffer,length);
+    result = (rc == length);
+#endif
+#if MQTT_VERSION == MQTT_VERSION_5
+    if (!result) {
+        // Aliases introduced by the dropped publishes never reached the broker
+        this->topicAliasCount = this->txAliasCount;
+    }
+#endif
+    return result;
+}
+
+void PubSubClient::flush() {
+    flushTx();
+}
+
+boolean PubSubClient::setCoalescing(uint16_t size, uint16_t maxDelay) {
+    flushTx();
+    if (size == 0) {
+        free(this->txBuffer);
+        this->txBuffer = NULL;
+        this->txSize = 0;
+        return true;
+    }
+    uint8_t* newBuffer = (uint8_t*)realloc(this->txBuffer, size);
+    if (newBuffer == NULL) {
+        return false;
+    }
+    this->txBuffer = newBuffer;
+    this->txSize = size;
+    this->txDelay = maxDelay;
+    return true;
+}
+
 boolean PubSubClient::subscribe(const char* topic) {
     return subscribe(topic, 0);
 }
@@ -614,19 +1474,19 @@ boolean PubSubClient::subscribe(const char* topic, uint8_t qos) {
     if (qos > 1) {
         return false;
     }
-    if (this->bufferSize < 9 + topicLength) {
+    if (this->bufferSize < 9 + topicLength + MQTT_PROPERTY_LENGTH_SIZE) {
         // Too long
         return false;
     }
     if (connected()) {
         // Leave room in the buffer for header and variable length field
         uint16_t length = MQTT_MAX_HEADER_SIZE;
-        nextMsgId++;
-        if (nextMsgId == 0) {
-            nextMsgId = 1;
-        }
-        this->buffer[length++] = (nextMsgId >> 8);
-        this->buffer[length++] = (nextMsgId & 0xFF);
+        uint16_t msgId = nextPacketId();
+        this->buffer[length++] = (msgId >> 8);
+        this->buffer[length++] = (msgId & 0xFF);
+#if MQTT_VERSION == MQTT_VERSION_5
+        this->buffer[length++] = 0; // no properties
+#endif
         length = writeString((char*)topic, this->buffer,length);
         this->buffer[length++] = qos;
         return write(MQTTSUBSCRIBE|MQTTQOS1,this->buffer,length-MQTT_MAX_HEADER_SIZE);
@@ -639,18 +1499,18 @@ boolean PubSubClient::unsubscribe(const char* topic) {
     if (topic == 0) {
         return false;
     }
-    if (this->bufferSize < 9 + topicLength) {
+    if (this->bufferSize < 9 + topicLength + MQTT_PROPERTY_LENGTH_SIZE) {
         // Too long
         return false;
     }
     if (connected()) {
         uint16_t length = MQTT_MAX_HEADER_SIZE;
-        nextMsgId++;
-        if (nextMsgId == 0) {
-            nextMsgId = 1;
-        }
-        this->buffer[length++] = (nextMsgId >> 8);
-        this->buffer[length++] = (nextMsgId & 0xFF);
+        uint16_t msgId = nextPacketId();
+        this->buffer[length++] = (msgId >> 8);
+        this->buffer[length++] = (msgId & 0xFF);
+#if MQTT_VERSION == MQTT_VERSION_5
+        this->buffer[length++] = 0; // no properties
+#endif
         length = writeString(topic, this->buffer,length);
         return write(MQTTUNSUBSCRIBE|MQTTQOS1,this->buffer,length-MQTT_MAX_HEADER_SIZE);
     }
@@ -658,9 +1518,12 @@ boolean PubSubClient::unsubscribe(const char* topic) {
 }
 
 void PubSubClient::disconnect() {
+    this->connectPhase = MQTT_CONNECT_IDLE;
+    flushTx();
+    cancelTimers();
     this->buffer[0] = MQTTDISCONNECT;
     this->buffer[1] = 0;
-    _client->write(this->buffer,2);
+    writeClient(this->buffer,2);
     _state = MQTT_DISCONNECTED;
     _client->flush();
     _client->stop();
@@ -680,6 +1543,195 @@ uint16_t PubSubClient::writeString(const char* string, uint8_t* buf, uint16_t po
     return pos;
 }
 
+#if MQTT_VERSION == MQTT_VERSION_5
+static uint16_t writeVarInt(uint32_t value, uint8_t* buf, uint16_t pos) {
+    do {
+        uint8_t digit = value & 127;
+        value >>= 7;
+        if (value > 0) {
+            digit |= 0x80;
+        }
+        buf[pos++] = digit;
+    } while (value > 0);
+    return pos;
+}
+
+static uint8_t varIntSize(uint32_t value) {
+    uint8_t size = 1;
+    while (value >= 128) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+// Reads a variable byte integer; returns the position after it or NULL if malformed
+static const uint8_t* readVarInt(const uint8_t* p, const uint8_t* end, uint32_t* value) {
+    uint32_t multiplier = 1;
+    *value = 0;
+    for (uint8_t i = 0; i < 4 && p < end; i++) {
+        uint8_t digit = *p++;
+        *value += (digit & 127) * multiplier;
+        if ((digit & 128) == 0) {
+            return p;
+        }
+        multiplier <<= 7;
+    }
+    return NULL;
+}
+
+// Returns the position after the value of property id, or NULL if unknown or truncated
+static const uint8_t* skipProperty(uint8_t id, const uint8_t* p, const uint8_t* end) {
+    uint32_t size;
+    switch (id) {
+    case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+        size = 1;
+        break;
+    case 0x13: case 0x21: case 0x22: case 0x23:
+        size = 2;
+        break;
+    case 0x02: case 0x11: case 0x18: case 0x27:
+        size = 4;
+        break;
+    case 0x0B:
+        return readVarInt(p, end, &size);
+    case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F:
+        if (end - p < 2) return NULL;
+        size = 2 + ((p[0]<<8)+p[1]);
+        break;
+    case MQTT5_PROP_USER_PROPERTY:
+        if (end - p < 2) return NULL;
+        size = 2 + ((p[0]<<8)+p[1]);
+        if ((uint32_t) (end - p) < size + 2) return NULL;
+        size += 2 + ((p[size]<<8)+p[size+1]);
+        break;
+    default:
+        return NULL;
+    }
+    return ((uint32_t) (end - p) >= size) ? p + size : NULL;
+}
+
+void PubSubClient::readConnackProperties(const uint8_t* p, const uint8_t* end) {
+    uint32_t length;
+    p = readVarInt(p, end, &length);
+    if (p == NULL) {
+        return;
+    }
+    if ((uint32_t) (end - p) > length) {
+        end = p + length;
+    }
+    while (p != NULL && p < end) {
+        uint8_t id = *p++;
+        if (id == MQTT5_PROP_TOPIC_ALIAS_MAXIMUM && end - p >= 2) {
+            this->serverTopicAliasMax = (p[0]<<8)+p[1];
+        } else if (id == MQTT5_PROP_RECEIVE_MAXIMUM && end - p >= 2) {
+            // Never keep more QoS 1 publishes in flight than the broker accepts
+            uint16_t receiveMax = (p[0]<<8)+p[1];
+            if (receiveMax < this->inflightWindow) {
+                setInflightWindow(receiveMax);
+            }
+        }
+        p = skipProperty(id, p, end);
+    }
+}
+
+// Returns the alias for topic, or the one a new alias would get if there is room (isNew set), or 0 for none.
+// The new alias is only registered by publishSent()
+uint16_t PubSubClient::topicAlias(const char* topic, boolean* isNew) {
+    *isNew = false;
+    for (uint8_t i = 0; i < this->topicAliasCount; i++) {
+        if (strcmp(this->topicAliases[i], topic) == 0) {
+            return i + 1;
+        }
+    }
+    if (this->topicAliasCount >= MQTT5_MAX_TOPIC_ALIASES || this->topicAliasCount >= this->serverTopicAliasMax
+        || strlen(topic) >= MQTT5_TOPIC_ALIAS_LENGTH) {
+        return 0;
+    }
+    *isNew = true;
+    return this->topicAliasCount + 1;
+}
+#endif
+
+boolean PubSubClient::publishSent(boolean sent) {
+#if MQTT_VERSION == MQTT_VERSION_5
+    if (this->aliasPending && sent) {
+        this->topicAliasCount++;
+    }
+    this->aliasPending = false;
+#endif
+    return sent;
+}
+
+uint16_t PubSubClient::writePublishHeader(const char* topic, uint16_t msgId, const MQTTPublishProperties* props, uint16_t pos) {
+#if MQTT_VERSION == MQTT_VERSION_5
+    // QoS 1 packets may be resent on a later connection, so only QoS 0 uses aliases
+    this->aliasPending = false;
+    boolean isNew = false;
+    uint16_t alias = (msgId == 0) ? topicAlias(topic, &isNew) : 0;
+    size_t tlen = (alias && !isNew) ? 0 : strnlen(topic, this->bufferSize);
+
+    uint32_t propLength = alias ? 3 : 0;
+    if (props) {
+        if (props->contentType) {
+            propLength += 3 + strlen(props->contentType);
+        }
+        for (uint8_t i = 0; i < props->userPropertyCount; i++) {
+            propLength += 5 + strlen(props->userProperties[i].key) + strlen(props->userProperties[i].value);
+        }
+    }
+    if ((uint32_t) pos + 2 + tlen + (msgId ? 2 : 0) + varIntSize(propLength) + propLength > this->bufferSize) {
+        return 0;
+    }
+
+    if (isNew) {
+        // Kept in the first unused slot until publishSent() counts it
+        strcpy(this->topicAliases[this->topicAliasCount], topic);
+        this->aliasPending = true;
+    }
+    if (tlen == 0) {
+        // Topic replaced by its alias
+        this->buffer[pos++] = 0;
+        this->buffer[pos++] = 0;
+    } else {
+        pos = writeString(topic,this->buffer,pos);
+    }
+    if (msgId) {
+        this->buffer[pos++] = (msgId >> 8);
+        this->buffer[pos++] = (msgId & 0xFF);
+    }
+    pos = writeVarInt(propLength, this->buffer, pos);
+    if (alias) {
+        this->buffer[pos++] = MQTT5_PROP_TOPIC_ALIAS;
+        this->buffer[pos++] = (alias >> 8);
+        this->buffer[pos++] = (alias & 0xFF);
+    }
+    if (props) {
+        if (props->contentType) {
+            this->buffer[pos++] = MQTT5_PROP_CONTENT_TYPE;
+            pos = writeString(props->contentType,this->buffer,pos);
+        }
+        for (uint8_t i = 0; i < props->userPropertyCount; i++) {
+            this->buffer[pos++] = MQTT5_PROP_USER_PROPERTY;
+            pos = writeString(props->userProperties[i].key,this->buffer,pos);
+            pos = writeString(props->userProperties[i].value,this->buffer,pos);
+        }
+    }
+    return pos;
+#else
+    (void) props;
+    if (pos + 2 + strnlen(topic, this->bufferSize) + (msgId ? 2 : 0) > this->bufferSize) {
+        return 0;
+    }
+    pos = writeString(topic,this->buffer,pos);
+    if (msgId) {
+        this->buffer[pos++] = (msgId >> 8);
+        this->buffer[pos++] = (msgId & 0xFF);
+    }
+    return pos;
+#endif
+}
+
 
 boolean PubSubClient::connected() {
     boolean rc;
@@ -690,6 +1742,7 @@ boolean PubSubClient::connected() {
         if (!rc) {
             if (this->_state == MQTT_CONNECTED) {
                 this->_state = MQTT_CONNECTION_LOST;
+                MQTT_METRIC(this->metrics.connectionsLost++;)
                 _client->flush();
                 _client->stop();
             }
@@ -728,6 +1781,35 @@ PubSubClient& PubSubClient::setClient(Client& client){
     return *this;
 }
 
+PubSubClient& PubSubClient::setStreamCallback(MQTT_STREAM_CALLBACK_SIGNATURE) {
+    this->streamCallback = streamCallback;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setPublishCallback(MQTT_PUBLISH_CALLBACK_SIGNATURE) {
+    this->publishCallback = publishCallback;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setInflightWindow(uint8_t window) {
+    if (window < 1) {
+        window = 1;
+    } else if (window > MQTT_MAX_INFLIGHT) {
+        window = MQTT_MAX_INFLIGHT;
+    }
+    this->inflightWindow = window;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setRetransmitTimeout(uint16_t timeout) {
+    this->retransmitTimeout = timeout;
+    return *this;
+}
+
+uint8_t PubSubClient::getInflightCount() {
+    return this->inflightCount;
+}
+
 PubSubClient& PubSubClient::setStream(Stream& stream){
     this->stream = &stream;
     return *this;
@@ -737,13 +1819,33 @@ int PubSubClient::state() {
     return this->_state;
 }
 
+unsigned long PubSubClient::keepAliveDeadline() {
+    unsigned long last = (long) (lastInActivity - lastOutActivity) < 0 ? lastInActivity : lastOutActivity;
+    return last + this->keepAlive*1000UL + 1;
+}
+
+#ifdef MQTT_METRICS
+void PubSubClient::getMetrics(MQTTMetrics* snapshot) {
+    memcpy(snapshot, &this->metrics, sizeof(MQTTMetrics));
+}
+
+void PubSubClient::resetMetrics() {
+    memset(&this->metrics, 0, sizeof(MQTTMetrics));
+}
+#endif
+
+uint8_t PubSubClient::lastReasonCode() {
+    return this->reasonCode;
+}
+
 boolean PubSubClient::setBufferSize(uint16_t size) {
     if (size == 0) {
         // Cannot set it back to 0
         return false;
     }
-    if (this->bufferSize == 0) {
+    if (this->bufferSize == 0 || this->bufferExternal) {
         this->buffer = (uint8_t*)malloc(size);
+        this->bufferExternal = false;
     } else {
         uint8_t* newBuffer = (uint8_t*)realloc(this->buffer, size);
         if (newBuffer != NULL) {
@@ -756,6 +1858,19 @@ boolean PubSubClient::setBufferSize(uint16_t size) {
     return (this->buffer != NULL);
 }
 
+boolean PubSubClient::setBuffer(uint8_t* buffer, uint16_t size) {
+    if (buffer == NULL || size == 0) {
+        return false;
+    }
+    if (this->bufferSize != 0 && !this->bufferExternal) {
+        free(this->buffer);
+    }
+    this->buffer = buffer;
+    this->bufferSize = size;
+    this->bufferExternal = true;
+    return true;
+}
+
 uint16_t PubSubClient::getBufferSize() {
     return this->bufferSize;
 }
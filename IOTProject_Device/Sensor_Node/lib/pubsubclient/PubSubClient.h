@@ -11,12 +11,15 @@
 #include "IPAddress.h"
 #include "Client.h"
 #include "Stream.h"
+#include "MQTTTimerWheel.h"
 
 #define MQTT_VERSION_3_1      3
 #define MQTT_VERSION_3_1_1    4
+#define MQTT_VERSION_5        5
 
 // MQTT_VERSION : Pick the version
 //#define MQTT_VERSION MQTT_VERSION_3_1
+//#define MQTT_VERSION MQTT_VERSION_5
 #ifndef MQTT_VERSION
 #define MQTT_VERSION MQTT_VERSION_3_1_1
 #endif
@@ -36,12 +39,66 @@
 #define MQTT_SOCKET_TIMEOUT 15
 #endif
 
+// MQTT_MAX_INFLIGHT : Maximum number of unacknowledged QoS 1 publishes. Narrow with setInflightWindow()
+#ifndef MQTT_MAX_INFLIGHT
+#define MQTT_MAX_INFLIGHT 32
+#endif
+
+// MQTT_RETRANSMIT_TIMEOUT : Seconds before an unacknowledged QoS 1 publish is resent with DUP set
+#ifndef MQTT_RETRANSMIT_TIMEOUT
+#define MQTT_RETRANSMIT_TIMEOUT 10
+#endif
+
+// MQTT_MAX_RETRANSMITS : Resends before a QoS 1 publish is reported as failed
+#ifndef MQTT_MAX_RETRANSMITS
+#define MQTT_MAX_RETRANSMITS 3
+#endif
+
+#if MQTT_VERSION == MQTT_VERSION_5
+// MQTT5_MAX_TOPIC_ALIASES : outgoing topic aliases remembered per connection
+#ifndef MQTT5_MAX_TOPIC_ALIASES
+#define MQTT5_MAX_TOPIC_ALIASES 4
+#endif
+
+// MQTT5_TOPIC_ALIAS_LENGTH : longest topic (including terminator) that gets an alias
+#ifndef MQTT5_TOPIC_ALIAS_LENGTH
+#define MQTT5_TOPIC_ALIAS_LENGTH 64
+#endif
+
+// MQTT5_SESSION_EXPIRY : seconds the broker keeps a session connected with cleanSession = false
+#ifndef MQTT5_SESSION_EXPIRY
+#define MQTT5_SESSION_EXPIRY 3600
+#endif
+#endif
+
+// MQTT_COALESCE_DELAY : default milliseconds a coalesced publish may wait before it is sent
+#ifndef MQTT_COALESCE_DELAY
+#define MQTT_COALESCE_DELAY 50
+#endif
+
+// MQTT_METRICS : define to keep traffic counters and latency histograms, read with getMetrics()
+//#define MQTT_METRICS
+
+#ifdef MQTT_METRICS
+// MQTT_METRICS_BUCKETS : latency histogram buckets. Bucket i counts samples below 2^i ms,
+//  the last bucket everything slower
+#ifndef MQTT_METRICS_BUCKETS
+#define MQTT_METRICS_BUCKETS 12
+#endif
+#endif
+
+// MQTT_RX_CHUNK_SIZE : stack scratch used to drain bytes of packets that do not fit in the buffer
+#ifndef MQTT_RX_CHUNK_SIZE
+#define MQTT_RX_CHUNK_SIZE 64
+#endif
+
 // MQTT_MAX_TRANSFER_SIZE : limit how much data is passed to the network client
 //  in each write call. Needed for the Arduino Wifi Shield. Leave undefined to
 //  pass the entire MQTT packet in each write call.
 //#define MQTT_MAX_TRANSFER_SIZE 80
 
 // Possible values for client.state()
+#define MQTT_CONNECTING             -5
 #define MQTT_CONNECTION_TIMEOUT     -4
 #define MQTT_CONNECTION_LOST        -3
 #define MQTT_CONNECT_FAILED         -2
@@ -72,24 +129,113 @@
 #define MQTTQOS0        (0 << 1)
 #define MQTTQOS1        (1 << 1)
 #define MQTTQOS2        (2 << 1)
+#define MQTTDUP         (1 << 3)
+
+// Returned by msUntilNextTimer() when no timer is armed
+#define MQTT_NO_TIMER ((unsigned long) -1)
 
 // Maximum size of fixed header and variable length size header
 #define MQTT_MAX_HEADER_SIZE 5
 
+// Bytes of the empty property length SUBSCRIBE and UNSUBSCRIBE carry in MQTT 5
+#if MQTT_VERSION == MQTT_VERSION_5
+#define MQTT_PROPERTY_LENGTH_SIZE 1
+#else
+#define MQTT_PROPERTY_LENGTH_SIZE 0
+#endif
+
+// MQTT 5 property identifiers
+#define MQTT5_PROP_CONTENT_TYPE         0x03
+#define MQTT5_PROP_SESSION_EXPIRY       0x11
+#define MQTT5_PROP_RECEIVE_MAXIMUM      0x21
+#define MQTT5_PROP_TOPIC_ALIAS_MAXIMUM  0x22
+#define MQTT5_PROP_TOPIC_ALIAS          0x23
+#define MQTT5_PROP_USER_PROPERTY        0x26
+
 #if defined(ESP8266) || defined(ESP32)
 #include <functional>
 #define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+#define MQTT_PUBLISH_CALLBACK_SIGNATURE std::function<void(uint16_t, boolean)> publishCallback
+#define MQTT_STREAM_CALLBACK_SIGNATURE std::function<void(const char*, uint32_t, const uint8_t*, unsigned int, uint32_t)> streamCallback
 #else
 #define MQTT_CALLBACK_SIGNATURE void (*callback)(char*, uint8_t*, unsigned int)
+#define MQTT_PUBLISH_CALLBACK_SIGNATURE void (*publishCallback)(uint16_t, boolean)
+#define MQTT_STREAM_CALLBACK_SIGNATURE void (*streamCallback)(const char*, uint32_t, const uint8_t*, unsigned int, uint32_t)
 #endif
 
 #define CHECK_STRING_LENGTH(l,s) if (l+2+strnlen(s, this->bufferSize) > this->bufferSize) {_client->stop();return false;}
 
+// An unacknowledged QoS 1 publish, kept as the complete packet for retransmission
+struct MQTTInflight {
+   uint16_t msgId;
+   uint16_t length;
+   uint8_t* packet;
+   unsigned long sentAt;
+   uint8_t retries;
+#ifdef MQTT_METRICS
+   unsigned long queuedAt;
+#endif
+};
+
+#if MQTT_VERSION == MQTT_VERSION_5
+// MQTT 5 user property (key/value UTF-8 pair)
+struct MQTTUserProperty {
+   const char* key;
+   const char* value;
+};
+
+// Optional MQTT 5 PUBLISH properties
+struct MQTTPublishProperties {
+   const char* contentType;
+   const MQTTUserProperty* userProperties;
+   uint8_t userPropertyCount;
+};
+#else
+struct MQTTPublishProperties;
+#endif
+
+#ifdef MQTT_METRICS
+// Fixed-bucket latency histogram in milliseconds
+struct MQTTHistogram {
+   uint32_t count;
+   uint32_t sum;
+   uint32_t max;
+   uint32_t buckets[MQTT_METRICS_BUCKETS];
+};
+
+// Counters are plain 32-bit words written only by the task running the client,
+// so another task can take a snapshot without locking
+struct MQTTMetrics {
+   uint32_t connects;          // CONNACK accepted
+   uint32_t connectFailures;   // TCP, CONNECT write, CONNACK refused or timed out
+   uint32_t connectionsLost;   // socket closed under a connected session
+   uint32_t timeouts;          // missing PINGRESP or a stalled packet
+   uint32_t bytesIn;
+   uint32_t bytesOut;
+   uint32_t packetsIn;
+   uint32_t droppedOversize;   // incoming packets larger than the buffer
+   uint32_t retransmits;       // QoS 1 publishes resent with DUP
+   uint32_t publishFailures;   // QoS 1 publishes given up
+   MQTTHistogram pingRtt;
+   MQTTHistogram publishLatency;  // QoS 1 publish to PUBACK
+};
+#define MQTT_METRIC(x) x
+#else
+#define MQTT_METRIC(x)
+#endif
+
+// One payload fragment for publishv()
+struct MQTTIOVec {
+   const void* base;
+   size_t len;
+};
+
 class PubSubClient : public Print {
 private:
    Client* _client;
    uint8_t* buffer;
    uint16_t bufferSize;
+   boolean bufferExternal;  // buffer belongs to the caller of setBuffer()
    uint16_t keepAlive;
    uint16_t socketTimeout;
    uint16_t nextMsgId;
@@ -97,21 +243,107 @@ private:
    unsigned long lastInActivity;
    bool pingOutstanding;
    MQTT_CALLBACK_SIGNATURE;
-   uint32_t readPacket(uint8_t*);
-   boolean readByte(uint8_t * result);
-   boolean readByte(uint8_t * result, uint16_t * index);
+   MQTT_PUBLISH_CALLBACK_SIGNATURE;
+   MQTT_STREAM_CALLBACK_SIGNATURE;
+   MQTTInflight inflight[MQTT_MAX_INFLIGHT];
+   uint8_t inflightCount;
+   uint8_t inflightWindow;
+   uint16_t retransmitTimeout;
+   uint16_t nextPacketId();
+   void completeInflight(MQTTInflight* slot, boolean delivered);
+   void retransmitInflight(unsigned long t, boolean force);
+   // Incremental receive state, kept across loop() calls so a packet may arrive in pieces
+   uint8_t rxState;
+   uint8_t rxLengthLength;
+   uint16_t rxLen;          // bytes of the packet stored in buffer
+   uint32_t rxRemaining;    // remaining length from the fixed header
+   uint32_t rxMultiplier;
+   uint32_t rxBody;         // bytes of the remaining length consumed so far
+   uint32_t rxSkip;         // PUBLISH: topic (+ msg id, + MQTT 5 properties) bytes in front of the payload
+   uint8_t rxProperties;    // MQTT 5 PUBLISH: still reading the property length
+   uint32_t rxPropertyLength;
+   uint32_t rxPropertyMultiplier;
+   uint8_t rxStreaming;     // PUBLISH delivered through streamCallback
+   uint16_t rxPayloadBase;  // streamed PUBLISH: buffer offset of the payload window
+   uint16_t rxMsgId;        // streamed PUBLISH: msg id for the PUBACK
+   unsigned long rxLastActivity;
+   // Timed work, kept in a timer wheel so loop() does no per-call deadline checks.
+   // Activity only updates timestamps; a timer that fires early re-arms itself for the real deadline
+   MQTTTimer keepAliveTimer;   // PINGREQ, or the PINGRESP timeout
+   MQTTTimer socketTimer;      // CONNACK wait, stalled partial packet
+   MQTTTimer retransmitTimer;  // oldest unacknowledged QoS 1 publish
+   MQTTTimer flushTimer;       // latency bound of coalesced publishes
+   MQTTTimerWheel* ownTimers;  // allocated on the first connect, unless an owner shared its wheel with setTimerWheel() before
+   MQTTTimerWheel* timers;     // NULL until the client has a wheel, only armed while connecting or connected
+   void initTimers();
+   boolean ensureTimers();
+   void cancelTimers();
+   void armRetransmit();
+   void onTimer(MQTTTimer* timer);
+   static void fireTimer(MQTTTimer* timer);
+   // Parses whatever the client has buffered without blocking
+   // Returns 1 with the packet in buffer, 0 if more bytes are needed, -1 if the packet was invalid
+   int8_t pollPacket(uint8_t* lengthLength, uint32_t* length);
    boolean write(uint8_t header, uint8_t* buf, uint16_t length);
+   // Every byte to the network goes through here
+   size_t writeClient(const uint8_t* buf, size_t size) {
+      size_t rc = _client->write(buf, size);
+      MQTT_METRIC(this->metrics.bytesOut += rc;)
+      return rc;
+   }
+#ifdef MQTT_METRICS
+   MQTTMetrics metrics;
+   unsigned long pingSentAt;
+#endif
    uint16_t writeString(const char* string, uint8_t* buf, uint16_t pos);
+   // Writes the PUBLISH variable header (topic, msg id when non-zero, MQTT 5 properties)
+   // at pos. Returns the new position, or 0 if it does not fit the buffer
+   uint16_t writePublishHeader(const char* topic, uint16_t msgId, const MQTTPublishProperties* props, uint16_t pos);
+   // Registers the alias the last writePublishHeader() introduced if its packet was sent, drops it otherwise
+   boolean publishSent(boolean sent);
+   uint32_t publishRemaining;  // payload bytes beginPublish() still expects from write()
+   // Publishes held back by setCoalescing(), sent as one client write
+   uint8_t* txBuffer;
+   uint16_t txSize;
+   uint16_t txLength;
+   uint16_t txDelay;
+   boolean coalesce(uint8_t header, uint16_t length);
+   boolean flushTx();
+   boolean publishWithProperties(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained, const MQTTPublishProperties* props);
+   uint8_t reasonCode;
+#if MQTT_VERSION == MQTT_VERSION_5
+   // Outgoing topic aliases of this connection; alias n is topicAliases[n-1]
+   char topicAliases[MQTT5_MAX_TOPIC_ALIASES][MQTT5_TOPIC_ALIAS_LENGTH];
+   uint8_t topicAliasCount;
+   uint16_t serverTopicAliasMax;
+   // A new alias only counts once the packet introducing it reached the client, otherwise
+   // later publishes would send the bare alias to a broker that never learned its topic
+   boolean aliasPending;    // writePublishHeader() introduced topicAliases[topicAliasCount]
+   uint8_t txAliasCount;    // topicAliasCount before the first publish held in txBuffer
+   uint16_t topicAlias(const char* topic, boolean* isNew);
+   void readConnackProperties(const uint8_t* p, const uint8_t* end);
+#endif
    // Build up the header ready to send
    // Returns the size of the header
    // Note: the header is built at the end of the first MQTT_MAX_HEADER_SIZE bytes, so will start
    //       (MQTT_MAX_HEADER_SIZE - <returned size>) bytes into the buffer
-   size_t buildHeader(uint8_t header, uint8_t* buf, uint16_t length);
+   size_t buildHeader(uint8_t header, uint8_t* buf, uint32_t length);
    IPAddress ip;
    const char* domain;
    uint16_t port;
    Stream* stream;
    int _state;
+   // Arguments held by beginConnect() until the CONNECT packet is sent
+   uint8_t connectPhase;
+   const char* connectId;
+   const char* connectUser;
+   const char* connectPass;
+   const char* connectWillTopic;
+   uint8_t connectWillQos;
+   boolean connectWillRetain;
+   const char* connectWillMessage;
+   boolean connectCleanSession;
+   boolean sendConnect();
 public:
    PubSubClient();
    PubSubClient(Client& client);
@@ -134,12 +366,33 @@ public:
    PubSubClient& setServer(uint8_t * ip, uint16_t port);
    PubSubClient& setServer(const char * domain, uint16_t port);
    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+   // Deliver incoming publishes in fragments instead of buffering them whole, so payloads
+   // larger than the buffer are not dropped. Called as (topic, offset, data, len, total):
+   // first once with data NULL and len 0 when the topic is known, then for each fragment
+   // as it arrives. offset + len == total marks the last call. Replaces callback while set.
+   PubSubClient& setStreamCallback(MQTT_STREAM_CALLBACK_SIGNATURE);
    PubSubClient& setClient(Client& client);
    PubSubClient& setStream(Stream& stream);
    PubSubClient& setKeepAlive(uint16_t keepAlive);
    PubSubClient& setSocketTimeout(uint16_t timeout);
+   // Called with (msgId, delivered) when a QoS 1 publish is acknowledged or given up
+   PubSubClient& setPublishCallback(MQTT_PUBLISH_CALLBACK_SIGNATURE);
+   // Number of QoS 1 publishes allowed in flight, 1..MQTT_MAX_INFLIGHT
+   PubSubClient& setInflightWindow(uint8_t window);
+   PubSubClient& setRetransmitTimeout(uint16_t timeout);
+   uint8_t getInflightCount();
 
    boolean setBufferSize(uint16_t size);
+   // Hold QoS 0 publishes in a send buffer of size bytes and write them together when it
+   // is full, maxDelay ms after the first one, on flush(), or before any other packet.
+   // Cuts TCP segments for bursts of small messages. size 0 sends every publish at once.
+   // publish() then only reports whether the message was queued
+   boolean setCoalescing(uint16_t size, uint16_t maxDelay = MQTT_COALESCE_DELAY);
+   // Send coalesced publishes now
+   virtual void flush();
+   // Use a caller-owned buffer (e.g. a slice of a shared arena) instead of a heap allocation.
+   // It must outlive the client; setBufferSize() switches back to an owned buffer
+   boolean setBuffer(uint8_t* buffer, uint16_t size);
    uint16_t getBufferSize();
 
    boolean connect(const char* id);
@@ -147,13 +400,32 @@ public:
    boolean connect(const char* id, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage);
    boolean connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage);
    boolean connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage, boolean cleanSession);
+   // Start a connection without blocking; advance it with pollConnect() (or loop()).
+   // The strings must stay valid until the CONNECT packet has been sent.
+   // Returns 0 if already connected or a connect is in progress
+   boolean beginConnect(const char* id, const char* user, const char* pass, const char* willTopic = NULL, uint8_t willQos = 0, boolean willRetain = 0, const char* willMessage = NULL, boolean cleanSession = 1);
+   // Advance a connect started with beginConnect()
+   // Returns 1 once connected, 0 while still in progress, -1 on failure (see state())
+   // Note: the TCP step is only as non-blocking as the underlying Client::connect()
+   int pollConnect();
    void disconnect();
    boolean publish(const char* topic, const char* payload);
    boolean publish(const char* topic, const char* payload, boolean retained);
    boolean publish(const char* topic, const uint8_t * payload, unsigned int plength);
    boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained);
+#if MQTT_VERSION == MQTT_VERSION_5
+   // Publish with MQTT 5 properties such as a content type or user properties
+   boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained, const MQTTPublishProperties& props);
+#endif
+   // Queue a QoS 1 publish; it is resent until PUBACK arrives and then reported to the publish callback
+   // Returns the message id, or 0 if not connected, the window is full or the packet does not fit
+   uint16_t publishQos1(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained);
    boolean publish_P(const char* topic, const char* payload, boolean retained);
    boolean publish_P(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained);
+   // Publish a payload made of count fragments without copying it into the buffer.
+   // Only the fixed header and topic are built in the buffer; each fragment is written
+   // straight to the client. Returns 1 if every byte was written
+   boolean publishv(const char* topic, const MQTTIOVec* iov, uint8_t count, boolean retained);
    // Start to publish a message.
    // This API:
    //   beginPublish(...)
@@ -165,6 +437,7 @@ public:
    boolean beginPublish(const char* topic, unsigned int plength, boolean retained);
    // Finish off this publish message (started with beginPublish)
    // Returns 1 if the packet was sent successfully, 0 if there was an error
+   // or fewer payload bytes were written than beginPublish() announced
    int endPublish();
    // Write a single byte of payload (only to be used with beginPublish/endPublish)
    virtual size_t write(uint8_t);
@@ -177,6 +450,29 @@ public:
    boolean loop();
    boolean connected();
    int state();
+   // millis() value after which loop() has keepalive work (a PINGREQ or a ping timeout)
+   unsigned long keepAliveDeadline();
+   // Keep the timers in wheel instead of the client's own, so an owner of several clients
+   // (e.g. PubSubClientPool) runs all of them, and its own timers, from one wheel. Armed timers
+   // move over. The wheel must outlive the client; NULL returns to the client's own wheel.
+   // A client is only given its own wheel when it first connects, one that was handed a shared
+   // wheel before (as PubSubClientPool does) never allocates one.
+   // Every client sharing a wheel must be used from the task that runs it
+   PubSubClient& setTimerWheel(MQTTTimerWheel* wheel);
+   // Fire the due keepalive, socket timeout and retransmit timers of the client's wheel,
+   // including those of other clients sharing it. loop() calls this
+   void runTimers();
+   // Milliseconds until the next timer of the client's wheel is due, or MQTT_NO_TIMER if none is armed.
+   // Lets the caller sleep (e.g. ulTaskNotifyTake) instead of polling loop(); to be woken by a
+   // hardware timer instead, see MQTTTimerWheel::setWakeCallback()
+   unsigned long msUntilNextTimer();
+#ifdef MQTT_METRICS
+   // Copy the counters and histograms gathered since construction or resetMetrics()
+   void getMetrics(MQTTMetrics* snapshot);
+   void resetMetrics();
+#endif
+   // Reason code of the last CONNACK or PUBACK (MQTT 5: 0x80 and above are failures)
+   uint8_t lastReasonCode();
 
 };
 
@@ -0,0 +1,223 @@
+/*
+ PubSubClientPool.cpp - Several MQTT sessions, one per access token, sharing
+  one buffer arena. One timer wheel runs the idle expiry and the clients' keepalives.
+*/
+
+#include "PubSubClientPool.h"
+
+PubSubClientPool::PubSubClientPool() {
+    this->sessionCount = 0;
+    this->arena = NULL;
+    this->bufferSize = 0;
+    this->domain = NULL;
+    this->port = 0;
+    this->idPrefix = "ESP32Client";
+    setIdleTimeout(MQTT_POOL_IDLE_TIMEOUT);
+    setRetryInterval(MQTT_POOL_RETRY_INTERVAL);
+}
+
+PubSubClientPool::~PubSubClientPool() {
+    for (uint8_t i = 0; i < this->sessionCount; i++) {
+        release(&this->sessions[i]);
+    }
+    free(this->arena);
+}
+
+boolean PubSubClientPool::addClient(Client& client) {
+    if (this->sessionCount >= MQTT_POOL_SIZE) {
+        return false;
+    }
+    MQTTPoolSession* s = &this->sessions[this->sessionCount];
+    s->net = &client;
+    s->pool = this;
+    s->mqtt.setClient(client);
+    s->mqtt.setTimerWheel(&this->wheel);
+    s->token[0] = '\0';
+    snprintf(s->id, sizeof(s->id), "%s-%u", this->idPrefix, this->sessionCount);
+    MQTTTimerWheel::init(&s->timer, s, onIdleTimer);
+    if (this->domain) {
+        s->mqtt.setServer(this->domain, this->port);
+    }
+    if (this->arena) {
+        s->mqtt.setBuffer(this->arena + (size_t) this->bufferSize * this->sessionCount, this->bufferSize);
+    }
+    this->sessionCount++;
+    return true;
+}
+
+PubSubClientPool& PubSubClientPool::setServer(const char* domain, uint16_t port) {
+    this->domain = domain;
+    this->port = port;
+    for (uint8_t i = 0; i < this->sessionCount; i++) {
+        this->sessions[i].mqtt.setServer(domain, port);
+    }
+    return *this;
+}
+
+PubSubClientPool& PubSubClientPool::setClientIdPrefix(const char* prefix) {
+    this->idPrefix = prefix;
+    for (uint8_t i = 0; i < this->sessionCount; i++) {
+        snprintf(this->sessions[i].id, sizeof(this->sessions[i].id), "%s-%u", prefix, i);
+    }
+    return *this;
+}
+
+PubSubClientPool& PubSubClientPool::setIdleTimeout(uint16_t seconds) {
+    this->idleTimeout = seconds;
+    return *this;
+}
+
+PubSubClientPool& PubSubClientPool::setRetryInterval(uint16_t ms) {
+    this->retryInterval = ms;
+    return *this;
+}
+
+boolean PubSubClientPool::setBufferSize(uint16_t size) {
+    if (size == 0) {
+        return false;
+    }
+    for (uint8_t i = 0; i < this->sessionCount; i++) {
+        if (this->sessions[i].token[0] != '\0') {
+            // Buffers cannot move under a live session
+            return false;
+        }
+    }
+    uint8_t* newArena = (uint8_t*)realloc(this->arena, (size_t) size * MQTT_POOL_SIZE);
+    if (newArena == NULL) {
+        return false;
+    }
+    this->arena = newArena;
+    this->bufferSize = size;
+    for (uint8_t i = 0; i < this->sessionCount; i++) {
+        this->sessions[i].mqtt.setBuffer(this->arena + (size_t) size * i, size);
+    }
+    return true;
+}
+
+MQTTPoolSession* PubSubClientPool::find(const char* token) {
+    for (uint8_t i = 0; i < this->sessionCount; i++) {
+        if (strcmp(this->sessions[i].token, token) == 0) {
+            return &this->sessions[i];
+        }
+    }
+    return NULL;
+}
+
+MQTTPoolSession* PubSubClientPool::leastRecentlyUsed() {
+    MQTTPoolSession* lru = NULL;
+    unsigned long t = millis();
+    for (uint8_t i = 0; i < this->sessionCount; i++) {
+        MQTTPoolSession* s = &this->sessions[i];
+        if (s->token[0] == '\0') {
+            return s;
+        }
+        if (lru == NULL || t - s->lastUsed > t - lru->lastUsed) {
+            lru = s;
+        }
+    }
+    return lru;
+}
+
+void PubSubClientPool::release(MQTTPoolSession* s) {
+    this->wheel.cancel(&s->timer);
+    if (s->token[0] != '\0') {
+        s->mqtt.disconnect();
+        s->token[0] = '\0';
+    }
+}
+
+void PubSubClientPool::release(const char* token) {
+    MQTTPoolSession* s = find(token);
+    if (s) {
+        release(s);
+    }
+}
+
+PubSubClient* PubSubClientPool::acquire(const char* token) {
+    if (token == NULL || token[0] == '\0' || strlen(token) >= MQTT_POOL_TOKEN_LENGTH) {
+        return NULL;
+    }
+    MQTTPoolSession* s = find(token);
+    if (s == NULL) {
+        s = leastRecentlyUsed();
+        if (s == NULL) {
+            return NULL;
+        }
+        release(s);
+        strcpy(s->token, token);
+        s->lastAttempt = millis() - this->retryInterval;
+    }
+    unsigned long t = millis();
+    s->lastUsed = t;
+    int state = s->mqtt.state();
+    if (state != MQTT_CONNECTED && state != MQTT_CONNECTING && t - s->lastAttempt >= this->retryInterval) {
+        // New slot, or the session dropped since it was last used
+        s->lastAttempt = t;
+        s->mqtt.beginConnect(s->id, s->token, NULL);
+    }
+    reschedule(s);
+    return &s->mqtt;
+}
+
+void PubSubClientPool::reschedule(MQTTPoolSession* s) {
+    if (s->token[0] == '\0') {
+        return;
+    }
+    // Keepalives are the client's own timers; the pool only tracks idle expiry
+    if (this->idleTimeout == 0) {
+        this->wheel.cancel(&s->timer);
+        return;
+    }
+    this->wheel.schedule(&s->timer, s->lastUsed + this->idleTimeout*1000UL);
+}
+
+void PubSubClientPool::onIdleTimer(MQTTTimer* timer) {
+    MQTTPoolSession* s = (MQTTPoolSession*) timer->owner;
+    if (millis() - s->lastUsed >= s->pool->idleTimeout*1000UL) {
+        s->pool->release(s);
+    } else {
+        s->pool->reschedule(s);
+    }
+}
+
+void PubSubClientPool::loop() {
+    for (uint8_t i = 0; i < this->sessionCount; i++) {
+        MQTTPoolSession* s = &this->sessions[i];
+        if (s->token[0] == '\0') {
+            continue;
+        }
+        // Only sessions with something to read or a connect to advance are polled
+        if (s->mqtt.state() == MQTT_CONNECTING || (s->mqtt.connected() && s->net->available())) {
+            s->mqtt.loop();
+        }
+    }
+    // Idle expiry, keepalives, socket timeouts and retransmits of every session
+    this->wheel.run(millis());
+}
+
+unsigned long PubSubClientPool::msUntilNextTimer() {
+    unsigned long expires;
+    if (!this->wheel.nextExpiry(&expires)) {
+        return MQTT_NO_TIMER;
+    }
+    long wait = (long) (expires - millis());
+    return (wait > 0) ? wait : 0;
+}
+
+void PubSubClientPool::setWakeCallback(MQTTWakeCallback wake, void* arg) {
+    this->wheel.setWakeCallback(wake, arg);
+}
+
+uint8_t PubSubClientPool::activeSessions() {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < this->sessionCount; i++) {
+        if (this->sessions[i].token[0] != '\0') {
+            n++;
+        }
+    }
+    return n;
+}
+
+size_t PubSubClientPool::sessionFootprint() {
+    return sizeof(MQTTPoolSession) + this->bufferSize;
+}
@@ -0,0 +1,99 @@
+/*
+ PubSubClientPool.h - Several MQTT sessions, one per access token, sharing
+  one buffer arena. One timer wheel runs the idle expiry and the clients' keepalives.
+*/
+
+#ifndef PubSubClientPool_h
+#define PubSubClientPool_h
+
+#include <Arduino.h>
+#include "PubSubClient.h"
+#include "MQTTTimerWheel.h"
+
+// MQTT_POOL_SIZE : maximum number of concurrent sessions
+#ifndef MQTT_POOL_SIZE
+#define MQTT_POOL_SIZE 4
+#endif
+
+// MQTT_POOL_TOKEN_LENGTH : longest access token (including terminator)
+#ifndef MQTT_POOL_TOKEN_LENGTH
+#define MQTT_POOL_TOKEN_LENGTH 50
+#endif
+
+// MQTT_POOL_IDLE_TIMEOUT : seconds a session may go unused before it is closed, 0 to keep it
+#ifndef MQTT_POOL_IDLE_TIMEOUT
+#define MQTT_POOL_IDLE_TIMEOUT 300
+#endif
+
+// MQTT_POOL_RETRY_INTERVAL : milliseconds between connect attempts of one session
+#ifndef MQTT_POOL_RETRY_INTERVAL
+#define MQTT_POOL_RETRY_INTERVAL 1000
+#endif
+
+class PubSubClientPool;
+
+// One pooled session: the client, its socket and the token it authenticated with
+struct MQTTPoolSession {
+   PubSubClient mqtt;
+   Client* net;
+   PubSubClientPool* pool;
+   MQTTTimer timer;        // idle expiry
+   unsigned long lastUsed;
+   unsigned long lastAttempt;
+   char token[MQTT_POOL_TOKEN_LENGTH];   // empty when the slot is free
+   char id[16];
+};
+
+class PubSubClientPool {
+private:
+   // Runs the timers of every session's client as well; declared first so it outlives them
+   MQTTTimerWheel wheel;
+   MQTTPoolSession sessions[MQTT_POOL_SIZE];
+   uint8_t sessionCount;
+   uint8_t* arena;
+   uint16_t bufferSize;
+   uint16_t idleTimeout;
+   uint16_t retryInterval;
+   const char* domain;
+   uint16_t port;
+   const char* idPrefix;
+   MQTTPoolSession* find(const char* token);
+   MQTTPoolSession* leastRecentlyUsed();
+   void release(MQTTPoolSession* s);
+   void reschedule(MQTTPoolSession* s);
+   static void onIdleTimer(MQTTTimer* timer);
+public:
+   PubSubClientPool();
+   ~PubSubClientPool();
+
+   // Add the network client of one session slot; up to MQTT_POOL_SIZE
+   boolean addClient(Client& client);
+   PubSubClientPool& setServer(const char* domain, uint16_t port);
+   // Client ids are the prefix followed by the slot number
+   PubSubClientPool& setClientIdPrefix(const char* prefix);
+   PubSubClientPool& setIdleTimeout(uint16_t seconds);
+   PubSubClientPool& setRetryInterval(uint16_t ms);
+   // Carve every session buffer out of one allocation of size bytes per slot.
+   // Only possible while no session is open
+   boolean setBufferSize(uint16_t size);
+
+   // Session for token, connecting it (and evicting the least recently used
+   // session if every slot is taken) when there is none yet.
+   // The returned client may still be connecting; check connected() before publishing.
+   // Returns NULL if no slot has a network client or the token is too long
+   PubSubClient* acquire(const char* token);
+   // Close the session of token, if any
+   void release(const char* token);
+   // Advance connects, read sockets with data and run due timers
+   void loop();
+   // Milliseconds until the next timer of any session is due, or MQTT_NO_TIMER if none is armed
+   unsigned long msUntilNextTimer();
+   // Wake the task running the pool from one hardware timer, see MQTTTimerWheel::setWakeCallback()
+   void setWakeCallback(MQTTWakeCallback wake, void* arg);
+
+   uint8_t activeSessions();
+   // Bytes held by one session while idle: slot, client object and buffer
+   size_t sessionFootprint();
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include "SHT31.h"
 #include "esp_now.h"
 #include "BH1750.h"
+#include "AdaptiveSampling.h"
 #include "esp_wifi.h"
 
 // DHT dht(DHTPIN, DHTTYPE);
@@ -28,6 +29,10 @@ typedef struct struct_message {
     float temperature;
     float humidity;
     float light_level;
+    uint32_t interval_ms; // time waited since the previous sample
+    uint32_t capture_ms;  // node millis() when the sensors were read
+    uint32_t send_ms;     // node millis() when this copy of the frame was sent
+    uint32_t rtt_ms;      // send-to-ACK time of the previous delivered frame
 } struct_message;
 
 struct_message myData;
@@ -41,6 +46,11 @@ ack_message ackData;
 // Counter variable to keep track of number of sent packets
 int counter = 0;
 esp_now_peer_info_t peerInfo;
+// Link round-trip of the last delivered frame, reported to the gateway for clock alignment
+volatile uint32_t lastRtt = 0;
+
+// Adaptive sampling: shrink the interval while the signal moves, back off while it is stable
+adaptive_sampler sampler;
 
 void printMAC(const uint8_t * mac_addr){
   char macStr[18];
@@ -53,6 +63,7 @@ void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
   Serial.print("\r\nLast Packet Send Status:\t");
   Serial.println(status == ESP_NOW_SEND_SUCCESS ? "Delivery Success" : "Delivery Fail");
   if (status == ESP_NOW_SEND_SUCCESS) {
+    lastRtt = millis() - myData.send_ms;
     ackData.counter = myData.counter; // Update ackData with the current counter
   }
 }
@@ -156,8 +167,10 @@ void read_sht30(void *pvParameters){
 }
 
 void ESP_NOW_task(void *pvParameters) {
+  uint32_t waited = 0;
   while(1){
     dht20.read();
+    myData.capture_ms = millis();
     myData.counter = counter++;
     myData.temperature = dht20.getTemperature();
     myData.humidity = dht20.getHumidity();
@@ -170,10 +183,13 @@ void ESP_NOW_task(void *pvParameters) {
       Serial.printf("Humidity: %f\n", myData.humidity);
       Serial.printf("Light Level: %f\n", myData.light_level);
     }
+    myData.interval_ms = waited;
 
     // Send message via ESP-NOW
     // Wait for acknowledgment
     while(myData.counter != ackData.counter) {
+      myData.rtt_ms = lastRtt;
+      myData.send_ms = millis();
       esp_err_t result = esp_now_send(receiverAddress, (uint8_t *) &myData, sizeof(myData));
       if (result == ESP_OK) {
         Serial.println("Sent with success");
@@ -185,7 +201,13 @@ void ESP_NOW_task(void *pvParameters) {
       }
       vTaskDelay(100);
     }
-    vTaskDelay(5000); // Delay for a second before sending the next message
+    if (!isnan(myData.temperature) && !isnan(myData.humidity)) {
+      waited = next_sample_interval(&sampler, myData.temperature, myData.humidity);
+    }
+    else {
+      waited = sampler.interval_ms;
+    }
+    vTaskDelay(pdMS_TO_TICKS(waited));
   }
 }
 
@@ -197,6 +219,7 @@ void setup() {
   readMacAddress();
   sensor_setup();
   init_ESPNOW();
+  init_adaptive_sampler(&sampler);
   
   xTaskCreate(ESP_NOW_task, "ESP_NOW_task", 8192, NULL, 2, NULL);
   // xTaskCreate(read_dht20, "read_sensor", 8192, NULL, 2, NULL);
@@ -0,0 +1,48 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+// Host stand-in for the parts of the Arduino core used by the library code under test.
+// Time is virtual, millis() only moves when a test advances it or the code under test calls delay().
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include <Print.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define F(string_literal) (string_literal)
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_byte_near(addr) pgm_read_byte(addr)
+
+using std::max;
+using std::min;
+
+inline unsigned long &native_millis() {
+  static unsigned long now = 0;
+  return now;
+}
+
+inline unsigned long millis() {
+  return native_millis();
+}
+
+inline unsigned long micros() {
+  return native_millis() * 1000UL;
+}
+
+inline void delay(unsigned long ms) {
+  native_millis() += ms;
+}
+
+inline void yield() {
+}
+
+#endif // Arduino_h
@@ -0,0 +1,18 @@
+#ifndef IPAddress_h
+#define IPAddress_h
+
+// Host stand-in for the Arduino IPAddress class.
+
+#include <stdint.h>
+
+class IPAddress {
+  public:
+    IPAddress() : m_address() {}
+    IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth) : m_address{ first, second, third, fourth } {}
+    uint8_t operator[](int index) const { return m_address[index]; }
+
+  private:
+    uint8_t m_address[4];
+};
+
+#endif // IPAddress_h
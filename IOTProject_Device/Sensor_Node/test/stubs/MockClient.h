@@ -0,0 +1,165 @@
+#ifndef MockClient_h
+#define MockClient_h
+
+// Host stand-in for a network connection, playing the broker side of the tests.
+// Bytes queued with push() are what the code under test reads, everything it writes is kept in tx.
+
+#include <Client.h>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+class MockClient : public Client {
+  public:
+    std::vector<uint8_t> rx;        // Bytes the code under test reads, consumed from rx_pos on
+    size_t rx_pos = 0;
+    size_t available_cap = SIZE_MAX; // Most bytes available() reports at once, to split packets into fragments
+    std::vector<uint8_t> tx;        // Every byte written
+    size_t write_budget = SIZE_MAX; // Bytes accepted before writes start to fail, to simulate a dead socket
+    int connect_result = 1;         // Returned by connect()
+    bool open = false;
+    unsigned writes = 0;            // write() calls, each one a separate segment without Nagle
+    unsigned reads = 0;             // read() calls
+    unsigned connects = 0;          // connect() calls
+
+    void clear() {
+      rx.clear();
+      rx_pos = 0;
+      available_cap = SIZE_MAX;
+      tx.clear();
+      write_budget = SIZE_MAX;
+      connect_result = 1;
+      open = false;
+      writes = reads = connects = 0;
+    }
+
+    void push(std::initializer_list<uint8_t> bytes) {
+      rx.insert(rx.end(), bytes);
+    }
+
+    void push(const std::vector<uint8_t> &bytes) {
+      rx.insert(rx.end(), bytes.begin(), bytes.end());
+    }
+
+    int connect(IPAddress, uint16_t) override {
+      connects++;
+      open = connect_result == 1;
+      return connect_result;
+    }
+
+    int connect(const char *, uint16_t) override {
+      connects++;
+      open = connect_result == 1;
+      return connect_result;
+    }
+
+    size_t write(uint8_t b) override {
+      return write(&b, 1);
+    }
+
+    size_t write(const uint8_t *buf, size_t size) override {
+      writes++;
+      if (!open) {
+        return 0;
+      }
+      const size_t n = std::min(size, write_budget);
+      write_budget -= n;
+      tx.insert(tx.end(), buf, buf + n);
+      return n;
+    }
+
+    int available() override {
+      return (int)std::min(rx.size() - rx_pos, available_cap);
+    }
+
+    int read() override {
+      reads++;
+      return rx_pos < rx.size() ? rx[rx_pos++] : -1;
+    }
+
+    int read(uint8_t *buf, size_t size) override {
+      reads++;
+      const size_t n = std::min(size, (size_t)available());
+      memcpy(buf, rx.data() + rx_pos, n);
+      rx_pos += n;
+      return (int)n;
+    }
+
+    int peek() override {
+      return rx_pos < rx.size() ? rx[rx_pos] : -1;
+    }
+
+    void flush() override {}
+
+    void stop() override {
+      open = false;
+    }
+
+    uint8_t connected() override {
+      return open;
+    }
+};
+
+// Remaining length field of an MQTT fixed header
+inline void mqtt_append_length(std::vector<uint8_t> &packet, size_t length) {
+  do {
+    uint8_t digit = length & 127;
+    length >>= 7;
+    if (length > 0) {
+      digit |= 0x80;
+    }
+    packet.push_back(digit);
+  } while (length > 0);
+}
+
+// Complete MQTT packet from its first byte and body
+inline std::vector<uint8_t> mqtt_packet(uint8_t header, const std::vector<uint8_t> &body) {
+  std::vector<uint8_t> packet{ header };
+  mqtt_append_length(packet, body.size());
+  packet.insert(packet.end(), body.begin(), body.end());
+  return packet;
+}
+
+// PUBLISH as a broker sends it, flags holding QoS, DUP and RETAIN. MQTT 5 packets need the encoded
+// properties, an empty property length included
+inline std::vector<uint8_t> mqtt_publish(const std::string &topic, const std::string &payload, uint8_t flags = 0, uint16_t id = 0,
+                                         const std::vector<uint8_t> *properties = nullptr) {
+  std::vector<uint8_t> body{ (uint8_t)(topic.size() >> 8), (uint8_t)(topic.size() & 0xFF) };
+  body.insert(body.end(), topic.begin(), topic.end());
+  if (flags & 0x06) {
+    body.push_back(id >> 8);
+    body.push_back(id & 0xFF);
+  }
+  if (properties != nullptr) {
+    body.insert(body.end(), properties->begin(), properties->end());
+  }
+  body.insert(body.end(), payload.begin(), payload.end());
+  return mqtt_packet(0x30 | flags, body);
+}
+
+inline std::vector<uint8_t> mqtt_puback(uint16_t id) {
+  return mqtt_packet(0x40, { (uint8_t)(id >> 8), (uint8_t)(id & 0xFF) });
+}
+
+// Splits the written bytes into packets, checking every fixed header on the way
+inline std::vector<std::vector<uint8_t>> mqtt_split(const std::vector<uint8_t> &bytes) {
+  std::vector<std::vector<uint8_t>> packets;
+  size_t pos = 0;
+  while (pos < bytes.size()) {
+    size_t length = 0, multiplier = 1, header = 1;
+    uint8_t digit;
+    do {
+      digit = bytes.at(pos + header++);
+      length += (digit & 127) * multiplier;
+      multiplier <<= 7;
+    } while (digit & 128);
+    if (pos + header + length > bytes.size()) {
+      break;
+    }
+    packets.emplace_back(bytes.begin() + pos, bytes.begin() + pos + header + length);
+    pos += header + length;
+  }
+  return packets;
+}
+
+#endif // MockClient_h
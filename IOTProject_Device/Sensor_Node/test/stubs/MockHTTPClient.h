@@ -0,0 +1,92 @@
+#ifndef MockHTTPClient_h
+#define MockHTTPClient_h
+
+// Host stand-in for the HTTP client below ThingsBoardHttp, playing the server side of the tests.
+// Opens a new connection when a request is sent without one, like ArduinoHttpClient does. Connecting and every request
+// advance the virtual millis() by the configured latencies, so keeping the connection alive shows up as requests per second.
+
+#include <Arduino.h>
+#include <IHTTP_Client.h>
+#include <string>
+
+class MockHTTPClient : public IHTTP_Client {
+  public:
+    unsigned long handshake_ms = 150;  // TCP and TLS handshake of a new connection, 3 round trips
+    unsigned long round_trip_ms = 50;  // Request and its response
+    int status = 200;                  // HTTP status code of every response
+    std::string body;                  // Body of every response
+    bool keep_alive = false;
+    bool open = false;
+    bool closed_by_server = false;     // Server closed the connection and the client noticed it, connected() returns false
+    bool fail_after_write = false;     // Next request is written, but the connection dies before any response arrives
+    unsigned connects = 0;             // connect() calls, including the ones opened by a request
+    unsigned posts = 0;                // post() calls, each one written to the server
+    unsigned gets = 0;                 // get() calls, each one written to the server
+    std::string last_path;
+
+    void clear() {
+      status = 200;
+      body.clear();
+      open = closed_by_server = fail_after_write = false;
+      connects = posts = gets = 0;
+      last_path.clear();
+    }
+
+    void set_keep_alive(const bool &enabled) override {
+      keep_alive = enabled;
+    }
+
+    int connect(const char *, const uint16_t &) override {
+      connects++;
+      native_millis() += handshake_ms;
+      open = true;
+      closed_by_server = false;
+      return 1;
+    }
+
+    void stop() override {
+      open = false;
+    }
+
+    bool connected() override {
+      return open && !closed_by_server;
+    }
+
+    int post(const char *url_path, const char *, const char *) override {
+      posts++;
+      return request(url_path);
+    }
+
+    int get_response_status_code() override {
+      return status;
+    }
+
+    int get(const char *url_path) override {
+      gets++;
+      return request(url_path);
+    }
+
+    std::string get_response_body() override {
+      return body;
+    }
+
+  private:
+    // Same error codes as ArduinoHttpClient
+    static constexpr int HTTP_ERROR_TIMED_OUT = -3;
+
+    int request(const char *url_path) {
+      last_path = url_path;
+      if (!connected()) {
+        connect(nullptr, 0U);
+      }
+      native_millis() += round_trip_ms;
+      if (fail_after_write) {
+        fail_after_write = false;
+        open = false;
+        return HTTP_ERROR_TIMED_OUT;
+      }
+      return 0;
+    }
+};
+
+#endif // MockHTTPClient_h
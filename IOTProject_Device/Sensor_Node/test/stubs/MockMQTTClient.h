@@ -0,0 +1,138 @@
+#ifndef MockMQTTClient_h
+#define MockMQTTClient_h
+
+// Host stand-in for the MQTT client below ThingsBoard, playing the broker side of the tests.
+// Everything published is kept in published, receive() hands a message to ThingsBoard as if the broker sent it.
+
+#include <IMQTT_Client.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+class MockMQTTClient : public IMQTT_Client {
+  public:
+    struct Message {
+      std::string topic;
+      std::string payload;
+    };
+
+    function callback = nullptr;
+    uint16_t buffer_size = 0;
+    bool is_connected = true;
+    bool fail_publish = false;               // Whether publishes fail even though the client is connected
+    std::vector<Message> published;          // Every publish, in order
+    bool keep_messages = true;               // Whether publishes are kept in published, off to keep the mock from allocating
+    unsigned publishes = 0;                  // publish() and begin_publish() calls
+    unsigned subscribes = 0;                 // subscribe() calls
+    unsigned unsubscribes = 0;               // unsubscribe() calls
+    unsigned disconnects = 0;                // disconnect() calls
+    unsigned writes = 0;                     // write() calls, each one a copy into the client
+    size_t written = 0;                      // Bytes accepted by write()
+    size_t write_budget = SIZE_MAX;          // Bytes write() accepts before it starts writing short, to simulate a dead connection
+
+    void clear() {
+      is_connected = true;
+      fail_publish = false;
+      published.clear();
+      keep_messages = true;
+      publishes = subscribes = unsubscribes = disconnects = writes = 0;
+      written = 0;
+      write_budget = SIZE_MAX;
+    }
+
+    // Hands the given message to the subscribed callback. Both are copied onto the stack first, like a client receiving into its own buffer
+    void receive(const char *topic, const char *payload) {
+      char topic_copy[128];
+      uint8_t payload_copy[32768];
+      const size_t length = strlen(payload);
+      snprintf(topic_copy, sizeof(topic_copy), "%s", topic);
+      memcpy(payload_copy, payload, std::min(length, sizeof(payload_copy)));
+      callback(topic_copy, payload_copy, std::min(length, sizeof(payload_copy)));
+    }
+
+    void set_callback(function cb) override {
+      callback = cb;
+    }
+
+    bool set_buffer_size(const uint16_t &size) override {
+      buffer_size = size;
+      return true;
+    }
+
+    uint16_t get_buffer_size() override {
+      return buffer_size;
+    }
+
+    void set_server(const char *, const uint16_t &) override {
+    }
+
+    bool connect(const char *, const char *, const char *) override {
+      is_connected = true;
+      return true;
+    }
+
+    void disconnect() override {
+      disconnects++;
+      is_connected = false;
+    }
+
+    bool loop() override {
+      return is_connected;
+    }
+
+    bool publish(const char *topic, const uint8_t *payload, const size_t &length) override {
+      publishes++;
+      if (fail_publish) {
+        return false;
+      }
+      if (keep_messages) {
+        published.push_back({ topic, std::string(reinterpret_cast<const char *>(payload), length) });
+      }
+      return is_connected;
+    }
+
+    bool subscribe(const char *) override {
+      subscribes++;
+      return is_connected;
+    }
+
+    bool unsubscribe(const char *) override {
+      unsubscribes++;
+      return is_connected;
+    }
+
+    bool connected() override {
+      return is_connected;
+    }
+
+    bool begin_publish(const char *topic, const size_t &) override {
+      publishes++;
+      if (fail_publish) {
+        return false;
+      }
+      if (keep_messages) {
+        published.push_back({ topic, std::string() });
+      }
+      return is_connected;
+    }
+
+    bool end_publish() override {
+      return is_connected;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override {
+      writes++;
+      size = std::min(size, write_budget);
+      write_budget -= size;
+      written += size;
+      if (keep_messages && !fail_publish) {
+        published.back().payload.append(reinterpret_cast<const char *>(buffer), size);
+      }
+      return size;
+    }
+};
+
+#endif // MockMQTTClient_h
@@ -0,0 +1,15 @@
+#ifndef Stream_h
+#define Stream_h
+
+// Host stand-in for the Arduino Stream class.
+
+#include <Arduino.h>
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+#endif // Stream_h
@@ -0,0 +1,102 @@
+#ifndef TwoWire_h
+#define TwoWire_h
+
+// Host stand-in for the Arduino TwoWire class, recording every bus transaction instead of talking to a device.
+
+#include <Arduino.h>
+#include <deque>
+#include <vector>
+
+// One bus transaction, from a START to the STOP ending it
+struct I2C_Transaction {
+  uint8_t address;
+  std::vector<uint8_t> written; // Bytes written after the START
+  uint8_t read;                 // Bytes requested after a repeated START or a START without a write, 0 for none
+  bool repeated_start;          // Whether the write ended without a STOP and the read followed with a repeated START
+  unsigned long at;             // millis() when the transaction started
+};
+
+class TwoWire {
+  public:
+    std::vector<I2C_Transaction> transactions;
+    std::deque<std::vector<uint8_t>> responses; // Data returned by the following requestFrom() calls, an empty entry is a NACK
+    uint8_t end_result = 0;                     // Returned by endTransmission(), anything else than 0 is a NACK
+
+    void clear() {
+      transactions.clear();
+      responses.clear();
+      end_result = 0;
+      m_open = false;
+      m_rx.clear();
+    }
+
+    void begin() {
+    }
+
+    void setClock(uint32_t) {
+    }
+
+    void beginTransmission(uint8_t address) {
+      transactions.push_back(I2C_Transaction{address, {}, 0U, false, millis()});
+      m_open = true;
+    }
+
+    void beginTransmission(int address) {
+      beginTransmission(static_cast<uint8_t>(address));
+    }
+
+    size_t write(uint8_t data) {
+      transactions.back().written.push_back(data);
+      return 1U;
+    }
+
+    uint8_t endTransmission(bool send_stop = true) {
+      // A transaction ended by a STOP stays closed, otherwise the following read belongs to it
+      m_open = !send_stop && end_result == 0;
+      return end_result;
+    }
+
+    uint8_t requestFrom(uint8_t address, uint8_t quantity) {
+      if (m_open) {
+        transactions.back().repeated_start = true;
+      }
+      else {
+        transactions.push_back(I2C_Transaction{address, {}, 0U, false, millis()});
+      }
+      transactions.back().read = quantity;
+      m_open = false;
+      m_rx.clear();
+      if (responses.empty()) {
+        return 0U;
+      }
+      m_rx.assign(responses.front().begin(), responses.front().end());
+      responses.pop_front();
+      if (m_rx.size() < quantity) {
+        m_rx.clear();
+        return 0U;
+      }
+      m_rx.resize(quantity);
+      return quantity;
+    }
+
+    int available() {
+      return static_cast<int>(m_rx.size());
+    }
+
+    int read() {
+      if (m_rx.empty()) {
+        return -1;
+      }
+      const uint8_t data = m_rx.front();
+      m_rx.pop_front();
+      return data;
+    }
+
+  private:
+    bool m_open = false;
+    std::deque<uint8_t> m_rx;
+};
+
+inline TwoWire Wire;
+
+#endif // TwoWire_h
@@ -0,0 +1,292 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include <AdaptiveSampling.h>
+
+// Grid the gateway models were trained on, see MODEL_STEP_MS and N_STEPS in Edge_Device/src/main.cpp
+#define MODEL_STEP_MS 5000
+#define N_STEPS 10
+
+// Simulated sensor trace, one reading per second
+#define TRACE_MAX_SECONDS 21600
+
+// Within the DHT20 repeatability of 0.1 degC and 0.1 %RH
+#define TEMPERATURE_NOISE 0.05f
+#define HUMIDITY_NOISE 0.05f
+
+struct trace {
+  const char *name;
+  float temperature[TRACE_MAX_SECONDS];
+  float humidity[TRACE_MAX_SECONDS];
+  int seconds;
+};
+
+struct simulation_result {
+  int samples;
+  double temperature_rmse;
+  double humidity_rmse;
+  double temperature_max;
+  double humidity_max;
+};
+
+static trace current;
+static uint32_t noise_state;
+
+// Deterministic noise in [-amplitude, amplitude], so every run reports the same numbers
+static float noise(float amplitude) {
+  noise_state = noise_state * 1664525u + 1013904223u;
+  return ((float)(noise_state >> 8) / (float)(1u << 24) * 2.0f - 1.0f) * amplitude;
+}
+
+// Value of the trace at any millisecond, linearly interpolated between the one second readings
+static float trace_at(const float *values, int seconds, uint32_t ms) {
+  uint32_t second = ms / 1000;
+  if ((int)second >= seconds - 1) return values[seconds - 1];
+  float frac = (float)(ms % 1000) / 1000.0f;
+  return values[second] + (values[second + 1] - values[second]) * frac;
+}
+
+// Quiet room drifting with the outside temperature
+static void make_stable_trace(trace *t) {
+  t->name = "stable room";
+  t->seconds = 7200;
+  for (int s = 0; s < t->seconds; s++) {
+    t->temperature[s] = 26.0f + 0.3f * sinf(2.0f * (float)M_PI * s / 7200.0f);
+    t->humidity[s] = 60.0f + 1.0f * sinf(2.0f * (float)M_PI * s / 5400.0f);
+  }
+}
+
+// Door opened for 20 seconds after half an hour, the room recovers within minutes
+static void make_door_trace(trace *t) {
+  t->name = "door opened";
+  t->seconds = 7200;
+  for (int s = 0; s < t->seconds; s++) {
+    float temperature = 26.0f;
+    float humidity = 60.0f;
+    if (s >= 1807 && s < 1827) {
+      float open = (float)(s - 1807) / 20.0f;
+      temperature -= 3.0f * open;
+      humidity += 10.0f * open;
+    }
+    else if (s >= 1827) {
+      float decay = expf(-(float)(s - 1827) / 120.0f);
+      temperature -= 3.0f * decay;
+      humidity += 10.0f * decay;
+    }
+    t->temperature[s] = temperature;
+    t->humidity[s] = humidity;
+  }
+}
+
+// Air conditioner cycling every 7 minutes
+static void make_cycling_trace(trace *t) {
+  t->name = "ac cycling";
+  t->seconds = 7200;
+  for (int s = 0; s < t->seconds; s++) {
+    float phase = (float)(s % 420) / 420.0f;
+    float saw = phase < 0.3f ? phase / 0.3f : 1.0f - (phase - 0.3f) / 0.7f;
+    t->temperature[s] = 24.5f + 1.5f * saw;
+    t->humidity[s] = 55.0f - 4.0f * saw;
+  }
+}
+
+// Recorded trace given as "seconds,temperature,humidity" lines, one per second
+static bool load_trace(trace *t, const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) return false;
+  t->name = path;
+  t->seconds = 0;
+  float second, temperature, humidity;
+  while (t->seconds < TRACE_MAX_SECONDS && fscanf(file, "%f,%f,%f", &second, &temperature, &humidity) == 3) {
+    t->temperature[t->seconds] = temperature;
+    t->humidity[t->seconds] = humidity;
+    t->seconds++;
+  }
+  fclose(file);
+  return t->seconds > 1;
+}
+
+// Sample the trace like the node does and rebuild the model grid like the gateway does.
+// A fixed_interval_ms of 0 uses the adaptive scheduler.
+static simulation_result simulate(const trace *t, uint32_t fixed_interval_ms) {
+  adaptive_sampler sampler;
+  init_adaptive_sampler(&sampler);
+  grid_resampler resampler;
+  init_grid_resampler(&resampler, MODEL_STEP_MS, N_STEPS * MODEL_STEP_MS);
+  noise_state = 1;
+
+  const uint32_t end_ms = (uint32_t)(t->seconds - 1) * 1000;
+  simulation_result result = {0, 0.0, 0.0, 0.0, 0.0};
+  int points = 0;
+  uint32_t grid_ms = 0;
+  uint32_t waited = 0;
+  for (uint32_t now = 0; now <= end_ms; now += waited) {
+    float temperature = trace_at(t->temperature, t->seconds, now) + noise(TEMPERATURE_NOISE);
+    float humidity = trace_at(t->humidity, t->seconds, now) + noise(HUMIDITY_NOISE);
+    result.samples++;
+
+    float temperatures[N_STEPS];
+    float humidities[N_STEPS];
+    int pushed = resample_to_grid(&resampler, temperature, humidity, waited, temperatures, humidities, N_STEPS);
+    for (int i = 0; i < pushed; i++) {
+      double temperature_error = temperatures[i] - trace_at(t->temperature, t->seconds, grid_ms);
+      double humidity_error = humidities[i] - trace_at(t->humidity, t->seconds, grid_ms);
+      result.temperature_rmse += temperature_error * temperature_error;
+      result.humidity_rmse += humidity_error * humidity_error;
+      result.temperature_max = fmax(result.temperature_max, fabs(temperature_error));
+      result.humidity_max = fmax(result.humidity_max, fabs(humidity_error));
+      points++;
+      grid_ms += MODEL_STEP_MS;
+    }
+    waited = fixed_interval_ms != 0 ? fixed_interval_ms : next_sample_interval(&sampler, temperature, humidity);
+  }
+  result.temperature_rmse = sqrt(result.temperature_rmse / points);
+  result.humidity_rmse = sqrt(result.humidity_rmse / points);
+  return result;
+}
+
+static void report(const char *mode, const trace *t, const simulation_result &result) {
+  char message[200];
+  snprintf(message, sizeof(message), "%-12s %-9s samples %5d  temperature rmse %.3f max %.3f degC  humidity rmse %.3f max %.3f %%RH",
+           t->name, mode, result.samples, result.temperature_rmse, result.temperature_max, result.humidity_rmse, result.humidity_max);
+  TEST_MESSAGE(message);
+}
+
+static void compare(const trace *t) {
+  simulation_result fixed = simulate(t, MODEL_STEP_MS);
+  simulation_result slow = simulate(t, SAMPLE_INTERVAL_MAX_MS);
+  simulation_result adaptive = simulate(t, 0);
+  report("fixed 5s", t, fixed);
+  report("fixed 30s", t, slow);
+  report("adaptive", t, adaptive);
+
+  // Sends less than sampling at the model step, rebuilds no worse than always backing off
+  TEST_ASSERT_LESS_THAN(fixed.samples, adaptive.samples);
+  TEST_ASSERT_TRUE(adaptive.temperature_max <= slow.temperature_max + TEMPERATURE_NOISE);
+  TEST_ASSERT_TRUE(adaptive.humidity_max <= slow.humidity_max + HUMIDITY_NOISE);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_resample_interpolates_between_samples(void) {
+  grid_resampler r;
+  init_grid_resampler(&r, MODEL_STEP_MS, N_STEPS * MODEL_STEP_MS);
+  float temperatures[N_STEPS];
+  float humidities[N_STEPS];
+
+  TEST_ASSERT_EQUAL(1, resample_to_grid(&r, 20.0f, 50.0f, 0, temperatures, humidities, N_STEPS));
+  TEST_ASSERT_EQUAL_FLOAT(20.0f, temperatures[0]);
+  TEST_ASSERT_EQUAL(2, resample_to_grid(&r, 30.0f, 70.0f, 10000, temperatures, humidities, N_STEPS));
+  TEST_ASSERT_EQUAL_FLOAT(25.0f, temperatures[0]);
+  TEST_ASSERT_EQUAL_FLOAT(60.0f, humidities[0]);
+  TEST_ASSERT_EQUAL_FLOAT(30.0f, temperatures[1]);
+  TEST_ASSERT_EQUAL_FLOAT(70.0f, humidities[1]);
+}
+
+void test_resample_fast_node_waits_for_grid_point(void) {
+  grid_resampler r;
+  init_grid_resampler(&r, MODEL_STEP_MS, N_STEPS * MODEL_STEP_MS);
+  float temperatures[N_STEPS];
+  float humidities[N_STEPS];
+
+  resample_to_grid(&r, 20.0f, 50.0f, 0, temperatures, humidities, N_STEPS);
+  TEST_ASSERT_EQUAL(0, resample_to_grid(&r, 21.0f, 50.0f, 2000, temperatures, humidities, N_STEPS));
+  TEST_ASSERT_EQUAL(0, resample_to_grid(&r, 22.0f, 50.0f, 2000, temperatures, humidities, N_STEPS));
+  TEST_ASSERT_EQUAL(1, resample_to_grid(&r, 24.0f, 50.0f, 2000, temperatures, humidities, N_STEPS));
+  // The grid point lies halfway between the samples at 4 s and 6 s
+  TEST_ASSERT_EQUAL_FLOAT(23.0f, temperatures[0]);
+}
+
+void test_resample_restarts_after_outage(void) {
+  grid_resampler r;
+  init_grid_resampler(&r, MODEL_STEP_MS, N_STEPS * MODEL_STEP_MS);
+  float temperatures[N_STEPS];
+  float humidities[N_STEPS];
+
+  resample_to_grid(&r, 20.0f, 50.0f, 0, temperatures, humidities, N_STEPS);
+  resample_to_grid(&r, 20.0f, 50.0f, 3000, temperatures, humidities, N_STEPS);
+  // Longer than the whole model window, nothing is interpolated across the gap
+  TEST_ASSERT_EQUAL(1, resample_to_grid(&r, 30.0f, 60.0f, N_STEPS * MODEL_STEP_MS + 1, temperatures, humidities, N_STEPS));
+  TEST_ASSERT_EQUAL_FLOAT(30.0f, temperatures[0]);
+  TEST_ASSERT_EQUAL_FLOAT(60.0f, humidities[0]);
+  // The grid restarted at the sample after the gap
+  TEST_ASSERT_EQUAL(1, resample_to_grid(&r, 30.0f, 60.0f, MODEL_STEP_MS, temperatures, humidities, N_STEPS));
+}
+
+void test_resample_bounds_points_per_sample(void) {
+  grid_resampler r;
+  init_grid_resampler(&r, MODEL_STEP_MS, N_STEPS * MODEL_STEP_MS);
+  float temperatures[N_STEPS];
+  float humidities[N_STEPS];
+
+  resample_to_grid(&r, 20.0f, 50.0f, 0, temperatures, humidities, N_STEPS);
+  TEST_ASSERT_EQUAL(4, resample_to_grid(&r, 20.0f, 50.0f, N_STEPS * MODEL_STEP_MS, temperatures, humidities, 4));
+  TEST_ASSERT_LESS_THAN(MODEL_STEP_MS, r.phase_ms);
+  // An interval that underflowed on the gateway restarts the grid instead of looping
+  TEST_ASSERT_EQUAL(1, resample_to_grid(&r, 20.0f, 50.0f, UINT32_MAX - 5, temperatures, humidities, N_STEPS));
+}
+
+void test_sampler_backs_off_while_stable(void) {
+  adaptive_sampler s;
+  init_adaptive_sampler(&s);
+  for (int i = 0; i < 40; i++) {
+    next_sample_interval(&s, 25.0f, 60.0f);
+  }
+  TEST_ASSERT_EQUAL(SAMPLE_INTERVAL_MAX_MS, s.interval_ms);
+}
+
+void test_sampler_speeds_up_on_change(void) {
+  adaptive_sampler s;
+  init_adaptive_sampler(&s);
+  for (int i = 0; i < 40; i++) {
+    next_sample_interval(&s, 25.0f, 60.0f);
+  }
+  TEST_ASSERT_LESS_THAN(SAMPLE_INTERVAL_MAX_MS, next_sample_interval(&s, 27.0f, 60.0f));
+  for (int i = 0; i < 5; i++) {
+    next_sample_interval(&s, 27.0f + i, 60.0f);
+  }
+  TEST_ASSERT_EQUAL(SAMPLE_INTERVAL_MIN_MS, s.interval_ms);
+}
+
+void test_simulate_stable_trace(void) {
+  make_stable_trace(&current);
+  compare(&current);
+}
+
+void test_simulate_door_trace(void) {
+  make_door_trace(&current);
+  compare(&current);
+}
+
+void test_simulate_cycling_trace(void) {
+  make_cycling_trace(&current);
+  compare(&current);
+}
+
+// Set SAMPLING_TRACE to a recorded "seconds,temperature,humidity" file to report on real data
+void test_simulate_recorded_trace(void) {
+  const char *path = getenv("SAMPLING_TRACE");
+  if (path == NULL || !load_trace(&current, path)) {
+    TEST_IGNORE_MESSAGE("SAMPLING_TRACE not set or not readable");
+  }
+  compare(&current);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_resample_interpolates_between_samples);
+  RUN_TEST(test_resample_fast_node_waits_for_grid_point);
+  RUN_TEST(test_resample_restarts_after_outage);
+  RUN_TEST(test_resample_bounds_points_per_sample);
+  RUN_TEST(test_sampler_backs_off_while_stable);
+  RUN_TEST(test_sampler_speeds_up_on_change);
+  RUN_TEST(test_simulate_stable_trace);
+  RUN_TEST(test_simulate_door_trace);
+  RUN_TEST(test_simulate_cycling_trace);
+  RUN_TEST(test_simulate_recorded_trace);
+  return UNITY_END();
+}
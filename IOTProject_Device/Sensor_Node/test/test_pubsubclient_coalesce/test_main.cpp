@@ -0,0 +1,161 @@
+#include <chrono>
+#include <unity.h>
+
+#include <MockClient.h>
+#include <PubSubClient.h>
+
+static MockClient net;
+static PubSubClient mqtt;
+
+static std::string telemetry(int i) {
+  return "{\"temperature\":" + std::to_string(20 + i % 10) + "}";
+}
+
+void setUp(void) {
+  native_millis() = 1000;
+  net.clear();
+  mqtt.setClient(net);
+  mqtt.setServer("broker", 1883);
+  mqtt.setCoalescing(0);
+  net.push({ 0x20, 2, 0, 0 });
+  TEST_ASSERT_TRUE(mqtt.connect("coalesce"));
+  net.tx.clear();
+  net.writes = 0;
+}
+
+void tearDown(void) {
+  mqtt.setCoalescing(0);
+  mqtt.disconnect();
+}
+
+void test_burst_is_written_in_few_segments(void) {
+  TEST_ASSERT_TRUE(mqtt.setCoalescing(1460, 50));
+  std::vector<uint8_t> expected;
+  for (int i = 0; i < 100; i++) {
+    TEST_ASSERT_TRUE(mqtt.publish("v1/devices/me/telemetry", telemetry(i).c_str()));
+    const std::vector<uint8_t> packet = mqtt_publish("v1/devices/me/telemetry", telemetry(i));
+    expected.insert(expected.end(), packet.begin(), packet.end());
+  }
+  mqtt.flush();
+  // 4600 bytes of publishes in 1460 byte segments
+  TEST_ASSERT_TRUE(expected == net.tx);
+  TEST_ASSERT_EQUAL((expected.size() + 1459) / 1460, net.writes);
+}
+
+void test_delay_bound_flushes_on_the_timer(void) {
+  TEST_ASSERT_TRUE(mqtt.setCoalescing(1460, 50));
+  mqtt.publish("t", "1");
+  delay(20);
+  mqtt.publish("t", "2");
+  mqtt.loop();
+  TEST_ASSERT_EQUAL(0, net.writes);
+  // Counted from the first queued publish, rounded up to the wheel tick
+  delay(30 + MQTT_TIMER_WHEEL_TICK);
+  mqtt.loop();
+  TEST_ASSERT_EQUAL(1, net.writes);
+  TEST_ASSERT_EQUAL(2, mqtt_split(net.tx).size());
+}
+
+void test_other_packets_keep_their_order(void) {
+  TEST_ASSERT_TRUE(mqtt.setCoalescing(1460, 50));
+  mqtt.publish("t", "1");
+  TEST_ASSERT_TRUE(mqtt.subscribe("s"));
+  const uint16_t id = mqtt.publishQos1("t", (const uint8_t *)"2", 1, false);
+  TEST_ASSERT_NOT_EQUAL(0, id);
+  const std::vector<std::vector<uint8_t>> packets = mqtt_split(net.tx);
+  TEST_ASSERT_EQUAL(3, packets.size());
+  TEST_ASSERT_EQUAL_HEX8(MQTTPUBLISH, packets[0][0]);
+  TEST_ASSERT_EQUAL_HEX8(MQTTSUBSCRIBE | MQTTQOS1, packets[1][0]);
+  TEST_ASSERT_EQUAL_HEX8(MQTTPUBLISH | MQTTQOS1, packets[2][0]);
+}
+
+void test_publish_larger_than_send_buffer(void) {
+  TEST_ASSERT_TRUE(mqtt.setCoalescing(64, 50));
+  mqtt.publish("t", "small");
+  const std::string large(200, 'l');
+  TEST_ASSERT_TRUE(mqtt.publish("t", large.c_str()));
+  // The queued one first, then the large one straight from the client buffer
+  TEST_ASSERT_EQUAL(2, net.writes);
+  const std::vector<std::vector<uint8_t>> packets = mqtt_split(net.tx);
+  TEST_ASSERT_TRUE(mqtt_publish("t", "small") == packets[0]);
+  TEST_ASSERT_TRUE(mqtt_publish("t", large) == packets[1]);
+}
+
+void test_failed_flush_drops_the_batch(void) {
+  TEST_ASSERT_TRUE(mqtt.setCoalescing(1460, 50));
+  mqtt.publish("t", "lost");
+  net.write_budget = 3;
+  mqtt.flush();
+  net.write_budget = SIZE_MAX;
+  net.tx.clear();
+  // Nothing of the failed batch is sent again
+  mqtt.flush();
+  TEST_ASSERT_TRUE(net.tx.empty());
+}
+
+// Segments each strategy puts on the wire for a steady stream of small publishes, in virtual time
+static void segments_per_second(uint16_t size, unsigned *messages, unsigned *segments) {
+  mqtt.setCoalescing(size, 50);
+  net.writes = 0;
+  *messages = 0;
+  // 200 publishes per second for 10 s
+  for (int ms = 0; ms < 10000; ms++) {
+    if (ms % 5 == 0) {
+      mqtt.publish("v1/devices/me/telemetry", telemetry(ms).c_str());
+      (*messages)++;
+    }
+    delay(1);
+    mqtt.loop();
+  }
+  mqtt.flush();
+  *messages /= 10;
+  *segments = net.writes / 10;
+}
+
+void test_segments_per_second(void) {
+  unsigned messages, direct, coalesced;
+  segments_per_second(0, &messages, &direct);
+  segments_per_second(1460, &messages, &coalesced);
+  char message[160];
+  snprintf(message, sizeof(message), "%u publishes/s: %u segments/s direct, %u segments/s coalesced (1460 B, 50 ms)",
+           messages, direct, coalesced);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL(messages, direct);
+  // The 50 ms delay bound caps a steady stream at one segment per delay, rounded to the wheel tick
+  TEST_ASSERT_LESS_OR_EQUAL(1000 / 50, coalesced);
+}
+
+void test_coalescing_throughput(void) {
+  const int rounds = 200000;
+  const std::string payload = telemetry(1);
+  for (uint16_t size : { (uint16_t)0, (uint16_t)1460 }) {
+    mqtt.setCoalescing(size, 50);
+    net.writes = 0;
+    net.tx.clear();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+      mqtt.publish("v1/devices/me/telemetry", payload.c_str());
+      if (net.tx.size() > 1 << 20) {
+        net.tx.clear();
+      }
+    }
+    mqtt.flush();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    char message[160];
+    snprintf(message, sizeof(message), "send buffer %4u B: %.0f publishes/s, %u client writes",
+             size, rounds / seconds, net.writes);
+    TEST_MESSAGE(message);
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_burst_is_written_in_few_segments);
+  RUN_TEST(test_delay_bound_flushes_on_the_timer);
+  RUN_TEST(test_other_packets_keep_their_order);
+  RUN_TEST(test_publish_larger_than_send_buffer);
+  RUN_TEST(test_failed_flush_drops_the_batch);
+  RUN_TEST(test_segments_per_second);
+  RUN_TEST(test_coalescing_throughput);
+  return UNITY_END();
+}
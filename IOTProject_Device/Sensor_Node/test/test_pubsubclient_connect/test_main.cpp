@@ -0,0 +1,108 @@
+#include <unity.h>
+
+#include <MockClient.h>
+#include <PubSubClient.h>
+
+static MockClient net;
+static PubSubClient *mqtt;
+
+// CONNECT of a clean session with the client id "c" and the default keepalive
+static const std::vector<uint8_t> connect_packet = { MQTTCONNECT, 13, 0, 4, 'M', 'Q', 'T', 'T', MQTT_VERSION, 0x02, 0, MQTT_KEEPALIVE, 0, 1, 'c' };
+
+void setUp(void) {
+  native_millis() = 1000;
+  net.clear();
+  mqtt = new PubSubClient(net);
+  mqtt->setServer("broker", 1883);
+}
+
+void tearDown(void) {
+  delete mqtt;
+}
+
+void test_connect_succeeds(void) {
+  TEST_ASSERT_TRUE(mqtt->beginConnect("c", NULL, NULL));
+  TEST_ASSERT_EQUAL(MQTT_CONNECTING, mqtt->state());
+  // Opens the TCP connection and sends CONNECT in the same poll
+  TEST_ASSERT_EQUAL(0, mqtt->pollConnect());
+  TEST_ASSERT_EQUAL(1, net.connects);
+  TEST_ASSERT_TRUE(net.tx == connect_packet);
+  // A second connect attempt is refused while one is in progress
+  TEST_ASSERT_FALSE(mqtt->beginConnect("c", NULL, NULL));
+
+  net.push({ MQTTCONNACK, 2, 0, 0 });
+  TEST_ASSERT_EQUAL(1, mqtt->pollConnect());
+  TEST_ASSERT_EQUAL(MQTT_CONNECTED, mqtt->state());
+  TEST_ASSERT_TRUE(mqtt->connected());
+  // Polling once connected only reports the state
+  TEST_ASSERT_EQUAL(1, mqtt->pollConnect());
+}
+
+void test_connack_split_across_reads(void) {
+  TEST_ASSERT_TRUE(mqtt->beginConnect("c", NULL, NULL));
+  TEST_ASSERT_EQUAL(0, mqtt->pollConnect());
+  // Only the fixed header has arrived
+  net.push({ MQTTCONNACK, 2 });
+  TEST_ASSERT_EQUAL(0, mqtt->pollConnect());
+  net.push({ 0 });
+  TEST_ASSERT_EQUAL(0, mqtt->pollConnect());
+  delay(100);
+  net.push({ 0 });
+  TEST_ASSERT_EQUAL(1, mqtt->pollConnect());
+  TEST_ASSERT_EQUAL(MQTT_CONNECTED, mqtt->state());
+}
+
+void test_connack_delivered_one_byte_per_read(void) {
+  net.available_cap = 1;
+  net.push({ MQTTCONNACK, 2, 0, 0 });
+  // The blocking connect() polls until the CONNACK has been assembled
+  TEST_ASSERT_TRUE(mqtt->connect("c"));
+  TEST_ASSERT_EQUAL(MQTT_CONNECTED, mqtt->state());
+}
+
+void test_refused_return_code(void) {
+  TEST_ASSERT_TRUE(mqtt->beginConnect("c", NULL, NULL));
+  TEST_ASSERT_EQUAL(0, mqtt->pollConnect());
+  net.push({ MQTTCONNACK, 2, 0, MQTT_CONNECT_BAD_CREDENTIALS });
+  TEST_ASSERT_EQUAL(-1, mqtt->pollConnect());
+  TEST_ASSERT_EQUAL(MQTT_CONNECT_BAD_CREDENTIALS, mqtt->state());
+  TEST_ASSERT_FALSE(mqtt->connected());
+  TEST_ASSERT_FALSE(net.open);
+
+  // The next attempt starts from scratch
+  net.rx.clear();
+  net.rx_pos = 0;
+  net.tx.clear();
+  TEST_ASSERT_TRUE(mqtt->beginConnect("c", NULL, NULL));
+  TEST_ASSERT_EQUAL(0, mqtt->pollConnect());
+  TEST_ASSERT_TRUE(net.tx == connect_packet);
+  net.push({ MQTTCONNACK, 2, 0, 0 });
+  TEST_ASSERT_EQUAL(1, mqtt->pollConnect());
+}
+
+void test_tcp_connect_failure(void) {
+  net.connect_result = 0;
+  TEST_ASSERT_TRUE(mqtt->beginConnect("c", NULL, NULL));
+  TEST_ASSERT_EQUAL(-1, mqtt->pollConnect());
+  TEST_ASSERT_EQUAL(MQTT_CONNECT_FAILED, mqtt->state());
+  TEST_ASSERT_EQUAL(1, net.connects);
+  TEST_ASSERT_TRUE(net.tx.empty());
+  // Nothing is left in progress, a failed attempt does not retry by itself
+  TEST_ASSERT_EQUAL(-1, mqtt->pollConnect());
+  TEST_ASSERT_EQUAL(1, net.connects);
+
+  net.connect_result = 1;
+  net.push({ MQTTCONNACK, 2, 0, 0 });
+  TEST_ASSERT_TRUE(mqtt->connect("c"));
+  TEST_ASSERT_EQUAL(2, net.connects);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_connect_succeeds);
+  RUN_TEST(test_connack_split_across_reads);
+  RUN_TEST(test_connack_delivered_one_byte_per_read);
+  RUN_TEST(test_refused_return_code);
+  RUN_TEST(test_tcp_connect_failure);
+  return UNITY_END();
+}
@@ -0,0 +1,196 @@
+#include <chrono>
+#include <unity.h>
+
+#include <MockClient.h>
+#include <PubSubClient.h>
+
+// Built with and without MQTT_METRICS (native_metrics and native environments). The counters are only
+// checked with metrics, the benchmark runs the same traffic in both builds to show what keeping them costs
+
+static MockClient net;
+static PubSubClient *mqtt;
+static size_t received = 0;
+
+static void on_message(char *, uint8_t *, unsigned int) {
+  received++;
+}
+
+static void connect() {
+  net.push({ MQTTCONNACK, 2, 0, 0 });
+  TEST_ASSERT_TRUE(mqtt->connect("m"));
+}
+
+static std::vector<uint8_t> puback(const uint16_t &id) {
+  return mqtt_packet(MQTTPUBACK, { (uint8_t)(id >> 8), (uint8_t)(id & 0xFF) });
+}
+
+void setUp(void) {
+  native_millis() = 1000;
+  net.clear();
+  mqtt = new PubSubClient(net);
+  mqtt->setServer("broker", 1883);
+  mqtt->setCallback(on_message);
+  received = 0;
+}
+
+void tearDown(void) {
+  delete mqtt;
+}
+
+#ifdef MQTT_METRICS
+static MQTTMetrics snapshot() {
+  MQTTMetrics metrics;
+  mqtt->getMetrics(&metrics);
+  return metrics;
+}
+
+void test_counters_follow_scripted_traffic(void) {
+  // CONNECT with the client id "m" is 15 bytes, the CONNACK 4
+  connect();
+  MQTTMetrics metrics = snapshot();
+  TEST_ASSERT_EQUAL(1, metrics.connects);
+  TEST_ASSERT_EQUAL(15, metrics.bytesOut);
+  TEST_ASSERT_EQUAL(4, metrics.bytesIn);
+  TEST_ASSERT_EQUAL(1, metrics.packetsIn);
+
+  // QoS 0 publishes of 5 bytes to "t" are 10 bytes each
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_TRUE(mqtt->publish("t", "hello"));
+  }
+  TEST_ASSERT_EQUAL(15 + 30, snapshot().bytesOut);
+
+  // A QoS 1 publish (12 bytes) acknowledged 40 ms later lands in the 32 to 63 ms bucket
+  const uint16_t id = mqtt->publishQos1("t", (const uint8_t *)"hello", 5, false);
+  TEST_ASSERT_NOT_EQUAL(0, id);
+  delay(40);
+  net.push(puback(id));
+  mqtt->loop();
+  metrics = snapshot();
+  TEST_ASSERT_EQUAL(15 + 30 + 12, metrics.bytesOut);
+  TEST_ASSERT_EQUAL(4 + 4, metrics.bytesIn);
+  TEST_ASSERT_EQUAL(2, metrics.packetsIn);
+  TEST_ASSERT_EQUAL(1, metrics.publishLatency.count);
+  TEST_ASSERT_EQUAL(40, metrics.publishLatency.sum);
+  TEST_ASSERT_EQUAL(40, metrics.publishLatency.max);
+  TEST_ASSERT_EQUAL(1, metrics.publishLatency.buckets[6]);
+
+  // Incoming PUBLISH of 7 bytes
+  net.push(mqtt_publish("t", "in"));
+  mqtt->loop();
+  metrics = snapshot();
+  TEST_ASSERT_EQUAL(3, metrics.packetsIn);
+  TEST_ASSERT_EQUAL(8 + 7, metrics.bytesIn);
+
+  // Idle until the keepalive sends a PINGREQ, answered 25 ms later
+  delay(MQTT_KEEPALIVE * 1000UL + MQTT_TIMER_WHEEL_TICK);
+  mqtt->loop();
+  TEST_ASSERT_EQUAL(15 + 30 + 12 + 2, snapshot().bytesOut);
+  delay(25);
+  net.push({ MQTTPINGRESP, 0 });
+  mqtt->loop();
+  metrics = snapshot();
+  TEST_ASSERT_EQUAL(4, metrics.packetsIn);
+  TEST_ASSERT_EQUAL(15 + 2, metrics.bytesIn);
+  TEST_ASSERT_EQUAL(1, metrics.pingRtt.count);
+  TEST_ASSERT_EQUAL(25, metrics.pingRtt.sum);
+  TEST_ASSERT_EQUAL(0, metrics.connectFailures);
+  TEST_ASSERT_EQUAL(0, metrics.timeouts);
+}
+
+void test_connect_failures_and_lost_connection(void) {
+  // Refused by the broker
+  net.push({ MQTTCONNACK, 2, 0, MQTT_CONNECT_BAD_CREDENTIALS });
+  TEST_ASSERT_FALSE(mqtt->connect("m"));
+  // TCP connect failing
+  net.connect_result = 0;
+  TEST_ASSERT_FALSE(mqtt->connect("m"));
+  net.connect_result = 1;
+  // No CONNACK within the socket timeout
+  TEST_ASSERT_TRUE(mqtt->beginConnect("m", NULL, NULL));
+  TEST_ASSERT_EQUAL(0, mqtt->pollConnect());
+  delay(MQTT_SOCKET_TIMEOUT * 1000UL + MQTT_TIMER_WHEEL_TICK);
+  TEST_ASSERT_EQUAL(-1, mqtt->pollConnect());
+  TEST_ASSERT_EQUAL(3, snapshot().connectFailures);
+
+  connect();
+  net.open = false;
+  TEST_ASSERT_FALSE(mqtt->connected());
+  MQTTMetrics metrics = snapshot();
+  TEST_ASSERT_EQUAL(1, metrics.connects);
+  TEST_ASSERT_EQUAL(1, metrics.connectionsLost);
+}
+
+void test_retransmit_and_failed_publish(void) {
+  mqtt->setRetransmitTimeout(1);
+  connect();
+  TEST_ASSERT_NOT_EQUAL(0, mqtt->publishQos1("t", (const uint8_t *)"hello", 5, false));
+  delay(1000 + MQTT_TIMER_WHEEL_TICK);
+  mqtt->loop();
+  TEST_ASSERT_EQUAL(1, snapshot().retransmits);
+
+  // The clean session reconnect drops the publish, it is never acknowledged
+  mqtt->disconnect();
+  connect();
+  MQTTMetrics metrics = snapshot();
+  TEST_ASSERT_EQUAL(1, metrics.publishFailures);
+  TEST_ASSERT_EQUAL(0, metrics.publishLatency.count);
+}
+
+void test_oversize_packet_is_counted(void) {
+  mqtt->setBufferSize(64);
+  connect();
+  net.push(mqtt_publish("t", std::string(100, 'x')));
+  mqtt->loop();
+  TEST_ASSERT_EQUAL(1, snapshot().droppedOversize);
+}
+
+void test_reset_clears_everything(void) {
+  connect();
+  mqtt->resetMetrics();
+  const MQTTMetrics metrics = snapshot();
+  const MQTTMetrics zero = {};
+  TEST_ASSERT_EQUAL_MEMORY(&zero, &metrics, sizeof(MQTTMetrics));
+}
+#endif // MQTT_METRICS
+
+// One QoS 0 publish out and one PUBLISH in per message, the path every counter of a busy client sits on
+void test_metrics_overhead_benchmark(void) {
+  const size_t messages = 100000;
+  connect();
+  const std::vector<uint8_t> incoming = mqtt_publish("t", "in");
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < messages; i++) {
+    net.tx.clear();
+    net.rx.clear();
+    net.rx_pos = 0;
+    net.push(incoming);
+    mqtt->publish("t", "hello");
+    mqtt->loop();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  TEST_ASSERT_TRUE(mqtt->connected());
+  TEST_ASSERT_EQUAL(messages, received);
+
+  char message[128];
+  snprintf(message, sizeof(message), "MQTT_METRICS %s: %.0f ns per message in and out, PubSubClient %zu bytes",
+#ifdef MQTT_METRICS
+    "on",
+#else
+    "off",
+#endif // MQTT_METRICS
+    std::chrono::duration<double, std::nano>(end - start).count() / messages, sizeof(PubSubClient));
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+#ifdef MQTT_METRICS
+  RUN_TEST(test_counters_follow_scripted_traffic);
+  RUN_TEST(test_connect_failures_and_lost_connection);
+  RUN_TEST(test_retransmit_and_failed_publish);
+  RUN_TEST(test_oversize_packet_is_counted);
+  RUN_TEST(test_reset_clears_everything);
+#endif // MQTT_METRICS
+  RUN_TEST(test_metrics_overhead_benchmark);
+  return UNITY_END();
+}
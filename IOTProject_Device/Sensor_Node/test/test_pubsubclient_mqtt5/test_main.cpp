@@ -0,0 +1,347 @@
+#include <map>
+#include <unity.h>
+
+#include <MockClient.h>
+#include <PubSubClient.h>
+
+#if MQTT_VERSION != MQTT_VERSION_5
+#error "Build with -D MQTT_VERSION=5, see the native_mqtt5 environment"
+#endif
+
+static MockClient net;
+static PubSubClient mqtt;
+static std::string received_topic;
+static std::string received_payload;
+static std::vector<std::pair<uint16_t, bool>> completed;
+
+static void on_message(char *topic, uint8_t *payload, unsigned int length) {
+  received_topic = topic;
+  received_payload.assign((const char *)payload, length);
+}
+
+static void on_publish(uint16_t id, boolean delivered) {
+  completed.emplace_back(id, delivered);
+}
+
+// CONNACK accepting the connection with the given encoded properties
+static std::vector<uint8_t> connack(const std::vector<uint8_t> &properties) {
+  std::vector<uint8_t> body{ 0, 0 };
+  mqtt_append_length(body, properties.size());
+  body.insert(body.end(), properties.begin(), properties.end());
+  return mqtt_packet(0x20, body);
+}
+
+// Topic alias maximum 2, receive maximum 4
+static const std::vector<uint8_t> broker_properties{ MQTT5_PROP_TOPIC_ALIAS_MAXIMUM, 0, 2, MQTT5_PROP_RECEIVE_MAXIMUM, 0, 4 };
+
+// What the broker learns from a PUBLISH the client sent: the topic, empty when replaced by the alias, and the alias
+struct Published {
+  std::string topic;
+  uint16_t alias;
+  std::string payload;
+};
+
+static Published parse_publish(const std::vector<uint8_t> &packet) {
+  size_t pos = 1;
+  while (packet[pos++] & 128) {}
+  const size_t topic_length = (packet[pos] << 8) | packet[pos + 1];
+  Published published{ std::string(packet.begin() + pos + 2, packet.begin() + pos + 2 + topic_length), 0, "" };
+  pos += 2 + topic_length;
+  if (packet[0] & 0x06) {
+    pos += 2;
+  }
+  const size_t properties_end = pos + 1 + packet[pos];
+  for (pos++; pos < properties_end;) {
+    const uint8_t id = packet[pos++];
+    if (id == MQTT5_PROP_TOPIC_ALIAS) {
+      published.alias = (packet[pos] << 8) | packet[pos + 1];
+      pos += 2;
+    } else {
+      // Content type and user properties are checked byte for byte where they are used
+      pos = properties_end;
+    }
+  }
+  published.payload.assign(packet.begin() + properties_end, packet.end());
+  return published;
+}
+
+// Publishes written since the last call, the broker resolving aliases as it goes.
+// Fails the test on an alias the broker was never told the topic of
+static std::map<uint16_t, std::string> broker_aliases;
+static size_t served = 0;
+
+static std::vector<Published> received_by_broker() {
+  std::vector<Published> publishes;
+  for (const std::vector<uint8_t> &packet : mqtt_split(std::vector<uint8_t>(net.tx.begin() + served, net.tx.end()))) {
+    if ((packet[0] & 0xF0) != MQTTPUBLISH) {
+      continue;
+    }
+    Published published = parse_publish(packet);
+    if (published.alias != 0) {
+      if (!published.topic.empty()) {
+        broker_aliases[published.alias] = published.topic;
+      } else {
+        TEST_ASSERT_TRUE_MESSAGE(broker_aliases.count(published.alias) == 1, "alias the broker does not know");
+        published.topic = broker_aliases[published.alias];
+      }
+    }
+    publishes.push_back(published);
+  }
+  served = net.tx.size();
+  return publishes;
+}
+
+static void connect(bool clean_session = true) {
+  net.open = false;
+  net.push(connack(broker_properties));
+  TEST_ASSERT_TRUE(mqtt.connect("mqtt5", NULL, NULL, NULL, 0, false, NULL, clean_session));
+  broker_aliases.clear();
+  served = net.tx.size();
+}
+
+void setUp(void) {
+  native_millis() = 1000;
+  net.clear();
+  received_topic.clear();
+  received_payload.clear();
+  completed.clear();
+  mqtt.setClient(net);
+  mqtt.setServer("broker", 1883);
+  mqtt.setCallback(on_message);
+  mqtt.setPublishCallback(on_publish);
+  mqtt.setBufferSize(256);
+  mqtt.setCoalescing(0);
+  mqtt.setInflightWindow(MQTT_MAX_INFLIGHT);
+  connect();
+}
+
+void tearDown(void) {
+  mqtt.disconnect();
+}
+
+void test_connect_properties(void) {
+  mqtt.disconnect();
+  net.clear();
+  net.push(connack({}));
+  TEST_ASSERT_TRUE(mqtt.connect("mqtt5", NULL, NULL, NULL, 0, false, NULL, false));
+  // Protocol level 5, then flags, keepalive and the session expiry interval a non-clean session asks for
+  const std::vector<uint8_t> expected{ 0x10, 23, 0, 4, 'M', 'Q', 'T', 'T', 5, 0x00, 0, MQTT_KEEPALIVE,
+                                       5, MQTT5_PROP_SESSION_EXPIRY, (uint8_t)(MQTT5_SESSION_EXPIRY >> 24), (uint8_t)(MQTT5_SESSION_EXPIRY >> 16),
+                                       (uint8_t)(MQTT5_SESSION_EXPIRY >> 8), (uint8_t)MQTT5_SESSION_EXPIRY, 0, 5, 'm', 'q', 't', 't', '5' };
+  TEST_ASSERT_TRUE(expected == net.tx);
+
+  mqtt.disconnect();
+  net.clear();
+  net.push(connack({}));
+  TEST_ASSERT_TRUE(mqtt.connect("mqtt5"));
+  // Clean session: empty property length
+  TEST_ASSERT_EQUAL_HEX8(0x02, net.tx[9]);
+  TEST_ASSERT_EQUAL(0, net.tx[12]);
+}
+
+void test_refused_connack_reason_code(void) {
+  mqtt.disconnect();
+  net.clear();
+  // Not authorized
+  net.push(mqtt_packet(0x20, { 0, 0x87, 0 }));
+  TEST_ASSERT_FALSE(mqtt.connect("mqtt5"));
+  TEST_ASSERT_EQUAL_HEX8(0x87, mqtt.lastReasonCode());
+  TEST_ASSERT_EQUAL(0x87, mqtt.state());
+}
+
+void test_receive_maximum_narrows_window(void) {
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_NOT_EQUAL(0, mqtt.publishQos1("q", (const uint8_t *)"1", 1, false));
+  }
+  TEST_ASSERT_EQUAL(0, mqtt.publishQos1("q", (const uint8_t *)"1", 1, false));
+  TEST_ASSERT_EQUAL(4, mqtt.getInflightCount());
+}
+
+void test_topic_alias_replaces_repeated_topic(void) {
+  TEST_ASSERT_TRUE(mqtt.publish("v1/devices/me/telemetry", "{\"a\":1}"));
+  TEST_ASSERT_TRUE(mqtt.publish("v1/devices/me/telemetry", "{\"a\":2}"));
+  TEST_ASSERT_TRUE(mqtt.publish("v1/devices/me/attributes", "{\"b\":1}"));
+  // Alias maximum of the broker reached, sent in full every time
+  TEST_ASSERT_TRUE(mqtt.publish("v1/devices/me/rpc/response/1", "{}"));
+  TEST_ASSERT_TRUE(mqtt.publish("v1/devices/me/rpc/response/1", "{}"));
+
+  const std::vector<std::vector<uint8_t>> packets = mqtt_split(std::vector<uint8_t>(net.tx.begin() + served, net.tx.end()));
+  std::vector<Published> published = received_by_broker();
+  TEST_ASSERT_EQUAL(5, published.size());
+  TEST_ASSERT_EQUAL(1, published[0].alias);
+  TEST_ASSERT_EQUAL(1, published[1].alias);
+  TEST_ASSERT_EQUAL(2, published[2].alias);
+  TEST_ASSERT_EQUAL(0, published[3].alias);
+  TEST_ASSERT_EQUAL(0, published[4].alias);
+  TEST_ASSERT_EQUAL_STRING("v1/devices/me/telemetry", published[1].topic.c_str());
+  TEST_ASSERT_EQUAL_STRING("{\"a\":2}", published[1].payload.c_str());
+  // Same payload length, the topic left out
+  TEST_ASSERT_EQUAL(packets[0].size() - strlen("v1/devices/me/telemetry"), packets[1].size());
+}
+
+void test_qos1_never_uses_alias(void) {
+  mqtt.publish("q", "x");
+  mqtt.publishQos1("q", (const uint8_t *)"x", 1, false);
+  const std::vector<Published> published = received_by_broker();
+  TEST_ASSERT_EQUAL(1, published[0].alias);
+  TEST_ASSERT_EQUAL(0, published[1].alias);
+  TEST_ASSERT_EQUAL_STRING("q", published[1].topic.c_str());
+}
+
+void test_failed_write_does_not_register_alias(void) {
+  // The first publish of the topic dies on the socket
+  net.write_budget = 3;
+  TEST_ASSERT_FALSE(mqtt.publish("t/alias", "first"));
+  net.tx.clear();
+  served = 0;
+  net.write_budget = SIZE_MAX;
+  TEST_ASSERT_TRUE(mqtt.publish("t/alias", "second"));
+  const std::vector<Published> published = received_by_broker();
+  TEST_ASSERT_EQUAL(1, published.size());
+  // Still introduces the topic instead of sending an alias the broker never learned
+  TEST_ASSERT_EQUAL_STRING("t/alias", published[0].topic.c_str());
+  TEST_ASSERT_EQUAL(1, published[0].alias);
+}
+
+void test_payload_too_large_does_not_register_alias(void) {
+  // Fits without the alias property, not with it: 5 + 2 + 7 + 240 <= 256 < 5 + 2 + 7 + 1 + 3 + 240
+  const std::string payload(240, 'p');
+  TEST_ASSERT_FALSE(mqtt.publish("t/alias", payload.c_str()));
+  TEST_ASSERT_TRUE(net.tx.size() == served);
+  TEST_ASSERT_TRUE(mqtt.publish("t/alias", "ok"));
+  TEST_ASSERT_TRUE(mqtt.publish("t/alias", "again"));
+  const std::vector<Published> published = received_by_broker();
+  TEST_ASSERT_EQUAL_STRING("t/alias", published[0].topic.c_str());
+  TEST_ASSERT_EQUAL(1, published[0].alias);
+  TEST_ASSERT_EQUAL_STRING("again", published[1].payload.c_str());
+}
+
+void test_header_too_large_does_not_register_alias(void) {
+  mqtt.setBufferSize(32);
+  MQTTUserProperty user_property{ "a-long-user-property-key", "and-its-value" };
+  MQTTPublishProperties properties{ NULL, &user_property, 1 };
+  TEST_ASSERT_FALSE(mqtt.publish("t/x", (const uint8_t *)"p", 1, false, properties));
+  mqtt.setBufferSize(256);
+  TEST_ASSERT_TRUE(mqtt.publish("t/x", "p"));
+  const std::vector<Published> published = received_by_broker();
+  TEST_ASSERT_EQUAL_STRING("t/x", published[0].topic.c_str());
+  TEST_ASSERT_EQUAL(1, published[0].alias);
+}
+
+void test_failed_flush_drops_aliases_of_coalesced_publishes(void) {
+  TEST_ASSERT_TRUE(mqtt.publish("t/known", "1"));
+  received_by_broker();
+  TEST_ASSERT_TRUE(mqtt.setCoalescing(200));
+  // Both only queued; the second already uses the alias the first introduces
+  TEST_ASSERT_TRUE(mqtt.publish("t/queued", "2"));
+  TEST_ASSERT_TRUE(mqtt.publish("t/queued", "3"));
+  TEST_ASSERT_TRUE(net.tx.size() == served);
+  net.write_budget = 0;
+  mqtt.flush();
+  net.write_budget = SIZE_MAX;
+  TEST_ASSERT_TRUE(mqtt.publish("t/queued", "4"));
+  TEST_ASSERT_TRUE(mqtt.publish("t/known", "5"));
+  mqtt.flush();
+  const std::vector<Published> published = received_by_broker();
+  TEST_ASSERT_EQUAL(2, published.size());
+  TEST_ASSERT_EQUAL_STRING("t/queued", published[0].topic.c_str());
+  TEST_ASSERT_EQUAL(2, published[0].alias);
+  // Aliases registered before the lost batch stay
+  TEST_ASSERT_EQUAL(1, published[1].alias);
+  TEST_ASSERT_EQUAL_STRING("t/known", published[1].topic.c_str());
+}
+
+void test_begin_publish_registers_alias_on_complete_payload(void) {
+  TEST_ASSERT_TRUE(mqtt.beginPublish("t/stream", 4, false));
+  TEST_ASSERT_EQUAL(2, mqtt.write((const uint8_t *)"ab", 2));
+  // Two bytes short
+  TEST_ASSERT_EQUAL(0, mqtt.endPublish());
+  net.tx.resize(served);
+
+  TEST_ASSERT_TRUE(mqtt.beginPublish("t/stream", 4, false));
+  mqtt.write((const uint8_t *)"ab", 2);
+  mqtt.write('c');
+  mqtt.write('d');
+  TEST_ASSERT_EQUAL(1, mqtt.endPublish());
+  TEST_ASSERT_TRUE(mqtt.publish("t/stream", "next"));
+  const std::vector<Published> published = received_by_broker();
+  TEST_ASSERT_EQUAL(2, published.size());
+  TEST_ASSERT_EQUAL_STRING("t/stream", published[0].topic.c_str());
+  TEST_ASSERT_EQUAL_STRING("abcd", published[0].payload.c_str());
+  TEST_ASSERT_EQUAL(published[0].alias, published[1].alias);
+  TEST_ASSERT_EQUAL_STRING("next", published[1].payload.c_str());
+}
+
+void test_aliases_reset_on_reconnect(void) {
+  mqtt.publish("t/a", "1");
+  received_by_broker();
+  mqtt.disconnect();
+  connect();
+  mqtt.publish("t/a", "2");
+  const std::vector<Published> published = received_by_broker();
+  TEST_ASSERT_EQUAL_STRING("t/a", published[0].topic.c_str());
+  TEST_ASSERT_EQUAL(1, published[0].alias);
+}
+
+void test_publish_properties_encoding(void) {
+  mqtt.disconnect();
+  net.clear();
+  // No topic aliases allowed
+  net.push(connack({}));
+  TEST_ASSERT_TRUE(mqtt.connect("mqtt5"));
+  net.tx.clear();
+  MQTTUserProperty user_property{ "k", "v" };
+  MQTTPublishProperties properties{ "text/plain", &user_property, 1 };
+  TEST_ASSERT_TRUE(mqtt.publish("c", (const uint8_t *)"pp", 2, false, properties));
+  const std::vector<uint8_t> expected{ 0x30, 26, 0, 1, 'c', 20, MQTT5_PROP_CONTENT_TYPE, 0, 10, 't', 'e', 'x', 't', '/', 'p', 'l', 'a', 'i', 'n',
+                                       MQTT5_PROP_USER_PROPERTY, 0, 1, 'k', 0, 1, 'v', 'p', 'p' };
+  TEST_ASSERT_TRUE(expected == net.tx);
+}
+
+void test_incoming_publish_skips_properties(void) {
+  // Payload format indicator and message expiry interval in front of the payload
+  const std::vector<uint8_t> properties{ 7, 0x01, 0x01, 0x02, 0, 0, 0, 60 };
+  net.push(mqtt_publish("v1/devices/me/attributes", "{\"fw\":2}", MQTTQOS1, 7, &properties));
+  mqtt.loop();
+  TEST_ASSERT_EQUAL_STRING("v1/devices/me/attributes", received_topic.c_str());
+  TEST_ASSERT_EQUAL_STRING("{\"fw\":2}", received_payload.c_str());
+  TEST_ASSERT_TRUE(mqtt_puback(7) == std::vector<uint8_t>(net.tx.begin() + served, net.tx.end()));
+}
+
+void test_puback_reason_codes(void) {
+  const uint16_t accepted = mqtt.publishQos1("q", (const uint8_t *)"1", 1, false);
+  const uint16_t no_subscribers = mqtt.publishQos1("q", (const uint8_t *)"2", 1, false);
+  const uint16_t refused = mqtt.publishQos1("q", (const uint8_t *)"3", 1, false);
+  // Bare PUBACK, "no matching subscribers" (0x10), "not authorized" (0x87)
+  net.push(mqtt_puback(accepted));
+  net.push(mqtt_packet(0x40, { (uint8_t)(no_subscribers >> 8), (uint8_t)no_subscribers, 0x10, 0 }));
+  net.push(mqtt_packet(0x40, { (uint8_t)(refused >> 8), (uint8_t)refused, 0x87 }));
+  for (int i = 0; i < 3; i++) {
+    mqtt.loop();
+  }
+  TEST_ASSERT_EQUAL(3, completed.size());
+  TEST_ASSERT_TRUE(completed[0] == std::make_pair(accepted, true));
+  TEST_ASSERT_TRUE(completed[1] == std::make_pair(no_subscribers, true));
+  TEST_ASSERT_TRUE(completed[2] == std::make_pair(refused, false));
+  TEST_ASSERT_EQUAL_HEX8(0x87, mqtt.lastReasonCode());
+  TEST_ASSERT_EQUAL(0, mqtt.getInflightCount());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_connect_properties);
+  RUN_TEST(test_refused_connack_reason_code);
+  RUN_TEST(test_receive_maximum_narrows_window);
+  RUN_TEST(test_topic_alias_replaces_repeated_topic);
+  RUN_TEST(test_qos1_never_uses_alias);
+  RUN_TEST(test_failed_write_does_not_register_alias);
+  RUN_TEST(test_payload_too_large_does_not_register_alias);
+  RUN_TEST(test_header_too_large_does_not_register_alias);
+  RUN_TEST(test_failed_flush_drops_aliases_of_coalesced_publishes);
+  RUN_TEST(test_begin_publish_registers_alias_on_complete_payload);
+  RUN_TEST(test_aliases_reset_on_reconnect);
+  RUN_TEST(test_publish_properties_encoding);
+  RUN_TEST(test_incoming_publish_skips_properties);
+  RUN_TEST(test_puback_reason_codes);
+  return UNITY_END();
+}
@@ -0,0 +1,163 @@
+#include <chrono>
+#include <unity.h>
+
+#include <MockClient.h>
+#include <PubSubClient.h>
+
+static MockClient net;
+static PubSubClient mqtt;
+static std::string received_topic;
+static std::string received_payload;
+static unsigned received = 0;
+
+static void on_message(char *topic, uint8_t *payload, unsigned int length) {
+  received_topic = topic;
+  received_payload.assign((const char *)payload, length);
+  received++;
+}
+
+// Hands the packet to the socket fragment bytes at a time, calling loop() after each fragment.
+// Returns the loop() calls made before the message arrived
+static unsigned feed_in_fragments(const std::vector<uint8_t> &packet, size_t fragment) {
+  unsigned loops = 0;
+  const unsigned before = received;
+  for (size_t pos = 0; pos < packet.size() && received == before; pos += fragment) {
+    net.rx.insert(net.rx.end(), packet.begin() + pos, packet.begin() + std::min(pos + fragment, packet.size()));
+    mqtt.loop();
+    loops++;
+  }
+  return loops;
+}
+
+// Runs loop() until a message arrived or max_loops calls went by
+static void loop_until_received(unsigned max_loops) {
+  const unsigned before = received;
+  for (unsigned loops = 0; received == before && loops < max_loops; loops++) {
+    mqtt.loop();
+  }
+}
+
+void setUp(void) {
+  native_millis() = 1000;
+  net.clear();
+  received_topic.clear();
+  received_payload.clear();
+  received = 0;
+  mqtt.setClient(net);
+  mqtt.setServer("broker", 1883);
+  mqtt.setCallback(on_message);
+  mqtt.setBufferSize(MQTT_MAX_PACKET_SIZE);
+  net.push({ 0x20, 2, 0, 0 });
+  TEST_ASSERT_TRUE(mqtt.connect("parser"));
+  net.tx.clear();
+}
+
+void tearDown(void) {
+  mqtt.disconnect();
+}
+
+void test_publish_read_in_one_piece(void) {
+  net.push(mqtt_publish("v1/devices/me/rpc/request/1", "{\"method\":\"reboot\"}"));
+  mqtt.loop();
+  TEST_ASSERT_EQUAL(1, received);
+  TEST_ASSERT_EQUAL_STRING("v1/devices/me/rpc/request/1", received_topic.c_str());
+  TEST_ASSERT_EQUAL_STRING("{\"method\":\"reboot\"}", received_payload.c_str());
+}
+
+void test_publish_split_across_loop_calls(void) {
+  std::string payload(5000, 'a');
+  payload.back() = 'z';
+  const std::vector<uint8_t> packet = mqtt_publish("t/x", payload);
+  // Every call only sees what the socket has buffered and returns instead of waiting for the rest
+  TEST_ASSERT_EQUAL((packet.size() + 99) / 100, feed_in_fragments(packet, 100));
+  TEST_ASSERT_EQUAL(1, received);
+  TEST_ASSERT_EQUAL_STRING("t/x", received_topic.c_str());
+  TEST_ASSERT_TRUE(payload == received_payload);
+  // Bulk reads: a couple of reads for the header, then one per fragment the socket offered
+  TEST_ASSERT_LESS_OR_EQUAL(5000 / 100 + 8, net.reads);
+}
+
+void test_remaining_length_split_byte_by_byte(void) {
+  const std::string payload(300, 'p');
+  const std::vector<uint8_t> packet = mqtt_publish("t/slow", payload, MQTTQOS1, 0x1234);
+  TEST_ASSERT_EQUAL(packet.size(), feed_in_fragments(packet, 1));
+  TEST_ASSERT_TRUE(payload == received_payload);
+  // The PUBACK still answers the message id read in pieces
+  TEST_ASSERT_TRUE(mqtt_puback(0x1234) == net.tx);
+}
+
+void test_packet_larger_than_buffer_is_dropped(void) {
+  mqtt.setBufferSize(200);
+  net.push(mqtt_publish("t/big", std::string(1000, 'b')));
+  net.push(mqtt_publish("t/small", "ok"));
+  loop_until_received(100);
+  // The oversized packet is drained without overrunning the buffer, the following one still parses
+  TEST_ASSERT_EQUAL(1, received);
+  TEST_ASSERT_EQUAL_STRING("t/small", received_topic.c_str());
+  TEST_ASSERT_EQUAL_STRING("ok", received_payload.c_str());
+  TEST_ASSERT_EQUAL(net.rx.size(), net.rx_pos);
+}
+
+void test_invalid_remaining_length_disconnects(void) {
+  // A fifth length byte is never valid
+  net.push({ 0x30, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 });
+  for (int i = 0; i < 10; i++) {
+    mqtt.loop();
+  }
+  TEST_ASSERT_EQUAL(0, received);
+  TEST_ASSERT_FALSE(net.connected());
+  TEST_ASSERT_FALSE(mqtt.connected());
+}
+
+void test_largest_remaining_length_is_accepted(void) {
+  // Four length bytes are the maximum and must not be mistaken for the invalid fifth one
+  net.push({ 0x30, 0xFF, 0xFF, 0xFF, 0x7F });
+  net.available_cap = 5;
+  for (int i = 0; i < 10; i++) {
+    mqtt.loop();
+  }
+  TEST_ASSERT_TRUE(mqtt.connected());
+}
+
+void test_parser_throughput(void) {
+  mqtt.setBufferSize(UINT16_MAX);
+  const size_t sizes[] = { 64, 256, 1024, 4096, 16384, 65535 - 5 - 2 - 3 };
+  for (size_t size : sizes) {
+    const size_t packets = size < 4096 ? 2000 : 100;
+    const std::vector<uint8_t> packet = mqtt_publish("t/x", std::string(size, 'x'));
+    net.rx.clear();
+    net.rx_pos = 0;
+    for (size_t i = 0; i < packets; i++) {
+      net.push(packet);
+    }
+    // Sockets hand over roughly one TCP segment at a time
+    net.available_cap = 1460;
+    net.reads = 0;
+    received = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    while (net.rx_pos < net.rx.size()) {
+      mqtt.loop();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    TEST_ASSERT_EQUAL(packets, received);
+    TEST_ASSERT_EQUAL(size, received_payload.size());
+    char message[160];
+    snprintf(message, sizeof(message), "%6u B payload: %8.1f MB/s, %.1f reads per packet",
+             (unsigned)size, packets * packet.size() / seconds / 1e6, (double)net.reads / packets);
+    TEST_MESSAGE(message);
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_publish_read_in_one_piece);
+  RUN_TEST(test_publish_split_across_loop_calls);
+  RUN_TEST(test_remaining_length_split_byte_by_byte);
+  RUN_TEST(test_packet_larger_than_buffer_is_dropped);
+  RUN_TEST(test_invalid_remaining_length_disconnects);
+  RUN_TEST(test_largest_remaining_length_is_accepted);
+  RUN_TEST(test_parser_throughput);
+  return UNITY_END();
+}
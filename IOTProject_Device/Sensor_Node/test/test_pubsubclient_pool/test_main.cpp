@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include <new>
+#include <unity.h>
+
+#include <MockClient.h>
+#include <PubSubClientPool.h>
+
+// Timer wheels allocated with new, told apart from other allocations by their size
+static size_t wheel_allocations = 0;
+
+void *operator new(size_t size) {
+  if (size == sizeof(MQTTTimerWheel)) {
+    wheel_allocations++;
+  }
+  void *memory = malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void *memory) noexcept {
+  free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+  free(memory);
+}
+
+static MockClient nets[2];
+static PubSubClientPool *pool;
+
+static unsigned wakes = 0;
+static unsigned long wake_at = 0;
+
+static void on_wake(void *arg, unsigned long expires) {
+  wakes++;
+  wake_at = expires;
+}
+
+// Acquires the session of token and lets the pool finish its connect
+static PubSubClient *connect(const char *token, MockClient &net) {
+  net.push({ 0x20, 2, 0, 0 });
+  PubSubClient *mqtt = pool->acquire(token);
+  TEST_ASSERT_NOT_NULL(mqtt);
+  for (int i = 0; i < 3 && !mqtt->connected(); i++) {
+    pool->loop();
+  }
+  TEST_ASSERT_TRUE(mqtt->connected());
+  net.tx.clear();
+  return mqtt;
+}
+
+static bool sent_ping(MockClient &net) {
+  return net.tx == std::vector<uint8_t>{ MQTTPINGREQ, 0 };
+}
+
+void setUp(void) {
+  native_millis() = 1000;
+  wakes = 0;
+  wake_at = 0;
+  wheel_allocations = 0;
+  pool = new PubSubClientPool();
+  for (MockClient &net : nets) {
+    net.clear();
+    TEST_ASSERT_TRUE(pool->addClient(net));
+  }
+  pool->setServer("broker", 1883);
+  pool->setBufferSize(256);
+  pool->setIdleTimeout(60);
+}
+
+void tearDown(void) {
+  delete pool;
+}
+
+void test_session_per_token(void) {
+  PubSubClient *a = connect("token-a", nets[0]);
+  PubSubClient *b = connect("token-b", nets[1]);
+  TEST_ASSERT_TRUE(a != b);
+  TEST_ASSERT_TRUE(a == pool->acquire("token-a"));
+  TEST_ASSERT_EQUAL(2, pool->activeSessions());
+  // Both slots taken: the least recently used session (b) makes room
+  delay(10);
+  pool->acquire("token-a");
+  nets[1].push({ 0x20, 2, 0, 0 });
+  PubSubClient *c = pool->acquire("token-c");
+  TEST_ASSERT_TRUE(b == c);
+  TEST_ASSERT_EQUAL(2, pool->activeSessions());
+}
+
+void test_keepalives_run_from_the_pool_wheel(void) {
+  connect("token-a", nets[0]);
+  delay(5000);
+  connect("token-b", nets[1]);
+  TEST_ASSERT_EQUAL(MQTT_KEEPALIVE * 1000UL - 5000 + 1, pool->msUntilNextTimer());
+  // Nothing to read: loop() only runs the wheel, which pings each session on its own deadline
+  delay(MQTT_KEEPALIVE * 1000UL - 5000 + MQTT_TIMER_WHEEL_TICK);
+  pool->loop();
+  TEST_ASSERT_TRUE(sent_ping(nets[0]));
+  TEST_ASSERT_TRUE(nets[1].tx.empty());
+  delay(5000);
+  pool->loop();
+  TEST_ASSERT_TRUE(sent_ping(nets[1]));
+}
+
+void test_idle_session_is_closed(void) {
+  connect("token-a", nets[0]);
+  delay(30000);
+  PubSubClient *b = connect("token-b", nets[1]);
+  // Keep the sessions answering pings
+  for (int second = 0; second < 40; second++) {
+    delay(1000);
+    for (MockClient &net : nets) {
+      if (sent_ping(net)) {
+        net.tx.clear();
+        net.push({ MQTTPINGRESP, 0 });
+      }
+    }
+    pool->loop();
+    pool->loop();
+  }
+  // token-a unused for 70 s, token-b for 40 s
+  TEST_ASSERT_EQUAL(1, pool->activeSessions());
+  TEST_ASSERT_FALSE(nets[0].connected());
+  TEST_ASSERT_TRUE(b->connected());
+  // Using a session pushes its expiry back
+  delay(15000);
+  pool->acquire("token-b");
+  delay(15000);
+  pool->loop();
+  TEST_ASSERT_EQUAL(1, pool->activeSessions());
+}
+
+void test_released_session_leaves_no_timer(void) {
+  connect("token-a", nets[0]);
+  TEST_ASSERT_NOT_EQUAL(MQTT_NO_TIMER, pool->msUntilNextTimer());
+  pool->release("token-a");
+  TEST_ASSERT_EQUAL(0, pool->activeSessions());
+  TEST_ASSERT_EQUAL(MQTT_NO_TIMER, pool->msUntilNextTimer());
+}
+
+void test_wake_callback(void) {
+  pool->setWakeCallback(on_wake, NULL);
+  connect("token-a", nets[0]);
+  // Armed for the CONNACK timeout, which the CONNACK cancelled again
+  TEST_ASSERT_EQUAL(1000 + MQTT_SOCKET_TIMEOUT * 1000UL, wake_at);
+  // The spurious wake finds nothing due and re-arms for the keepalive
+  native_millis() = wake_at;
+  pool->loop();
+  TEST_ASSERT_TRUE(nets[0].tx.empty());
+  TEST_ASSERT_EQUAL(1000 + MQTT_KEEPALIVE * 1000UL + 1, wake_at);
+  native_millis() = wake_at;
+  pool->loop();
+  TEST_ASSERT_TRUE(sent_ping(nets[0]));
+  // Next: the ping timeout
+  TEST_ASSERT_EQUAL(millis() + MQTT_KEEPALIVE * 1000UL + 1, wake_at);
+}
+
+void test_sessions_share_the_pool_wheel(void) {
+  connect("token-a", nets[0]);
+  connect("token-b", nets[1]);
+  // Neither session allocated a wheel of its own, the pool's wheel serves both
+  TEST_ASSERT_EQUAL(0, wheel_allocations);
+
+  char message[128];
+  snprintf(message, sizeof(message), "PubSubClient %zu bytes, a wheel of its own would add %zu bytes per session",
+    sizeof(PubSubClient), sizeof(MQTTTimerWheel));
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_session_per_token);
+  RUN_TEST(test_keepalives_run_from_the_pool_wheel);
+  RUN_TEST(test_idle_session_is_closed);
+  RUN_TEST(test_released_session_leaves_no_timer);
+  RUN_TEST(test_wake_callback);
+  RUN_TEST(test_sessions_share_the_pool_wheel);
+  return UNITY_END();
+}
@@ -0,0 +1,171 @@
+#include <chrono>
+#include <unity.h>
+
+#include <MockClient.h>
+#include <PubSubClient.h>
+
+// Counts how many written bytes came straight from the caller's payload instead of a copy
+class SourceClient : public MockClient {
+  public:
+    const uint8_t *payload_begin = nullptr;
+    const uint8_t *payload_end = nullptr;
+    size_t from_payload = 0;
+    bool keep = true;  // Whether written bytes are kept in tx, off for the benchmark
+
+    size_t write(const uint8_t *buf, size_t size) override {
+      if (buf >= payload_begin && buf + size <= payload_end) {
+        from_payload += size;
+      }
+      if (!keep) {
+        writes++;
+        return size;
+      }
+      return MockClient::write(buf, size);
+    }
+    using MockClient::write;
+};
+
+static SourceClient net;
+static PubSubClient mqtt;
+
+void setUp(void) {
+  native_millis() = 1000;
+  net.clear();
+  net.payload_begin = net.payload_end = nullptr;
+  net.from_payload = 0;
+  net.keep = true;
+  mqtt.setClient(net);
+  mqtt.setServer("broker", 1883);
+  mqtt.setBufferSize(MQTT_MAX_PACKET_SIZE);
+  net.push({ 0x20, 2, 0, 0 });
+  TEST_ASSERT_TRUE(mqtt.connect("publishv"));
+  net.tx.clear();
+  net.writes = 0;
+}
+
+void tearDown(void) {
+  mqtt.disconnect();
+}
+
+void test_publishv_matches_publish(void) {
+  const std::string a = "{\"ts\":1700000000000,", b = "\"values\":{\"temperature\":21.5}", c = "}";
+  const MQTTIOVec iov[3] = { { a.data(), a.size() }, { b.data(), b.size() }, { c.data(), c.size() } };
+  TEST_ASSERT_TRUE(mqtt.publishv("v1/devices/me/telemetry", iov, 3, false));
+  TEST_ASSERT_TRUE(mqtt_publish("v1/devices/me/telemetry", a + b + c) == net.tx);
+
+  net.tx.clear();
+  TEST_ASSERT_TRUE(mqtt.publishv("t/r", iov, 3, true));
+  TEST_ASSERT_TRUE(mqtt_publish("t/r", a + b + c, 1) == net.tx);
+}
+
+void test_payload_larger_than_buffer(void) {
+  // Only the header and topic have to fit, the payload never enters the buffer
+  mqtt.setBufferSize(64);
+  const std::string a(100, 'a'), b(30000, 'b');
+  const MQTTIOVec iov[2] = { { a.data(), a.size() }, { b.data(), b.size() } };
+  TEST_ASSERT_TRUE(mqtt.publishv("t/x", iov, 2, false));
+  TEST_ASSERT_TRUE(mqtt_publish("t/x", a + b) == net.tx);
+  TEST_ASSERT_EQUAL(3, net.writes);
+}
+
+void test_empty_fragments_are_skipped(void) {
+  const std::string a = "abc";
+  const MQTTIOVec iov[3] = { { nullptr, 0 }, { a.data(), a.size() }, { nullptr, 0 } };
+  TEST_ASSERT_TRUE(mqtt.publishv("t", iov, 3, false));
+  TEST_ASSERT_TRUE(mqtt_publish("t", a) == net.tx);
+  TEST_ASSERT_EQUAL(2, net.writes);
+
+  net.tx.clear();
+  TEST_ASSERT_TRUE(mqtt.publishv("t", iov, 0, false));
+  TEST_ASSERT_TRUE(mqtt_publish("t", "") == net.tx);
+}
+
+void test_topic_larger_than_buffer_fails(void) {
+  mqtt.setBufferSize(16);
+  const MQTTIOVec iov[1] = { { "x", 1 } };
+  TEST_ASSERT_FALSE(mqtt.publishv("a/topic/that/does/not/fit", iov, 1, false));
+  TEST_ASSERT_TRUE(net.tx.empty());
+}
+
+void test_short_write_fails(void) {
+  const std::string a(100, 'a'), b(100, 'b');
+  const MQTTIOVec iov[2] = { { a.data(), a.size() }, { b.data(), b.size() } };
+  net.write_budget = 150;
+  TEST_ASSERT_FALSE(mqtt.publishv("t", iov, 2, false));
+  // Nothing is written after the fragment that came up short
+  TEST_ASSERT_EQUAL(150, net.tx.size());
+  TEST_ASSERT_EQUAL(3, net.writes);
+}
+
+void test_not_connected_fails(void) {
+  mqtt.disconnect();
+  net.tx.clear();
+  const MQTTIOVec iov[1] = { { "x", 1 } };
+  TEST_ASSERT_FALSE(mqtt.publishv("t", iov, 1, false));
+  TEST_ASSERT_TRUE(net.tx.empty());
+}
+
+void test_bytes_copied(void) {
+  const std::string payload(4096, 'p');
+  net.payload_begin = (const uint8_t *)payload.data();
+  net.payload_end = net.payload_begin + payload.size();
+
+  TEST_ASSERT_TRUE(mqtt.publish("v1/devices/me/telemetry", (const uint8_t *)payload.data(), payload.size()));
+  const size_t publish_copied = net.tx.size() - net.from_payload;
+
+  net.tx.clear();
+  net.from_payload = 0;
+  const MQTTIOVec iov[2] = { { payload.data(), 1024 }, { payload.data() + 1024, payload.size() - 1024 } };
+  TEST_ASSERT_TRUE(mqtt.publishv("v1/devices/me/telemetry", iov, 2, false));
+  const size_t publishv_copied = net.tx.size() - net.from_payload;
+
+  char message[160];
+  snprintf(message, sizeof(message), "4096 B payload, bytes copied into the client buffer: publish %u, publishv %u",
+           (unsigned)publish_copied, (unsigned)publishv_copied);
+  TEST_MESSAGE(message);
+  // publish() copies topic and payload, publishv() only the fixed header and topic
+  TEST_ASSERT_EQUAL(net.tx.size(), publish_copied);
+  TEST_ASSERT_EQUAL(payload.size(), net.from_payload);
+  TEST_ASSERT_EQUAL(net.tx.size() - payload.size(), publishv_copied);
+}
+
+void test_publishv_throughput(void) {
+  net.keep = false;
+  const size_t sizes[] = { 256, 4096, 16384 };
+  for (size_t size : sizes) {
+    const std::string payload(size, 'p');
+    const size_t third = size / 3;
+    const MQTTIOVec iov[3] = { { payload.data(), third }, { payload.data() + third, third }, { payload.data() + 2 * third, size - 2 * third } };
+    const int rounds = 20000;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+      TEST_ASSERT_TRUE(mqtt.publish("v1/devices/me/telemetry", (const uint8_t *)payload.data(), size));
+    }
+    const double copied = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+      TEST_ASSERT_TRUE(mqtt.publishv("v1/devices/me/telemetry", iov, 3, false));
+    }
+    const double gathered = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    char message[160];
+    snprintf(message, sizeof(message), "%5u B payload: publish %8.1f MB/s, publishv %8.1f MB/s",
+             (unsigned)size, rounds * size / copied / 1e6, rounds * size / gathered / 1e6);
+    TEST_MESSAGE(message);
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_publishv_matches_publish);
+  RUN_TEST(test_payload_larger_than_buffer);
+  RUN_TEST(test_empty_fragments_are_skipped);
+  RUN_TEST(test_topic_larger_than_buffer_fails);
+  RUN_TEST(test_short_write_fails);
+  RUN_TEST(test_not_connected_fails);
+  RUN_TEST(test_bytes_copied);
+  RUN_TEST(test_publishv_throughput);
+  return UNITY_END();
+}
@@ -0,0 +1,222 @@
+#include <deque>
+#include <map>
+#include <unity.h>
+
+#include <MockClient.h>
+#include <PubSubClient.h>
+
+static MockClient net;
+static PubSubClient mqtt;
+static std::map<uint16_t, bool> completed;  // Publish callback results by message id
+static size_t served = 0;                   // Bytes of net.tx the broker has looked at
+static std::vector<std::vector<uint8_t>> publishes;  // PUBLISH packets the broker received
+
+static void on_publish(uint16_t id, boolean delivered) {
+  completed[id] = delivered;
+}
+
+static uint16_t packet_id(const std::vector<uint8_t> &publish) {
+  // Fixed header, topic "t", message id
+  const size_t pos = publish.size() - 5 - 2;
+  return (publish[pos] << 8) | publish[pos + 1];
+}
+
+// Broker side: collects new publishes and answers pings, acknowledging nothing on its own
+static void serve() {
+  const std::vector<uint8_t> written(net.tx.begin() + served, net.tx.end());
+  served = net.tx.size();
+  for (const std::vector<uint8_t> &packet : mqtt_split(written)) {
+    if ((packet[0] & 0xF0) == MQTTPUBLISH) {
+      publishes.push_back(packet);
+    } else if (packet[0] == MQTTPINGREQ) {
+      net.push({ MQTTPINGRESP, 0 });
+    }
+  }
+}
+
+static uint16_t publish() {
+  return mqtt.publishQos1("t", (const uint8_t *)"hello", 5, false);
+}
+
+static void connect(bool clean_session) {
+  net.push({ 0x20, 2, 0, 0 });
+  TEST_ASSERT_TRUE(mqtt.connect("qos1", NULL, NULL, NULL, 0, false, NULL, clean_session));
+  served = net.tx.size();
+}
+
+void setUp(void) {
+  native_millis() = 1000;
+  net.clear();
+  mqtt.setClient(net);
+  mqtt.setServer("broker", 1883);
+  mqtt.setPublishCallback(on_publish);
+  mqtt.setInflightWindow(8);
+  mqtt.setRetransmitTimeout(MQTT_RETRANSMIT_TIMEOUT);
+  // The clean session also fails whatever a previous test left in flight
+  connect(true);
+  completed.clear();
+  publishes.clear();
+}
+
+void tearDown(void) {
+  mqtt.disconnect();
+}
+
+void test_window_limits_unacknowledged_publishes(void) {
+  uint16_t ids[10];
+  for (int i = 0; i < 10; i++) {
+    ids[i] = publish();
+  }
+  for (int i = 0; i < 8; i++) {
+    TEST_ASSERT_NOT_EQUAL(0, ids[i]);
+    for (int j = 0; j < i; j++) {
+      TEST_ASSERT_NOT_EQUAL(ids[j], ids[i]);
+    }
+  }
+  TEST_ASSERT_EQUAL(0, ids[8]);
+  TEST_ASSERT_EQUAL(0, ids[9]);
+  TEST_ASSERT_EQUAL(8, mqtt.getInflightCount());
+  serve();
+  TEST_ASSERT_EQUAL(8, publishes.size());
+  TEST_ASSERT_EQUAL_HEX8(MQTTPUBLISH | MQTTQOS1, publishes[0][0]);
+}
+
+void test_out_of_order_puback_completes_matching_publish(void) {
+  uint16_t ids[4];
+  for (int i = 0; i < 4; i++) {
+    ids[i] = publish();
+  }
+  net.push(mqtt_puback(ids[3]));
+  net.push(mqtt_puback(ids[0]));
+  // One packet per loop() call
+  mqtt.loop();
+  mqtt.loop();
+  TEST_ASSERT_EQUAL(2, completed.size());
+  TEST_ASSERT_TRUE(completed[ids[3]]);
+  TEST_ASSERT_TRUE(completed[ids[0]]);
+  TEST_ASSERT_EQUAL(2, mqtt.getInflightCount());
+  // The freed slots take new publishes again
+  TEST_ASSERT_NOT_EQUAL(0, publish());
+  // A PUBACK for an id nobody waits for is ignored
+  net.push(mqtt_puback(0x7777));
+  mqtt.loop();
+  TEST_ASSERT_EQUAL(3, mqtt.getInflightCount());
+}
+
+void test_retransmit_sets_dup_and_gives_up(void) {
+  const uint16_t id = publish();
+  serve();
+  TEST_ASSERT_EQUAL(1, publishes.size());
+  TEST_ASSERT_FALSE(publishes[0][0] & MQTTDUP);
+
+  for (int retry = 1; retry <= MQTT_MAX_RETRANSMITS; retry++) {
+    delay(MQTT_RETRANSMIT_TIMEOUT * 1000UL);
+    mqtt.loop();
+    serve();
+    mqtt.loop();
+    TEST_ASSERT_EQUAL(1 + retry, publishes.size());
+    TEST_ASSERT_TRUE(publishes.back()[0] & MQTTDUP);
+    TEST_ASSERT_EQUAL(id, packet_id(publishes.back()));
+    TEST_ASSERT_TRUE(completed.empty());
+  }
+  delay(MQTT_RETRANSMIT_TIMEOUT * 1000UL);
+  mqtt.loop();
+  serve();
+  TEST_ASSERT_EQUAL(1 + MQTT_MAX_RETRANSMITS, publishes.size());
+  TEST_ASSERT_EQUAL(1, completed.size());
+  TEST_ASSERT_FALSE(completed[id]);
+  TEST_ASSERT_EQUAL(0, mqtt.getInflightCount());
+}
+
+void test_resumed_session_resends_in_flight(void) {
+  const uint16_t first = publish();
+  const uint16_t second = publish();
+  served = net.tx.size();
+  net.stop();
+  TEST_ASSERT_FALSE(mqtt.connected());
+  net.push({ 0x20, 2, 1, 0 });
+  TEST_ASSERT_TRUE(mqtt.connect("qos1", NULL, NULL, NULL, 0, false, NULL, false));
+  // Both come again with DUP right behind the CONNECT
+  const std::vector<std::vector<uint8_t>> packets = mqtt_split(std::vector<uint8_t>(net.tx.begin() + served, net.tx.end()));
+  TEST_ASSERT_EQUAL(3, packets.size());
+  TEST_ASSERT_EQUAL_HEX8(MQTTCONNECT, packets[0][0]);
+  TEST_ASSERT_EQUAL_HEX8(MQTTPUBLISH | MQTTQOS1 | MQTTDUP, packets[1][0]);
+  TEST_ASSERT_EQUAL(first, packet_id(packets[1]));
+  TEST_ASSERT_EQUAL(second, packet_id(packets[2]));
+  TEST_ASSERT_TRUE(completed.empty());
+}
+
+void test_clean_session_fails_in_flight(void) {
+  const uint16_t id = publish();
+  net.stop();
+  connect(true);
+  TEST_ASSERT_EQUAL(1, completed.size());
+  TEST_ASSERT_FALSE(completed[id]);
+  TEST_ASSERT_EQUAL(0, mqtt.getInflightCount());
+}
+
+void test_message_ids_skip_zero_and_ids_in_flight(void) {
+  const uint16_t held = publish();
+  for (uint32_t i = 0; i < 0x10000; i++) {
+    const uint16_t id = publish();
+    TEST_ASSERT_NOT_EQUAL(0, id);
+    TEST_ASSERT_NOT_EQUAL(held, id);
+    net.push(mqtt_puback(id));
+    mqtt.loop();
+  }
+  TEST_ASSERT_EQUAL(1, mqtt.getInflightCount());
+}
+
+// Mock broker acknowledging every publish rtt ms after it was written, in virtual time
+static unsigned acknowledged_per_second(uint8_t window, unsigned rtt) {
+  mqtt.setInflightWindow(window);
+  std::deque<std::pair<unsigned long, uint16_t>> pending;
+  unsigned acknowledged = 0;
+  const unsigned long end = millis() + 10000;
+  while (millis() < end) {
+    while (publish() != 0) {}
+    serve();
+    for (const std::vector<uint8_t> &packet : publishes) {
+      pending.emplace_back(millis() + rtt, packet_id(packet));
+    }
+    publishes.clear();
+    delay(1);
+    while (!pending.empty() && pending.front().first <= millis()) {
+      net.push(mqtt_puback(pending.front().second));
+      pending.pop_front();
+      acknowledged++;
+    }
+    // loop() handles one packet per call
+    do {
+      mqtt.loop();
+    } while (net.available() > 0);
+  }
+  return acknowledged / 10;
+}
+
+void test_throughput_by_window(void) {
+  const unsigned rtt = 50;
+  const unsigned one = acknowledged_per_second(1, rtt);
+  const unsigned eight = acknowledged_per_second(8, rtt);
+  const unsigned thirty_two = acknowledged_per_second(MQTT_MAX_INFLIGHT, rtt);
+  char message[160];
+  snprintf(message, sizeof(message), "%u ms RTT, QoS 1 publishes per second: window 1 %u, window 8 %u, window %u %u",
+           rtt, one, eight, MQTT_MAX_INFLIGHT, thirty_two);
+  TEST_MESSAGE(message);
+  // Stop-and-wait is bound by the round trip, a window of n keeps n round trips busy
+  TEST_ASSERT_UINT_WITHIN(2, 1000 / rtt, one);
+  TEST_ASSERT_GREATER_OR_EQUAL(7 * one, eight);
+  TEST_ASSERT_GREATER_OR_EQUAL(3 * eight, thirty_two);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_window_limits_unacknowledged_publishes);
+  RUN_TEST(test_out_of_order_puback_completes_matching_publish);
+  RUN_TEST(test_retransmit_sets_dup_and_gives_up);
+  RUN_TEST(test_resumed_session_resends_in_flight);
+  RUN_TEST(test_clean_session_fails_in_flight);
+  RUN_TEST(test_message_ids_skip_zero_and_ids_in_flight);
+  RUN_TEST(test_throughput_by_window);
+  return UNITY_END();
+}
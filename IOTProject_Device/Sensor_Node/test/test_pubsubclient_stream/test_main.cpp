@@ -0,0 +1,164 @@
+#include <unity.h>
+
+#include <MockClient.h>
+#include <PubSubClient.h>
+
+// One streamCallback call
+struct Fragment {
+  std::string topic;
+  uint32_t offset;
+  std::string data;
+  bool has_data;
+  uint32_t total;
+};
+
+static MockClient net;
+static PubSubClient mqtt;
+static std::vector<Fragment> fragments;
+
+static void on_fragment(const char *topic, uint32_t offset, const uint8_t *data, unsigned int length, uint32_t total) {
+  fragments.push_back({ topic, offset, data ? std::string((const char *)data, length) : std::string(), data != nullptr, total });
+}
+
+// Payload put back together from the fragments, checking their order on the way
+static std::string reassemble(const std::string &topic) {
+  TEST_ASSERT_FALSE(fragments.empty());
+  // Topic first, before any payload byte
+  TEST_ASSERT_FALSE(fragments[0].has_data);
+  TEST_ASSERT_EQUAL(0, fragments[0].offset);
+  std::string payload;
+  for (size_t i = 1; i < fragments.size(); i++) {
+    TEST_ASSERT_EQUAL_STRING(topic.c_str(), fragments[i].topic.c_str());
+    TEST_ASSERT_EQUAL(payload.size(), fragments[i].offset);
+    TEST_ASSERT_EQUAL(fragments[0].total, fragments[i].total);
+    payload += fragments[i].data;
+  }
+  TEST_ASSERT_EQUAL(fragments[0].total, payload.size());
+  return payload;
+}
+
+// Hands the bytes to the socket fragment bytes at a time, calling loop() after each fragment
+static void feed_in_fragments(const std::vector<uint8_t> &bytes, size_t fragment) {
+  for (size_t pos = 0; pos < bytes.size(); pos += fragment) {
+    net.rx.insert(net.rx.end(), bytes.begin() + pos, bytes.begin() + std::min(pos + fragment, bytes.size()));
+    mqtt.loop();
+  }
+}
+
+static std::string firmware_chunk(size_t size) {
+  std::string payload(size, '\0');
+  for (size_t i = 0; i < size; i++) {
+    payload[i] = (char)(i * 31 + 7);
+  }
+  return payload;
+}
+
+void setUp(void) {
+  native_millis() = 1000;
+  net.clear();
+  fragments.clear();
+  mqtt.setClient(net);
+  mqtt.setServer("broker", 1883);
+  mqtt.setBufferSize(64);
+  mqtt.setStreamCallback(on_fragment);
+  net.push({ 0x20, 2, 0, 0 });
+  TEST_ASSERT_TRUE(mqtt.connect("stream"));
+  net.tx.clear();
+}
+
+void tearDown(void) {
+  mqtt.disconnect();
+}
+
+void test_topic_then_payload_fragments(void) {
+  const std::string topic = "v2/fw/response/0/chunk/3";
+  net.push(mqtt_publish(topic, "hello"));
+  mqtt.loop();
+  TEST_ASSERT_EQUAL(2, fragments.size());
+  TEST_ASSERT_EQUAL_STRING(topic.c_str(), fragments[0].topic.c_str());
+  TEST_ASSERT_EQUAL(5, fragments[0].total);
+  TEST_ASSERT_EQUAL_STRING("hello", reassemble(topic).c_str());
+}
+
+void test_payload_larger_than_buffer(void) {
+  // 64 byte buffer, 10 KB firmware chunk
+  const std::string topic = "v2/fw/response/0/chunk/0";
+  const std::string payload = firmware_chunk(10000);
+  net.push(mqtt_publish(topic, payload));
+  mqtt.loop();
+  TEST_ASSERT_GREATER_THAN(2, fragments.size());
+  TEST_ASSERT_TRUE(payload == reassemble(topic));
+  for (size_t i = 1; i < fragments.size(); i++) {
+    // Each fragment fits the buffer behind the topic
+    TEST_ASSERT_LESS_OR_EQUAL(64 - topic.size(), fragments[i].data.size());
+  }
+}
+
+void test_fragmented_socket_reads(void) {
+  const std::string topic = "v2/fw/response/0/chunk/1";
+  const std::string payload = firmware_chunk(4000);
+  const std::vector<uint8_t> packet = mqtt_publish(topic, payload);
+  // Sizes that split the length field, the topic length and the topic itself
+  const size_t sizes[] = { 1, 2, 3, 7, 61, 1460 };
+  for (size_t size : sizes) {
+    fragments.clear();
+    feed_in_fragments(packet, size);
+    TEST_ASSERT_TRUE(payload == reassemble(topic));
+    // A new publish starts cleanly behind the previous one
+    TEST_ASSERT_EQUAL(net.rx.size(), net.rx_pos);
+  }
+}
+
+void test_qos1_stream_is_acknowledged(void) {
+  const std::string topic = "v1/devices/me/attributes";
+  const std::string payload = firmware_chunk(500);
+  feed_in_fragments(mqtt_publish(topic, payload, MQTTQOS1, 0xBEEF), 13);
+  TEST_ASSERT_TRUE(payload == reassemble(topic));
+  TEST_ASSERT_TRUE(mqtt_puback(0xBEEF) == net.tx);
+}
+
+void test_empty_payload(void) {
+  net.push(mqtt_publish("t/empty", ""));
+  mqtt.loop();
+  TEST_ASSERT_EQUAL(1, fragments.size());
+  TEST_ASSERT_EQUAL(0, fragments[0].total);
+}
+
+void test_topic_larger_than_buffer_is_dropped(void) {
+  const std::string long_topic(100, 't');
+  net.push(mqtt_publish(long_topic, firmware_chunk(300)));
+  net.push(mqtt_publish("t/next", "ok"));
+  mqtt.loop();
+  // The packet whose topic cannot be terminated in the buffer is drained unseen
+  TEST_ASSERT_TRUE(fragments.empty());
+  TEST_ASSERT_TRUE(mqtt.connected());
+  mqtt.loop();
+  TEST_ASSERT_EQUAL_STRING("ok", reassemble("t/next").c_str());
+}
+
+void test_other_packets_between_streams(void) {
+  net.push({ MQTTPINGRESP, 0 });
+  net.push(mqtt_publish("t/a", "first"));
+  net.push(mqtt_puback(0x1234));
+  net.push(mqtt_publish("t/b", "second"));
+  for (int i = 0; i < 4; i++) {
+    mqtt.loop();
+  }
+  TEST_ASSERT_EQUAL(4, fragments.size());
+  TEST_ASSERT_EQUAL_STRING("t/a", fragments[0].topic.c_str());
+  TEST_ASSERT_EQUAL_STRING("first", fragments[1].data.c_str());
+  TEST_ASSERT_EQUAL_STRING("t/b", fragments[2].topic.c_str());
+  TEST_ASSERT_EQUAL_STRING("second", fragments[3].data.c_str());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_topic_then_payload_fragments);
+  RUN_TEST(test_payload_larger_than_buffer);
+  RUN_TEST(test_fragmented_socket_reads);
+  RUN_TEST(test_qos1_stream_is_acknowledged);
+  RUN_TEST(test_empty_payload);
+  RUN_TEST(test_topic_larger_than_buffer_is_dropped);
+  RUN_TEST(test_other_packets_between_streams);
+  return UNITY_END();
+}
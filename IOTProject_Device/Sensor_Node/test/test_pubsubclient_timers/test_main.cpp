@@ -0,0 +1,217 @@
+#include <unity.h>
+
+#include <MockClient.h>
+#include <PubSubClient.h>
+
+static MockClient first_net, second_net;
+static PubSubClient *first, *second;
+
+// Stands in for a one-shot esp_timer: remembers the expiry it was last armed for
+static unsigned wakes = 0;
+static unsigned long wake_at = 0;
+
+static void on_wake(void *arg, unsigned long expires) {
+  TEST_ASSERT_EQUAL_PTR(&wakes, arg);
+  wakes++;
+  wake_at = expires;
+}
+
+static void connect(PubSubClient &mqtt, MockClient &net) {
+  net.clear();
+  net.push({ 0x20, 2, 0, 0 });
+  mqtt.setClient(net);
+  mqtt.setServer("broker", 1883);
+  TEST_ASSERT_TRUE(mqtt.connect("timers"));
+  net.tx.clear();
+}
+
+static bool sent_ping(MockClient &net) {
+  return net.tx == std::vector<uint8_t>{ MQTTPINGREQ, 0 };
+}
+
+void setUp(void) {
+  native_millis() = 1000;
+  wakes = 0;
+  wake_at = 0;
+  first = new PubSubClient();
+  second = new PubSubClient();
+  first->setKeepAlive(10);
+  second->setKeepAlive(20);
+}
+
+void tearDown(void) {
+  delete first;
+  delete second;
+}
+
+void test_keepalive_on_virtual_clock(void) {
+  connect(*first, first_net);
+  TEST_ASSERT_EQUAL(10001, first->msUntilNextTimer());
+  delay(10000);
+  first->loop();
+  TEST_ASSERT_TRUE(first_net.tx.empty());
+  // The wheel ticks in MQTT_TIMER_WHEEL_TICK ms, the keepalive is due 1 ms after the interval
+  delay(MQTT_TIMER_WHEEL_TICK);
+  first->loop();
+  TEST_ASSERT_TRUE(sent_ping(first_net));
+  // No PINGRESP within the next interval closes the connection
+  delay(10000 + MQTT_TIMER_WHEEL_TICK);
+  first->loop();
+  TEST_ASSERT_EQUAL(MQTT_CONNECTION_TIMEOUT, first->state());
+  TEST_ASSERT_EQUAL(MQTT_NO_TIMER, first->msUntilNextTimer());
+}
+
+void test_traffic_pushes_keepalive_back(void) {
+  connect(*first, first_net);
+  delay(6000);
+  // Traffic in both directions, the keepalive counts from the idler one
+  first_net.push(mqtt_publish("t", "in"));
+  first->loop();
+  TEST_ASSERT_TRUE(first->publish("t", "out"));
+  first_net.tx.clear();
+  delay(4100);
+  // The timer fires, finds the traffic and re-arms for the new deadline instead of pinging
+  first->loop();
+  TEST_ASSERT_TRUE(first_net.tx.empty());
+  TEST_ASSERT_UINT_WITHIN(MQTT_TIMER_WHEEL_TICK, 6000, first->msUntilNextTimer());
+  delay(6000);
+  first->loop();
+  TEST_ASSERT_TRUE(sent_ping(first_net));
+}
+
+void test_connack_timeout(void) {
+  first_net.clear();
+  first->setClient(first_net);
+  first->setServer("broker", 1883);
+  first->setSocketTimeout(5);
+  TEST_ASSERT_TRUE(first->beginConnect("timers", NULL, NULL));
+  TEST_ASSERT_EQUAL(0, first->pollConnect());
+  delay(4900);
+  TEST_ASSERT_EQUAL(0, first->pollConnect());
+  delay(200);
+  TEST_ASSERT_EQUAL(-1, first->pollConnect());
+  TEST_ASSERT_EQUAL(MQTT_CONNECTION_TIMEOUT, first->state());
+}
+
+void test_clients_keep_separate_wheels(void) {
+  connect(*first, first_net);
+  connect(*second, second_net);
+  TEST_ASSERT_EQUAL(10001, first->msUntilNextTimer());
+  TEST_ASSERT_EQUAL(20001, second->msUntilNextTimer());
+  delay(10100);
+  // Running one client does not fire the timers of the other
+  second->loop();
+  TEST_ASSERT_TRUE(first_net.tx.empty());
+  first->loop();
+  TEST_ASSERT_TRUE(sent_ping(first_net));
+  TEST_ASSERT_TRUE(second_net.tx.empty());
+  // Destroying a client leaves the other one's timers alone
+  delete first;
+  first = new PubSubClient();
+  TEST_ASSERT_UINT_WITHIN(MQTT_TIMER_WHEEL_TICK, 9900, second->msUntilNextTimer());
+  delay(10000);
+  second->loop();
+  TEST_ASSERT_TRUE(sent_ping(second_net));
+}
+
+void test_shared_wheel_runs_every_client(void) {
+  MQTTTimerWheel wheel;
+  first->setTimerWheel(&wheel);
+  second->setTimerWheel(&wheel);
+  connect(*first, first_net);
+  connect(*second, second_net);
+  TEST_ASSERT_EQUAL(10001, first->msUntilNextTimer());
+  TEST_ASSERT_EQUAL(10001, second->msUntilNextTimer());
+  delay(20100);
+  // One run of the owner's wheel serves both clients
+  TEST_ASSERT_EQUAL(2, wheel.run(millis()));
+  TEST_ASSERT_TRUE(sent_ping(first_net));
+  TEST_ASSERT_TRUE(sent_ping(second_net));
+  first->setTimerWheel(NULL);
+  second->setTimerWheel(NULL);
+}
+
+void test_armed_timers_move_with_the_wheel(void) {
+  connect(*first, first_net);
+  MQTTTimerWheel wheel;
+  unsigned long expires;
+  TEST_ASSERT_FALSE(wheel.nextExpiry(&expires));
+  first->setTimerWheel(&wheel);
+  TEST_ASSERT_TRUE(wheel.nextExpiry(&expires));
+  TEST_ASSERT_EQUAL(1000 + 10001, expires);
+  first->setTimerWheel(NULL);
+  TEST_ASSERT_FALSE(wheel.nextExpiry(&expires));
+  TEST_ASSERT_EQUAL(10001, first->msUntilNextTimer());
+}
+
+void test_wake_callback_tracks_earliest_expiry(void) {
+  MQTTTimerWheel wheel;
+  wheel.setWakeCallback(on_wake, &wakes);
+  TEST_ASSERT_EQUAL(0, wakes);
+  second->setTimerWheel(&wheel);
+  connect(*second, second_net);
+  // Armed for the CONNACK timeout; the CONNACK cancelled it, which only costs one spurious wake
+  TEST_ASSERT_EQUAL(1, wakes);
+  TEST_ASSERT_EQUAL(1000 + MQTT_SOCKET_TIMEOUT * 1000UL, wake_at);
+  first->setTimerWheel(&wheel);
+  connect(*first, first_net);
+  // An earlier deadline re-arms the hardware timer, a later one does not
+  TEST_ASSERT_EQUAL(2, wakes);
+  TEST_ASSERT_EQUAL(1000 + 10001, wake_at);
+
+  // Task woken by the hardware timer: run the wheel, which arms the next wake
+  native_millis() = wake_at + MQTT_TIMER_WHEEL_TICK;
+  TEST_ASSERT_EQUAL(1, wheel.run(millis()));
+  TEST_ASSERT_TRUE(sent_ping(first_net));
+  TEST_ASSERT_EQUAL(1000 + 20001, wake_at);
+  TEST_ASSERT_EQUAL(3, wakes);
+  const unsigned before = wakes;
+  // Woken early, e.g. by another notification: nothing due, the hardware timer stays as it is
+  TEST_ASSERT_EQUAL(0, wheel.run(millis()));
+  TEST_ASSERT_EQUAL(before, wakes);
+  first->setTimerWheel(NULL);
+  second->setTimerWheel(NULL);
+}
+
+void test_own_wheel_only_once_connecting(void) {
+  // Nothing is armed before the first connect
+  TEST_ASSERT_EQUAL(MQTT_NO_TIMER, first->msUntilNextTimer());
+  first->runTimers();
+  MQTTTimerWheel wheel;
+  // A shared wheel handed back before connecting leaves the client without any wheel
+  first->setTimerWheel(&wheel);
+  first->setTimerWheel(NULL);
+  connect(*first, first_net);
+  TEST_ASSERT_EQUAL(10001, first->msUntilNextTimer());
+  unsigned long expires;
+  TEST_ASSERT_FALSE(wheel.nextExpiry(&expires));
+  // Reconnecting keeps the wheel the client got on its first connect
+  first->disconnect();
+  connect(*first, first_net);
+  TEST_ASSERT_EQUAL(10001, first->msUntilNextTimer());
+}
+
+void test_timer_run_cost(void) {
+  // Armed timers sit in their slot, a run only looks at the ticks passed since the last one
+  connect(*first, first_net);
+  for (int i = 0; i < 1000; i++) {
+    delay(1);
+    first->runTimers();
+  }
+  TEST_ASSERT_TRUE(first_net.tx.empty());
+  TEST_ASSERT_UINT_WITHIN(MQTT_TIMER_WHEEL_TICK, 9001, first->msUntilNextTimer());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_keepalive_on_virtual_clock);
+  RUN_TEST(test_traffic_pushes_keepalive_back);
+  RUN_TEST(test_connack_timeout);
+  RUN_TEST(test_clients_keep_separate_wheels);
+  RUN_TEST(test_shared_wheel_runs_every_client);
+  RUN_TEST(test_armed_timers_move_with_the_wheel);
+  RUN_TEST(test_wake_callback_tracks_earliest_expiry);
+  RUN_TEST(test_own_wheel_only_once_connecting);
+  RUN_TEST(test_timer_run_cost);
+  return UNITY_END();
+}
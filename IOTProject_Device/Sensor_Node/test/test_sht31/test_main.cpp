@@ -0,0 +1,339 @@
+#include <chrono>
+#include <unity.h>
+
+#include <Wire.h>
+#include <SHT31.h>
+
+// Exposes the CRC helpers to the tests
+class SHT31_Probe : public SHT31 {
+  public:
+    using SHT31::SHT31;
+    using SHT31::crc8;
+    using SHT31::checkCRC;
+};
+
+static SHT31_Probe sht(0x44, &Wire);
+
+// Bitwise CRC-8 from page 14 of the datasheet, the reference the driver is checked against
+static uint8_t reference_crc(uint8_t first, uint8_t second) {
+  const uint8_t data[2] = { first, second };
+  uint8_t crc = 0xFF;
+  for (uint8_t i = 0; i < 2; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+// Sensor answer to a measurement or fetch { T, T, CRC, H, H, CRC }
+static std::vector<uint8_t> measurement(uint16_t temperature, uint16_t humidity) {
+  const uint8_t t_msb = temperature >> 8, t_lsb = temperature & 0xFF;
+  const uint8_t h_msb = humidity >> 8, h_lsb = humidity & 0xFF;
+  return { t_msb, t_lsb, reference_crc(t_msb, t_lsb), h_msb, h_lsb, reference_crc(h_msb, h_lsb) };
+}
+
+static void assert_command(const I2C_Transaction &transaction, uint16_t command) {
+  TEST_ASSERT_EQUAL_HEX8(0x44, transaction.address);
+  TEST_ASSERT_EQUAL(2, transaction.written.size());
+  TEST_ASSERT_EQUAL_HEX8(command >> 8, transaction.written[0]);
+  TEST_ASSERT_EQUAL_HEX8(command & 0xFF, transaction.written[1]);
+}
+
+void setUp(void) {
+  Wire.clear();
+  native_millis() = 1000;
+  sht = SHT31_Probe(0x44, &Wire);
+}
+
+void tearDown(void) {}
+
+void test_start_periodic_sends_rate_and_repeatability_command(void) {
+  const uint16_t commands[5][3] = {
+    { 0x2032, 0x2024, 0x202F },
+    { 0x2130, 0x2126, 0x212D },
+    { 0x2236, 0x2220, 0x222B },
+    { 0x2334, 0x2322, 0x2329 },
+    { 0x2737, 0x2721, 0x272A }
+  };
+  for (uint8_t rate = SHT31_MPS_0_5; rate <= SHT31_MPS_10; rate++) {
+    for (uint8_t repeatability = SHT31_REPEAT_HIGH; repeatability <= SHT31_REPEAT_LOW; repeatability++) {
+      setUp();
+      TEST_ASSERT_TRUE(sht.startPeriodic(rate, repeatability));
+      TEST_ASSERT_EQUAL(1, Wire.transactions.size());
+      assert_command(Wire.transactions[0], commands[rate][repeatability]);
+      TEST_ASSERT_FALSE(Wire.transactions[0].repeated_start);
+      TEST_ASSERT_EQUAL(0, Wire.transactions[0].read);
+    }
+  }
+}
+
+void test_start_periodic_rejects_unknown_rate(void) {
+  TEST_ASSERT_FALSE(sht.startPeriodic(SHT31_MPS_10 + 1, SHT31_REPEAT_HIGH));
+  TEST_ASSERT_FALSE(sht.startPeriodic(SHT31_MPS_1, SHT31_REPEAT_LOW + 1));
+  TEST_ASSERT_EQUAL(SHT31_ERR_PERIODIC, sht.getError());
+  TEST_ASSERT_EQUAL(0, Wire.transactions.size());
+  TEST_ASSERT_FALSE(sht.isPeriodic());
+}
+
+void test_periodic_ready_after_one_interval(void) {
+  TEST_ASSERT_TRUE(sht.startPeriodic(SHT31_MPS_2, SHT31_REPEAT_HIGH));
+  TEST_ASSERT_EQUAL(500, sht.getPeriodicInterval());
+  native_millis() += 499;
+  TEST_ASSERT_FALSE(sht.periodicReady());
+  native_millis() += 1;
+  TEST_ASSERT_TRUE(sht.periodicReady());
+
+  Wire.responses.push_back(measurement(0x6666, 0x8000));
+  TEST_ASSERT_TRUE(sht.fetchData());
+  // The next result is one interval after the fetched one
+  TEST_ASSERT_FALSE(sht.periodicReady());
+  native_millis() += 500;
+  TEST_ASSERT_TRUE(sht.periodicReady());
+}
+
+void test_fetch_is_one_transaction_without_conversion_wait(void) {
+  TEST_ASSERT_TRUE(sht.startPeriodic(SHT31_MPS_10, SHT31_REPEAT_HIGH));
+  native_millis() += 100;
+  Wire.transactions.clear();
+  Wire.responses.push_back(measurement(0x6666, 0x8000));
+
+  const unsigned long before = millis();
+  TEST_ASSERT_TRUE(sht.fetchData(false));
+  TEST_ASSERT_EQUAL(before, millis());
+
+  TEST_ASSERT_EQUAL(1, Wire.transactions.size());
+  assert_command(Wire.transactions[0], 0xE000);
+  TEST_ASSERT_TRUE(Wire.transactions[0].repeated_start);
+  TEST_ASSERT_EQUAL(6, Wire.transactions[0].read);
+  TEST_ASSERT_EQUAL_HEX16(0x6666, sht.getRawTemperature());
+  TEST_ASSERT_EQUAL_HEX16(0x8000, sht.getRawHumidity());
+  TEST_ASSERT_EQUAL(before, sht.lastRead());
+}
+
+void test_read_fetches_while_periodic(void) {
+  TEST_ASSERT_TRUE(sht.startPeriodic(SHT31_MPS_1, SHT31_REPEAT_MEDIUM));
+  native_millis() += 1000;
+  Wire.transactions.clear();
+  Wire.responses.push_back(measurement(0x1234, 0x4321));
+
+  const unsigned long before = millis();
+  TEST_ASSERT_TRUE(sht.read());
+  TEST_ASSERT_EQUAL(before, millis());
+  TEST_ASSERT_EQUAL(1, Wire.transactions.size());
+  assert_command(Wire.transactions[0], 0xE000);
+  TEST_ASSERT_EQUAL_HEX16(0x1234, sht.getRawTemperature());
+}
+
+void test_fetch_without_new_data_reports_not_ready(void) {
+  TEST_ASSERT_TRUE(sht.startPeriodic(SHT31_MPS_1, SHT31_REPEAT_HIGH));
+  // No response queued, the sensor NACKs the read header
+  TEST_ASSERT_FALSE(sht.fetchData());
+  TEST_ASSERT_EQUAL(SHT31_ERR_NOT_READY, sht.getError());
+  TEST_ASSERT_TRUE(sht.isPeriodic());
+}
+
+void test_fetch_rejects_bad_crc(void) {
+  TEST_ASSERT_TRUE(sht.startPeriodic(SHT31_MPS_1, SHT31_REPEAT_HIGH));
+  std::vector<uint8_t> data = measurement(0x1234, 0x4321);
+  data[5] ^= 0x01;
+  Wire.responses.push_back(data);
+  TEST_ASSERT_FALSE(sht.fetchData(false));
+  TEST_ASSERT_EQUAL(SHT31_ERR_CRC_HUM, sht.getError());
+}
+
+void test_fetch_requires_periodic_mode(void) {
+  TEST_ASSERT_FALSE(sht.fetchData());
+  TEST_ASSERT_EQUAL(SHT31_ERR_PERIODIC, sht.getError());
+  TEST_ASSERT_EQUAL(0, Wire.transactions.size());
+}
+
+void test_stop_periodic_sends_break_and_returns_to_single_shot(void) {
+  TEST_ASSERT_TRUE(sht.startPeriodic(SHT31_MPS_4, SHT31_REPEAT_LOW));
+  Wire.transactions.clear();
+
+  unsigned long before = millis();
+  TEST_ASSERT_TRUE(sht.stopPeriodic());
+  TEST_ASSERT_FALSE(sht.isPeriodic());
+  TEST_ASSERT_EQUAL(1, Wire.transactions.size());
+  assert_command(Wire.transactions[0], 0x3093);
+  // The sensor needs 1 ms before it accepts the next command
+  TEST_ASSERT_EQUAL(before + 1, millis());
+
+  // Back to single shot: measurement command, conversion wait, then the read
+  Wire.transactions.clear();
+  Wire.responses.push_back(measurement(0x1234, 0x4321));
+  before = millis();
+  TEST_ASSERT_TRUE(sht.read(true));
+  TEST_ASSERT_EQUAL(2, Wire.transactions.size());
+  assert_command(Wire.transactions[0], 0x2416);
+  TEST_ASSERT_FALSE(Wire.transactions[0].repeated_start);
+  TEST_ASSERT_EQUAL(6, Wire.transactions[1].read);
+  TEST_ASSERT_EQUAL(before + 4, Wire.transactions[1].at);
+}
+
+void test_restart_periodic_stops_first(void) {
+  TEST_ASSERT_TRUE(sht.startPeriodic(SHT31_MPS_1, SHT31_REPEAT_HIGH));
+  Wire.transactions.clear();
+  TEST_ASSERT_TRUE(sht.startPeriodic(SHT31_MPS_10, SHT31_REPEAT_HIGH));
+  TEST_ASSERT_EQUAL(2, Wire.transactions.size());
+  assert_command(Wire.transactions[0], 0x3093);
+  assert_command(Wire.transactions[1], 0x2737);
+  TEST_ASSERT_EQUAL(100, sht.getPeriodicInterval());
+}
+
+void test_read_status_is_one_transaction(void) {
+  Wire.responses.push_back({ 0x80, 0x10, reference_crc(0x80, 0x10) });
+  TEST_ASSERT_EQUAL_HEX16(0x8010, sht.readStatus());
+  TEST_ASSERT_EQUAL(1, Wire.transactions.size());
+  assert_command(Wire.transactions[0], 0xF32D);
+  TEST_ASSERT_TRUE(Wire.transactions[0].repeated_start);
+  TEST_ASSERT_EQUAL(3, Wire.transactions[0].read);
+}
+
+void test_read_status_always_polls_the_sensor(void) {
+  Wire.responses.push_back({ 0x80, 0x10, reference_crc(0x80, 0x10) });
+  Wire.responses.push_back({ 0x00, 0x00, reference_crc(0x00, 0x00) });
+  TEST_ASSERT_EQUAL_HEX16(0x8010, sht.readStatus());
+  // A new alert or reset shows up without invalidating anything
+  TEST_ASSERT_EQUAL_HEX16(0x0000, sht.readStatus());
+  TEST_ASSERT_EQUAL(2, Wire.transactions.size());
+}
+
+void test_get_status_is_cached_until_invalidated(void) {
+  Wire.responses.push_back({ 0x80, 0x10, reference_crc(0x80, 0x10) });
+  Wire.responses.push_back({ 0x20, 0x00, reference_crc(0x20, 0x00) });
+  Wire.responses.push_back({ 0x00, 0x00, reference_crc(0x00, 0x00) });
+  TEST_ASSERT_EQUAL_HEX16(0x8010, sht.getStatus());
+  TEST_ASSERT_EQUAL_HEX16(0x8010, sht.getStatus());
+  TEST_ASSERT_EQUAL(1, Wire.transactions.size());
+
+  sht.invalidateStatus();
+  TEST_ASSERT_EQUAL_HEX16(0x2000, sht.getStatus());
+  TEST_ASSERT_EQUAL(2, Wire.transactions.size());
+
+  // Commands changing the register drop the cached copy
+  TEST_ASSERT_TRUE(sht.clearStatus());
+  TEST_ASSERT_EQUAL_HEX16(0x0000, sht.getStatus());
+  TEST_ASSERT_EQUAL(4, Wire.transactions.size());
+  assert_command(Wire.transactions[2], 0x3041);
+}
+
+void test_get_status_does_not_cache_crc_errors(void) {
+  Wire.responses.push_back({ 0x80, 0x10, (uint8_t)(reference_crc(0x80, 0x10) ^ 0x01) });
+  Wire.responses.push_back({ 0x80, 0x10, reference_crc(0x80, 0x10) });
+  TEST_ASSERT_EQUAL_HEX16(0xFFFF, sht.getStatus());
+  TEST_ASSERT_EQUAL(SHT31_ERR_CRC_STATUS, sht.getError());
+  TEST_ASSERT_EQUAL_HEX16(0x8010, sht.getStatus());
+}
+
+// Status check plus measurement, as the node polls the sensor
+void test_polling_cycle_transaction_count(void) {
+  TEST_ASSERT_TRUE(sht.startPeriodic(SHT31_MPS_10, SHT31_REPEAT_HIGH));
+  Wire.transactions.clear();
+  const int cycles = 100;
+  Wire.responses.push_back({ 0x00, 0x00, reference_crc(0x00, 0x00) });
+  for (int i = 0; i < cycles; i++) {
+    TEST_ASSERT_EQUAL_HEX16(0x0000, sht.getStatus());
+    native_millis() += 100;
+    Wire.responses.push_back(measurement(0x6666, 0x8000));
+    TEST_ASSERT_TRUE(sht.fetchData());
+  }
+  // Separate write and read transactions would need 4 per cycle
+  char message[80];
+  snprintf(message, sizeof(message), "%d polling cycles: %u I2C transactions", cycles, (unsigned) Wire.transactions.size());
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL(cycles + 1, Wire.transactions.size());
+  for (const I2C_Transaction &transaction : Wire.transactions) {
+    TEST_ASSERT_TRUE(transaction.repeated_start);
+  }
+}
+
+void test_crc_matches_bitwise_for_every_word(void) {
+  for (uint32_t word = 0; word <= 0xFFFF; word++) {
+    const uint8_t data[2] = { (uint8_t)(word >> 8), (uint8_t)(word & 0xFF) };
+    TEST_ASSERT_EQUAL_HEX8(reference_crc(data[0], data[1]), sht.crc8(data, 2));
+  }
+  // Datasheet example
+  const uint8_t example[2] = { 0xBE, 0xEF };
+  TEST_ASSERT_EQUAL_HEX8(0x92, sht.crc8(example, 2));
+}
+
+void test_batch_crc_matches_bitwise_for_every_word(void) {
+  for (uint32_t word = 0; word <= 0xFFFF; word++) {
+    std::vector<uint8_t> data = measurement(word, word ^ 0xA5A5);
+    TEST_ASSERT_EQUAL(SHT31_OK, sht.checkCRC(data.data()));
+    data[2] ^= 0x01;
+    TEST_ASSERT_EQUAL(SHT31_ERR_CRC_TEMP, sht.checkCRC(data.data()));
+    data[2] ^= 0x01;
+    data[5] ^= 0x80;
+    TEST_ASSERT_EQUAL(SHT31_ERR_CRC_HUM, sht.checkCRC(data.data()));
+  }
+}
+
+void test_crc_benchmark(void) {
+  const int rounds = 20;
+  std::vector<uint8_t> measurements;
+  for (uint32_t word = 0; word <= 0xFFFF; word++) {
+    std::vector<uint8_t> data = measurement(word, ~word & 0xFFFF);
+    measurements.insert(measurements.end(), data.begin(), data.end());
+  }
+  const size_t count = measurements.size() / 6;
+
+  volatile uint32_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < count; i++) {
+      const uint8_t *data = &measurements[i * 6];
+      sink += (reference_crc(data[0], data[1]) == data[2]) && (reference_crc(data[3], data[4]) == data[5]);
+    }
+  }
+  const double bitwise = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < count; i++) {
+      const uint8_t *data = &measurements[i * 6];
+      sink += (sht.crc8(data, 2) == data[2]) && (sht.crc8(data + 3, 2) == data[5]);
+    }
+  }
+  const double table = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < count; i++) {
+      sink += sht.checkCRC(&measurements[i * 6]) == SHT31_OK;
+    }
+  }
+  const double batch = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  TEST_ASSERT_EQUAL(3UL * rounds * count, sink);
+  char message[160];
+  snprintf(message, sizeof(message), "ns per measurement: bitwise %.2f, table %.2f, batch %.2f",
+           bitwise / (rounds * count), table / (rounds * count), batch / (rounds * count));
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_start_periodic_sends_rate_and_repeatability_command);
+  RUN_TEST(test_start_periodic_rejects_unknown_rate);
+  RUN_TEST(test_periodic_ready_after_one_interval);
+  RUN_TEST(test_fetch_is_one_transaction_without_conversion_wait);
+  RUN_TEST(test_read_fetches_while_periodic);
+  RUN_TEST(test_fetch_without_new_data_reports_not_ready);
+  RUN_TEST(test_fetch_rejects_bad_crc);
+  RUN_TEST(test_fetch_requires_periodic_mode);
+  RUN_TEST(test_stop_periodic_sends_break_and_returns_to_single_shot);
+  RUN_TEST(test_restart_periodic_stops_first);
+  RUN_TEST(test_read_status_is_one_transaction);
+  RUN_TEST(test_read_status_always_polls_the_sensor);
+  RUN_TEST(test_get_status_is_cached_until_invalidated);
+  RUN_TEST(test_get_status_does_not_cache_crc_errors);
+  RUN_TEST(test_polling_cycle_transaction_count);
+  RUN_TEST(test_crc_matches_bitwise_for_every_word);
+  RUN_TEST(test_batch_crc_matches_bitwise_for_every_word);
+  RUN_TEST(test_crc_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,170 @@
+#include <chrono>
+#include <stdlib.h>
+#include <new>
+#include <string>
+#include <unity.h>
+
+#include <MockMQTTClient.h>
+#include <ThingsBoard.h>
+
+// Every heap allocation while counting is on, received messages must never grow the receive document
+static bool counting = false;
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+  if (counting) {
+    allocations++;
+  }
+  void *memory = malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void *memory) noexcept {
+  free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+  free(memory);
+}
+
+static MockMQTTClient mqtt;
+static int called = 0;
+static size_t received_params = 0;
+
+static RPC_Response on_rpc(const RPC_Data &data) {
+  called++;
+  received_params = data.size();
+  return RPC_Response();
+}
+
+static void on_shared(const Shared_Attribute_Data &data) {
+  called++;
+  received_params = data.size();
+}
+
+// Object with the given amount of members
+static std::string object(size_t members) {
+  std::string json = "{";
+  for (size_t i = 0; i < members; i++) {
+    json += (i == 0 ? "\"k" : ",\"k") + std::to_string(i) + "\":" + std::to_string(i);
+  }
+  return json + "}";
+}
+
+void setUp(void) {
+  mqtt.clear();
+  mqtt.keep_messages = false;
+  called = 0;
+  received_params = 0;
+  counting = false;
+}
+
+void tearDown(void) {
+  counting = false;
+}
+
+void test_messages_within_maximum_are_processed(void) {
+  ThingsBoard tb(mqtt, 1024, Default_Max_Stack_Size, Default_Buffering_Size, 16);
+  TEST_ASSERT_TRUE(tb.RPC_Subscribe(RPC_Callback("set", on_rpc)));
+  mqtt.receive("v1/devices/me/rpc/request/1", ("{\"method\":\"set\",\"params\":" + object(12) + "}").c_str());
+  TEST_ASSERT_EQUAL(1, called);
+  TEST_ASSERT_EQUAL(12, received_params);
+}
+
+void test_messages_over_maximum_are_discarded(void) {
+  ThingsBoard tb(mqtt, 1024, Default_Max_Stack_Size, Default_Buffering_Size, 16);
+  TEST_ASSERT_TRUE(tb.RPC_Subscribe(RPC_Callback("set", on_rpc)));
+  mqtt.receive("v1/devices/me/rpc/request/1", ("{\"method\":\"set\",\"params\":" + object(40) + "}").c_str());
+  TEST_ASSERT_EQUAL(0, called);
+
+  // Discarding a message does not affect the following ones
+  mqtt.receive("v1/devices/me/rpc/request/2", ("{\"method\":\"set\",\"params\":" + object(4) + "}").c_str());
+  TEST_ASSERT_EQUAL(1, called);
+}
+
+void test_filtered_keys_do_not_count_towards_maximum(void) {
+  ThingsBoard tb(mqtt, 1024, Default_Max_Stack_Size, Default_Buffering_Size, 4);
+  const std::vector<const char *> keys = { "k1", "k30" };
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback(on_shared, keys.cbegin(), keys.cend())));
+  // 40 keys are received, only the 2 subscribed ones are kept
+  mqtt.receive("v1/devices/me/attributes", object(40).c_str());
+  TEST_ASSERT_EQUAL(1, called);
+  TEST_ASSERT_EQUAL(2, received_params);
+}
+
+void test_receiving_never_allocates(void) {
+  ThingsBoard tb(mqtt, 1024, Default_Max_Stack_Size, Default_Buffering_Size, 16);
+  TEST_ASSERT_TRUE(tb.RPC_Subscribe(RPC_Callback("set", on_rpc)));
+  const std::string small = "{\"method\":\"set\",\"params\":" + object(2) + "}";
+  const std::string big = "{\"method\":\"set\",\"params\":" + object(14) + "}";
+  const std::string too_big = "{\"method\":\"set\",\"params\":" + object(100) + "}";
+
+  allocations = 0;
+  counting = true;
+  for (size_t i = 0; i < 50; i++) {
+    mqtt.receive("v1/devices/me/rpc/request/1", small.c_str());
+    mqtt.receive("v1/devices/me/rpc/request/2", big.c_str());
+    mqtt.receive("v1/devices/me/rpc/request/3", too_big.c_str());
+  }
+  counting = false;
+  TEST_ASSERT_EQUAL(100, called);
+  TEST_ASSERT_EQUAL(0, allocations);
+}
+
+// RPC request with 8 fields that all have the given string value
+static std::string request(const std::string &value) {
+  std::string params = "{";
+  for (size_t i = 0; i < 8; i++) {
+    params += (i == 0 ? "\"k" : ",\"k") + std::to_string(i) + "\":\"" + value + "\"";
+  }
+  return "{\"method\":\"set\",\"params\":" + params + "}}";
+}
+
+// RPC request of roughly the given size in bytes, padded with long string values so every size has the same amount of fields
+static std::string padded_request(const size_t &bytes) {
+  const size_t empty = request("").size();
+  return request(std::string((bytes - empty) / 8, 'x'));
+}
+
+void test_payload_size_benchmark(void) {
+  ThingsBoard tb(mqtt, 20000, Default_Max_Stack_Size, Default_Buffering_Size, 16);
+  TEST_ASSERT_TRUE(tb.RPC_Subscribe(RPC_Callback("set", on_rpc)));
+  const size_t sizes[] = { 100, 1024, 4096, 16384 };
+  const size_t messages = 500;
+  char message[200];
+  int written = snprintf(message, sizeof(message), "ns per received RPC request by payload size:");
+
+  for (const size_t &size : sizes) {
+    const std::string payload = padded_request(size);
+    called = 0;
+    allocations = 0;
+    counting = true;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < messages; i++) {
+      mqtt.receive("v1/devices/me/rpc/request/1", payload.c_str());
+    }
+    const auto end = std::chrono::steady_clock::now();
+    counting = false;
+    TEST_ASSERT_EQUAL(messages, called);
+    TEST_ASSERT_EQUAL(8, received_params);
+    // The document only holds the fields, the strings point into the payload, so the size of the payload never grows it
+    TEST_ASSERT_EQUAL(0, allocations);
+    written += snprintf(message + written, sizeof(message) - written, " %u B %.0f,", static_cast<unsigned>(payload.size()),
+                        std::chrono::duration<double, std::nano>(end - start).count() / messages);
+  }
+  message[written - 1] = '\0';
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_messages_within_maximum_are_processed);
+  RUN_TEST(test_messages_over_maximum_are_discarded);
+  RUN_TEST(test_filtered_keys_do_not_count_towards_maximum);
+  RUN_TEST(test_receiving_never_allocates);
+  RUN_TEST(test_payload_size_benchmark);
+  return UNITY_END();
+}
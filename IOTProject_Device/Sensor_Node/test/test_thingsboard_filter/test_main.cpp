@@ -0,0 +1,143 @@
+#include <chrono>
+#include <string>
+#include <unity.h>
+
+#include <MockMQTTClient.h>
+#include <ThingsBoard.h>
+
+// Big enough to deserialize all 200 keys of the benchmark update when the filter is disabled
+using TB = ThingsBoardSized<256>;
+
+static MockMQTTClient mqtt;
+static std::string received;
+static size_t received_keys = 0;
+static int called = 0;
+
+static void on_shared(const Shared_Attribute_Data &data) {
+  called++;
+  for (const JsonPairConst kv : data) {
+    received += std::string(kv.key().c_str()) + "=" + kv.value().as<std::string>() + ";";
+  }
+}
+
+static void on_any(const Shared_Attribute_Data &data) {
+  called++;
+  received_keys = data.size();
+}
+
+// Shared attribute update with the keys k0 to k(count - 1)
+static std::string update(const size_t &count) {
+  std::string json = "{";
+  for (size_t i = 0; i < count; i++) {
+    json += (i == 0 ? "\"k" : ",\"k") + std::to_string(i) + "\":" + std::to_string(i);
+  }
+  return json + "}";
+}
+
+static double nanoseconds_per_message(const std::string &payload, const size_t &messages) {
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < messages; i++) {
+    mqtt.receive("v1/devices/me/attributes", payload.c_str());
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / messages;
+}
+
+void setUp(void) {
+  mqtt.clear();
+  mqtt.keep_messages = false;
+  received.clear();
+  received_keys = 0;
+  called = 0;
+}
+
+void tearDown(void) {
+}
+
+void test_only_subscribed_keys_are_kept(void) {
+  TB tb(mqtt, 8192);
+  const std::vector<const char *> first = { "k7", "k150" };
+  const std::vector<const char *> second = { "k199" };
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback(on_shared, first.cbegin(), first.cend())));
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback(on_shared, second.cbegin(), second.cend())));
+
+  mqtt.receive("v1/devices/me/attributes", update(200).c_str());
+  TEST_ASSERT_EQUAL(2, called);
+  TEST_ASSERT_EQUAL_STRING("k7=7;k150=150;k199=199;k7=7;k150=150;k199=199;", received.c_str());
+}
+
+void test_attribute_response_keys_are_filtered(void) {
+  TB tb(mqtt, 8192);
+  const std::vector<const char *> keys = { "k7" };
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback(on_shared, keys.cbegin(), keys.cend())));
+
+  mqtt.receive("v1/devices/me/attributes", "{\"shared\":{\"k7\":1,\"k8\":2}}");
+  TEST_ASSERT_EQUAL_STRING("k7=1;", received.c_str());
+}
+
+void test_update_without_subscribed_keys_skips_callbacks(void) {
+  TB tb(mqtt, 8192);
+  const std::vector<const char *> keys = { "k7" };
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback(on_shared, keys.cbegin(), keys.cend())));
+
+  mqtt.receive("v1/devices/me/attributes", "{\"k8\":1,\"k9\":2}");
+  TEST_ASSERT_EQUAL(0, called);
+}
+
+void test_callback_without_keys_disables_filter(void) {
+  TB tb(mqtt, 8192);
+  const std::vector<const char *> keys = { "k7" };
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback(on_shared, keys.cbegin(), keys.cend())));
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback(on_any)));
+
+  mqtt.receive("v1/devices/me/attributes", update(200).c_str());
+  TEST_ASSERT_EQUAL(2, called);
+  TEST_ASSERT_EQUAL(200, received_keys);
+}
+
+void test_rpc_keeps_only_method_and_params(void) {
+  TB tb(mqtt, 8192);
+  static std::string params;
+  TEST_ASSERT_TRUE(tb.RPC_Subscribe(RPC_Callback("m", [](const RPC_Data &data) {
+    params = data.as<std::string>();
+    return RPC_Response();
+  })));
+
+  mqtt.receive("v1/devices/me/rpc/request/12", "{\"method\":\"m\",\"junk\":[1,2,3],\"params\":{\"a\":1}}");
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1}", params.c_str());
+}
+
+// Update with 200 keys of which 3 are subscribed, the filter skips the other 197 while parsing instead of storing them first
+void test_filter_benchmark(void) {
+  const size_t messages = 2000;
+  const std::string payload = update(200);
+  TB tb(mqtt, 8192);
+  const std::vector<const char *> first = { "k7", "k150" };
+  const std::vector<const char *> second = { "k199" };
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback(on_any, first.cbegin(), first.cend())));
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback(on_any, second.cbegin(), second.cend())));
+  const double filtered = nanoseconds_per_message(payload, messages);
+  TEST_ASSERT_EQUAL(2 * messages, called);
+
+  // A callback interested in every key disables the filter, meaning all 200 keys are stored in the document again
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback(on_any)));
+  called = 0;
+  const double unfiltered = nanoseconds_per_message(payload, messages);
+  TEST_ASSERT_EQUAL(3 * messages, called);
+  TEST_ASSERT_EQUAL(200, received_keys);
+
+  char message[128];
+  snprintf(message, sizeof(message), "200 keys, 3 subscribed: filtered %.0f ns/msg, unfiltered %.0f ns/msg (%.1fx)", filtered, unfiltered, unfiltered / filtered);
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_only_subscribed_keys_are_kept);
+  RUN_TEST(test_attribute_response_keys_are_filtered);
+  RUN_TEST(test_update_without_subscribed_keys_skips_callbacks);
+  RUN_TEST(test_callback_without_keys_disables_filter);
+  RUN_TEST(test_rpc_keeps_only_method_and_params);
+  RUN_TEST(test_filter_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,138 @@
+#include <string>
+#include <unity.h>
+
+#include <MockHTTPClient.h>
+#include <ThingsBoardHttp.h>
+
+static MockHTTPClient http;
+
+void setUp(void) {
+  http.clear();
+  native_millis() = 0;
+}
+
+void tearDown(void) {
+}
+
+void test_keep_alive_reuses_connection(void) {
+  ThingsBoardHttp tb(http, "TOKEN", "localhost", 80U, true);
+  for (size_t i = 0; i < 5; i++) {
+    TEST_ASSERT_TRUE(tb.sendTelemetryData("temperature", 20.5));
+  }
+  TEST_ASSERT_EQUAL(1, http.connects);
+  TEST_ASSERT_EQUAL(5, http.posts);
+  TEST_ASSERT_EQUAL_STRING("/api/v1/TOKEN/telemetry", http.last_path.c_str());
+}
+
+void test_without_keep_alive_every_request_connects(void) {
+  ThingsBoardHttp tb(http, "TOKEN", "localhost", 80U, false);
+  for (size_t i = 0; i < 5; i++) {
+    TEST_ASSERT_TRUE(tb.sendTelemetryData("temperature", 20.5));
+  }
+  TEST_ASSERT_EQUAL(5, http.connects);
+  TEST_ASSERT_FALSE(http.open);
+}
+
+void test_post_over_connection_closed_before_sending_uses_new_connection(void) {
+  ThingsBoardHttp tb(http, "TOKEN", "localhost", 80U, true);
+  TEST_ASSERT_TRUE(tb.sendTelemetryData("temperature", 20.5));
+  http.closed_by_server = true;
+  TEST_ASSERT_TRUE(tb.sendTelemetryData("temperature", 21.5));
+  TEST_ASSERT_EQUAL(2, http.connects);
+  TEST_ASSERT_EQUAL(2, http.posts);
+}
+
+void test_post_failing_after_write_is_not_resent(void) {
+  ThingsBoardHttp tb(http, "TOKEN", "localhost", 80U, true);
+  TEST_ASSERT_TRUE(tb.sendTelemetryData("temperature", 20.5));
+  // The server might have already stored the telemetry, sending it again would duplicate it
+  http.fail_after_write = true;
+  TEST_ASSERT_FALSE(tb.sendTelemetryData("temperature", 21.5));
+  TEST_ASSERT_EQUAL(2, http.posts);
+
+  // The following request is sent over a new connection
+  TEST_ASSERT_TRUE(tb.sendTelemetryData("temperature", 22.5));
+  TEST_ASSERT_EQUAL(3, http.posts);
+  TEST_ASSERT_EQUAL(2, http.connects);
+}
+
+void test_get_failing_after_write_on_reused_connection_is_resent(void) {
+  ThingsBoardHttp tb(http, "TOKEN", "localhost", 80U, true);
+  std::string response;
+  http.body = "{\"a\":1}";
+  TEST_ASSERT_TRUE(tb.sendGetRequest("/api/v1/TOKEN/attributes", response));
+  http.fail_after_write = true;
+  response.clear();
+  TEST_ASSERT_TRUE(tb.sendGetRequest("/api/v1/TOKEN/attributes", response));
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1}", response.c_str());
+  TEST_ASSERT_EQUAL(3, http.gets);
+  TEST_ASSERT_EQUAL(2, http.connects);
+}
+
+void test_first_request_is_never_resent(void) {
+  // The connection opened by the constructor has not completed any request yet
+  ThingsBoardHttp tb(http, "TOKEN", "localhost", 80U, true);
+  std::string response;
+  http.fail_after_write = true;
+  TEST_ASSERT_FALSE(tb.sendGetRequest("/api/v1/TOKEN/attributes", response));
+  TEST_ASSERT_EQUAL(1, http.gets);
+}
+
+void test_error_status_closes_connection(void) {
+  ThingsBoardHttp tb(http, "TOKEN", "localhost", 80U, true);
+  TEST_ASSERT_TRUE(tb.sendTelemetryData("temperature", 20.5));
+  http.status = 500;
+  TEST_ASSERT_FALSE(tb.sendTelemetryData("temperature", 21.5));
+  TEST_ASSERT_EQUAL(2, http.posts);
+  TEST_ASSERT_FALSE(http.open);
+}
+
+// Requests per second, with every new connection costing a TCP and TLS handshake of 3 round trips
+static double requests_per_second(const bool &keep_alive, const size_t &requests, const size_t &idle_close_every) {
+  http.clear();
+  native_millis() = 0;
+  ThingsBoardHttp tb(http, "TOKEN", "localhost", 443U, keep_alive);
+  const unsigned long start = millis();
+  for (size_t i = 0; i < requests; i++) {
+    if (idle_close_every != 0 && i != 0 && i % idle_close_every == 0) {
+      http.closed_by_server = true;
+    }
+    TEST_ASSERT_TRUE(tb.sendTelemetryData("temperature", 20.5));
+  }
+  TEST_ASSERT_EQUAL(requests, http.posts);
+  return requests * 1000.0 / (millis() - start);
+}
+
+void test_keep_alive_benchmark(void) {
+  const size_t requests = 100;
+  const double closed = requests_per_second(false, requests, 0);
+  const unsigned closed_connects = http.connects;
+  const double kept = requests_per_second(true, requests, 0);
+  const unsigned kept_connects = http.connects;
+  // The server closes the idle connection after every 10th request, each one needs a new connection but is only sent once
+  const double idle = requests_per_second(true, requests, 10);
+  const unsigned idle_connects = http.connects;
+
+  TEST_ASSERT_EQUAL(requests, closed_connects);
+  TEST_ASSERT_EQUAL(1, kept_connects);
+  TEST_ASSERT_EQUAL(10, idle_connects);
+  TEST_ASSERT_GREATER_THAN(closed, kept);
+
+  char message[192];
+  snprintf(message, sizeof(message), "%zu POSTs, 50 ms round trip: keep-alive off %.1f req/s %u connects, on %.1f req/s %u connects, on with idle close %.1f req/s %u connects",
+    requests, closed, closed_connects, kept, kept_connects, idle, idle_connects);
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_keep_alive_reuses_connection);
+  RUN_TEST(test_without_keep_alive_every_request_connects);
+  RUN_TEST(test_post_over_connection_closed_before_sending_uses_new_connection);
+  RUN_TEST(test_post_failing_after_write_is_not_resent);
+  RUN_TEST(test_get_failing_after_write_on_reused_connection_is_resent);
+  RUN_TEST(test_first_request_is_never_resent);
+  RUN_TEST(test_error_status_closes_connection);
+  RUN_TEST(test_keep_alive_benchmark);
+  return UNITY_END();
+}
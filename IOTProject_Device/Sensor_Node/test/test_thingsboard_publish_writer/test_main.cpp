@@ -0,0 +1,157 @@
+#include <chrono>
+#include <string>
+#include <unity.h>
+
+#include <MockMQTTClient.h>
+#include <ThingsBoard.h>
+
+using TB = ThingsBoardSized<32>;
+
+static MockMQTTClient mqtt;
+
+static size_t write_string(Publish_Writer &writer, const char *part) {
+  return writer.write(reinterpret_cast<const uint8_t *>(part), strlen(part));
+}
+
+void setUp(void) {
+  mqtt.clear();
+  TEST_ASSERT_TRUE(mqtt.begin_publish("t", 0U));
+}
+
+void tearDown(void) {
+}
+
+void test_small_parts_are_gathered_until_chunk_is_full(void) {
+  uint8_t chunk[8];
+  Publish_Writer writer(mqtt, chunk, sizeof(chunk));
+  TEST_ASSERT_EQUAL(3, write_string(writer, "abc"));
+  TEST_ASSERT_EQUAL(1, writer.write(static_cast<uint8_t>('d')));
+  TEST_ASSERT_EQUAL(4, write_string(writer, "efgh"));
+  // Exactly full, nothing has been written to the client yet
+  TEST_ASSERT_EQUAL(0, mqtt.writes);
+  // The next byte flushes the full chunk first
+  TEST_ASSERT_EQUAL(1, writer.write(static_cast<uint8_t>('i')));
+  TEST_ASSERT_EQUAL(1, mqtt.writes);
+  TEST_ASSERT_EQUAL_STRING("abcdefgh", mqtt.published.back().payload.c_str());
+  TEST_ASSERT_TRUE(writer.flush());
+  TEST_ASSERT_EQUAL(2, mqtt.writes);
+  TEST_ASSERT_EQUAL_STRING("abcdefghi", mqtt.published.back().payload.c_str());
+  // Flushing an empty chunk writes nothing
+  TEST_ASSERT_TRUE(writer.flush());
+  TEST_ASSERT_EQUAL(2, mqtt.writes);
+}
+
+void test_parts_larger_than_chunk_are_written_directly(void) {
+  uint8_t chunk[8];
+  Publish_Writer writer(mqtt, chunk, sizeof(chunk));
+  TEST_ASSERT_EQUAL(2, write_string(writer, "ab"));
+  // The pending bytes go out first, then the big part without being copied into the chunk
+  TEST_ASSERT_EQUAL(12, write_string(writer, "0123456789AB"));
+  TEST_ASSERT_EQUAL(2, mqtt.writes);
+  TEST_ASSERT_EQUAL(2, write_string(writer, "yz"));
+  TEST_ASSERT_TRUE(writer.flush());
+  TEST_ASSERT_EQUAL(3, mqtt.writes);
+  TEST_ASSERT_EQUAL_STRING("ab0123456789AByz", mqtt.published.back().payload.c_str());
+
+  // A part of exactly the chunk size into an empty chunk is written directly as well
+  mqtt.writes = 0;
+  TEST_ASSERT_EQUAL(8, write_string(writer, "01234567"));
+  TEST_ASSERT_EQUAL(0, mqtt.writes);
+  TEST_ASSERT_EQUAL(1, write_string(writer, "8"));
+  TEST_ASSERT_EQUAL(1, mqtt.writes);
+}
+
+void test_short_client_write_fails_writer(void) {
+  uint8_t chunk[8];
+  Publish_Writer writer(mqtt, chunk, sizeof(chunk));
+  mqtt.write_budget = 5;
+  TEST_ASSERT_EQUAL(8, write_string(writer, "abcdefgh"));
+  // The flush of the full chunk only gets 5 of its 8 bytes out
+  TEST_ASSERT_EQUAL(0, writer.write(static_cast<uint8_t>('i')));
+  TEST_ASSERT_EQUAL(0, write_string(writer, "jklmnopqrstu"));
+  TEST_ASSERT_EQUAL_STRING("abcde", mqtt.published.back().payload.c_str());
+
+  // A short write of the last bytes is reported by flush()
+  mqtt.write_budget = 1;
+  TEST_ASSERT_EQUAL(2, write_string(writer, "vw"));
+  TEST_ASSERT_FALSE(writer.flush());
+}
+
+void test_short_write_disconnects_client(void) {
+  TB tb(mqtt, 1024);
+  mqtt.clear();
+  StaticJsonDocument<JSON_OBJECT_SIZE(2)> doc;
+  doc["temperature"] = 21.5;
+  doc["status"] = "a status long enough to need more than one chunk of the default buffering size";
+  mqtt.write_budget = 10;
+  TEST_ASSERT_FALSE(tb.sendTelemetryJson(doc, Helper::Measure_Json(doc)));
+  // The broker already got the header of the complete message, continuing would desync the stream
+  TEST_ASSERT_EQUAL(1, mqtt.disconnects);
+  TEST_ASSERT_FALSE(mqtt.connected());
+
+  // A short write of only the last bytes is caught as well
+  mqtt.clear();
+  mqtt.write_budget = Helper::Measure_Json(doc) - 2U;
+  TEST_ASSERT_FALSE(tb.sendTelemetryJson(doc, Helper::Measure_Json(doc)));
+  TEST_ASSERT_EQUAL(1, mqtt.disconnects);
+
+  mqtt.clear();
+  TEST_ASSERT_TRUE(tb.sendTelemetryJson(doc, Helper::Measure_Json(doc)));
+  TEST_ASSERT_EQUAL(0, mqtt.disconnects);
+  std::string expected;
+  serializeJson(doc, expected);
+  TEST_ASSERT_EQUAL_STRING(expected.c_str(), mqtt.published.back().payload.c_str());
+}
+
+// 24 key value pairs, serialized straight into the client compared to first serializing them into a temporary string
+void test_serialize_benchmark(void) {
+  const size_t messages = 20000;
+  TB tb(mqtt, 4096);
+  mqtt.clear();
+  mqtt.keep_messages = false;
+  static const char *const keys[] = { "k00", "k01", "k02", "k03", "k04", "k05", "k06", "k07", "k08", "k09", "k10", "k11",
+    "k12", "k13", "k14", "k15", "k16", "k17", "k18", "k19", "k20", "k21", "k22", "k23" };
+  StaticJsonDocument<JSON_OBJECT_SIZE(24)> doc;
+  for (size_t i = 0; i < 24; i++) {
+    doc[keys[i]] = 1000.25 * i;
+  }
+  const size_t json_size = Helper::Measure_Json(doc);
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < messages; i++) {
+    TEST_ASSERT_TRUE(tb.sendTelemetryJson(doc, json_size));
+  }
+  const auto streamed = std::chrono::steady_clock::now();
+  const unsigned stream_writes = mqtt.writes;
+  const size_t stream_written = mqtt.written;
+
+  mqtt.clear();
+  mqtt.keep_messages = false;
+  for (size_t i = 0; i < messages; i++) {
+    char json[json_size];
+    serializeJson(doc, json, json_size);
+    TEST_ASSERT_TRUE(tb.sendTelemetryJson(json));
+  }
+  const auto end = std::chrono::steady_clock::now();
+  TEST_ASSERT_EQUAL(messages, mqtt.publishes);
+
+  // Streaming copies every byte into the chunk and then into the client, the string path into the string and then into the client.
+  // What differs is the temporary buffer, the chunk has the buffering size, the string the size of the complete json
+  char message[256];
+  snprintf(message, sizeof(message), "%zu B payload: streamed %.0f ns, %zu B copied per message in %.1f writes through a %u B chunk; "
+    "string %.0f ns, %zu B copied per message through a %zu B string",
+    json_size - 1U, std::chrono::duration<double, std::nano>(streamed - start).count() / messages,
+    2U * stream_written / messages, static_cast<double>(stream_writes) / messages, Default_Buffering_Size + 1U,
+    std::chrono::duration<double, std::nano>(end - streamed).count() / messages, 2U * (json_size - 1U), json_size);
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_small_parts_are_gathered_until_chunk_is_full);
+  RUN_TEST(test_parts_larger_than_chunk_are_written_directly);
+  RUN_TEST(test_short_client_write_fails_writer);
+  RUN_TEST(test_short_write_disconnects_client);
+  RUN_TEST(test_serialize_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,281 @@
+#include <stdint.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <unity.h>
+
+#include <Arduino.h>
+#include <MockMQTTClient.h>
+#include <Request_Table.h>
+#include <ThingsBoard.h>
+
+// Default_Requests_Amt slots, compared to a table with only 3 slots where ids collide much more often
+using Default_TB = ThingsBoard;
+#if THINGSBOARD_ENABLE_DYNAMIC
+using Small_TB = ThingsBoardSized<ThingsBoardDefaultLogger, Static_Storage<4, 4, 3>>;
+#else
+using Small_TB = ThingsBoardSized<8, ThingsBoardDefaultLogger, Static_Storage<4, 4, 3>>;
+#endif // THINGSBOARD_ENABLE_DYNAMIC
+
+// Plays the broker, every request published by ThingsBoard is answered with replies to its response topic
+static MockMQTTClient mqtt;
+static std::vector<int> results;
+static int timeouts = 0;
+
+
+// Request id of the published message with the given index, the last part of its topic
+static std::string request_id(const size_t &index) {
+  const std::string &topic = mqtt.published.at(index).topic;
+  return topic.substr(topic.rfind('/') + 1U);
+}
+
+// Response topics are the ones the library subscribes to, followed by the request id
+static void reply(const char *topic, const std::string &id, const std::string &payload) {
+  mqtt.receive((std::string(topic) + "/" + id).c_str(), payload.c_str());
+}
+
+static void advance(const unsigned long &milliseconds) {
+  native_millis() += milliseconds;
+}
+
+static RPC_Request_Callback rpc(RPC_Request_Callback::function callback, const uint32_t &timeout, RPC_Request_Callback::timeout_function on_timeout = nullptr) {
+  RPC_Request_Callback callback_copy("m", callback);
+  callback_copy.Set_Timeout(timeout, on_timeout);
+  return callback_copy;
+}
+
+static void push_value(const JsonVariantConst &data) {
+  results.push_back(data["v"].as<int>());
+}
+
+static void ignore(const JsonVariantConst &) {
+}
+
+void setUp(void) {
+  mqtt.clear();
+  results.clear();
+  timeouts = 0;
+  native_millis() = 0;
+}
+
+void tearDown(void) {
+}
+
+template <typename TB>
+static void out_of_order_responses_reach_their_request(const size_t &capacity) {
+  TB tb(mqtt, 1024);
+  for (size_t i = 0; i < capacity; i++) {
+    TEST_ASSERT_TRUE(tb.RPC_Request(rpc(push_value, 1000U)));
+  }
+  // Every slot is waiting for its response
+  TEST_ASSERT_FALSE(tb.RPC_Request(rpc(push_value, 1000U)));
+  TEST_ASSERT_EQUAL(capacity, mqtt.published.size());
+
+  // The broker answers in reverse order, with the middle one swapped to the front
+  std::vector<std::string> order;
+  for (size_t i = 0; i < capacity; i++) {
+    order.push_back(request_id(i));
+  }
+  std::reverse(order.begin(), order.end());
+  std::swap(order.front(), order[order.size() / 2U]);
+  for (const std::string &id : order) {
+    reply(RPC_RESPONSE_TOPIC, id, "{\"v\":" + id + "}");
+  }
+  TEST_ASSERT_EQUAL(capacity, results.size());
+  for (size_t i = 0; i < capacity; i++) {
+    TEST_ASSERT_EQUAL(atoi(order[i].c_str()), results[i]);
+  }
+
+  // A duplicated response and one for an id that was never sent are both ignored
+  reply(RPC_RESPONSE_TOPIC, order.front(), "{\"v\":1}");
+  reply(RPC_RESPONSE_TOPIC, "4096", "{\"v\":1}");
+  TEST_ASSERT_EQUAL(capacity, results.size());
+  // Each response freed its slot
+  TEST_ASSERT_TRUE(tb.RPC_Request(rpc(push_value, 1000U)));
+}
+
+void test_out_of_order_responses_reach_their_request(void) {
+  out_of_order_responses_reach_their_request<Default_TB>(Default_Requests_Amt);
+  setUp();
+  out_of_order_responses_reach_their_request<Small_TB>(3U);
+}
+
+void test_timeouts_discard_late_responses(void) {
+  Small_TB tb(mqtt, 1024);
+  TEST_ASSERT_TRUE(tb.RPC_Request(rpc(push_value, 100U, []() { timeouts += 1; })));
+  TEST_ASSERT_TRUE(tb.RPC_Request(rpc(push_value, 300U, []() { timeouts += 10; })));
+
+  advance(99U);
+  tb.loop();
+  TEST_ASSERT_EQUAL(0, timeouts);
+  advance(1U);
+  tb.loop();
+  TEST_ASSERT_EQUAL(1, timeouts);
+
+  // The response of the expired request arrives too late and is dropped, the other one is still answered
+  reply(RPC_RESPONSE_TOPIC, request_id(0), "{\"v\":1}");
+  TEST_ASSERT_TRUE(results.empty());
+  reply(RPC_RESPONSE_TOPIC, request_id(1), "{\"v\":2}");
+  TEST_ASSERT_EQUAL(1, results.size());
+  TEST_ASSERT_EQUAL(2, results.front());
+
+  // An answered request never times out afterwards
+  advance(500U);
+  tb.loop();
+  TEST_ASSERT_EQUAL(1, timeouts);
+}
+
+void test_request_without_timeout_keeps_its_slot(void) {
+  Small_TB tb(mqtt, 1024);
+  TEST_ASSERT_TRUE(tb.RPC_Request(rpc(push_value, 0U)));
+  const std::string forever = request_id(0);
+
+  // The remaining slots are filled and expire repeatedly, new ids keep skipping the occupied slot
+  for (size_t round = 0; round < 5; round++) {
+    TEST_ASSERT_TRUE(tb.RPC_Request(rpc(ignore, 10U)));
+    TEST_ASSERT_TRUE(tb.RPC_Request(rpc(ignore, 10U)));
+    TEST_ASSERT_FALSE(tb.RPC_Request(rpc(ignore, 10U)));
+    advance(10U);
+    tb.loop();
+  }
+  TEST_ASSERT_EQUAL(11, mqtt.published.size());
+
+  reply(RPC_RESPONSE_TOPIC, forever, "{\"v\":1000}");
+  TEST_ASSERT_EQUAL(1, results.size());
+  TEST_ASSERT_EQUAL(1000, results.front());
+}
+
+void test_failed_publish_frees_slot(void) {
+  Small_TB tb(mqtt, 1024);
+  mqtt.fail_publish = true;
+  for (size_t i = 0; i < 5; i++) {
+    TEST_ASSERT_FALSE(tb.RPC_Request(rpc(ignore, 1000U)));
+  }
+  mqtt.fail_publish = false;
+  for (size_t i = 0; i < 3; i++) {
+    TEST_ASSERT_TRUE(tb.RPC_Request(rpc(ignore, 1000U)));
+  }
+}
+
+void test_timeout_callback_may_send_request(void) {
+  static Small_TB *tb = nullptr;
+  Small_TB instance(mqtt, 1024);
+  tb = &instance;
+  TEST_ASSERT_TRUE(tb->RPC_Request(rpc(ignore, 5U, []() {
+    timeouts = 1;
+    TEST_ASSERT_TRUE(tb->RPC_Request(rpc(push_value, 5U, []() { timeouts = 2; })));
+  })));
+
+  advance(5U);
+  tb->loop();
+  TEST_ASSERT_EQUAL(1, timeouts);
+  TEST_ASSERT_EQUAL(2, mqtt.published.size());
+  // The request sent from inside the timeout callback expires as well
+  advance(5U);
+  tb->loop();
+  TEST_ASSERT_EQUAL(2, timeouts);
+}
+
+static Attribute_Request_Callback attribute_request(Attribute_Request_Callback::function callback, const uint32_t &timeout) {
+#if THINGSBOARD_ENABLE_STL
+  static const std::vector<const char *> keys = { "a" };
+  Attribute_Request_Callback request(callback, keys.cbegin(), keys.cend());
+#else
+  Attribute_Request_Callback request("a", callback);
+#endif // THINGSBOARD_ENABLE_STL
+  request.Set_Timeout(timeout);
+  return request;
+}
+
+void test_attribute_requests_out_of_order(void) {
+  static std::map<int, int> received;
+  received.clear();
+  Small_TB tb(mqtt, 1024);
+  for (size_t i = 0; i < 3; i++) {
+    TEST_ASSERT_TRUE(tb.Shared_Attributes_Request(attribute_request([](const Shared_Attribute_Data &data) { received[data["a"].as<int>()]++; }, 1000U)));
+  }
+  for (size_t i = 3; i-- > 0;) {
+    reply(ATTRIBUTE_RESPONSE_TOPIC, request_id(i), "{\"shared\":{\"a\":" + std::to_string(i) + "}}");
+  }
+  TEST_ASSERT_EQUAL(3, received.size());
+  TEST_ASSERT_EQUAL(1, received[0]);
+  TEST_ASSERT_EQUAL(1, received[1]);
+  TEST_ASSERT_EQUAL(1, received[2]);
+}
+
+void test_last_expired_request_unsubscribes_response_topic(void) {
+  Small_TB tb(mqtt, 1024);
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Request(attribute_request([](const Shared_Attribute_Data &) {}, 1U)));
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Request(attribute_request([](const Shared_Attribute_Data &) {}, 2U)));
+  const unsigned unsubscribes = mqtt.unsubscribes;
+  advance(1U);
+  tb.loop();
+  TEST_ASSERT_EQUAL(unsubscribes, mqtt.unsubscribes);
+  advance(1U);
+  tb.loop();
+  TEST_ASSERT_EQUAL(unsubscribes + 1, mqtt.unsubscribes);
+}
+
+void test_deadline_after_millis_wraparound(void) {
+  Small_TB tb(mqtt, 1024);
+  native_millis() = 0xFFFFFFF0UL;
+  tb.loop();
+  TEST_ASSERT_TRUE(tb.RPC_Request(rpc(ignore, 0x20U, []() { timeouts++; })));
+  // The deadline 0x10 is numerically smaller than the time the request was sent at, but still 32 ms in the future
+  native_millis() = 0x0FUL;
+  tb.loop();
+  TEST_ASSERT_EQUAL(0, timeouts);
+  native_millis() = 0x10UL;
+  tb.loop();
+  TEST_ASSERT_EQUAL(1, timeouts);
+}
+
+void test_request_id_wraparound(void) {
+  // 2^64 - 1 and 0 are consecutive ids that share slot 0 of 3 slots, the wrapped id has to skip the slot instead of overwriting it
+  Request_Table<int, 3> table;
+  const size_t last = SIZE_MAX;
+  TEST_ASSERT_NOT_NULL(table.insert(last - 1U, 1, 0U, 0U));
+  TEST_ASSERT_NOT_NULL(table.insert(last, 2, 0U, 0U));
+  TEST_ASSERT_FALSE(table.is_free(0U));
+  TEST_ASSERT_NULL(table.insert(0U, 3, 0U, 0U));
+  TEST_ASSERT_NULL(table.find(0U));
+  TEST_ASSERT_TRUE(table.is_free(1U));
+  TEST_ASSERT_NOT_NULL(table.insert(1U, 3, 0U, 0U));
+
+  TEST_ASSERT_EQUAL(1, *table.find(last - 1U));
+  TEST_ASSERT_EQUAL(2, *table.find(last));
+  TEST_ASSERT_EQUAL(3, *table.find(1U));
+  table.erase(last);
+  TEST_ASSERT_NULL(table.find(last));
+  TEST_ASSERT_TRUE(table.is_free(0U));
+  TEST_ASSERT_EQUAL(2, table.size());
+}
+
+void test_erase_expired_skips_slots_until_deadline(void) {
+  Request_Table<int, 4> table;
+  TEST_ASSERT_NOT_NULL(table.insert(1U, 1, 100U, 50U));
+  TEST_ASSERT_NOT_NULL(table.insert(2U, 2, 100U, 0U));
+  size_t expired = 0;
+  TEST_ASSERT_EQUAL(0, table.erase_expired(149U, [&expired](const int &) { expired++; }));
+  TEST_ASSERT_EQUAL(1, table.erase_expired(150U, [&expired](const int &) { expired++; }));
+  TEST_ASSERT_EQUAL(1, expired);
+  // The request without a timeout never expires
+  TEST_ASSERT_EQUAL(0, table.erase_expired(UINT32_MAX, [&expired](const int &) { expired++; }));
+  TEST_ASSERT_EQUAL(1, table.size());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_out_of_order_responses_reach_their_request);
+  RUN_TEST(test_timeouts_discard_late_responses);
+  RUN_TEST(test_request_without_timeout_keeps_its_slot);
+  RUN_TEST(test_failed_publish_frees_slot);
+  RUN_TEST(test_timeout_callback_may_send_request);
+  RUN_TEST(test_attribute_requests_out_of_order);
+  RUN_TEST(test_last_expired_request_unsubscribes_response_topic);
+  RUN_TEST(test_deadline_after_millis_wraparound);
+  RUN_TEST(test_request_id_wraparound);
+  RUN_TEST(test_erase_expired_skips_slots_until_deadline);
+  return UNITY_END();
+}
@@ -0,0 +1,209 @@
+#include <chrono>
+#include <string>
+#include <unity.h>
+
+#include <ThingsBoard.h>
+
+// Gateway API like table, to check that further topics are routed with their own table and Route type
+enum class Gateway_Route : uint8_t {
+  ATTRIBUTE_UPDATE,
+  ATTRIBUTE_RESPONSE,
+  CONNECT,
+  RPC
+};
+
+constexpr char GATEWAY_ATTRIBUTE_TOPIC[] = "v1/gateway/attributes";
+constexpr char GATEWAY_ATTRIBUTE_RESPONSE_TOPIC[] = "v1/gateway/attributes/response";
+constexpr char GATEWAY_CONNECT_TOPIC[] = "v1/gateway/connect";
+constexpr char GATEWAY_RPC_TOPIC[] = "v1/gateway/rpc";
+
+constexpr Topic_Route<Gateway_Route> GATEWAY_ROUTES[] = {
+  { GATEWAY_ATTRIBUTE_TOPIC, Topic_Suffix::NONE, Gateway_Route::ATTRIBUTE_UPDATE },
+  { GATEWAY_ATTRIBUTE_RESPONSE_TOPIC, Topic_Suffix::NONE, Gateway_Route::ATTRIBUTE_RESPONSE },
+  { GATEWAY_CONNECT_TOPIC, Topic_Suffix::NONE, Gateway_Route::CONNECT },
+  { GATEWAY_RPC_TOPIC, Topic_Suffix::NONE, Gateway_Route::RPC },
+};
+static_assert(Topic_Router::Is_Sorted(GATEWAY_ROUTES, 4U), "Sorted table has to be detected");
+
+constexpr Topic_Route<Gateway_Route> UNSORTED_ROUTES[] = {
+  { GATEWAY_ATTRIBUTE_RESPONSE_TOPIC, Topic_Suffix::NONE, Gateway_Route::ATTRIBUTE_RESPONSE },
+  { GATEWAY_ATTRIBUTE_TOPIC, Topic_Suffix::NONE, Gateway_Route::ATTRIBUTE_UPDATE },
+};
+static_assert(!Topic_Router::Is_Sorted(UNSORTED_ROUTES, 2U), "Unsorted table has to be detected");
+
+static const size_t UNTOUCHED = 777U;
+
+// Route the given topic is forwarded to or -1 if it matches none, the id is reset to UNTOUCHED beforehand
+static int route(const char *topic, size_t &id) {
+  id = UNTOUCHED;
+  const Topic_Route<ThingsBoard_Route> *matched = Topic_Router::Route_Topic(RECEIVE_ROUTES, topic, id);
+  return matched == nullptr ? -1 : static_cast<int>(matched->route);
+}
+
+static int route(const char *topic) {
+  size_t id = 0U;
+  return route(topic, id);
+}
+
+static int gateway_route(const char *topic) {
+  size_t id = 0U;
+  const Topic_Route<Gateway_Route> *matched = Topic_Router::Route_Topic(GATEWAY_ROUTES, topic, id);
+  return matched == nullptr ? -1 : static_cast<int>(matched->route);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_exact_topics(void) {
+  size_t id = 0U;
+  TEST_ASSERT_EQUAL(static_cast<int>(ThingsBoard_Route::ATTRIBUTE_UPDATE), route("v1/devices/me/attributes", id));
+  TEST_ASSERT_EQUAL(UNTOUCHED, id);
+  TEST_ASSERT_EQUAL(static_cast<int>(ThingsBoard_Route::PROVISION_RESPONSE), route("/provision/response", id));
+  TEST_ASSERT_EQUAL(UNTOUCHED, id);
+}
+
+void test_numeric_suffix(void) {
+  size_t id = 0U;
+  TEST_ASSERT_EQUAL(static_cast<int>(ThingsBoard_Route::ATTRIBUTE_RESPONSE), route("v1/devices/me/attributes/response/15", id));
+  TEST_ASSERT_EQUAL(15, id);
+  TEST_ASSERT_EQUAL(static_cast<int>(ThingsBoard_Route::RPC_REQUEST), route("v1/devices/me/rpc/request/42", id));
+  TEST_ASSERT_EQUAL(42, id);
+  TEST_ASSERT_EQUAL(static_cast<int>(ThingsBoard_Route::RPC_RESPONSE), route("v1/devices/me/rpc/response/0", id));
+  TEST_ASSERT_EQUAL(0, id);
+  TEST_ASSERT_EQUAL(static_cast<int>(ThingsBoard_Route::RPC_RESPONSE), route("v1/devices/me/rpc/response/0007", id));
+  TEST_ASSERT_EQUAL(7, id);
+}
+
+// "v1/devices/me/attributes" is a prefix of "v1/devices/me/attributes/response/N", both have to be told apart in either direction
+void test_prefix_of_prefix(void) {
+  TEST_ASSERT_EQUAL(static_cast<int>(ThingsBoard_Route::ATTRIBUTE_UPDATE), route("v1/devices/me/attributes"));
+  TEST_ASSERT_EQUAL(static_cast<int>(ThingsBoard_Route::ATTRIBUTE_RESPONSE), route("v1/devices/me/attributes/response/1"));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/attributes/"));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/attributes/response"));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/attributes/responseX/1"));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/attributes/respons/1"));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/attributesX"));
+
+  TEST_ASSERT_EQUAL(static_cast<int>(Gateway_Route::ATTRIBUTE_UPDATE), gateway_route("v1/gateway/attributes"));
+  TEST_ASSERT_EQUAL(static_cast<int>(Gateway_Route::ATTRIBUTE_RESPONSE), gateway_route("v1/gateway/attributes/response"));
+  TEST_ASSERT_EQUAL(-1, gateway_route("v1/gateway/attributes/"));
+}
+
+void test_empty_and_non_numeric_suffix(void) {
+  size_t id = 0U;
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/rpc/request/", id));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/rpc/request", id));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/rpc/request/1x", id));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/rpc/request/x1", id));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/rpc/request/-1", id));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/rpc/request/1/2", id));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/rpc/request/ 1", id));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/rpc/request//1", id));
+  // The id is only written once the suffix matched
+  TEST_ASSERT_EQUAL(UNTOUCHED, id);
+}
+
+void test_overflowing_id_is_rejected(void) {
+  size_t id = 0U;
+  const std::string prefix = "v1/devices/me/rpc/request/";
+  const std::string max = std::to_string(SIZE_MAX);
+  TEST_ASSERT_EQUAL(static_cast<int>(ThingsBoard_Route::RPC_REQUEST), route((prefix + max).c_str(), id));
+  TEST_ASSERT_TRUE(id == SIZE_MAX);
+
+  // SIZE_MAX + 1 ends in 6 for both 32 and 64 bit, because SIZE_MAX ends in 5
+  std::string above = max;
+  above.back() = '6';
+  TEST_ASSERT_EQUAL(-1, route((prefix + above).c_str(), id));
+  TEST_ASSERT_EQUAL(-1, route((prefix + max + "0").c_str(), id));
+  TEST_ASSERT_EQUAL(-1, route((prefix + "99999999999999999999999999").c_str(), id));
+  TEST_ASSERT_EQUAL(UNTOUCHED, id);
+}
+
+void test_unknown_topics(void) {
+  TEST_ASSERT_EQUAL(-1, route(""));
+  TEST_ASSERT_EQUAL(-1, route("v"));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me"));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/telemetry"));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/attribute"));
+  TEST_ASSERT_EQUAL(-1, route("v1/devices/me/rpc/requests/1"));
+  TEST_ASSERT_EQUAL(-1, route("/provision/responses"));
+  TEST_ASSERT_EQUAL(-1, route("/provision"));
+  // Firmware topics are only routed with THINGSBOARD_ENABLE_OTA
+  TEST_ASSERT_EQUAL(-1, route("v2/fw/response/0/chunk/3"));
+  TEST_ASSERT_EQUAL(-1, gateway_route("v1/gateway/connec"));
+  TEST_ASSERT_EQUAL(-1, gateway_route("v1/gateway/rpcs"));
+}
+
+// Routing by checking every topic with strncmp and parsing the id from a copy, as received messages were routed before
+static int route_strncmp(const char *topic, size_t &id) {
+  if (strncmp(RPC_RESPONSE_TOPIC, topic, strlen(RPC_RESPONSE_TOPIC)) == 0) {
+    id = atoi(std::string(topic).substr(strlen(RPC_RESPONSE_TOPIC) + 1U).c_str());
+    return static_cast<int>(ThingsBoard_Route::RPC_RESPONSE);
+  }
+  else if (strncmp(RPC_REQUEST_TOPIC, topic, strlen(RPC_REQUEST_TOPIC)) == 0) {
+    id = atoi(std::string(topic).substr(strlen(RPC_REQUEST_TOPIC) + 1U).c_str());
+    return static_cast<int>(ThingsBoard_Route::RPC_REQUEST);
+  }
+  else if (strncmp(ATTRIBUTE_RESPONSE_TOPIC, topic, strlen(ATTRIBUTE_RESPONSE_TOPIC)) == 0) {
+    id = atoi(std::string(topic).substr(strlen(ATTRIBUTE_RESPONSE_TOPIC) + 1U).c_str());
+    return static_cast<int>(ThingsBoard_Route::ATTRIBUTE_RESPONSE);
+  }
+  else if (strncmp(ATTRIBUTE_TOPIC, topic, strlen(ATTRIBUTE_TOPIC)) == 0) {
+    return static_cast<int>(ThingsBoard_Route::ATTRIBUTE_UPDATE);
+  }
+  else if (strncmp(PROV_RESPONSE_TOPIC, topic, strlen(PROV_RESPONSE_TOPIC)) == 0) {
+    return static_cast<int>(ThingsBoard_Route::PROVISION_RESPONSE);
+  }
+  return -1;
+}
+
+void test_routing_benchmark(void) {
+  const char *const topics[] = { "v1/devices/me/attributes", "v1/devices/me/attributes/response/15", "v1/devices/me/rpc/request/42",
+    "v1/devices/me/rpc/response/7", "/provision/response", "v1/devices/me/unknown" };
+  const size_t topic_amount = sizeof(topics) / sizeof(topics[0]);
+  const size_t iterations = 200000U;
+  size_t sink = 0U;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    size_t id = 0U;
+    sink += route(topics[i % topic_amount], id) + id;
+  }
+  const auto middle = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    size_t id = 0U;
+    sink += route_strncmp(topics[i % topic_amount], id) + id;
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  // Both have to agree on every topic, the unknown one included
+  for (size_t i = 0; i < topic_amount; i++) {
+    size_t router_id = 0U, strncmp_id = 0U;
+    const int routed = route(topics[i], router_id);
+    TEST_ASSERT_EQUAL(route_strncmp(topics[i], strncmp_id), routed);
+    if (routed >= static_cast<int>(ThingsBoard_Route::ATTRIBUTE_RESPONSE)) {
+      TEST_ASSERT_EQUAL(strncmp_id, router_id);
+    }
+  }
+
+  char message[128];
+  snprintf(message, sizeof(message), "Topic_Router %.1f ns/topic, strncmp chain %.1f ns/topic (checksum %zu)",
+    std::chrono::duration<double, std::nano>(middle - start).count() / iterations,
+    std::chrono::duration<double, std::nano>(end - middle).count() / iterations, sink);
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_exact_topics);
+  RUN_TEST(test_numeric_suffix);
+  RUN_TEST(test_prefix_of_prefix);
+  RUN_TEST(test_empty_and_non_numeric_suffix);
+  RUN_TEST(test_overflowing_id_is_rejected);
+  RUN_TEST(test_unknown_topics);
+  RUN_TEST(test_routing_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,147 @@
+#include <chrono>
+#include <string>
+#include <unity.h>
+
+#include <MockMQTTClient.h>
+#include <ThingsBoard.h>
+
+// Pairs of different names with the same 32-bit FNV-1a hash
+constexpr char COLLIDING_FIRST[] = "costarring";
+constexpr char COLLIDING_SECOND[] = "liquid";
+static_assert(Helper::hash(COLLIDING_FIRST) == Helper::hash(COLLIDING_SECOND), "Names have to collide for the test to mean anything");
+
+// Hashed by the compiler, the constexpr overload is only guaranteed to be evaluated at compile time in a constant expression like this one
+constexpr uint32_t SET_HASH = Helper::hash("set");
+
+using RPC_TB = ThingsBoardSized<256>;
+
+static MockMQTTClient mqtt;
+static const char *answered = nullptr;  // Name of the callback that answered the last request
+static size_t called = 0;
+
+static RPC_Response on_set(const RPC_Data &) {
+  answered = "set";
+  called++;
+  return RPC_Response();
+}
+
+static RPC_Response on_set_value(const RPC_Data &) {
+  answered = "setValue";
+  called++;
+  return RPC_Response();
+}
+
+static RPC_Response on_first(const RPC_Data &) {
+  answered = COLLIDING_FIRST;
+  called++;
+  return RPC_Response();
+}
+
+static RPC_Response on_second(const RPC_Data &) {
+  answered = COLLIDING_SECOND;
+  called++;
+  return RPC_Response();
+}
+
+static void request(const char *method) {
+  const std::string payload = std::string("{\"method\":\"") + method + "\",\"params\":1}";
+  mqtt.receive("v1/devices/me/rpc/request/1", payload.c_str());
+}
+
+void setUp(void) {
+  mqtt.clear();
+  mqtt.keep_messages = false;
+  answered = nullptr;
+  called = 0;
+}
+
+void tearDown(void) {
+  // Nothing to do
+}
+
+void test_literal_hash_matches_runtime_hash(void) {
+  const char *name = "set";
+  TEST_ASSERT_EQUAL_UINT32(Helper::hash(name), SET_HASH);
+  const RPC_Callback hashed("set", SET_HASH, on_set);
+  const RPC_Callback runtime("set", on_set);
+  TEST_ASSERT_EQUAL_UINT32(runtime.Get_Name_Hash(), hashed.Get_Name_Hash());
+}
+
+void test_prefix_of_a_name_does_not_answer(void) {
+  static RPC_TB tb(mqtt, 256);
+  TEST_ASSERT_TRUE(tb.RPC_Subscribe(RPC_Callback("set", SET_HASH, on_set)));
+
+  // Used to be answered by "set", because only the length of the subscribed name was compared
+  request("setValue");
+  TEST_ASSERT_EQUAL(0, called);
+  request("se");
+  TEST_ASSERT_EQUAL(0, called);
+
+  TEST_ASSERT_TRUE(tb.RPC_Subscribe(RPC_Callback("setValue", on_set_value)));
+  request("setValue");
+  TEST_ASSERT_EQUAL_STRING("setValue", answered);
+  request("set");
+  TEST_ASSERT_EQUAL_STRING("set", answered);
+  TEST_ASSERT_EQUAL(2, called);
+  tb.RPC_Unsubscribe();
+}
+
+void test_names_with_the_same_hash_are_told_apart(void) {
+  static RPC_TB tb(mqtt, 256);
+  TEST_ASSERT_TRUE(tb.RPC_Subscribe(RPC_Callback(COLLIDING_SECOND, on_second)));
+  request(COLLIDING_FIRST);
+  TEST_ASSERT_EQUAL(0, called);
+
+  TEST_ASSERT_TRUE(tb.RPC_Subscribe(RPC_Callback(COLLIDING_FIRST, on_first)));
+  request(COLLIDING_FIRST);
+  TEST_ASSERT_EQUAL_STRING(COLLIDING_FIRST, answered);
+  request(COLLIDING_SECOND);
+  TEST_ASSERT_EQUAL_STRING(COLLIDING_SECOND, answered);
+  TEST_ASSERT_EQUAL(2, called);
+  tb.RPC_Unsubscribe();
+}
+
+// Nanoseconds per received request with the given amount of subscribed methods, always requesting the one subscribed last
+static double dispatch_ns(const size_t &methods) {
+  static std::string names[256];
+  static RPC_TB tb(mqtt, 256);
+  tb.RPC_Unsubscribe();
+  for (size_t i = 0; i < methods; i++) {
+    names[i] = "method" + std::to_string(i);
+    TEST_ASSERT_TRUE(tb.RPC_Subscribe(RPC_Callback(names[i].c_str(), on_set)));
+  }
+  const std::string payload = "{\"method\":\"" + names[methods - 1U] + "\",\"params\":1}";
+
+  const size_t rounds = 20000;
+  called = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rounds; i++) {
+    mqtt.receive("v1/devices/me/rpc/request/1", payload.c_str());
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  TEST_ASSERT_EQUAL(rounds, called);
+  return std::chrono::duration<double, std::nano>(elapsed).count() / rounds;
+}
+
+void test_dispatch_benchmark(void) {
+  const size_t amounts[] = { 1, 4, 16, 64, 256 };
+  double ns[5];
+  for (size_t i = 0; i < 5; i++) {
+    ns[i] = dispatch_ns(amounts[i]);
+  }
+  char message[200];
+  snprintf(message, sizeof(message), "ns per RPC request including parsing, methods 1: %.0f, 4: %.0f, 16: %.0f, 64: %.0f, 256: %.0f",
+           ns[0], ns[1], ns[2], ns[3], ns[4]);
+  TEST_MESSAGE(message);
+  // The lookup is a binary search, 256 methods only add a handful of hash comparisons to the parsing every request needs anyway
+  TEST_ASSERT_LESS_THAN(2.0 * ns[0], ns[4]);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_literal_hash_matches_runtime_hash);
+  RUN_TEST(test_prefix_of_a_name_does_not_answer);
+  RUN_TEST(test_names_with_the_same_hash_are_told_apart);
+  RUN_TEST(test_dispatch_benchmark);
+  return UNITY_END();
+}
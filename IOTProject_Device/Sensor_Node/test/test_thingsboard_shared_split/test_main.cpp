@@ -0,0 +1,197 @@
+#include <chrono>
+#include <stdlib.h>
+#include <new>
+#include <string>
+#include <unity.h>
+
+#include <MockMQTTClient.h>
+#include <ThingsBoard.h>
+
+#if THINGSBOARD_ENABLE_STL
+#error "Covers the comma seperated keys of non-STL builds, has to be built with THINGSBOARD_ENABLE_STL=0"
+#endif // THINGSBOARD_ENABLE_STL
+
+// Every heap allocation while counting is on, splitting and looking up the keys must not need any
+static bool counting = false;
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+  if (counting) {
+    allocations++;
+  }
+  void *memory = malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+// The non-STL Vector allocates with new[], which the sanitizers would otherwise intercept before it reaches operator new
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *memory) noexcept {
+  free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+  operator delete(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+  operator delete(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept {
+  operator delete(memory);
+}
+
+// Big enough for the 20 callbacks and the 50 keys of the benchmark update
+using TB = ThingsBoardSized<64>;
+
+static MockMQTTClient mqtt;
+static int first_called = 0;
+static int second_called = 0;
+static std::string received;  // Keys the first callback received, seperated by ;
+
+static void on_first(const Shared_Attribute_Data &data) {
+  first_called++;
+  received.clear();
+  for (const JsonPairConst kv : data) {
+    received += std::string(kv.key().c_str()) + ";";
+  }
+}
+
+static void on_second(const Shared_Attribute_Data &) {
+  second_called++;
+}
+
+static void update(const char *payload) {
+  mqtt.receive("v1/devices/me/attributes", payload);
+}
+
+void setUp(void) {
+  mqtt.clear();
+  mqtt.keep_messages = false;
+  first_called = 0;
+  second_called = 0;
+  received.clear();
+  counting = false;
+}
+
+void tearDown(void) {
+  counting = false;
+}
+
+void test_keys_only_match_whole_segments(void) {
+  TB tb(mqtt, 1024);
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback("a,bb", on_first)));
+
+  // Neither longer or shorter keys nor the comma seperated string itself are subscribed
+  update("{\"bbb\":1}");
+  update("{\"b\":1}");
+  update("{\"a,bb\":1}");
+  update("{\"ab\":1}");
+  TEST_ASSERT_EQUAL(0, first_called);
+
+  update("{\"bb\":1}");
+  TEST_ASSERT_EQUAL(1, first_called);
+  update("{\"a\":1}");
+  TEST_ASSERT_EQUAL(2, first_called);
+  // The keys point into the subscribed string, the filter has to copy them to keep only the subscribed ones
+  update("{\"bbb\":1,\"bb\":2,\"a\":3,\"c\":4}");
+  TEST_ASSERT_EQUAL(3, first_called);
+  TEST_ASSERT_EQUAL_STRING("bb;a;", received.c_str());
+}
+
+void test_first_and_last_segment(void) {
+  TB tb(mqtt, 1024);
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback("first,middle,last", on_first)));
+  update("{\"first\":1}");
+  update("{\"middle\":1}");
+  update("{\"last\":1}");
+  TEST_ASSERT_EQUAL(3, first_called);
+  update("{\"firs\":1,\"last,\":1,\"ast\":1}");
+  TEST_ASSERT_EQUAL(3, first_called);
+}
+
+void test_shared_keys_reach_every_callback(void) {
+  TB tb(mqtt, 1024);
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback("x,y", on_first)));
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback("y,z", on_second)));
+  update("{\"y\":1}");
+  TEST_ASSERT_EQUAL(1, first_called);
+  TEST_ASSERT_EQUAL(1, second_called);
+  update("{\"shared\":{\"z\":1}}");
+  TEST_ASSERT_EQUAL(1, first_called);
+  TEST_ASSERT_EQUAL(2, second_called);
+  // Two matching keys still call each callback only once
+  update("{\"x\":1,\"y\":2,\"z\":3}");
+  TEST_ASSERT_EQUAL(2, first_called);
+  TEST_ASSERT_EQUAL(3, second_called);
+}
+
+void test_callback_without_keys_receives_everything(void) {
+  TB tb(mqtt, 1024);
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback(nullptr, on_first)));
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback("y", on_second)));
+  update("{\"x\":1,\"y\":2}");
+  TEST_ASSERT_EQUAL(1, first_called);
+  TEST_ASSERT_EQUAL(1, second_called);
+  TEST_ASSERT_EQUAL_STRING("x;y;", received.c_str());
+}
+
+void test_update_benchmark(void) {
+  static TB tb(mqtt, 2048);
+  // 50 keys k0 to k49, each of the 20 callbacks subscribes 5 of them, so every key is wanted by 2 callbacks
+  static char keys[20][40];
+  for (size_t c = 0; c < 20; c++) {
+    int written = 0;
+    for (size_t k = 0; k < 5; k++) {
+      written += snprintf(keys[c] + written, sizeof(keys[c]) - written, k == 0 ? "k%u" : ",k%u", static_cast<unsigned>((c * 5 + k * 10) % 50));
+    }
+  }
+
+  counting = true;
+  allocations = 0;
+  for (size_t c = 0; c < 20; c++) {
+    TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(Shared_Attribute_Callback(keys[c], on_second)));
+  }
+  counting = false;
+  const size_t subscribe_allocations = allocations;
+
+  std::string payload = "{";
+  for (size_t k = 0; k < 50; k++) {
+    payload += (k == 0 ? "\"k" : ",\"k") + std::to_string(k) + "\":" + std::to_string(k);
+  }
+  payload += "}";
+
+  const size_t messages = 2000;
+  allocations = 0;
+  counting = true;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < messages; i++) {
+    update(payload.c_str());
+  }
+  const auto end = std::chrono::steady_clock::now();
+  counting = false;
+  TEST_ASSERT_EQUAL(20 * messages, second_called);
+
+  char message[200];
+  snprintf(message, sizeof(message), "50 keys, 20 callbacks: %.0f ns and %u allocations per update, %u allocations for all subscribes",
+           std::chrono::duration<double, std::nano>(end - start).count() / messages,
+           static_cast<unsigned>(allocations / messages), static_cast<unsigned>(subscribe_allocations));
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL(0, allocations);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_keys_only_match_whole_segments);
+  RUN_TEST(test_first_and_last_segment);
+  RUN_TEST(test_shared_keys_reach_every_callback);
+  RUN_TEST(test_callback_without_keys_receives_everything);
+  RUN_TEST(test_update_benchmark);
+  return UNITY_END();
+}
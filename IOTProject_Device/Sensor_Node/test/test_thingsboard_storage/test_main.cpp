@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <new>
+#include <unity.h>
+
+#include <MockMQTTClient.h>
+#include <ThingsBoard.h>
+
+// Every heap allocation and release while counting is on, to show which storage policy touches the heap
+static bool counting = false;
+static size_t allocations = 0;
+static size_t releases = 0;
+
+void *operator new(size_t size) {
+  if (counting) {
+    allocations++;
+  }
+  void *memory = malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void *memory) noexcept {
+  if (counting && memory != nullptr) {
+    releases++;
+  }
+  free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+  operator delete(memory);
+}
+
+static void start_counting() {
+  allocations = 0;
+  releases = 0;
+  counting = true;
+}
+
+static void stop_counting() {
+  counting = false;
+}
+
+using Static_TB = ThingsBoardSized<32, ThingsBoardDefaultLogger, Static_Storage<32, 64>>;
+using Dynamic_TB = ThingsBoardSized<32, ThingsBoardDefaultLogger, Dynamic_Storage>;
+
+static MockMQTTClient mqtt;
+static int called = 0;
+static const char *const methods[] = { "m0", "m1", "m2", "m3", "m4", "m5", "m6", "m7", "m8", "m9", "m10", "m11", "m12", "m13", "m14", "m15",
+  "m16", "m17", "m18", "m19", "m20", "m21", "m22", "m23", "m24", "m25", "m26", "m27", "m28", "m29", "m30", "m31", "m32" };
+
+static RPC_Response on_rpc(const RPC_Data &) {
+  called++;
+  return RPC_Response();
+}
+
+static void on_shared(const Shared_Attribute_Data &) {
+  called++;
+}
+
+void setUp(void) {
+  mqtt.clear();
+  mqtt.keep_messages = false;
+  called = 0;
+}
+
+void tearDown(void) {
+  stop_counting();
+}
+
+void test_static_storage_subscribe_never_allocates(void) {
+  static Static_TB tb(mqtt, 256);
+  RPC_Callback callbacks[32];
+  for (size_t i = 0; i < 32; i++) {
+    callbacks[i] = RPC_Callback(methods[i], on_rpc);
+  }
+
+  start_counting();
+  for (size_t i = 0; i < 32; i++) {
+    TEST_ASSERT_TRUE(tb.RPC_Subscribe(callbacks[i]));
+  }
+  stop_counting();
+  TEST_ASSERT_EQUAL(0, allocations);
+  TEST_ASSERT_FALSE(tb.RPC_Subscribe(RPC_Callback(methods[32], on_rpc)));
+  tb.RPC_Unsubscribe();
+}
+
+void test_rpc_range_over_capacity_inserts_nothing(void) {
+  static Static_TB tb(mqtt, 256);
+  const std::vector<RPC_Callback> first(30, RPC_Callback(methods[0], on_rpc));
+  TEST_ASSERT_TRUE(tb.RPC_Subscribe(first.cbegin(), first.cend()));
+  const unsigned subscribes = mqtt.subscribes;
+
+  // 30 + 3 exceeds the capacity of 32, none of them may be subscribed
+  const std::vector<RPC_Callback> second = { RPC_Callback(methods[1], on_rpc), RPC_Callback(methods[2], on_rpc), RPC_Callback(methods[3], on_rpc) };
+  TEST_ASSERT_FALSE(tb.RPC_Subscribe(second.cbegin(), second.cend()));
+  TEST_ASSERT_EQUAL(subscribes, mqtt.subscribes);
+  mqtt.receive("v1/devices/me/rpc/request/1", "{\"method\":\"m1\",\"params\":1}");
+  TEST_ASSERT_EQUAL(0, called);
+
+  // The remaining 2 still fit
+  TEST_ASSERT_TRUE(tb.RPC_Subscribe(second.cbegin(), second.cbegin() + 2));
+  mqtt.receive("v1/devices/me/rpc/request/2", "{\"method\":\"m1\",\"params\":1}");
+  TEST_ASSERT_EQUAL(1, called);
+  tb.RPC_Unsubscribe();
+}
+
+void test_shared_attributes_range_over_key_capacity_inserts_nothing(void) {
+  static Static_TB tb(mqtt, 256);
+  const std::vector<const char *> keys(methods, methods + 30);
+  const std::vector<Shared_Attribute_Callback> first = { Shared_Attribute_Callback(on_shared, keys.cbegin(), keys.cend()),
+    Shared_Attribute_Callback(on_shared, keys.cbegin(), keys.cend()) };
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(first.cbegin(), first.cend()));
+
+  // Only 2 callbacks of 32 are used, but 60 + 3 + 3 keys exceed the capacity of 64 keys, none of them may be subscribed
+  const std::vector<const char *> more(methods + 30, methods + 33);
+  const std::vector<Shared_Attribute_Callback> second = { Shared_Attribute_Callback(on_shared, more.cbegin(), more.cend()),
+    Shared_Attribute_Callback(on_shared, more.cbegin(), more.cend()) };
+  TEST_ASSERT_FALSE(tb.Shared_Attributes_Subscribe(second.cbegin(), second.cend()));
+  mqtt.receive("v1/devices/me/attributes", "{\"m31\":1}");
+  TEST_ASSERT_EQUAL(0, called);
+
+  TEST_ASSERT_TRUE(tb.Shared_Attributes_Subscribe(second.cbegin(), second.cbegin() + 1));
+  mqtt.receive("v1/devices/me/attributes", "{\"m31\":1}");
+  TEST_ASSERT_EQUAL(1, called);
+  tb.Shared_Attributes_Unsubscribe();
+}
+
+void test_single_subscribe_checks_before_subscribing_topic(void) {
+  static Static_TB tb(mqtt, 256);
+  const std::vector<RPC_Callback> all(32, RPC_Callback(methods[0], on_rpc));
+  TEST_ASSERT_TRUE(tb.RPC_Subscribe(all.cbegin(), all.cend()));
+  const unsigned subscribes = mqtt.subscribes;
+  TEST_ASSERT_FALSE(tb.RPC_Subscribe(RPC_Callback(methods[1], on_rpc)));
+  TEST_ASSERT_EQUAL(subscribes, mqtt.subscribes);
+  tb.RPC_Unsubscribe();
+}
+
+// Heap blocks allocated while setting up a typical subscription set and while receiving messages afterwards.
+// Blocks freed during setup are holes between the ones that stay, which a long running device can not always reuse
+struct Heap_Usage {
+  size_t setup_allocations;
+  size_t setup_releases;
+  size_t receive_allocations;
+};
+
+template <typename TB>
+static Heap_Usage measure(const char *name) {
+  Heap_Usage usage = {};
+  const std::vector<const char *> keys(methods, methods + 4);
+  const Shared_Attribute_Callback shared(on_shared, keys.cbegin(), keys.cend());
+  start_counting();
+  {
+    TB tb(mqtt, 256);
+    for (size_t i = 0; i < 16; i++) {
+      tb.RPC_Subscribe(RPC_Callback(methods[i], on_rpc));
+    }
+    for (size_t i = 0; i < 8; i++) {
+      tb.Shared_Attributes_Subscribe(shared);
+    }
+    usage.setup_allocations = allocations;
+    usage.setup_releases = releases;
+
+    allocations = 0;
+    for (size_t i = 0; i < 100; i++) {
+      mqtt.receive("v1/devices/me/rpc/request/1", "{\"method\":\"m3\",\"params\":1}");
+      mqtt.receive("v1/devices/me/attributes", "{\"m2\":1}");
+    }
+    usage.receive_allocations = allocations;
+  }
+  stop_counting();
+
+  char message[160];
+  snprintf(message, sizeof(message), "%s: setup %zu allocations, %zu freed again, 200 received messages %zu allocations",
+    name, usage.setup_allocations, usage.setup_releases, usage.receive_allocations);
+  TEST_MESSAGE(message);
+  return usage;
+}
+
+void test_heap_allocations_by_storage_policy(void) {
+  const Heap_Usage fixed = measure<Static_TB>("Static_Storage");
+  const Heap_Usage dynamic = measure<Dynamic_TB>("Dynamic_Storage");
+  // Each message calls the RPC callback and all 8 shared attribute callbacks
+  TEST_ASSERT_EQUAL(2 * 100 * 9, called);
+
+  // Handing the bound message callback to the client allocates it and a temporary copy, and with STL every copied
+  // Shared_Attribute_Callback still allocates its own vector of keys, nothing else may touch the heap
+  TEST_ASSERT_EQUAL(2 + 8, fixed.setup_allocations);
+  TEST_ASSERT_EQUAL(2, fixed.setup_releases);
+  TEST_ASSERT_GREATER_THAN(fixed.setup_releases, dynamic.setup_releases);
+  TEST_ASSERT_LESS_THAN(dynamic.setup_allocations, fixed.setup_allocations);
+  TEST_ASSERT_EQUAL(0, fixed.receive_allocations);
+  TEST_ASSERT_EQUAL(0, dynamic.receive_allocations);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_static_storage_subscribe_never_allocates);
+  RUN_TEST(test_rpc_range_over_capacity_inserts_nothing);
+  RUN_TEST(test_shared_attributes_range_over_key_capacity_inserts_nothing);
+  RUN_TEST(test_single_subscribe_checks_before_subscribing_topic);
+  RUN_TEST(test_heap_allocations_by_storage_policy);
+  return UNITY_END();
+}
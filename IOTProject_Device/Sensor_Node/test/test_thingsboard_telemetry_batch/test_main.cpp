@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <chrono>
+#include <new>
+#include <string>
+#include <unity.h>
+
+#include <MockMQTTClient.h>
+#include <ThingsBoard.h>
+
+// Every heap allocation while counting is on, filling a batch must never touch the heap
+static bool counting = false;
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+  if (counting) {
+    allocations++;
+  }
+  void *memory = malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void *memory) noexcept {
+  free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+  free(memory);
+}
+
+using Batch = Telemetry_Batch<4, 8>;
+
+static MockMQTTClient mqtt;
+
+static const char *const expected_batch = "[{\"ts\":1451649600512,\"values\":{\"temperature\":21.5,\"humidity\":40,\"ok\":true}},"
+  "{\"ts\":1451649600513,\"values\":{\"temperature\":22,\"humidity\":41,\"status\":\"a\\\"b\"}}]";
+
+// Keys are only referenced by the batch, these copies stay valid for the whole test and are different pointers than the literals
+static const std::string status_key = "status";
+static const std::string humidity_key = "humidity";
+
+// Two timestamps, where the second one reuses a key through a different pointer and adds a key the first one does not have
+static void fill(Batch &batch) {
+  TEST_ASSERT_TRUE(batch.Add_Timestamp(1451649600512ULL));
+  TEST_ASSERT_TRUE(batch.Add_Value("temperature", 21.5));
+  TEST_ASSERT_TRUE(batch.Add_Value("humidity", 40));
+  TEST_ASSERT_TRUE(batch.Add_Value("ok", true));
+  TEST_ASSERT_TRUE(batch.Add_Timestamp(1451649600513ULL));
+  TEST_ASSERT_TRUE(batch.Add_Value("temperature", 22.0f));
+  TEST_ASSERT_TRUE(batch.Add_Value(status_key.c_str(), "a\"b"));
+  TEST_ASSERT_TRUE(batch.Add_Value(humidity_key.c_str(), 41));
+}
+
+void setUp(void) {
+  mqtt.clear();
+  counting = false;
+}
+
+void tearDown(void) {
+  counting = false;
+}
+
+void test_value_without_timestamp_is_rejected(void) {
+  Batch batch;
+  TEST_ASSERT_FALSE(batch.Add_Value("temperature", 1));
+  TEST_ASSERT_FALSE(batch.Add_Value(nullptr, 1));
+  TEST_ASSERT_EQUAL(0, batch.Key_Count());
+}
+
+void test_limits_and_type_mismatch_are_rejected(void) {
+  Batch batch;
+  fill(batch);
+  TEST_ASSERT_EQUAL(4, batch.Key_Count());
+  TEST_ASSERT_EQUAL(2, batch.Timestamp_Count());
+  // humidity has been added as an integer before
+  TEST_ASSERT_FALSE(batch.Add_Value("humidity", 1.5));
+  // All 4 key columns are used
+  TEST_ASSERT_FALSE(batch.Add_Value("fifth", 1));
+
+  for (size_t i = 2; i < 8; i++) {
+    TEST_ASSERT_TRUE(batch.Add_Timestamp(i));
+  }
+  TEST_ASSERT_FALSE(batch.Add_Timestamp(8));
+  TEST_ASSERT_EQUAL(8, batch.Timestamp_Count());
+}
+
+void test_filling_never_allocates(void) {
+  static Batch batch;
+  allocations = 0;
+  counting = true;
+  fill(batch);
+  counting = false;
+  TEST_ASSERT_EQUAL(0, allocations);
+}
+
+void test_send_serializes_all_timestamps(void) {
+  ThingsBoard tb(mqtt, 4096);
+  Batch batch;
+  fill(batch);
+  TEST_ASSERT_TRUE(tb.sendTelemetryBatch(batch));
+  TEST_ASSERT_EQUAL(1, mqtt.published.size());
+  TEST_ASSERT_EQUAL_STRING("v1/devices/me/telemetry", mqtt.published.back().topic.c_str());
+  TEST_ASSERT_EQUAL_STRING(expected_batch, mqtt.published.back().payload.c_str());
+  TEST_ASSERT_EQUAL(strlen(expected_batch) + 1, batch.Measure_Json());
+}
+
+void test_serialize_into_small_buffer_is_truncated(void) {
+  Batch batch;
+  fill(batch);
+  char small[10];
+  TEST_ASSERT_EQUAL(9, batch.Serialize_Json(small, sizeof(small)));
+  TEST_ASSERT_EQUAL_STRING("[{\"ts\":14", small);
+  TEST_ASSERT_EQUAL(0, batch.Serialize_Json(small, 0));
+}
+
+void test_batch_over_buffer_size_is_not_sent(void) {
+  ThingsBoard tb(mqtt, 4096);
+  Batch batch;
+  fill(batch);
+  mqtt.buffer_size = 50;
+  TEST_ASSERT_FALSE(tb.sendTelemetryBatch(batch));
+  TEST_ASSERT_EQUAL(0, mqtt.publishes);
+}
+
+void test_clear_keeps_keys(void) {
+  ThingsBoard tb(mqtt, 4096);
+  Batch batch;
+  fill(batch);
+  batch.Clear();
+  TEST_ASSERT_EQUAL(0, batch.Timestamp_Count());
+  TEST_ASSERT_EQUAL(4, batch.Key_Count());
+  TEST_ASSERT_TRUE(tb.sendTelemetryBatch(batch));
+  TEST_ASSERT_EQUAL_STRING("[]", mqtt.published.back().payload.c_str());
+
+  // Values of the previous batch do not show up for timestamps that did not set them
+  TEST_ASSERT_TRUE(batch.Add_Timestamp(1));
+  TEST_ASSERT_TRUE(batch.Add_Value("ok", false));
+  TEST_ASSERT_TRUE(tb.sendTelemetryBatch(batch));
+  TEST_ASSERT_EQUAL_STRING("[{\"ts\":1,\"values\":{\"ok\":false}}]", mqtt.published.back().payload.c_str());
+}
+
+// Payload bytes of all messages published since the mock was cleared
+static size_t published_bytes() {
+  size_t bytes = 0;
+  for (const MockMQTTClient::Message &message : mqtt.published) {
+    bytes += message.payload.size();
+  }
+  return bytes;
+}
+
+// 8 timestamps of 4 keys, sent as a single batch compared to one sendTelemetry() call per timestamp.
+// The batch is measured before it is serialized and carries the timestamps of the measurements, so it costs more CPU and payload bytes,
+// but replaces 8 messages, each with its own topic and round trip, with 1
+void test_batch_benchmark(void) {
+  const size_t iterations = 20000;
+  ThingsBoard tb(mqtt, 4096);
+  static Batch batch;
+
+  for (size_t i = 0; i < 8; i++) {
+    batch.Add_Timestamp(1000 + i);
+    batch.Add_Value("temperature", 20.0 + i);
+    batch.Add_Value("humidity", 40 + i);
+    batch.Add_Value("ok", true);
+    batch.Add_Value("status", "fine");
+  }
+  TEST_ASSERT_TRUE(tb.sendTelemetryBatch(batch));
+  const size_t batch_bytes = published_bytes();
+  mqtt.clear();
+  for (size_t i = 0; i < 8; i++) {
+    const Telemetry data[] = { Telemetry("temperature", 20.0 + i), Telemetry("humidity", 40 + i), Telemetry("ok", true), Telemetry("status", "fine") };
+    TEST_ASSERT_TRUE(tb.sendTelemetry(data, 4));
+  }
+  const size_t single_bytes = published_bytes();
+  mqtt.clear();
+  mqtt.keep_messages = false;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t n = 0; n < iterations; n++) {
+    batch.Clear();
+    for (size_t i = 0; i < 8; i++) {
+      batch.Add_Timestamp(1000 + i);
+      batch.Add_Value("temperature", 20.0 + i);
+      batch.Add_Value("humidity", 40 + i);
+      batch.Add_Value("ok", true);
+      batch.Add_Value("status", "fine");
+    }
+    TEST_ASSERT_TRUE(tb.sendTelemetryBatch(batch));
+  }
+  const auto batched = std::chrono::steady_clock::now();
+  for (size_t n = 0; n < iterations; n++) {
+    for (size_t i = 0; i < 8; i++) {
+      const Telemetry data[] = { Telemetry("temperature", 20.0 + i), Telemetry("humidity", 40 + i), Telemetry("ok", true), Telemetry("status", "fine") };
+      TEST_ASSERT_TRUE(tb.sendTelemetry(data, 4));
+    }
+  }
+  const auto end = std::chrono::steady_clock::now();
+  TEST_ASSERT_EQUAL(iterations * 9, mqtt.publishes);
+
+  const double batch_ns = std::chrono::duration<double, std::nano>(batched - start).count() / iterations;
+  const double single_ns = std::chrono::duration<double, std::nano>(end - batched).count() / iterations;
+  char message[192];
+  snprintf(message, sizeof(message), "8 timestamps of 4 keys: 1 batch %.0f ns %zu bytes, 8x sendTelemetry %.0f ns %zu bytes in 8 messages",
+    batch_ns, batch_bytes, single_ns, single_bytes);
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_value_without_timestamp_is_rejected);
+  RUN_TEST(test_limits_and_type_mismatch_are_rejected);
+  RUN_TEST(test_filling_never_allocates);
+  RUN_TEST(test_send_serializes_all_timestamps);
+  RUN_TEST(test_serialize_into_small_buffer_is_truncated);
+  RUN_TEST(test_batch_over_buffer_size_is_not_sent);
+  RUN_TEST(test_clear_keeps_keys);
+  RUN_TEST(test_batch_benchmark);
+  return UNITY_END();
+}